@@ -151,7 +151,10 @@ void run()
 	renderer->set_camera(&cam);
 	assert(renderer->complete());
 
-	renderer->setSkybox(loadImageCube(renderer->get_context(), "assets/PaperMill_Ruins_E/PaperMill_E_3k.hdr", false));
+	const char* skyboxNames[] = {"assets/PaperMill_Ruins_E/PaperMill_E_3k.hdr",
+								 "assets/Walk_Of_Fame/Mans_Outside_2k.hdr"};
+	int skyboxIndex = 0;
+	renderer->setSkybox(skyboxNames[skyboxIndex]);
 
 	modelLoader = make_unique<ModelLoader>();
 	struct SceneInfo
@@ -169,6 +172,7 @@ void run()
 			float brightness{1.0f};
 			float radius{1};
 			bool hasShadow{false};
+			bool dualParaboloid{false};
 
 			bool draw()
 			{
@@ -178,6 +182,7 @@ void run()
 				edited |= ImGui::DragFloat("Brightness##POINT", &brightness, 0.01f, 0.0f, 16.0f);
 				edited |= ImGui::DragFloat("Radius##POINT", &radius, 0.1f, 0.1f, 100.0f);
 				edited |= ImGui::Checkbox("Enable Shadow##POINT", &hasShadow);
+				edited |= ImGui::Checkbox("Dual Paraboloid##POINT", &dualParaboloid);
 				return edited;
 			}
 		};
@@ -237,6 +242,10 @@ void run()
 					lights.push_back(editable);
 					auto handle = renderer->get_lightCaster()->createPointLight(editable.pos, editable.color * editable.brightness,
 																				editable.radius, editable.hasShadow);
+					if (handle != 0)
+					{
+						renderer->get_lightCaster()->setDualParaboloid(handle, editable.dualParaboloid);
+					}
 					pointHandles.push_back(handle);
 
 					editable.color = glm::vec3(1.0f);
@@ -244,6 +253,7 @@ void run()
 					editable.brightness = 1.0f;
 					editable.radius = 1.0f;
 					editable.hasShadow = false;
+					editable.dualParaboloid = false;
 				}
 				if (toUpdate >= 0)
 				{
@@ -253,6 +263,7 @@ void run()
 					renderer->get_lightCaster()->setColor(h, glm::vec3(l.color) * l.brightness);
 					renderer->get_lightCaster()->setRadius(h, l.radius);
 					l.hasShadow = renderer->get_lightCaster()->setShadow(h, l.hasShadow);
+					renderer->get_lightCaster()->setDualParaboloid(h, l.dualParaboloid);
 				}
 			}
 			else if (type == ALightCaster::Type::DIRECTIONAL)
@@ -310,7 +321,8 @@ void run()
 	std::map<int, std::shared_ptr<Model>> modelHolder;
 
 	auto mod = modelHolder[holderKey++] =
-		modelLoader->loadModel(renderer->get_context(), renderer->get_shader(), sceneInfo.modelIndex);
+		modelLoader->loadModel(renderer->get_context(), renderer->get_shader(), sceneInfo.modelIndex,
+							   renderer->get_textureHeap(), renderer->get_geometryArena());
 	auto handle = renderer->submit(mod.get());
 
 	// Run
@@ -429,10 +441,11 @@ void run()
 							{
 								sceneInfo.modelIndex = i;
 								sceneInfo.modelName = label;
-								handle.destroy();
+								renderer->remove(handle);
 								auto mod = modelHolder[holderKey++] =
 									modelLoader->loadModel(renderer->get_context(), renderer->get_shader(),
-															sceneInfo.modelIndex); // TODO
+															sceneInfo.modelIndex, renderer->get_textureHeap(),
+															renderer->get_geometryArena()); // TODO
 								handle = renderer->submit(mod.get());
 								renderer->waitIdle();
 								modelHolder.erase(holderKey - 2);
@@ -446,6 +459,13 @@ void run()
 						}
 						ImGui::EndCombo();
 					}
+					ImGui::Checkbox("Static Batching", &modelLoader->staticBatching);
+
+					// Baked over a few frames while the current skybox stays in use.
+					if (ImGui::Combo("Skybox##Combo", &skyboxIndex, skyboxNames, IM_ARRAYSIZE(skyboxNames)))
+					{
+						renderer->updateSkybox(skyboxNames[skyboxIndex]);
+					}
 
 					if (ImGui::CollapsingHeader("Lights"))
 					{
@@ -165,20 +165,6 @@ struct CascadeUBlock
 };
 /// @}
 
-/**
- * @struct ModelPushConstantBlock
- *
- * @brief PCB for sending Model matrix to the GPU.
- *
- * @addtogroup PushConstantBlocks
- * @{
- */
-struct ModelPushConstantBlock
-{
-	glm::mat4 model;
-};
-/// @}
-
 /**
  * @struct ShadowPushConstantBlock
  *
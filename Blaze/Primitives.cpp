@@ -1,6 +1,9 @@
 
 #include "Primitives.hpp"
 
+#include <cassert>
+#include <cmath>
+
 namespace blaze
 {
 IndexedVertexBuffer<Vertex> getUVCube(const Context* context)
@@ -127,4 +130,38 @@ IndexedVertexBuffer<Vertex> getIcoSphere(const Context* context)
 	};
 	return IndexedVertexBuffer(context, indices, vertices);
 }
+
+IndexedVertexBuffer<Vertex> getCone(const Context* context, uint32_t segments)
+{
+	assert(segments >= 3);
+
+	constexpr float PI = 3.14159265358979f;
+	const float step = 2.0f * PI / static_cast<float>(segments);
+	// The corners of the base are pushed out so that its edges touch the unit circle.
+	const float cornerRadius = 1.0f / std::cos(0.5f * step);
+
+	// The apex, the center of the base, then the corners of the base.
+	std::vector<Vertex> vertices;
+	vertices.reserve(segments + 2);
+	vertices.push_back({{0.0f, 0.0f, 0.0f}, {0.0f, 0.0f, -1.0f}});
+	vertices.push_back({{0.0f, 0.0f, 1.0f}, {0.0f, 0.0f, 1.0f}});
+	for (uint32_t i = 0; i < segments; ++i)
+	{
+		const float angle = step * static_cast<float>(i);
+		const glm::vec3 corner = {cornerRadius * std::cos(angle), cornerRadius * std::sin(angle), 1.0f};
+		vertices.push_back({corner, glm::normalize(glm::vec3(corner.x, corner.y, -1.0f))});
+	}
+
+	// Counter clockwise from the outside, as the IcoSphere.
+	std::vector<uint32_t> indices;
+	indices.reserve(6 * segments);
+	for (uint32_t i = 0; i < segments; ++i)
+	{
+		const uint32_t corner = 2 + i;
+		const uint32_t next = 2 + (i + 1) % segments;
+		indices.insert(indices.end(), {0, next, corner});
+		indices.insert(indices.end(), {1, corner, next});
+	}
+	return IndexedVertexBuffer(context, indices, vertices);
+}
 } // namespace blaze
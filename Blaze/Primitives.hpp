@@ -39,4 +39,19 @@ IndexedVertexBuffer<Vertex> getUVRect(const Context* context);
  * @returns IndexedVertexBuffer of Vertex for the IcoSphere
  */
 IndexedVertexBuffer<Vertex> getIcoSphere(const Context* context);
+
+/**
+ * @fn getCone
+ *
+ * @brief Creates a simple vertex buffer for a closed Cone
+ *
+ * The apex is at the origin and the base is at z = 1. The base circumscribes the unit circle,
+ * so the cone contains the round cone of the same height and a base of radius 1.
+ *
+ * @param context the current Vulkan Context
+ * @param segments the number of sides of the base
+ *
+ * @returns IndexedVertexBuffer of Vertex for the Cone
+ */
+IndexedVertexBuffer<Vertex> getCone(const Context* context, uint32_t segments = 16);
 } // namespace blaze
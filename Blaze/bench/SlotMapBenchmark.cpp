@@ -0,0 +1,170 @@
+/**
+ * Compares util::SlotMap with util::PackedHandler, the container it replaced, on add, erase,
+ * iteration and lookup.
+ *
+ * Prints the average time per element of each operation for 1k, 10k and 100k elements.
+ */
+
+#include <util/PackedHandler.hpp>
+#include <util/SlotMap.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <numeric>
+#include <random>
+#include <vector>
+
+namespace
+{
+using namespace blaze::util;
+using Clock = std::chrono::steady_clock;
+
+/// Roughly the size of a light.
+struct Payload
+{
+	std::array<float, 16> values;
+};
+
+constexpr uint32_t ITERATIONS = 20;
+
+/// Keeps the results alive, so the timed loops aren't optimized away.
+volatile float sink;
+
+template <typename F>
+double timeNs(F&& func)
+{
+	auto start = Clock::now();
+	func();
+	return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+}
+
+struct Results
+{
+	double add{0};
+	double iterate{0};
+	double lookup{0};
+	double erase{0};
+};
+
+Payload makePayload(uint32_t i)
+{
+	Payload payload;
+	payload.values.fill(static_cast<float>(i));
+	return payload;
+}
+
+Results benchSlotMap(uint32_t count, const std::vector<uint32_t>& order)
+{
+	Results results;
+	for (uint32_t iteration = 0; iteration < ITERATIONS; iteration++)
+	{
+		SlotMap<Payload> map;
+		std::vector<SlotMap<Payload>::Handle> handles(count);
+
+		results.add += timeNs([&] {
+			for (uint32_t i = 0; i < count; i++)
+			{
+				handles[i] = map.add(makePayload(i));
+			}
+		});
+
+		results.iterate += timeNs([&] {
+			float sum = 0.0f;
+			for (const auto& payload : map)
+			{
+				sum += payload.values[0];
+			}
+			sink = sum;
+		});
+
+		results.lookup += timeNs([&] {
+			float sum = 0.0f;
+			for (uint32_t i : order)
+			{
+				sum += map.get(handles[i])->values[0];
+			}
+			sink = sum;
+		});
+
+		results.erase += timeNs([&] {
+			for (uint32_t i : order)
+			{
+				map.remove(handles[i]);
+			}
+		});
+	}
+	return results;
+}
+
+Results benchPackedHandler(uint32_t count, const std::vector<uint32_t>& order)
+{
+	Results results;
+	for (uint32_t iteration = 0; iteration < ITERATIONS; iteration++)
+	{
+		// The handles point back to the handler, so it must not move.
+		PackedHandler<Payload> handler;
+		std::vector<PackedHandler<Payload>::Handle> handles(count);
+
+		results.add += timeNs([&] {
+			for (uint32_t i = 0; i < count; i++)
+			{
+				handles[i] = handler.add(makePayload(i));
+			}
+		});
+
+		results.iterate += timeNs([&] {
+			float sum = 0.0f;
+			for (const auto& payload : handler)
+			{
+				sum += payload.values[0];
+			}
+			sink = sum;
+		});
+
+		results.lookup += timeNs([&] {
+			float sum = 0.0f;
+			for (uint32_t i : order)
+			{
+				sum += handles[i].get().values[0];
+			}
+			sink = sum;
+		});
+
+		results.erase += timeNs([&] {
+			for (uint32_t i : order)
+			{
+				handles[i].destroy();
+			}
+		});
+	}
+	return results;
+}
+
+void print(const char* name, uint32_t count, const Results& results)
+{
+	const double scale = 1.0 / (static_cast<double>(count) * ITERATIONS);
+	printf("%-14s %7u %10.2f %10.2f %10.2f %10.2f\n", name, count, results.add * scale, results.iterate * scale,
+		   results.lookup * scale, results.erase * scale);
+}
+} // namespace
+
+int main()
+{
+	printf("%-14s %7s %10s %10s %10s %10s\n", "container", "count", "add ns", "iterate ns", "lookup ns",
+		   "erase ns");
+
+	std::mt19937 rng(42);
+	for (uint32_t count : {1000u, 10000u, 100000u})
+	{
+		// Lookups and erases in a random order, as removals of lights and drawables are.
+		std::vector<uint32_t> order(count);
+		std::iota(order.begin(), order.end(), 0u);
+		std::shuffle(order.begin(), order.end(), rng);
+
+		print("SlotMap", count, benchSlotMap(count, order));
+		print("PackedHandler", count, benchPackedHandler(count, order));
+	}
+	return 0;
+}
@@ -190,6 +190,10 @@ public:
 	{
 		return aspect;
 	}
+	inline const glm::vec2& get_screenSize() const
+	{
+		return screenSize;
+	}
 	inline void set_screenSize(const glm::vec2& screen_size)
 	{
 		aspect = screen_size.x / screen_size.y;
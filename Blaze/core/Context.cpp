@@ -213,6 +213,64 @@ vkw::PhysicalDevice Context::getPhysicalDevice() const
 	throw std::runtime_error("Suitable Device Not Found");
 }
 
+VkPhysicalDeviceFeatures Context::getEnabledFeatures() const
+{
+	VkPhysicalDeviceFeatures supportedFeatures;
+	vkGetPhysicalDeviceFeatures(physicalDevice.get(), &supportedFeatures);
+
+	VkPhysicalDeviceFeatures deviceFeatures = {};
+	deviceFeatures.samplerAnisotropy = VK_TRUE;
+	deviceFeatures.depthClamp = VK_TRUE;
+	// Optional, used to draw all the meshlets of a primitive in one call.
+	deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+	// Optional, culled meshlet draws pass the primitive index in firstInstance.
+	deviceFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+
+	return deviceFeatures;
+}
+
+bool Context::checkDescriptorIndexingSupport() const
+{
+	uint32_t extensionCount = 0;
+	vkEnumerateDeviceExtensionProperties(physicalDevice.get(), nullptr, &extensionCount, nullptr);
+	std::vector<VkExtensionProperties> extensions(extensionCount);
+	vkEnumerateDeviceExtensionProperties(physicalDevice.get(), nullptr, &extensionCount, extensions.data());
+
+	bool hasExtension = false;
+	for (auto& extension : extensions)
+	{
+		if (std::string(extension.extensionName) == VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME)
+		{
+			hasExtension = true;
+			break;
+		}
+	}
+	if (!hasExtension)
+	{
+		return false;
+	}
+
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {};
+	indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+	VkPhysicalDeviceFeatures2 features = {};
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features.pNext = &indexingFeatures;
+	vkGetPhysicalDeviceFeatures2(physicalDevice.get(), &features);
+
+	VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexingProperties = {};
+	indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+	VkPhysicalDeviceProperties2 properties = {};
+	properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	properties.pNext = &indexingProperties;
+	vkGetPhysicalDeviceProperties2(physicalDevice.get(), &properties);
+
+	return indexingFeatures.runtimeDescriptorArray && indexingFeatures.descriptorBindingPartiallyBound &&
+		   indexingFeatures.descriptorBindingSampledImageUpdateAfterBind &&
+		   indexingFeatures.shaderSampledImageArrayNonUniformIndexing &&
+		   indexingProperties.maxPerStageDescriptorUpdateAfterBindSamplers >= spirv::MAX_RUNTIME_ARRAY_LENGTH &&
+		   indexingProperties.maxDescriptorSetUpdateAfterBindSamplers >= spirv::MAX_RUNTIME_ARRAY_LENGTH;
+}
+
 vkw::Device Context::createLogicalDevice() const
 {
 	std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
@@ -231,17 +289,28 @@ vkw::Device Context::createLogicalDevice() const
 		queueCreateInfos.push_back(createInfo);
 	}
 
-	VkPhysicalDeviceFeatures deviceFeatures = {};
-	deviceFeatures.samplerAnisotropy = VK_TRUE;
-	deviceFeatures.depthClamp = VK_TRUE;
-
 	VkDeviceCreateInfo createInfo = {};
 	createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 	createInfo.pQueueCreateInfos = queueCreateInfos.data();
 	createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
-	createInfo.pEnabledFeatures = &deviceFeatures;
-	createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-	createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+	createInfo.pEnabledFeatures = &enabledFeatures;
+
+	std::vector<const char*> extensions = deviceExtensions;
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {};
+	if (descriptorIndexing)
+	{
+		// VK_KHR_maintenance3, the only dependency, is core in 1.1
+		extensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+
+		indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+		indexingFeatures.runtimeDescriptorArray = VK_TRUE;
+		indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+		indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+		indexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+		createInfo.pNext = &indexingFeatures;
+	}
+	createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+	createInfo.ppEnabledExtensionNames = extensions.data();
 	if (enableValidationLayers)
 	{
 		createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
@@ -369,6 +438,8 @@ Context::Context(GLFWwindow* window, bool enableValidationLayers) noexcept
 		surface = createSurface(window);
 		physicalDevice = getPhysicalDevice();
 		queueFamilyIndices = util::getQueueFamilies(physicalDevice.get(), surface.get());
+		enabledFeatures = getEnabledFeatures();
+		descriptorIndexing = checkDescriptorIndexingSupport();
 		device = createLogicalDevice();
 		graphicsQueue = getQueue(queueFamilyIndices.graphicsIndex.value());
 		presentQueue = getQueue(queueFamilyIndices.presentIndex.value());
@@ -378,6 +449,7 @@ Context::Context(GLFWwindow* window, bool enableValidationLayers) noexcept
 			VkPhysicalDeviceProperties props;
 			vkGetPhysicalDeviceProperties(physicalDevice.get(), &props);
 			std::cout << "Using " << props.deviceName << std::endl;
+			std::cout << "Bindless textures " << (descriptorIndexing ? "enabled" : "unsupported") << std::endl;
 		}
 
 		allocator = createAllocator();
@@ -397,10 +469,11 @@ Context::Context(Context&& other) noexcept
 	: window(other.window), enableValidationLayers(other.enableValidationLayers), isComplete(other.isComplete),
 	  instance(std::move(other.instance)), debugMessenger(std::move(other.debugMessenger)),
 	  surface(std::move(other.surface)), physicalDevice(std::move(other.physicalDevice)),
-	  queueFamilyIndices(std::move(other.queueFamilyIndices)), device(std::move(other.device)),
-	  graphicsQueue(std::move(other.graphicsQueue)), presentQueue(std::move(other.presentQueue)),
-	  graphicsCommandPool(std::move(other.graphicsCommandPool)), allocator(std::move(other.allocator)),
-	  pipelineFactory(std::move(other.pipelineFactory))
+	  enabledFeatures(other.enabledFeatures), descriptorIndexing(other.descriptorIndexing),
+	  queueFamilyIndices(std::move(other.queueFamilyIndices)),
+	  device(std::move(other.device)), graphicsQueue(std::move(other.graphicsQueue)),
+	  presentQueue(std::move(other.presentQueue)), graphicsCommandPool(std::move(other.graphicsCommandPool)),
+	  allocator(std::move(other.allocator)), pipelineFactory(std::move(other.pipelineFactory))
 {
 }
 
@@ -417,6 +490,8 @@ Context& Context::operator=(Context&& other) noexcept
 	debugMessenger = std::move(other.debugMessenger);
 	surface = std::move(other.surface);
 	physicalDevice = std::move(other.physicalDevice);
+	enabledFeatures = other.enabledFeatures;
+	descriptorIndexing = other.descriptorIndexing;
 	queueFamilyIndices = std::move(other.queueFamilyIndices);
 	device = std::move(other.device);
 	graphicsQueue = std::move(other.graphicsQueue);
@@ -44,6 +44,8 @@ private:
 	vkw::DebugUtilsMessengerEXT debugMessenger;
 	vkw::SurfaceKHR surface;
 	vkw::PhysicalDevice physicalDevice;
+	VkPhysicalDeviceFeatures enabledFeatures{};
+	bool descriptorIndexing{false};
 	vkw::Device device;
 
 	util::QueueFamilyIndices queueFamilyIndices;
@@ -207,6 +209,15 @@ public:
 	{
 		return device.get();
 	}
+	inline const VkPhysicalDeviceFeatures& get_enabledFeatures() const
+	{
+		return enabledFeatures;
+	}
+	/// Whether VK_EXT_descriptor_indexing is enabled for runtime sized texture arrays.
+	inline bool get_descriptorIndexing() const
+	{
+		return descriptorIndexing;
+	}
 	inline const VkQueue& get_graphicsQueue() const
 	{
 		return graphicsQueue.get();
@@ -255,6 +266,8 @@ private:
 	void setupDebugMessenger();
 	vkw::SurfaceKHR createSurface(GLFWwindow* window) const;
 	vkw::PhysicalDevice getPhysicalDevice() const;
+	VkPhysicalDeviceFeatures getEnabledFeatures() const;
+	bool checkDescriptorIndexingSupport() const;
 	vkw::Device createLogicalDevice() const;
 	vkw::Queue getQueue(uint32_t index) const;
 	vkw::CommandPool createCommandPool(uint32_t queueIndex) const;
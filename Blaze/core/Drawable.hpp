@@ -4,8 +4,16 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
+#include <rendering/ClusterCuller.hpp>
+
+#include <cstdint>
+#include <limits>
+
 namespace blaze
 {
+class GeometryArena;
+class RenderQueue;
+
 /**
  * @interface Drawable
  *
@@ -14,58 +22,189 @@ namespace blaze
  * Renderer contains two kinds of draws:
  * \arg Full: Using material info.
  * \arg Geometry: Only using the vertex position.
+ *
+ * Per draw data (transforms, materials) is read by the shaders from storage buffers
+ * in the object set of the Drawable, bound at the set index \a objectSet of the pipeline.
  */
 class Drawable
 {
 public:
 	/**
-	 * @fn draw(VkCommandBuffer cb, VkPipelineLayout lay)
+	 * @fn draw(VkCommandBuffer cb, VkPipelineLayout lay, uint32_t objectSet)
 	 *
 	 * @brief Should draw the model with all the material and maps included.
 	 *
 	 * This method is used during the primary render and should bind
-	 * all the required buffers and textures and push material PCB.
+	 * all the required buffers, textures and the object set.
 	 *
 	 * @param cb The command buffer to record to.
 	 * @param lay The pipeline layout to bind descriptors.
+	 * @param objectSet The index of the object set in \a lay.
 	 */
-	virtual void draw(VkCommandBuffer cb, VkPipelineLayout lay) = 0;
+	virtual void draw(VkCommandBuffer cb, VkPipelineLayout lay, uint32_t objectSet) = 0;
 
 	/**
 	 * @brief Should draw the model with only the OPAQUE and MASK material and maps.
 	 *
 	 * This method is used during the primary render and should bind
-	 * all the required buffers and textures and push material PCB.
+	 * all the required buffers, textures and the object set.
 	 *
 	 * @param cb The command buffer to record to.
 	 * @param lay The pipeline layout to bind descriptors.
+	 * @param objectSet The index of the object set in \a lay.
 	 */
-	virtual void drawOpaque(VkCommandBuffer cb, VkPipelineLayout lay) = 0;
+	virtual void drawOpaque(VkCommandBuffer cb, VkPipelineLayout lay, uint32_t objectSet) = 0;
 
 	/**
 	 * @brief Should draw the model with only the BLEND material and maps.
 	 *
 	 * This method is used during the primary render and should bind
-	 * all the required buffers and textures and push material PCB.
+	 * all the required buffers, textures and the object set.
 	 *
 	 * @param cb The command buffer to record to.
 	 * @param lay The pipeline layout to bind descriptors.
+	 * @param objectSet The index of the object set in \a lay.
 	 */
-	virtual void drawAlphaBlended(VkCommandBuffer cb, VkPipelineLayout lay) = 0;
+	virtual void drawAlphaBlended(VkCommandBuffer cb, VkPipelineLayout lay, uint32_t objectSet) = 0;
 
 	/**
-	 * @fn drawGeometry(VkCommandBuffer cb, VkPipelineLayout lay)
+	 * @fn drawGeometry(VkCommandBuffer cb, VkPipelineLayout lay, uint32_t objectSet)
 	 *
 	 * @brief Should draw only the geometry and not bind any materials.
 	 *
 	 * @note SKIPS TRANSPARENCY
 	 *
 	 * This method is used for casting shadows and dowsn't require any information
-	 * beyond the position attribute of the Vertex and a model transformation PCB.
+	 * beyond the position attribute of the Vertex and the model transformation.
 	 *
 	 * @param cb The command buffer to record to.
 	 * @param lay The pipeline layout to bind descriptors.
+	 * @param objectSet The index of the object set in \a lay.
+	 */
+	virtual void drawGeometry(VkCommandBuffer cb, VkPipelineLayout lay, uint32_t objectSet) = 0;
+
+	/**
+	 * @fn enqueue(RenderQueue& queue, const glm::vec3& eye)
+	 *
+	 * @brief Should push an item for each of its draws of the CAMERA_VIEW into \a queue.
+	 *
+	 * The items are recorded with bind and drawItem, replacing drawOpaque and drawAlphaBlended.
+	 *
+	 * @param queue The RenderQueue of the frame.
+	 * @param eye The position of the camera, to compute the depth of the items.
+	 */
+	virtual void enqueue(RenderQueue& queue, const glm::vec3& eye) = 0;
+
+	/**
+	 * @fn bind(VkCommandBuffer cb, VkPipelineLayout lay, uint32_t objectSet)
+	 *
+	 * @brief Should bind the buffers and sets used by the items of the Drawable.
+	 *
+	 * A Drawable drawing from a GeometryArena does not bind it, the caller binds the arena
+	 * returned by get_geometryArena once for all the Drawables sharing it.
+	 *
+	 * @param cb The command buffer to record to.
+	 * @param lay The pipeline layout to bind descriptors.
+	 * @param objectSet The index of the object set in \a lay.
+	 */
+	virtual void bind(VkCommandBuffer cb, VkPipelineLayout lay, uint32_t objectSet) = 0;
+
+	/**
+	 * @fn drawItem(VkCommandBuffer cb, uint32_t element, uint32_t lod)
+	 *
+	 * @brief Should record the draw of an item pushed by enqueue. The Drawable is already bound.
+	 *
+	 * @param cb The command buffer to record to.
+	 * @param element The element of the item.
+	 * @param lod The detail level of the item.
+	 */
+	virtual void drawItem(VkCommandBuffer cb, uint32_t element, uint32_t lod) = 0;
+
+	/**
+	 * @fn get_geometryArena()
+	 *
+	 * @brief The GeometryArena holding the vertices and indices of the Drawable, if any.
+	 */
+	virtual const GeometryArena* get_geometryArena() const
+	{
+		return nullptr;
+	}
+
+	/// Version of a Drawable that doesn't track its changes, it is considered changed every frame.
+	constexpr static uint64_t UNTRACKED_VERSION = std::numeric_limits<uint64_t>::max();
+
+	/**
+	 * @fn get_version()
+	 *
+	 * @brief Should return a value that changes whenever what drawGeometry draws changes, eg. a transform.
+	 *
+	 * The versions must be unique across Drawables. Used with get_bounds to keep the cached shadows
+	 * of the lights that no changed Drawable touches.
+	 */
+	virtual uint64_t get_version() const
+	{
+		return UNTRACKED_VERSION;
+	}
+
+	/**
+	 * @fn get_bounds()
+	 *
+	 * @brief The bounding sphere of the Drawable in world space, xyz is the center and w the radius.
+	 */
+	virtual glm::vec4 get_bounds() const
+	{
+		return glm::vec4(0.0f, 0.0f, 0.0f, std::numeric_limits<float>::infinity());
+	}
+
+	/**
+	 * @fn upload(VkCommandBuffer cb)
+	 *
+	 * @brief Records the transfers of the per frame data read by the draws, eg. transforms.
+	 *
+	 * Must be called once per frame outside of a render pass, before any draw or cull of the frame.
+	 *
+	 * @param cb The command buffer to record to.
+	 */
+	virtual void upload(VkCommandBuffer cb)
+	{
+	}
+
+	/**
+	 * @fn cull(VkCommandBuffer cb, const ClusterCuller& culler, ClusterCuller::View view, const ClusterCuller::Frustum& frustum)
+	 *
+	 * @brief Records the culling of the meshlets of the drawable for a view.
+	 *
+	 * Must be called between ClusterCuller::begin and ClusterCuller::end, outside of a render pass.
+	 * The draw methods consuming \a view use the culled draws until the next call.
+	 * Drawables without meshlets may ignore it.
+	 *
+	 * @param cb The command buffer to record to.
+	 * @param culler The ClusterCuller recording the culling pass.
+	 * @param view The set of draws to write.
+	 * @param frustum The frustum to cull against.
+	 */
+	virtual void cull(VkCommandBuffer cb, const ClusterCuller& culler, ClusterCuller::View view,
+					  const ClusterCuller::Frustum& frustum)
+	{
+	}
+
+	/**
+	 * @fn selectLod(ClusterCuller::View view, const glm::vec3& eye, float lodScale)
+	 *
+	 * @brief Selects the detail level used by the draw methods consuming \a view.
+	 *
+	 * A level may be used when its error projects to at most a pixel, ie. when
+	 * \f$ error \cdot lodScale / distance \le 1 \f$.
+	 * Drawables without detail levels may ignore it. A change of the levels drawn by drawGeometry
+	 * changes the version.
+	 *
+	 * @param view The set of draws to select for.
+	 * @param eye The position of the camera.
+	 * @param lodScale Pixels covered by a unit length at unit distance, divided by the allowed error in pixels.
+	 * A scale of 0 selects the full detail.
 	 */
-	virtual void drawGeometry(VkCommandBuffer cb, VkPipelineLayout lay) = 0;
+	virtual void selectLod(ClusterCuller::View view, const glm::vec3& eye, float lodScale)
+	{
+	}
 };
 } // namespace blaze
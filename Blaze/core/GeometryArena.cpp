@@ -0,0 +1,195 @@
+#include "GeometryArena.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#include <thirdparty/optick/optick.h>
+
+namespace blaze
+{
+GeometryArena::GeometryArena(const Context* context, uint32_t vertexCapacity, uint32_t indexCapacity)
+	: context(context), vertexRanges(vertexCapacity), indexRanges(indexCapacity)
+{
+	vertexBuffer = context->createBuffer(static_cast<size_t>(vertexCapacity) * sizeof(Vertex),
+										 VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+											 VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+										 VMA_MEMORY_USAGE_GPU_ONLY);
+	indexBuffer = context->createBuffer(static_cast<size_t>(indexCapacity) * sizeof(uint16_t),
+										VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+											VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+										VMA_MEMORY_USAGE_GPU_ONLY);
+}
+
+std::optional<GeometryArena::Handle> GeometryArena::allocate(const std::vector<Vertex>& vertices,
+															  const std::vector<uint16_t>& indices)
+{
+	OPTICK_EVENT();
+	auto vertexRange = vertexRanges.allocate(static_cast<uint32_t>(vertices.size()));
+	if (!vertexRange)
+	{
+		return std::nullopt;
+	}
+	auto indexRange = indexRanges.allocate(static_cast<uint32_t>(indices.size()));
+	if (!indexRange)
+	{
+		vertexRanges.release(*vertexRange);
+		return std::nullopt;
+	}
+
+	const size_t vertexSize = vertices.size() * sizeof(Vertex);
+	const size_t indexSize = indices.size() * sizeof(uint16_t);
+
+	if (vertexSize + indexSize > 0)
+	{
+		auto stagingBuffer =
+			context->createBuffer(vertexSize + indexSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
+
+		void* data;
+		vmaMapMemory(stagingBuffer.allocator, stagingBuffer.allocation, &data);
+		memcpy(data, vertices.data(), vertexSize);
+		memcpy(static_cast<uint8_t*>(data) + vertexSize, indices.data(), indexSize);
+		vmaUnmapMemory(stagingBuffer.allocator, stagingBuffer.allocation);
+
+		VkCommandBuffer commandBuffer = context->startCommandBufferRecord();
+
+		VkBufferCopy copyRegion = {};
+		if (vertexSize > 0)
+		{
+			copyRegion.srcOffset = 0;
+			copyRegion.dstOffset = static_cast<VkDeviceSize>(vertexRange->first) * sizeof(Vertex);
+			copyRegion.size = vertexSize;
+			vkCmdCopyBuffer(commandBuffer, stagingBuffer.handle, vertexBuffer.handle, 1, &copyRegion);
+		}
+		if (indexSize > 0)
+		{
+			copyRegion.srcOffset = vertexSize;
+			copyRegion.dstOffset = static_cast<VkDeviceSize>(indexRange->first) * sizeof(uint16_t);
+			copyRegion.size = indexSize;
+			vkCmdCopyBuffer(commandBuffer, stagingBuffer.handle, indexBuffer.handle, 1, &copyRegion);
+		}
+
+		context->flushCommandBuffer(commandBuffer);
+	}
+
+	Handle handle;
+	if (!freeHandles.empty())
+	{
+		handle = freeHandles.back();
+		freeHandles.pop_back();
+	}
+	else
+	{
+		handle = static_cast<Handle>(allocations.size());
+		allocations.emplace_back();
+	}
+	allocations[handle] = {*vertexRange, *indexRange, true};
+	return handle;
+}
+
+void GeometryArena::release(Handle handle)
+{
+	assert(handle < allocations.size() && allocations[handle].live);
+
+	auto& allocation = allocations[handle];
+	vertexRanges.release(allocation.vertices);
+	indexRanges.release(allocation.indices);
+	allocation = {};
+	freeHandles.push_back(handle);
+
+	if (vertexRanges.fragmented() || indexRanges.fragmented())
+	{
+		compact();
+	}
+}
+
+void GeometryArena::compact()
+{
+	OPTICK_EVENT();
+
+	// Live allocations in the order of their vertices, so that they keep their relative order. They are copied
+	// into new buffers of the same capacity, so the arena briefly takes twice its memory while compacting.
+	std::vector<Handle> order;
+	for (Handle handle = 0; handle < allocations.size(); handle++)
+	{
+		if (allocations[handle].live)
+		{
+			order.push_back(handle);
+		}
+	}
+	std::sort(order.begin(), order.end(), [this](Handle a, Handle b) {
+		return allocations[a].vertices.first < allocations[b].vertices.first;
+	});
+
+	const uint32_t vertexCapacity = vertexRanges.get_capacity();
+	const uint32_t indexCapacity = indexRanges.get_capacity();
+
+	util::RangeAllocator newVertexRanges(vertexCapacity);
+	util::RangeAllocator newIndexRanges(indexCapacity);
+	vkw::Buffer newVertexBuffer = context->createBuffer(static_cast<size_t>(vertexCapacity) * sizeof(Vertex),
+														VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+															VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+															VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+														VMA_MEMORY_USAGE_GPU_ONLY);
+	vkw::Buffer newIndexBuffer = context->createBuffer(static_cast<size_t>(indexCapacity) * sizeof(uint16_t),
+													   VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+														   VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+														   VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+													   VMA_MEMORY_USAGE_GPU_ONLY);
+
+	std::vector<VkBufferCopy> vertexCopies;
+	std::vector<VkBufferCopy> indexCopies;
+	std::vector<Allocation> moved = allocations;
+	for (Handle handle : order)
+	{
+		const auto& old = allocations[handle];
+		auto& now = moved[handle];
+
+		// The new allocators start empty and have the same capacity, so this cannot fail.
+		now.vertices = *newVertexRanges.allocate(old.vertices.count);
+		now.indices = *newIndexRanges.allocate(old.indices.count);
+
+		if (old.vertices.count > 0)
+		{
+			vertexCopies.push_back({static_cast<VkDeviceSize>(old.vertices.first) * sizeof(Vertex),
+									static_cast<VkDeviceSize>(now.vertices.first) * sizeof(Vertex),
+									static_cast<VkDeviceSize>(old.vertices.count) * sizeof(Vertex)});
+		}
+		if (old.indices.count > 0)
+		{
+			indexCopies.push_back({static_cast<VkDeviceSize>(old.indices.first) * sizeof(uint16_t),
+								   static_cast<VkDeviceSize>(now.indices.first) * sizeof(uint16_t),
+								   static_cast<VkDeviceSize>(old.indices.count) * sizeof(uint16_t)});
+		}
+	}
+
+	if (!vertexCopies.empty() || !indexCopies.empty())
+	{
+		VkCommandBuffer commandBuffer = context->startCommandBufferRecord();
+		if (!vertexCopies.empty())
+		{
+			vkCmdCopyBuffer(commandBuffer, vertexBuffer.handle, newVertexBuffer.handle,
+							static_cast<uint32_t>(vertexCopies.size()), vertexCopies.data());
+		}
+		if (!indexCopies.empty())
+		{
+			vkCmdCopyBuffer(commandBuffer, indexBuffer.handle, newIndexBuffer.handle,
+							static_cast<uint32_t>(indexCopies.size()), indexCopies.data());
+		}
+		context->flushCommandBuffer(commandBuffer);
+	}
+
+	vertexBuffer = std::move(newVertexBuffer);
+	indexBuffer = std::move(newIndexBuffer);
+	vertexRanges = std::move(newVertexRanges);
+	indexRanges = std::move(newIndexRanges);
+	allocations = std::move(moved);
+}
+
+void GeometryArena::bind(VkCommandBuffer cb) const
+{
+	VkDeviceSize offset = 0;
+	vkCmdBindVertexBuffers(cb, 0, 1, &vertexBuffer.handle, &offset);
+	vkCmdBindIndexBuffer(cb, indexBuffer.handle, 0, VK_INDEX_TYPE_UINT16);
+}
+} // namespace blaze
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <Datatypes.hpp>
+#include <core/Context.hpp>
+#include <util/RangeAllocator.hpp>
+
+#include <optional>
+#include <vector>
+
+namespace blaze
+{
+/**
+ * @brief Renderer wide vertex and index buffers shared by the Drawables.
+ *
+ * Drawables suballocate ranges of the two buffers, so that every Drawable in the arena
+ * can be drawn with a single vertex and index buffer binding.
+ * Indices are 16 bit, local to a primitive and offset by the vertexOffset of the draw, so the
+ * Drawables whose primitives have more than 65536 vertices keep buffers of their own.
+ *
+ * Ranges are referred to by a Handle, as compaction moves them. The offsets must be read
+ * with get_allocation while recording, and not kept across frames.
+ */
+class GeometryArena
+{
+public:
+	using Range = util::RangeAllocator::Range;
+	using Handle = uint32_t;
+
+	/**
+	 * @brief The ranges of the vertex and index buffer owned by a Drawable.
+	 */
+	struct Allocation
+	{
+		Range vertices;
+		Range indices;
+		bool live{false};
+	};
+
+	constexpr static uint32_t DEFAULT_VERTEX_CAPACITY = 1u << 20;
+	constexpr static uint32_t DEFAULT_INDEX_CAPACITY = 1u << 22;
+
+private:
+	const Context* context{nullptr};
+	vkw::Buffer vertexBuffer;
+	vkw::Buffer indexBuffer;
+	util::RangeAllocator vertexRanges;
+	util::RangeAllocator indexRanges;
+	std::vector<Allocation> allocations;
+	std::vector<Handle> freeHandles;
+
+public:
+	/**
+	 * @brief Default constructor.
+	 */
+	GeometryArena() noexcept
+	{
+	}
+
+	/**
+	 * @brief Main constructor.
+	 *
+	 * @param context The Vulkan Context in use.
+	 * @param vertexCapacity The number of vertices the arena can hold.
+	 * @param indexCapacity The number of indices the arena can hold.
+	 */
+	GeometryArena(const Context* context, uint32_t vertexCapacity = DEFAULT_VERTEX_CAPACITY,
+				  uint32_t indexCapacity = DEFAULT_INDEX_CAPACITY);
+
+	/**
+	 * @name Move Constructors.
+	 *
+	 * @brief Move only, copy deleted.
+	 *
+	 * @{
+	 */
+	GeometryArena(GeometryArena&& other) noexcept = default;
+	GeometryArena& operator=(GeometryArena&& other) noexcept = default;
+	GeometryArena(const GeometryArena& other) = delete;
+	GeometryArena& operator=(const GeometryArena& other) = delete;
+	/**
+	 * @}
+	 */
+
+	/**
+	 * @brief Allocates ranges for the vertices and indices and uploads them.
+	 *
+	 * @param vertices The vertices to upload.
+	 * @param indices The indices to upload.
+	 *
+	 * @returns The handle of the allocation, or nullopt if the arena has no room.
+	 */
+	std::optional<Handle> allocate(const std::vector<Vertex>& vertices, const std::vector<uint16_t>& indices);
+
+	/**
+	 * @brief Frees the ranges of \a handle, and compacts the arena if it left a hole.
+	 *
+	 * The GPU must be idle, as compaction moves the ranges of the other allocations.
+	 */
+	void release(Handle handle);
+
+	/**
+	 * @brief Moves all allocations to the start of the buffers, leaving a single free range at the end.
+	 *
+	 * The allocations are copied into new buffers, so the arena needs twice its memory until the old
+	 * buffers are freed. The GPU must be idle.
+	 */
+	void compact();
+
+	/**
+	 * @brief Binds the vertex and index buffers.
+	 */
+	void bind(VkCommandBuffer cb) const;
+
+	inline const Allocation& get_allocation(Handle handle) const
+	{
+		return allocations[handle];
+	}
+
+	inline bool valid() const
+	{
+		return vertexBuffer.valid() && indexBuffer.valid();
+	}
+};
+} // namespace blaze
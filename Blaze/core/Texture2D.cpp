@@ -84,7 +84,8 @@ Texture2D::Texture2D(const Context* context, const ImageData2D& image_data, bool
 		}
 		imageViews = vkw::ImageViewVector(std::move(views), context->get_device());
 		imageSampler =
-			vkw::Sampler(createSampler(context->get_device(), miplevels, image_data.samplerAddressMode, anisotropy),
+			vkw::Sampler(createSampler(context->get_device(), miplevels, image_data.samplerAddressMode, anisotropy,
+									   image_data.depthCompare),
 						 context->get_device());
 
 		imageInfo.imageView = allViews.get();
@@ -227,7 +228,8 @@ Texture2D::Texture2D(const Context* context, const ImageData2D& image_data, bool
 	}
 	imageViews = vkw::ImageViewVector(std::move(views), context->get_device());
 	imageSampler =
-		vkw::Sampler(createSampler(context->get_device(), miplevels, image_data.samplerAddressMode, anisotropy),
+		vkw::Sampler(createSampler(context->get_device(), miplevels, image_data.samplerAddressMode, anisotropy,
+								   image_data.depthCompare),
 					 context->get_device());
 
 	imageInfo.imageView = allViews.get();
@@ -59,6 +59,9 @@ struct ImageData2D
 
 	/// @brief Activate Anisotropy
 	VkBool32 anisotropy{VK_TRUE};
+
+	/// @brief Make the sampler a depth comparison sampler, for the shadow sampler types.
+	VkBool32 depthCompare{VK_FALSE};
 };
 
 /**
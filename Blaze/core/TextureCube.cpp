@@ -4,6 +4,9 @@
 #include "Texture2D.hpp"
 #include "util/files.hpp"
 #include "util/processing.hpp"
+#include "util/RadianceReader.hpp"
+
+#include <algorithm>
 
 namespace blaze
 {
@@ -50,38 +53,64 @@ namespace blaze
 		throw std::runtime_error("Can't load " + ext + " files.");
 	}
 
-	int width, height, numChannels;
-	float* data = stbi_loadf(name.c_str(), &width, &height, &numChannels, 0);
+	// Decoded straight to shared exponent texels a band of rows at a time, so neither the float image
+	// nor the whole staging ever sit in memory, at a quarter of the size of RGBA floats.
+	util::RadianceReader reader(name);
+	const uint32_t width = reader.get_width();
+	const uint32_t height = reader.get_height();
+	constexpr size_t texelSize = sizeof(uint32_t);
+
+	ImageData2D eqvData = {};
+	eqvData.width = width;
+	eqvData.height = height;
+	eqvData.numChannels = 3;
+	eqvData.size = width * height * static_cast<uint32_t>(texelSize);
+	eqvData.format = VK_FORMAT_E5B9G9R9_UFLOAT_PACK32;
+	eqvData.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	eqvData.layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	eqvData.access = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+	Texture2D equirect(context, eqvData, false);
 
-	float* data_rgba = new float[size_t(width) * size_t(height) * 4];
-	if (numChannels == 3)
 	{
-		for (size_t i = 0; i < size_t(width) * size_t(height); i++)
+		constexpr size_t BAND_SIZE = 16 << 20;
+		const uint32_t bandRows =
+			static_cast<uint32_t>(std::clamp<size_t>(BAND_SIZE / (width * texelSize), 1, height));
+		auto stagingBuffer = context->createBuffer(bandRows * width * texelSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+												   VMA_MEMORY_USAGE_CPU_ONLY);
+
+		void* bufferdata;
+		vmaMapMemory(stagingBuffer.allocator, stagingBuffer.allocation, &bufferdata);
+		for (uint32_t row = 0; row < height; row += bandRows)
 		{
-			for (size_t c = 0; c < 3; c++)
+			const uint32_t rows = std::min(bandRows, height - row);
+			reader.readRows(rows, static_cast<uint32_t*>(bufferdata));
+
+			VkBufferImageCopy region = {};
+			region.bufferOffset = 0;
+			region.bufferRowLength = 0;
+			region.bufferImageHeight = 0;
+			region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			region.imageSubresource.mipLevel = 0;
+			region.imageSubresource.baseArrayLayer = 0;
+			region.imageSubresource.layerCount = 1;
+			region.imageOffset = {0, static_cast<int32_t>(row), 0};
+			region.imageExtent = {width, rows, 1};
+
+			// The staging is reused by the next band, so each copy completes before it is overwritten.
+			VkCommandBuffer commandBuffer = context->startCommandBufferRecord();
+			vkCmdCopyBufferToImage(commandBuffer, stagingBuffer.handle, equirect.get_image(),
+								   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+			if (row + rows == height)
 			{
-				data_rgba[4 * i + c] = data[3 * i + c];
+				equirect.transferLayout(commandBuffer, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+										VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+										VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
 			}
-			data_rgba[4 * i + 3] = 1.0f;
+			context->flushCommandBuffer(commandBuffer);
 		}
+		vmaUnmapMemory(stagingBuffer.allocator, stagingBuffer.allocation);
 	}
-	else
-	{
-		memcpy(data_rgba, data, size_t(width) * size_t(height) * 4 * 4);
-	}
-
-	stbi_image_free(data);
-
-	ImageData2D eqvData = {};
-	eqvData.data = reinterpret_cast<uint8_t*>(data_rgba);
-	eqvData.width = width;
-	eqvData.height = height;
-	eqvData.numChannels = 4;
-	eqvData.size = width * height * 4 * sizeof(float);
-	eqvData.format = VK_FORMAT_R32G32B32A32_SFLOAT;
-
-	Texture2D equirect(context, eqvData, false);
-	delete[] data_rgba;
 
 	VkDescriptorPoolSize poolSize = {};
 	poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
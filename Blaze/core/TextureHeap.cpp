@@ -0,0 +1,57 @@
+#include "TextureHeap.hpp"
+
+#include <cassert>
+#include <stdexcept>
+
+namespace blaze
+{
+TextureHeap::TextureHeap(const Context* context, const spirv::Shader& shader, const std::string& uniformName)
+	: context(context)
+{
+	auto uniform = shader.getUniform(uniformName);
+	if (!uniform->runtimeArray)
+	{
+		throw std::invalid_argument("Uniform " + uniformName + " is not a runtime array");
+	}
+
+	set = context->get_pipelineFactory()->createSet(*shader.getSetWithUniform(uniformName));
+	binding = uniform->binding;
+	slots = util::RangeAllocator(uniform->arrayLength);
+}
+
+TextureHeap::Range TextureHeap::allocate(uint32_t count)
+{
+	auto range = slots.allocate(count);
+	if (!range)
+	{
+		throw std::runtime_error("Texture heap out of space for " + std::to_string(count) + " textures");
+	}
+	return *range;
+}
+
+void TextureHeap::release(const Range& range)
+{
+	slots.release(range);
+}
+
+void TextureHeap::write(uint32_t first, const std::vector<VkDescriptorImageInfo>& imageInfos) const
+{
+	assert(first + imageInfos.size() <= get_capacity());
+
+	VkWriteDescriptorSet write = {};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	write.descriptorCount = static_cast<uint32_t>(imageInfos.size());
+	write.dstSet = set.get();
+	write.dstBinding = binding;
+	write.dstArrayElement = first;
+	write.pImageInfo = imageInfos.data();
+
+	vkUpdateDescriptorSets(context->get_device(), 1, &write, 0, nullptr);
+}
+
+void TextureHeap::bind(VkCommandBuffer cmd, VkPipelineLayout layout, VkPipelineBindPoint bindPoint) const
+{
+	vkCmdBindDescriptorSets(cmd, bindPoint, layout, set.setIdx, 1, &set.get(), 0, nullptr);
+}
+} // namespace blaze
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <core/Context.hpp>
+#include <spirv/PipelineFactory.hpp>
+#include <util/RangeAllocator.hpp>
+
+#include <string>
+#include <vector>
+
+namespace blaze
+{
+/**
+ * @brief A global, bindless array of textures.
+ *
+ * Wraps a descriptor set with a single runtime sized array of combined image samplers
+ * (`sampler2D textures[]`) that is partially bound and updated after bind, so textures of
+ * every loaded Drawable live in one set that is bound once per pipeline.
+ *
+ * Drawables allocate contiguous ranges of slots and index them from their push constants.
+ * Requires Context::get_descriptorIndexing.
+ */
+class TextureHeap
+{
+public:
+	/// A contiguous range of slots in the heap.
+	using Range = util::RangeAllocator::Range;
+
+private:
+	const Context* context{nullptr};
+	spirv::SetSingleton set;
+	uint32_t binding{0};
+	util::RangeAllocator slots;
+
+public:
+	/**
+	 * @brief Default constructor.
+	 */
+	TextureHeap() noexcept
+	{
+	}
+
+	/**
+	 * @brief Main constructor.
+	 *
+	 * @param context The Vulkan Context in use.
+	 * @param shader The Shader declaring the runtime array.
+	 * @param uniformName The name of the runtime array in the shader.
+	 */
+	TextureHeap(const Context* context, const spirv::Shader& shader, const std::string& uniformName);
+
+	/**
+	 * @brief Allocates \a count contiguous slots.
+	 *
+	 * @throws std::runtime_error if the heap has no range large enough.
+	 */
+	Range allocate(uint32_t count);
+
+	/**
+	 * @brief Returns the slots of \a range to the heap.
+	 *
+	 * The slots must not be in use by any command buffer still executing.
+	 */
+	void release(const Range& range);
+
+	/**
+	 * @brief Writes the textures into the slots starting at \a first.
+	 *
+	 * Safe while the set is bound, as long as the slots aren't used by an executing command buffer.
+	 */
+	void write(uint32_t first, const std::vector<VkDescriptorImageInfo>& imageInfos) const;
+
+	/**
+	 * @brief Binds the heap set to the pipeline layout.
+	 */
+	void bind(VkCommandBuffer cmd, VkPipelineLayout layout,
+			  VkPipelineBindPoint bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS) const;
+
+	inline uint32_t get_capacity() const
+	{
+		return set.info.empty() ? 0u : set.info.front().arrayLength;
+	}
+
+	inline bool valid() const
+	{
+		return set.pool.valid();
+	}
+};
+} // namespace blaze
@@ -5,6 +5,7 @@
 #include <core/Context.hpp>
 
 #include <cstring>
+#include <limits>
 #include <stdexcept>
 #include <type_traits>
 #include <vector>
@@ -37,7 +38,8 @@ public:
 	enum Usage
 	{
 		VertexBuffer = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-		IndexBuffer = VK_BUFFER_USAGE_INDEX_BUFFER_BIT
+		IndexBuffer = VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+		StorageBuffer = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
 	};
 
 	BaseVBO() noexcept
@@ -100,15 +102,14 @@ public:
 };
 
 /**
- * @tparam T The type of vertex data held by the buffer.
+ * @brief Object encapsulating the data in an index buffer.
  *
- * @brief Object encapsulating the data in a vertex buffer.
+ * The index width is chosen at construction and remembered, so that bind
+ * can pick the matching VkIndexType.
  */
-template <typename T>
 class IndexBuffer : public BaseVBO
 {
-	static_assert(std::is_same<T, uint16_t>() || std::is_same<T, uint32_t>());
-	static constexpr VkIndexType indexType = std::is_same<T, uint16_t>() ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+	VkIndexType indexType{VK_INDEX_TYPE_UINT32};
 
 public:
 	/**
@@ -121,18 +122,64 @@ public:
 	}
 
 	/**
-	 * @fn IndexBuffer(const Context* context, const std::vector<T>& data)
+	 * @fn IndexBuffer(const Context* context, const std::vector<uint16_t>& data)
 	 *
-	 * @brief Main constructor.
+	 * @brief Constructor for 16 bit indices.
 	 *
 	 * @param context The Vulkan Context in use.
-	 * @param data A vector of vertices (\a T) to be held in the buffer.
+	 * @param data A vector of 16 bit indices to be held in the buffer.
+	 */
+	IndexBuffer(const Context* context, const std::vector<uint16_t>& data) noexcept
+		: BaseVBO(context, Usage::IndexBuffer, data.data(), static_cast<uint32_t>(data.size()),
+				  data.size() * sizeof(uint16_t)),
+		  indexType(VK_INDEX_TYPE_UINT16)
+	{
+	}
+
+	/**
+	 * @fn IndexBuffer(const Context* context, const std::vector<uint32_t>& data)
+	 *
+	 * @brief Constructor for 32 bit indices.
+	 *
+	 * @param context The Vulkan Context in use.
+	 * @param data A vector of 32 bit indices to be held in the buffer.
+	 */
+	IndexBuffer(const Context* context, const std::vector<uint32_t>& data) noexcept
+		: BaseVBO(context, Usage::IndexBuffer, data.data(), static_cast<uint32_t>(data.size()),
+				  data.size() * sizeof(uint32_t)),
+		  indexType(VK_INDEX_TYPE_UINT32)
+	{
+	}
+
+	/**
+	 * @name Move Constructors.
+	 *
+	 * @brief Move only, copy deleted.
+	 *
+	 * @{
 	 */
-	IndexBuffer(const Context* context, const std::vector<T>& data) noexcept
-		: BaseVBO(context, Usage::IndexBuffer, data.data(), static_cast<uint32_t>(data.size()), data.size() * sizeof(T))
+	IndexBuffer(IndexBuffer&& other) noexcept : BaseVBO(std::move(other))
 	{
+		std::swap(indexType, other.indexType);
 	}
 
+	IndexBuffer& operator=(IndexBuffer&& other) noexcept
+	{
+		if (this == &other)
+		{
+			return *this;
+		}
+		BaseVBO::operator=(std::move(other));
+		std::swap(indexType, other.indexType);
+		return *this;
+	}
+
+	IndexBuffer(const IndexBuffer& other) = delete;
+	IndexBuffer& operator=(const IndexBuffer& other) = delete;
+	/**
+	 * @}
+	 */
+
 	/**
 	 * @fn bind(VkCommandBuffer buf)
 	 *
@@ -144,6 +191,77 @@ public:
 	{
 		vkCmdBindIndexBuffer(buf, buffer.handle, 0, indexType);
 	}
+
+	inline VkIndexType get_indexType() const
+	{
+		return indexType;
+	}
+
+	/**
+	 * @fn narrow(const std::vector<uint32_t>& data)
+	 *
+	 * @brief Checks if all indices fit in 16 bits and returns the narrowed copy.
+	 *
+	 * @param data The 32 bit indices.
+	 *
+	 * @returns A vector of 16 bit indices, or an empty vector if any index needs 32 bits.
+	 */
+	static std::vector<uint16_t> narrow(const std::vector<uint32_t>& data)
+	{
+		for (uint32_t index : data)
+		{
+			if (index > std::numeric_limits<uint16_t>::max())
+			{
+				return {};
+			}
+		}
+		return std::vector<uint16_t>(data.begin(), data.end());
+	}
+};
+
+/**
+ * @tparam T The type of the elements, laid out to match the std430 struct in the shaders.
+ *
+ * @brief Object encapsulating an immutable storage buffer.
+ */
+template <typename T>
+class StorageBuffer : public BaseVBO
+{
+public:
+	/**
+	 * @fn StorageBuffer()
+	 *
+	 * @brief Default Constructor.
+	 */
+	StorageBuffer() noexcept : BaseVBO()
+	{
+	}
+
+	/**
+	 * @fn StorageBuffer(const Context* context, const std::vector<T>& data)
+	 *
+	 * @brief Main constructor.
+	 *
+	 * @param context The Vulkan Context in use.
+	 * @param data A vector of elements (\a T) to be held in the buffer.
+	 */
+	StorageBuffer(const Context* context, const std::vector<T>& data) noexcept
+		: BaseVBO(context, Usage::StorageBuffer, data.data(), static_cast<uint32_t>(data.size()),
+				  data.size() * sizeof(T))
+	{
+	}
+
+	/**
+	 * @brief Creates a new VkDescriptorBufferInfo for the buffer.
+	 */
+	inline VkDescriptorBufferInfo get_descriptorInfo() const
+	{
+		return VkDescriptorBufferInfo{
+			buffer.handle,
+			0,
+			size,
+		};
+	}
 };
 
 /**
@@ -157,7 +275,7 @@ class IndexedVertexBuffer
 
 private:
 	VertexBuffer<T> vertexBuffer;
-	IndexBuffer<uint32_t> indexBuffer;
+	IndexBuffer indexBuffer;
 
 public:
 	/**
@@ -173,11 +291,35 @@ public:
 	 * @brief Main constructor for the object.
 	 *
 	 * @param context The Vulkan Context in use.
+	 * The indices are stored as 16 bit whenever every index fits, otherwise as 32 bit.
+	 *
 	 * @param vertex_data A vector of vertices (\a T) to be in the buffer.
 	 * @param index_data A vector of indices (uint32_t) to be index the vertices.
 	 */
 	IndexedVertexBuffer(const Context* context, const std::vector<uint32_t>& index_data,
 						const std::vector<T>& vertex_data) noexcept
+		: vertexBuffer(context, vertex_data)
+	{
+		auto narrowed = IndexBuffer::narrow(index_data);
+		if (!narrowed.empty() || index_data.empty())
+		{
+			indexBuffer = IndexBuffer(context, narrowed);
+		}
+		else
+		{
+			indexBuffer = IndexBuffer(context, index_data);
+		}
+	}
+
+	/**
+	 * @brief Constructor for already narrowed 16 bit indices.
+	 *
+	 * @param context The Vulkan Context in use.
+	 * @param vertex_data A vector of vertices (\a T) to be in the buffer.
+	 * @param index_data A vector of indices (uint16_t) to be index the vertices.
+	 */
+	IndexedVertexBuffer(const Context* context, const std::vector<uint16_t>& index_data,
+						const std::vector<T>& vertex_data) noexcept
 		: vertexBuffer(context, vertex_data), indexBuffer(context, index_data)
 	{
 	}
@@ -247,6 +389,10 @@ public:
 	{
 		return indexBuffer.get_count();
 	}
+	inline VkIndexType get_indexType() const
+	{
+		return indexBuffer.get_indexType();
+	}
 	/**
 	 * @}
 	 */
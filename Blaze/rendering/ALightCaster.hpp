@@ -7,6 +7,7 @@
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
+#include <cassert>
 #include <vector>
 
 #define GLFW_INCLUDE_VULKAN
@@ -27,10 +28,31 @@ public:
 		SPOT = 3,
 	};
 
+	/**
+	 * @brief The parameters of a point light, for creating many lights in a single call.
+	 */
+	struct PointLightInfo
+	{
+		glm::vec3 position;
+		glm::vec3 color;
+		float radius;
+		bool enableShadow{false};
+	};
+
 	virtual Handle createPointLight(const glm::vec3& position, const glm::vec3& color, float radius,
 									bool enableShadow) = 0;
 	virtual Handle createPointLight(const glm::vec3& position, float brightness, float radius, bool enableShadow) = 0;
 	virtual Handle createDirectionLight(const glm::vec3& direction, float brightness, uint32_t numCascades) = 0;
+	/**
+	 * @brief Creates a spot light, lighting the cone around \a direction up to \a radius.
+	 *
+	 * @param innerAngle The half angle of the cone in radians where the light starts to fade.
+	 * @param outerAngle The half angle of the cone in radians where the light ends.
+	 *
+	 * @returns The handle of the light, or 0 if it could not be created.
+	 */
+	virtual Handle createSpotLight(const glm::vec3& position, const glm::vec3& direction, const glm::vec3& color,
+								   float radius, float innerAngle, float outerAngle, bool enableShadow) = 0;
 	virtual void removeLight(Handle handle) = 0;
 
 	virtual uint32_t getMaxPointLights() = 0;
@@ -44,6 +66,63 @@ public:
 	virtual void setColor(Handle handle, const glm::vec3& color) = 0;
 	virtual void setBrightness(Handle handle, float brightness) = 0;
 	virtual bool setShadow(Handle handle, bool hasShadow) = 0;
+	/**
+	 * @brief Switches the shadow of a point light between a cube and two paraboloid hemispheres.
+	 *
+	 * A dual paraboloid shadow draws two views instead of six, at the cost of some distortion, so it
+	 * suits distant and small lights.
+	 */
+	virtual void setDualParaboloid(Handle handle, bool enable) = 0;
+
+	/**
+	 * @name Bulk operations
+	 *
+	 * @brief Operations on many lights in a single call.
+	 *
+	 * The default implementations forward to the single light methods.
+	 * A light that could not be created gets a handle of 0.
+	 *
+	 * @{
+	 */
+	virtual std::vector<Handle> createPointLights(const std::vector<PointLightInfo>& infos)
+	{
+		std::vector<Handle> handles;
+		handles.reserve(infos.size());
+		for (const auto& info : infos)
+		{
+			handles.push_back(createPointLight(info.position, info.color, info.radius, info.enableShadow));
+		}
+		return handles;
+	}
+
+	virtual void removeLights(const std::vector<Handle>& handles)
+	{
+		for (Handle handle : handles)
+		{
+			removeLight(handle);
+		}
+	}
+
+	virtual void setPositions(const std::vector<Handle>& handles, const std::vector<glm::vec3>& positions)
+	{
+		assert(handles.size() == positions.size());
+		for (size_t i = 0; i < handles.size(); i++)
+		{
+			setPosition(handles[i], positions[i]);
+		}
+	}
+
+	virtual void setColors(const std::vector<Handle>& handles, const std::vector<glm::vec3>& colors)
+	{
+		assert(handles.size() == colors.size());
+		for (size_t i = 0; i < handles.size(); i++)
+		{
+			setColor(handles[i], colors[i]);
+		}
+	}
+	/**
+	 * @}
+	 */
 
 	virtual void update(const Camera* camera, uint32_t frame) = 0;
 	virtual void cast(VkCommandBuffer cmd, const std::vector<Drawable*>& drawables) = 0;
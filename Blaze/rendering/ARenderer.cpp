@@ -3,6 +3,9 @@
 
 #include "thirdparty/optick/optick.h"
 
+#include <algorithm>
+#include <cassert>
+
 namespace blaze
 {
 
@@ -19,6 +22,7 @@ ARenderer::ARenderer(GLFWwindow* window, bool enableValidationLayers) noexcept
 
 	context = make_unique<Context>(window, enableValidationLayers);
 	swapchain = make_unique<Swapchain>(context.get());
+	geometryArena = GeometryArena(context.get());
 
 	setupPerFrameData(swapchain->get_imageCount());
 
@@ -36,6 +40,7 @@ void ARenderer::render()
 							  imageAvailableSem[currentFrame], VK_NULL_HANDLE, &imageIndex);
 	vkWaitForFences(context->get_device(), 1, &inFlightFences[imageIndex], VK_TRUE, numeric_limits<uint64_t>::max());
 
+	updateEnvironment(imageIndex);
 	update(imageIndex);
 	rebuildCommandBuffer(imageIndex);
 
@@ -101,9 +106,89 @@ void ARenderer::render()
 
 void ARenderer::setSkybox(TextureCube&& env)
 {
+	retirePendingEnvironment();
 	environment = std::make_unique<Environment>(context.get(), std::move(env), this->get_environmentSet());
 }
 
+void ARenderer::setSkybox(const std::string& filename)
+{
+	retirePendingEnvironment();
+	environment = std::make_unique<Environment>(context.get(), loadImageCube(context.get(), filename, false),
+												this->get_environmentSet(), filename);
+}
+
+void ARenderer::updateSkybox(const std::string& filename, uint32_t slicesPerFrame)
+{
+	OPTICK_EVENT();
+
+	if (!environment)
+	{
+		setSkybox(filename);
+		return;
+	}
+	assert(slicesPerFrame > 0);
+
+	retirePendingEnvironment();
+
+	// Baked into its own set, as the current set is used by the frames until the swap.
+	pendingEnvironmentSet = createEnvironmentSet();
+	pendingEnvironment = std::make_unique<Environment>(
+		context.get(), loadImageCube(context.get(), filename, false), &pendingEnvironmentSet, filename, true);
+	environmentSlicesPerFrame = slicesPerFrame;
+}
+
+void ARenderer::updateEnvironment(uint32_t frame)
+{
+	OPTICK_EVENT();
+
+	if (pendingEnvironment)
+	{
+		bool complete = !pendingEnvironment->isBaking();
+		if (!complete && pendingEnvironmentImage.has_value())
+		{
+			// The fence of the image is only reset once it was waited for in a later frame.
+			const uint32_t image = pendingEnvironmentImage.value();
+			if (image == frame || vkGetFenceStatus(context->get_device(), inFlightFences[image]) == VK_SUCCESS)
+			{
+				pendingEnvironment->finishBake();
+				complete = true;
+			}
+		}
+
+		if (complete)
+		{
+			// Frames in flight still bind the old set, so it is swapped out and retired rather than rewritten.
+			std::swap(*get_environmentSet(), pendingEnvironmentSet);
+			environment.swap(pendingEnvironment);
+			retirePendingEnvironment();
+		}
+	}
+
+	// The frame was waited for, and is rebuilt with the current environment.
+	for (auto& retired : retiredEnvironments)
+	{
+		retired.inFlight[frame] = false;
+	}
+	retiredEnvironments.erase(std::remove_if(retiredEnvironments.begin(), retiredEnvironments.end(),
+											 [](const RetiredEnvironment& retired) {
+												 return std::none_of(retired.inFlight.begin(),
+																	 retired.inFlight.end(),
+																	 [](bool inFlight) { return inFlight; });
+											 }),
+							  retiredEnvironments.end());
+}
+
+void ARenderer::retirePendingEnvironment()
+{
+	if (pendingEnvironment)
+	{
+		retiredEnvironments.push_back({std::move(pendingEnvironment), std::move(pendingEnvironmentSet),
+									   std::vector<bool>(swapchain->get_imageCount(), true)});
+	}
+	pendingEnvironment.reset();
+	pendingEnvironmentImage.reset();
+}
+
 vkw::SemaphoreVector ARenderer::createSemaphores(uint32_t imageCount) const
 {
 	std::vector<VkSemaphore> sems(imageCount);
@@ -149,6 +234,14 @@ void ARenderer::recreateSwapchain()
 	try
 	{
 		vkDeviceWaitIdle(context->get_device());
+		// Nothing is in flight anymore, and the fences of the images are recreated.
+		retiredEnvironments.clear();
+		if (pendingEnvironmentImage.has_value())
+		{
+			pendingEnvironment->finishBake();
+			pendingEnvironmentImage.reset();
+		}
+
 		auto [width, height] = get_dimensions();
 		while (width == 0 || height == 0)
 		{
@@ -197,6 +290,14 @@ void ARenderer::rebuildCommandBuffer(uint32_t frame)
 		throw std::runtime_error("Begin Command Buffer failed with " + std::to_string(result));
 	}
 
+	if (pendingEnvironment && pendingEnvironment->isBaking() && !pendingEnvironmentImage.has_value())
+	{
+		if (pendingEnvironment->recordBake(commandBuffers[frame], environmentSlicesPerFrame))
+		{
+			pendingEnvironmentImage = frame;
+		}
+	}
+
 	{
 		recordCommands(frame);
 
@@ -6,16 +6,21 @@
 
 #include <core/Context.hpp>
 #include <core/Drawable.hpp>
+#include <core/GeometryArena.hpp>
 #include <core/Bindable.hpp>
 #include <core/Camera.hpp>
 #include <core/Context.hpp>
 #include <core/Swapchain.hpp>
+#include <core/TextureHeap.hpp>
 #include <gui/GUI.hpp>
 #include <spirv/PipelineFactory.hpp>
-#include <util/PackedHandler.hpp>
+#include <util/SlotMap.hpp>
 #include <resource/Environment.hpp>
 #include <vkwrap/VkWrap.hpp>
 
+#include <optional>
+#include <vector>
+
 namespace blaze
 {
 class ALightCaster;
@@ -42,17 +47,39 @@ protected:
 	std::unique_ptr<GUI> gui;
 	Camera* camera{nullptr};
 
+	/// Vertices and indices of the Drawables, shared so that they can be drawn with one binding.
+	GeometryArena geometryArena;
+
 	vkw::CommandBufferVector commandBuffers;
 
 	vkw::SemaphoreVector imageAvailableSem;
 	vkw::SemaphoreVector renderFinishedSem;
 	vkw::FenceVector inFlightFences;
 
-	using DrawList = util::PackedHandler<Drawable*>;
+	using DrawList = util::SlotMap<Drawable*>;
 	DrawList drawables;
 
 	std::unique_ptr<Environment> environment;
 
+	/// The environment being baked over several frames, with the set it is swapped in with once baked.
+	std::unique_ptr<Environment> pendingEnvironment;
+	spirv::SetSingleton pendingEnvironmentSet;
+	uint32_t environmentSlicesPerFrame{0};
+	/// The swapchain image of the frame the last slices were recorded in, once they are.
+	std::optional<uint32_t> pendingEnvironmentImage;
+
+	/**
+	 * @brief An environment replaced while frames in flight may still use it.
+	 */
+	struct RetiredEnvironment
+	{
+		std::unique_ptr<Environment> environment;
+		spirv::SetSingleton set;
+		/// The swapchain images whose frames may still use the environment.
+		std::vector<bool> inFlight;
+	};
+	std::vector<RetiredEnvironment> retiredEnvironments;
+
 public:
 	ARenderer() noexcept
 	{
@@ -75,6 +102,23 @@ public:
      */
 	void setSkybox(TextureCube&& env);
 
+    /**
+     * @brief Loads the environment from an HDR file, with the baked maps cached next to the file.
+     */
+	void setSkybox(const std::string& filename);
+
+    /**
+     * @brief Loads an environment from an HDR file while the current one stays in use.
+     *
+     * The maps are baked a few slices per frame, after which the new environment is swapped in between frames.
+     * Loading the skybox, and the maps if cached, is not spread. Loads like setSkybox without a current
+     * environment, and replaces an environment still being baked.
+     *
+     * @param filename The HDR file, with the baked maps cached next to it.
+     * @param slicesPerFrame The faces of the irradiance projection or of prefiltered mips baked each frame.
+     */
+	void updateSkybox(const std::string& filename, uint32_t slicesPerFrame = 4);
+
     /**
      * @brief Returns the currently used primary shader.
      */
@@ -96,6 +140,22 @@ public:
 	// Light Controls
 	virtual ALightCaster* get_lightCaster() = 0;
 
+    /**
+     * @brief Returns the bindless texture heap for the textures of Drawables, if the renderer uses one.
+     */
+	virtual TextureHeap* get_textureHeap()
+	{
+		return nullptr;
+	}
+
+    /**
+     * @brief Returns the arena for the vertices and indices of Drawables, if it could be created.
+     */
+	GeometryArena* get_geometryArena()
+	{
+		return geometryArena.valid() ? &geometryArena : nullptr;
+	}
+
 	const Context* get_context() const
 	{
 		return context.get();
@@ -114,6 +174,14 @@ public:
 		return drawables.add(sub);
 	}
 
+    /**
+     * @brief Removes a drawable submitted with \a handle. Stale handles are ignored.
+     */
+	void remove(DrawList::Handle handle)
+	{
+		drawables.remove(handle);
+	}
+
     /**
      * @brief Checks if the renderer is complete.
      */
@@ -155,8 +223,16 @@ protected:
 
 	// Get the environment set
 	virtual spirv::SetSingleton* get_environmentSet() = 0;
+	// Create a set with the layout of the environment set
+	virtual spirv::SetSingleton createEnvironmentSet() = 0;
 
 private:
+	/**
+	 * @brief Swaps the pending environment in once it is baked, and releases the retired ones no frame uses.
+	 */
+	void updateEnvironment(uint32_t frame);
+	void retirePendingEnvironment();
+
 	vkw::SemaphoreVector createSemaphores(uint32_t imageCount) const;
 	vkw::FenceVector createFences(uint32_t imageCount) const;
 	vkw::CommandBufferVector allocateCommandBuffers(uint32_t imageCount) const;
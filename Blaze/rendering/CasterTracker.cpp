@@ -0,0 +1,78 @@
+#include "CasterTracker.hpp"
+
+#include <thirdparty/optick/optick.h>
+
+#include <unordered_map>
+
+namespace blaze
+{
+void CasterTracker::update(const std::vector<Drawable*>& drawables)
+{
+	OPTICK_EVENT();
+	changedBounds.clear();
+
+	std::unordered_map<const Drawable*, const Caster*> previous;
+	previous.reserve(casters.size());
+	for (const auto& caster : casters)
+	{
+		previous.emplace(caster.drawable, &caster);
+	}
+
+	std::vector<Caster> current;
+	current.reserve(drawables.size());
+	for (const Drawable* drawable : drawables)
+	{
+		Caster caster = {drawable, drawable->get_version(), drawable->get_bounds()};
+
+		auto it = previous.find(drawable);
+		if (it == previous.end())
+		{
+			changedBounds.push_back(caster.bounds);
+		}
+		else
+		{
+			const Caster& old = *it->second;
+			if (caster.version == Drawable::UNTRACKED_VERSION || caster.version != old.version ||
+				caster.bounds != old.bounds)
+			{
+				changedBounds.push_back(old.bounds);
+				changedBounds.push_back(caster.bounds);
+			}
+			previous.erase(it);
+		}
+		current.push_back(caster);
+	}
+
+	// Removed since the previous frame.
+	for (const auto& [drawable, old] : previous)
+	{
+		changedBounds.push_back(old->bounds);
+	}
+
+	casters = std::move(current);
+}
+
+bool CasterTracker::intersects(const glm::vec4& sphere) const
+{
+	for (const auto& bounds : changedBounds)
+	{
+		if (glm::distance(glm::vec3(bounds), glm::vec3(sphere)) <= bounds.w + sphere.w)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+bool CasterTracker::intersects(const ClusterCuller::Frustum& frustum) const
+{
+	for (const auto& bounds : changedBounds)
+	{
+		if (ClusterCuller::intersects(frustum, bounds))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+} // namespace blaze
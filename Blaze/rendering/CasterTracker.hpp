@@ -0,0 +1,57 @@
+#pragma once
+
+#include <core/Drawable.hpp>
+#include <rendering/ClusterCuller.hpp>
+
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace blaze
+{
+/**
+ * @brief Tracks the changes of the shadow casting Drawables between frames, for the cached shadows.
+ *
+ * Every frame the Drawables are compared with the ones of the previous frame by their version and bounds.
+ * The old and new bounds of each Drawable that was added, removed or changed are collected, and a
+ * cached shadow only has to be drawn again if its volume intersects one of them.
+ */
+class CasterTracker
+{
+public:
+	struct Caster
+	{
+		const Drawable* drawable;
+		uint64_t version;
+		glm::vec4 bounds;
+	};
+
+private:
+	std::vector<Caster> casters;
+	/// Bounding spheres touched by the changes of this frame.
+	std::vector<glm::vec4> changedBounds;
+
+public:
+	/**
+	 * @brief Compares \a drawables with the Drawables of the previous call.
+	 */
+	void update(const std::vector<Drawable*>& drawables);
+
+	/**
+	 * @brief Checks if a change of this frame touches the sphere, xyz is the center and w the radius.
+	 */
+	bool intersects(const glm::vec4& sphere) const;
+
+	/**
+	 * @brief Checks if a change of this frame touches the frustum, the cone test is not done.
+	 */
+	bool intersects(const ClusterCuller::Frustum& frustum) const;
+
+	/**
+	 * @brief The Drawables of the last update with their bounds.
+	 */
+	const std::vector<Caster>& get_casters() const
+	{
+		return casters;
+	}
+};
+} // namespace blaze
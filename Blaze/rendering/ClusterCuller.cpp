@@ -0,0 +1,186 @@
+#include "ClusterCuller.hpp"
+
+#include <array>
+#include <util/files.hpp>
+
+#include <thirdparty/optick/optick.h>
+
+namespace blaze
+{
+ClusterCuller::ClusterCuller(const Context* context) : context(context)
+{
+	shader = createShader();
+	pipeline = createPipeline();
+}
+
+ClusterCuller::Frustum ClusterCuller::createFrustum(const glm::mat4& viewProj, const glm::vec3& eye, bool cullCone,
+													bool cullNear)
+{
+	// Ref: Gribb, Hartmann - Fast Extraction of Viewing Frustum Planes from the World-View-Projection Matrix
+	// Adjusted for the [0, 1] depth range.
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; i++)
+	{
+		rows[i] = glm::vec4(viewProj[0][i], viewProj[1][i], viewProj[2][i], viewProj[3][i]);
+	}
+
+	Frustum frustum = {};
+	frustum.planes[0] = rows[3] + rows[0]; // Left
+	frustum.planes[1] = rows[3] - rows[0]; // Right
+	frustum.planes[2] = rows[3] + rows[1]; // Bottom
+	frustum.planes[3] = rows[3] - rows[1]; // Top
+	frustum.planes[4] = rows[2];		   // Near
+	frustum.planes[5] = rows[3] - rows[2]; // Far
+
+	for (auto& plane : frustum.planes)
+	{
+		plane /= glm::length(glm::vec3(plane));
+	}
+
+	if (!cullNear)
+	{
+		frustum.planes[4] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+	}
+
+	frustum.eye = eye;
+	frustum.flags = CULL_FRUSTUM | (cullCone ? CULL_CONE : 0u);
+	return frustum;
+}
+
+ClusterCuller::Frustum ClusterCuller::createSphere(const glm::vec3& center, float radius)
+{
+	Frustum frustum = {};
+	frustum.planes[0] = glm::vec4(center, radius);
+	frustum.eye = center;
+	frustum.flags = CULL_SPHERE;
+	return frustum;
+}
+
+bool ClusterCuller::intersects(const Frustum& frustum, const glm::vec4& sphere)
+{
+	const glm::vec3 center = glm::vec3(sphere);
+	if (frustum.flags & CULL_FRUSTUM)
+	{
+		for (const auto& plane : frustum.planes)
+		{
+			if (glm::dot(glm::vec3(plane), center) + plane.w < -sphere.w)
+			{
+				return false;
+			}
+		}
+	}
+	if (frustum.flags & CULL_SPHERE)
+	{
+		if (glm::distance(glm::vec3(frustum.planes[0]), center) > frustum.planes[0].w + sphere.w)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool ClusterCuller::contains(const Frustum& frustum, const glm::vec4& sphere)
+{
+	assert(frustum.flags & CULL_FRUSTUM);
+	const glm::vec3 center = glm::vec3(sphere);
+	for (const auto& plane : frustum.planes)
+	{
+		if (glm::dot(glm::vec3(plane), center) + plane.w < sphere.w)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void ClusterCuller::begin(VkCommandBuffer cmd) const
+{
+	// Previous indirect reads and culling writes must be done before the buffers are overwritten.
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+						 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0,
+						 nullptr, 0, nullptr);
+}
+
+void ClusterCuller::end(VkCommandBuffer cmd) const
+{
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1,
+						 &barrier, 0, nullptr, 0, nullptr);
+}
+
+void ClusterCuller::dispatch(VkCommandBuffer cmd, const spirv::SetSingleton& set, Frustum frustum,
+							 uint32_t meshletCount, uint32_t drawOffset, uint32_t vertexBase, uint32_t indexBase) const
+{
+	OPTICK_EVENT();
+	assert(valid());
+
+	frustum.meshletCount = meshletCount;
+	frustum.drawOffset = drawOffset;
+	frustum.vertexBase = vertexBase;
+	frustum.indexBase = indexBase;
+
+	vkCmdBindPipeline(cmd, pipeline.bindPoint, pipeline.pipeline.get());
+	vkCmdBindDescriptorSets(cmd, pipeline.bindPoint, shader.pipelineLayout.get(), set.setIdx, 1, &set.get(), 0,
+							nullptr);
+	vkCmdPushConstants(cmd, shader.pipelineLayout.get(), shader.pushConstant.stage, 0, sizeof(Frustum), &frustum);
+	vkCmdDispatch(cmd, (meshletCount + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+}
+
+spirv::SetSingleton ClusterCuller::createSet(const VkDescriptorBufferInfo& meshlets,
+											 const VkDescriptorBufferInfo& transforms,
+											 const VkDescriptorBufferInfo& draws,
+											 const VkDescriptorBufferInfo& drawInfos) const
+{
+	auto set = context->get_pipelineFactory()->createSet(*shader.getSetWithUniform("meshlets"));
+
+	const VkDescriptorBufferInfo* infos[] = {&meshlets, &transforms, &draws, &drawInfos};
+	const char* names[] = {"meshlets", "transforms", "draws", "drawInfos"};
+
+	std::array<VkWriteDescriptorSet, 4> writes;
+	for (size_t i = 0; i < writes.size(); i++)
+	{
+		auto unif = shader.getUniform(names[i]);
+
+		writes[i] = {};
+		writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[i].descriptorType = unif->type;
+		writes[i].descriptorCount = 1;
+		writes[i].dstSet = set.get();
+		writes[i].dstBinding = unif->binding;
+		writes[i].dstArrayElement = 0;
+		writes[i].pBufferInfo = infos[i];
+	}
+
+	vkUpdateDescriptorSets(context->get_device(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+
+	return set;
+}
+
+spirv::Shader ClusterCuller::createShader()
+{
+	std::vector<spirv::ShaderStageData> stages;
+
+	spirv::ShaderStageData* stage;
+	stage = &stages.emplace_back();
+	stage->spirv = util::loadBinaryFile(compShaderFileName);
+	stage->stage = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	return context->get_pipelineFactory()->createShader(stages);
+}
+
+spirv::Pipeline ClusterCuller::createPipeline()
+{
+	assert(shader.valid());
+
+	return context->get_pipelineFactory()->createComputePipeline(shader);
+}
+} // namespace blaze
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <core/Context.hpp>
+#include <spirv/PipelineFactory.hpp>
+
+#include <glm/glm.hpp>
+#include <string>
+
+namespace blaze
+{
+/**
+ * @brief Compute pass that culls the meshlets of Drawables for a view.
+ *
+ * Each meshlet is tested against the view frustum (or a bounding sphere) and its
+ * normal cone, and an indexed indirect draw command with instanceCount 0 or 1
+ * is written for it. The Drawables consume the commands in their draw methods.
+ *
+ * Usage per view:
+ * \arg begin() once.
+ * \arg Drawable::cull for each drawable.
+ * \arg end() once, before the render pass that draws the view.
+ */
+class ClusterCuller
+{
+public:
+	/// The independent sets of draw commands that a Drawable keeps.
+	enum View : uint32_t
+	{
+		CAMERA_VIEW = 0, ///< Consumed by draw, drawOpaque and drawAlphaBlended.
+		SHADOW_VIEW = 1, ///< Consumed by drawGeometry.
+		VIEW_COUNT = 2,
+	};
+
+	enum Flags : uint32_t
+	{
+		CULL_FRUSTUM = 0x1,
+		CULL_CONE = 0x2,
+		CULL_SPHERE = 0x4,
+	};
+
+	/**
+	 * @brief Push constant block of the culling shader.
+	 */
+	struct Frustum
+	{
+		glm::vec4 planes[6];
+		glm::vec3 eye;
+		/// Added to the vertexOffset of the culled draws, for Drawables in a GeometryArena.
+		uint32_t vertexBase;
+		uint32_t meshletCount;
+		uint32_t drawOffset;
+		uint32_t flags;
+		/// Added to the firstIndex of the culled draws, for Drawables in a GeometryArena.
+		uint32_t indexBase;
+	};
+
+	static_assert(sizeof(Frustum) == 128, "Frustum must fit in the minimum push constant size");
+
+private:
+	constexpr static std::string_view compShaderFileName = "shaders/deferred/cClusterCull.comp.spv";
+	constexpr static uint32_t WORKGROUP_SIZE = 64;
+
+	const Context* context{nullptr};
+
+	spirv::Shader shader;
+	spirv::Pipeline pipeline;
+
+public:
+	bool enabled{true};
+
+	/**
+	 * @brief Default constructor.
+	 */
+	ClusterCuller() noexcept
+	{
+	}
+
+	/**
+	 * @brief Main constructor.
+	 *
+	 * @param context The Vulkan Context in use.
+	 */
+	ClusterCuller(const Context* context);
+
+	/**
+	 * @brief Creates a frustum from a view projection matrix.
+	 *
+	 * @param viewProj The view projection matrix of the view.
+	 * @param eye The position of the viewer for the backface cone test.
+	 * @param cullCone Enables the backface cone test.
+	 * @param cullNear Disable for shadow maps with depth clamp, where casters in front of the near plane count.
+	 */
+	static Frustum createFrustum(const glm::mat4& viewProj, const glm::vec3& eye, bool cullCone, bool cullNear = true);
+
+	/**
+	 * @brief Creates a frustum that only culls against a bounding sphere.
+	 *
+	 * @param center The center of the sphere.
+	 * @param radius The radius of the sphere.
+	 */
+	static Frustum createSphere(const glm::vec3& center, float radius);
+
+	/**
+	 * @brief Checks if a bounding sphere is inside the frustum or sphere, like the culling shader does for meshlets.
+	 *
+	 * @param frustum The frustum created by createFrustum or createSphere, the cone test is not done.
+	 * @param sphere The sphere to test, xyz is the center and w the radius.
+	 */
+	static bool intersects(const Frustum& frustum, const glm::vec4& sphere);
+
+	/**
+	 * @brief Checks if a bounding sphere lies entirely inside a frustum created by createFrustum with cullNear.
+	 *
+	 * @param frustum The frustum created by createFrustum.
+	 * @param sphere The sphere to test, xyz is the center and w the radius.
+	 */
+	static bool contains(const Frustum& frustum, const glm::vec4& sphere);
+
+	/**
+	 * @brief Makes the previous draws of the indirect buffers finish before culling.
+	 *
+	 * @param cmd The command buffer to record to.
+	 */
+	void begin(VkCommandBuffer cmd) const;
+
+	/**
+	 * @brief Makes the culled commands visible to the indirect draws.
+	 *
+	 * @param cmd The command buffer to record to.
+	 */
+	void end(VkCommandBuffer cmd) const;
+
+	/**
+	 * @brief Records the culling of \a meshletCount meshlets.
+	 *
+	 * @param cmd The command buffer to record to.
+	 * @param set The descriptor set created by createSet.
+	 * @param frustum The frustum to cull against, the per dispatch members are overwritten.
+	 * @param meshletCount The number of meshlets in the set.
+	 * @param drawOffset The index of the first draw command to write.
+	 * @param vertexBase The first vertex of the Drawable in the bound vertex buffer.
+	 * @param indexBase The first index of the Drawable in the bound index buffer.
+	 */
+	void dispatch(VkCommandBuffer cmd, const spirv::SetSingleton& set, Frustum frustum, uint32_t meshletCount,
+				  uint32_t drawOffset, uint32_t vertexBase = 0, uint32_t indexBase = 0) const;
+
+	/**
+	 * @brief Creates a descriptor set for the culling inputs of a Drawable.
+	 *
+	 * @param meshlets The storage buffer of Meshlet.
+	 * @param transforms The storage buffer of node transforms (mat4).
+	 * @param draws The storage/indirect buffer of VkDrawIndexedIndirectCommand.
+	 * @param drawInfos The storage buffer mapping each primitive to its node (Model::DrawInfo).
+	 */
+	spirv::SetSingleton createSet(const VkDescriptorBufferInfo& meshlets, const VkDescriptorBufferInfo& transforms,
+								  const VkDescriptorBufferInfo& draws, const VkDescriptorBufferInfo& drawInfos) const;
+
+	inline bool valid() const
+	{
+		return pipeline.pipeline.valid();
+	}
+
+private:
+	spirv::Shader createShader();
+	spirv::Pipeline createPipeline();
+};
+} // namespace blaze
@@ -0,0 +1,142 @@
+#include "DepthReduction.hpp"
+
+#include <util/files.hpp>
+
+#include <array>
+#include <cstring>
+
+#include <thirdparty/optick/optick.h>
+
+namespace blaze
+{
+namespace
+{
+/// The bits of 1.0f, the far plane.
+constexpr uint32_t FAR_DEPTH_BITS = 0x3F800000u;
+} // namespace
+
+DepthReduction::DepthReduction(const Context* context, const Texture2D& depthBuffer, uint32_t frames)
+	: context(context), extent{depthBuffer.get_width(), depthBuffer.get_height()}
+{
+	shader = createShader();
+	pipeline = createPipeline();
+
+	results.reserve(frames);
+	sets.reserve(frames);
+	for (uint32_t i = 0; i < frames; i++)
+	{
+		auto& result =
+			results.emplace_back(context->createBuffer(sizeof(Range), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+													   VMA_MEMORY_USAGE_GPU_TO_CPU));
+		reset(result);
+
+		auto& set = sets.emplace_back(context->get_pipelineFactory()->createSet(*shader.getSetWithUniform("depthMap")));
+
+		VkDescriptorImageInfo imageInfo = depthBuffer.get_imageInfo();
+		VkDescriptorBufferInfo bufferInfo = {result.handle, 0, sizeof(Range)};
+
+		const char* names[] = {"depthMap", "range"};
+		std::array<VkWriteDescriptorSet, 2> writes;
+		for (size_t j = 0; j < writes.size(); j++)
+		{
+			auto unif = shader.getUniform(names[j]);
+
+			writes[j] = {};
+			writes[j].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[j].descriptorType = unif->type;
+			writes[j].descriptorCount = 1;
+			writes[j].dstSet = set.get();
+			writes[j].dstBinding = unif->binding;
+			writes[j].dstArrayElement = 0;
+		}
+		writes[0].pImageInfo = &imageInfo;
+		writes[1].pBufferInfo = &bufferInfo;
+
+		vkUpdateDescriptorSets(context->get_device(), static_cast<uint32_t>(writes.size()), writes.data(), 0,
+							   nullptr);
+	}
+}
+
+void DepthReduction::dispatch(VkCommandBuffer cmd, uint32_t frame) const
+{
+	OPTICK_EVENT();
+	assert(valid());
+
+	// The depth buffer was written by the previous render pass.
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+						 &barrier, 0, nullptr, 0, nullptr);
+
+	glm::uvec2 size = {extent.width, extent.height};
+	vkCmdBindPipeline(cmd, pipeline.bindPoint, pipeline.pipeline.get());
+	vkCmdBindDescriptorSets(cmd, pipeline.bindPoint, shader.pipelineLayout.get(), sets[frame].setIdx, 1,
+							&sets[frame].get(), 0, nullptr);
+	vkCmdPushConstants(cmd, shader.pipelineLayout.get(), shader.pushConstant.stage, 0, sizeof(size), &size);
+	vkCmdDispatch(cmd, (extent.width + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE,
+				  (extent.height + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1);
+
+	// Read back on the host once the frame's fence is signalled.
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0,
+						 nullptr, 0, nullptr);
+}
+
+std::optional<glm::vec2> DepthReduction::read(uint32_t frame)
+{
+	const vkw::Buffer& result = results[frame];
+
+	Range range;
+	void* data;
+	vmaMapMemory(result.allocator, result.allocation, &data);
+	vmaInvalidateAllocation(result.allocator, result.allocation, 0, VK_WHOLE_SIZE);
+	memcpy(&range, data, sizeof(Range));
+	vmaUnmapMemory(result.allocator, result.allocation);
+
+	reset(result);
+
+	if (range.minDepth > range.maxDepth)
+	{
+		return std::nullopt;
+	}
+
+	glm::vec2 depths;
+	memcpy(&depths.x, &range.minDepth, sizeof(float));
+	memcpy(&depths.y, &range.maxDepth, sizeof(float));
+	return depths;
+}
+
+void DepthReduction::reset(const vkw::Buffer& result) const
+{
+	// Empty, so that a frame that is never dispatched reads as no depths.
+	const Range empty = {FAR_DEPTH_BITS, 0};
+
+	void* data;
+	vmaMapMemory(result.allocator, result.allocation, &data);
+	memcpy(data, &empty, sizeof(Range));
+	vmaFlushAllocation(result.allocator, result.allocation, 0, VK_WHOLE_SIZE);
+	vmaUnmapMemory(result.allocator, result.allocation);
+}
+
+spirv::Shader DepthReduction::createShader()
+{
+	std::vector<spirv::ShaderStageData> stages;
+
+	spirv::ShaderStageData* stage;
+	stage = &stages.emplace_back();
+	stage->spirv = util::loadBinaryFile(compShaderFileName);
+	stage->stage = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	return context->get_pipelineFactory()->createShader(stages);
+}
+
+spirv::Pipeline DepthReduction::createPipeline()
+{
+	assert(shader.valid());
+
+	return context->get_pipelineFactory()->createComputePipeline(shader);
+}
+} // namespace blaze
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <core/Context.hpp>
+#include <core/Texture2D.hpp>
+#include <spirv/PipelineFactory.hpp>
+
+#include <glm/glm.hpp>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace blaze
+{
+/**
+ * @brief Compute pass that finds the range of the depths on screen.
+ *
+ * The shadow cascades are fitted to the range, instead of the whole near to far range of the camera.
+ * Each frame in flight has its own result buffer, which is read back by the next update of the same
+ * frame, after its fence was waited on. Reading never stalls, and the range lags the view by the
+ * frames in flight.
+ *
+ * Usage per frame:
+ * \arg read() before recording, for the range of the last time the frame was rendered.
+ * \arg dispatch() after the depth buffer was written.
+ */
+class DepthReduction
+{
+private:
+	constexpr static std::string_view compShaderFileName = "shaders/deferred/cDepthReduce.comp.spv";
+	constexpr static uint32_t WORKGROUP_SIZE = 16;
+
+	/**
+	 * @brief The result buffer, the depths as their float bits, which sort like the floats as they are positive.
+	 */
+	struct Range
+	{
+		uint32_t minDepth;
+		uint32_t maxDepth;
+	};
+
+	const Context* context{nullptr};
+
+	spirv::Shader shader;
+	spirv::Pipeline pipeline;
+
+	std::vector<vkw::Buffer> results;
+	std::vector<spirv::SetSingleton> sets;
+	VkExtent2D extent{0, 0};
+
+public:
+	/**
+	 * @brief Default constructor.
+	 */
+	DepthReduction() noexcept
+	{
+	}
+
+	/**
+	 * @brief Main constructor.
+	 *
+	 * @param context The Vulkan Context in use.
+	 * @param depthBuffer The depth buffer to reduce, sampled in its read only layout.
+	 * @param frames The number of frames in flight.
+	 */
+	DepthReduction(const Context* context, const Texture2D& depthBuffer, uint32_t frames);
+
+	/**
+	 * @brief Records the reduction of the depth buffer into the result of \a frame.
+	 *
+	 * @param cmd The command buffer to record to, outside of a render pass.
+	 * @param frame The frame in flight.
+	 */
+	void dispatch(VkCommandBuffer cmd, uint32_t frame) const;
+
+	/**
+	 * @brief Reads the range of the last dispatch for \a frame, and resets it for the next dispatch.
+	 *
+	 * The frame must not be in flight.
+	 *
+	 * @returns The smallest and largest depth in [0, 1] that is not the far plane, or nullopt if there
+	 * was none or the frame was not dispatched yet.
+	 */
+	std::optional<glm::vec2> read(uint32_t frame);
+
+	inline bool valid() const
+	{
+		return pipeline.pipeline.valid();
+	}
+
+private:
+	void reset(const vkw::Buffer& result) const;
+	spirv::Shader createShader();
+	spirv::Pipeline createPipeline();
+};
+} // namespace blaze
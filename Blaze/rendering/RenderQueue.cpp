@@ -0,0 +1,97 @@
+#include "RenderQueue.hpp"
+
+#include <core/Drawable.hpp>
+#include <core/GeometryArena.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#include <thirdparty/optick/optick.h>
+
+namespace blaze
+{
+namespace
+{
+/// Bits of a non negative float compare in the same order as the floats.
+uint32_t depthBits(float depth)
+{
+	depth = std::max(depth, 0.0f);
+	uint32_t bits;
+	std::memcpy(&bits, &depth, sizeof(bits));
+	return bits;
+}
+} // namespace
+
+void RenderQueue::clear()
+{
+	items.clear();
+	currentDrawable = nullptr;
+	currentDrawableId = 0;
+	drawableCount = 0;
+	blendedBegin = 0;
+}
+
+void RenderQueue::push(Drawable* drawable, uint32_t element, uint32_t lod, uint32_t material, bool blended,
+					   float depth)
+{
+	if (drawable != currentDrawable)
+	{
+		assert(drawableCount < MAX_DRAWABLES);
+		currentDrawable = drawable;
+		currentDrawableId = drawableCount++ & (MAX_DRAWABLES - 1);
+	}
+
+	const uint64_t state = (static_cast<uint64_t>(currentDrawableId) << 16) | (material & 0xFFFFu);
+	const uint64_t depthKey = depthBits(depth);
+
+	uint64_t key;
+	if (blended)
+	{
+		key = (1ull << 63) | (static_cast<uint64_t>(~depthKey & 0xFFFFFFFFu) << 31) | state;
+	}
+	else
+	{
+		key = (state << 32) | depthKey;
+	}
+
+	items.push_back({key, drawable, element, lod});
+}
+
+void RenderQueue::sort()
+{
+	OPTICK_EVENT();
+	std::sort(items.begin(), items.end(), [](const Item& a, const Item& b) { return a.key < b.key; });
+
+	blendedBegin = std::partition_point(items.begin(), items.end(),
+										[](const Item& item) { return (item.key >> 63) == 0; }) -
+				   items.begin();
+}
+
+void RenderQueue::draw(VkCommandBuffer cb, Pass pass, VkPipelineLayout layout, uint32_t objectSet) const
+{
+	OPTICK_EVENT();
+	size_t begin = pass == OPAQUE_PASS ? 0 : blendedBegin;
+	size_t end = pass == OPAQUE_PASS ? blendedBegin : items.size();
+
+	const Drawable* bound = nullptr;
+	const GeometryArena* boundArena = nullptr;
+	for (size_t i = begin; i < end; i++)
+	{
+		const Item& item = items[i];
+		if (item.drawable != bound)
+		{
+			// Drawables with buffers of their own replace the arena binding.
+			const GeometryArena* arena = item.drawable->get_geometryArena();
+			if (arena != boundArena && arena != nullptr)
+			{
+				arena->bind(cb);
+			}
+			boundArena = arena;
+			item.drawable->bind(cb, layout, objectSet);
+			bound = item.drawable;
+		}
+		item.drawable->drawItem(cb, item.element, item.lod);
+	}
+}
+} // namespace blaze
@@ -0,0 +1,101 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace blaze
+{
+class Drawable;
+
+/**
+ * @brief Sorted list of the individual draws of the Drawables for a frame.
+ *
+ * Drawables expand themselves into items in Drawable::enqueue, each item is given a 64 bit key
+ * and the queue is sorted once per frame. Recording a pass walks the sorted items and only binds
+ * the buffers and sets of a Drawable when the previous item came from a different one.
+ *
+ * Key layout, from the most significant bit:
+ * \arg Opaque: | pass:1 | drawable:15 | material:16 | depth:32 |, grouped by state, then front to back.
+ * \arg Blended: | pass:1 | ~depth:32 | drawable:15 | material:16 |, back to front.
+ *
+ * Each pass has one pipeline, so the pass bit is the pipeline key. The drawable id stands for
+ * its descriptor sets, and its vertex buffer unless it draws from a GeometryArena, which is bound
+ * once for all the consecutive Drawables sharing it.
+ */
+class RenderQueue
+{
+public:
+	enum Pass : uint32_t
+	{
+		OPAQUE_PASS = 0,
+		BLENDED_PASS = 1,
+	};
+
+	/**
+	 * @brief A single draw of a Drawable.
+	 */
+	struct Item
+	{
+		uint64_t key;
+		Drawable* drawable;
+		/// Drawable specific, eg. the primitive index of a Model.
+		uint32_t element;
+		/// The detail level of the element.
+		uint32_t lod;
+	};
+
+	/// Number of drawables that can be told apart by the key.
+	constexpr static uint32_t MAX_DRAWABLES = 1u << 15;
+
+private:
+	std::vector<Item> items;
+	Drawable* currentDrawable{nullptr};
+	uint32_t currentDrawableId{0};
+	uint32_t drawableCount{0};
+	/// Index of the first blended item after sort.
+	size_t blendedBegin{0};
+
+public:
+	/**
+	 * @brief Removes all items, to be called at the start of each frame.
+	 */
+	void clear();
+
+	/**
+	 * @brief Adds a draw of \a drawable.
+	 *
+	 * @param drawable The Drawable recording the draw in Drawable::drawItem.
+	 * @param element The element passed back to Drawable::drawItem.
+	 * @param lod The detail level passed back to Drawable::drawItem.
+	 * @param material The material of the element, used to group draws.
+	 * @param blended Whether the element belongs to the blended pass.
+	 * @param depth The distance of the element from the camera.
+	 */
+	void push(Drawable* drawable, uint32_t element, uint32_t lod, uint32_t material, bool blended, float depth);
+
+	/**
+	 * @brief Sorts the items by their keys.
+	 */
+	void sort();
+
+	/**
+	 * @brief Records the draws of a pass.
+	 *
+	 * The pipeline and the per pass sets must already be bound.
+	 *
+	 * @param cb The command buffer to record to.
+	 * @param pass The pass to draw.
+	 * @param layout The layout of the bound pipeline.
+	 * @param objectSet The index of the object set in \a layout.
+	 */
+	void draw(VkCommandBuffer cb, Pass pass, VkPipelineLayout layout, uint32_t objectSet) const;
+
+	inline size_t get_size() const
+	{
+		return items.size();
+	}
+};
+} // namespace blaze
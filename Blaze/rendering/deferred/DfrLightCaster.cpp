@@ -1,7 +1,13 @@
 
 #include "DfrLightCaster.hpp"
 
+#include <gui/GUI.hpp>
+
+#include <algorithm>
+#include <cassert>
 #include <iostream>
+#include <stdexcept>
+#include <string>
 
 #undef max
 #undef min
@@ -10,15 +16,19 @@ namespace blaze
 {
 // DfrLightCaster
 
-DfrLightCaster::DfrLightCaster(const Context* context, const spirv::Shader* shader, uint32_t frames) noexcept
+DfrLightCaster::DfrLightCaster(const Context* context, const spirv::Shader* shader, uint32_t frames,
+							   const ClusterCuller* culler) noexcept
 {
 	auto set = shader->getSetWithUniform("lights");
-	auto texSet = shader->getSetWithUniform("shadows");
+	auto texSet = shader->getSetWithUniform("shadowAtlas");
 
 	dataSet = context->get_pipelineFactory()->createSets(*set, frames);
 	textureSet = context->get_pipelineFactory()->createSet(*texSet);
-	pointLights = std::make_unique<dfr::PointLightCaster>(context, 1024u, dataSet, textureSet);
-	directionLights = std::make_unique<dfr::DirectionLightCaster>(context, 4u, dataSet, textureSet);
+	shadowMoments = std::make_unique<dfr::ShadowMoments>(context);
+	pointLights =
+		std::make_unique<dfr::PointLightCaster>(context, 1024u, dataSet, textureSet, culler, shadowMoments.get());
+	directionLights =
+		std::make_unique<dfr::DirectionLightCaster>(context, 4u, dataSet, textureSet, culler, shadowMoments.get());
 }
 
 void DfrLightCaster::recreate(const Context* context, const spirv::Shader* shader, uint32_t frames)
@@ -36,65 +46,77 @@ void DfrLightCaster::bind(VkCommandBuffer buf, VkPipelineLayout lay, uint32_t fr
 							nullptr);
 }
 
-dfr::PointLightCaster::LightIterator DfrLightCaster::getPointLightIterator()
+const std::vector<dfr::PointLightCaster::LightData>& DfrLightCaster::getPointLights() const
+{
+	return pointLights->get_lights();
+}
+
+uint32_t DfrLightCaster::getSpotLightCount() const
+{
+	return pointLights->get_spotCount();
+}
+
+void DfrLightCaster::readOcclusion(uint32_t frame, const std::vector<uint64_t>& samples)
+{
+	pointLights->readOcclusion(frame, samples);
+}
+
+const std::vector<glm::mat4>& DfrLightCaster::getOcclusionVolumes() const
 {
-	return pointLights->getLightIterator();
+	return pointLights->get_occlusionVolumes();
+}
+
+uint32_t DfrLightCaster::getOcclusionConeCount() const
+{
+	return pointLights->get_occlusionConeCount();
 }
 
 DfrLightCaster::Handle DfrLightCaster::createPointLight(const glm::vec3& position, float brightness, float radius,
 														bool enableShadow)
 {
-	uint16_t idx = pointLights->createLight(position, glm::vec3(brightness), radius, enableShadow);
-	if (idx == UINT16_MAX)
+	auto idx = pointLights->createLight(position, glm::vec3(brightness), radius, enableShadow);
+	if (idx == dfr::PointLightCaster::INVALID_HANDLE)
 	{
 		return 0;
 	}
 
-	HandleExposed exposed = {
-		static_cast<uint8_t>(Type::POINT),
-		pointGeneration,
-		idx,
-	};
-
-	pointGeneration = pointGeneration + 1;
-
-	Handle handle = reinterpret_cast<Handle&>(exposed);
-	validHandles.insert(handle);
-
-	return handle;
+	return lights.add({Type::POINT, idx});
 }
 
 DfrLightCaster::Handle DfrLightCaster::createPointLight(const glm::vec3& position, const glm::vec3& color, float radius,
 										bool enableShadow)
 {
-	uint16_t idx = pointLights->createLight(position, color, radius, enableShadow);
-	if (idx == UINT16_MAX)
+	auto idx = pointLights->createLight(position, color, radius, enableShadow);
+	if (idx == dfr::PointLightCaster::INVALID_HANDLE)
 	{
 		return 0;
 	}
 
-	HandleExposed exposed = {
-		static_cast<uint8_t>(Type::POINT),
-		pointGeneration,
-		idx,
-	};
-
-	pointGeneration = pointGeneration + 1;
+	return lights.add({Type::POINT, idx});
+}
 
-	Handle handle = reinterpret_cast<Handle&>(exposed);
-	validHandles.insert(handle);
+DfrLightCaster::Handle DfrLightCaster::createSpotLight(const glm::vec3& position, const glm::vec3& direction,
+													   const glm::vec3& color, float radius, float innerAngle,
+													   float outerAngle, bool enableShadow)
+{
+	auto idx = pointLights->createSpotLight(position, direction, color, radius, innerAngle, outerAngle, enableShadow);
+	if (idx == dfr::PointLightCaster::INVALID_HANDLE)
+	{
+		return 0;
+	}
 
-	return handle;
+	return lights.add({Type::SPOT, idx});
 }
 
 void DfrLightCaster::setPosition(Handle handle, const glm::vec3& position)
 {
-	HandleExposed exposed = reinterpret_cast<HandleExposed&>(handle);
-	Type type = static_cast<Type>(exposed.type);
+	const LightRef& ref = getLightRef(handle);
+	Type type = ref.type;
 	switch (type)
 	{
-	case Type::POINT: {
-		pointLights->getLight(exposed.idx)->position = position;
+	case Type::POINT:
+	case Type::SPOT: {
+		pointLights->getLight(ref.idx)->position = position;
 	};
 	break;
 	case Type::DIRECTIONAL: {
@@ -108,8 +130,8 @@ void DfrLightCaster::setPosition(Handle handle, const glm::vec3& position)
 
 void DfrLightCaster::setDirection(Handle handle, const glm::vec3& direction)
 {
-	HandleExposed exposed = reinterpret_cast<HandleExposed&>(handle);
-	Type type = static_cast<Type>(exposed.type);
+	const LightRef& ref = getLightRef(handle);
+	Type type = ref.type;
 	switch (type)
 	{
 	case Type::POINT: {
@@ -117,7 +139,11 @@ void DfrLightCaster::setDirection(Handle handle, const glm::vec3& direction)
 	};
 	break;
 	case Type::DIRECTIONAL: {
-		directionLights->getLight(exposed.idx)->direction = glm::normalize(direction);
+		directionLights->getLight(ref.idx)->direction = glm::normalize(direction);
+	}
+	break;
+	case Type::SPOT: {
+		pointLights->getLight(ref.idx)->direction = glm::normalize(direction);
 	}
 	break;
 	default:
@@ -127,12 +153,13 @@ void DfrLightCaster::setDirection(Handle handle, const glm::vec3& direction)
 
 void DfrLightCaster::setColor(Handle handle, const glm::vec3& color)
 {
-	HandleExposed exposed = reinterpret_cast<HandleExposed&>(handle);
-	Type type = static_cast<Type>(exposed.type);
+	const LightRef& ref = getLightRef(handle);
+	Type type = ref.type;
 	switch (type)
 	{
-	case Type::POINT: {
-		pointLights->getLight(exposed.idx)->color = color;
+	case Type::POINT:
+	case Type::SPOT: {
+		pointLights->getLight(ref.idx)->color = color;
 	};
 	break;
 	case Type::DIRECTIONAL: {
@@ -148,8 +175,8 @@ void DfrLightCaster::setBrightness(Handle handle, float brightness)
 {
 	assert(brightness >= 0.0f);
 
-	HandleExposed exposed = reinterpret_cast<HandleExposed&>(handle);
-	Type type = static_cast<Type>(exposed.type);
+	const LightRef& ref = getLightRef(handle);
+	Type type = ref.type;
 	switch (type)
 	{
 	case Type::POINT: {
@@ -157,7 +184,7 @@ void DfrLightCaster::setBrightness(Handle handle, float brightness)
 	};
 	break;
 	case Type::DIRECTIONAL: {
-		directionLights->getLight(exposed.idx)->brightness = brightness;
+		directionLights->getLight(ref.idx)->brightness = brightness;
 	}
 	break;
 	default:
@@ -167,16 +194,40 @@ void DfrLightCaster::setBrightness(Handle handle, float brightness)
 
 bool DfrLightCaster::setShadow(Handle handle, bool hasShadow)
 {
-	HandleExposed exposed = reinterpret_cast<HandleExposed&>(handle);
-	Type type = static_cast<Type>(exposed.type);
+	const LightRef& ref = getLightRef(handle);
+	Type type = ref.type;
+	switch (type)
+	{
+	case Type::POINT:
+	case Type::SPOT: {
+		return pointLights->setShadow(ref.idx, hasShadow);
+	};
+	break;
+	case Type::DIRECTIONAL: {
+		return directionLights->setShadow(ref.idx, hasShadow);
+	}
+	break;
+	default:
+		throw std::invalid_argument("Unimplemented");
+	}
+}
+
+void DfrLightCaster::setDualParaboloid(Handle handle, bool enable)
+{
+	const LightRef& ref = getLightRef(handle);
+	Type type = ref.type;
 	switch (type)
 	{
 	case Type::POINT: {
-		return pointLights->setShadow(exposed.idx, hasShadow);
+		pointLights->setDualParaboloid(ref.idx, enable);
 	};
 	break;
+	case Type::SPOT: {
+		throw std::invalid_argument("Spot light shadows are a single view");
+	}
+	break;
 	case Type::DIRECTIONAL: {
-		return directionLights->setShadow(exposed.idx, hasShadow);
+		throw std::invalid_argument("Directional light shadows are cascades");
 	}
 	break;
 	default:
@@ -186,12 +237,13 @@ bool DfrLightCaster::setShadow(Handle handle, bool hasShadow)
 
 void DfrLightCaster::setRadius(Handle handle, float radius)
 {
-	HandleExposed exposed = reinterpret_cast<HandleExposed&>(handle);
-	Type type = static_cast<Type>(exposed.type);
+	const LightRef& ref = getLightRef(handle);
+	Type type = ref.type;
 	switch (type)
 	{
-	case Type::POINT: {
-		pointLights->getLight(exposed.idx)->radius = radius;
+	case Type::POINT:
+	case Type::SPOT: {
+		pointLights->getLight(ref.idx)->radius = radius;
 	};
 	break;
 	case Type::DIRECTIONAL: {
@@ -205,33 +257,72 @@ void DfrLightCaster::setRadius(Handle handle, float radius)
 
 void DfrLightCaster::removeLight(Handle handle)
 {
-	if (validHandles.find(handle) == validHandles.end())
+	const LightRef* ref = lights.get(handle);
+	if (ref == nullptr)
 	{
 		return;
 	}
 
-	HandleExposed exposed = reinterpret_cast<HandleExposed&>(handle);
-	uint32_t idx = static_cast<uint32_t>(exposed.idx);
-	Type type = static_cast<Type>(exposed.type);
-	switch (type)
+	switch (ref->type)
 	{
 	case Type::POINT:
-		pointLights->removeLight(idx);
+	case Type::SPOT:
+		pointLights->removeLight(ref->idx);
 		break;
 	case Type::DIRECTIONAL:
-		directionLights->removeLight(idx);
+		directionLights->removeLight(ref->idx);
 		break;
 	default:
 		throw std::invalid_argument("Only point lights are supported so far");
 	}
 
-	validHandles.erase(handle);
+	lights.remove(handle);
+}
+
+std::vector<DfrLightCaster::Handle> DfrLightCaster::createPointLights(const std::vector<PointLightInfo>& infos)
+{
+	// The lights that didn't fit keep a handle of 0.
+	std::vector<Handle> handles(infos.size(), 0);
+	std::vector<dfr::PointLightCaster::Handle> indices = pointLights->createLights(infos);
+
+	lights.reserve(lights.get_size() + static_cast<uint32_t>(indices.size()));
+	for (size_t i = 0; i < indices.size(); ++i)
+	{
+		handles[i] = lights.add({Type::POINT, indices[i]});
+	}
+	return handles;
+}
+
+const DfrLightCaster::LightRef& DfrLightCaster::getLightRef(Handle handle) const
+{
+	const LightRef* ref = lights.get(handle);
+	if (ref == nullptr)
+	{
+		throw std::invalid_argument("Stale light handle " + std::to_string(handle));
+	}
+	return *ref;
+}
+
+void DfrLightCaster::trackCasters(const std::vector<Drawable*>& drawables)
+{
+	casterTracker.update(drawables);
+}
+
+void DfrLightCaster::setViewDepthRange(const glm::vec2& range)
+{
+	directionLights->setViewDepthRange(range);
+}
+
+void DfrLightCaster::setMomentShadows(const Context* context, bool enable)
+{
+	pointLights->setMomentsEnabled(context, enable, textureSet);
+	directionLights->setMomentsEnabled(context, enable, textureSet);
 }
 
 void DfrLightCaster::update(const Camera* camera, uint32_t frame)
 {
-	pointLights->update(frame);
-	directionLights->update(camera, frame);
+	pointLights->update(camera, frame);
+	directionLights->update(camera, frame, casterTracker);
 }
 
 uint32_t DfrLightCaster::getMaxPointLights()
@@ -246,31 +337,23 @@ uint32_t DfrLightCaster::getMaxPointShadows()
 
 void DfrLightCaster::cast(VkCommandBuffer cmd, const std::vector<Drawable*>& drawables)
 {
-	pointLights->cast(cmd, drawables);
-	directionLights->cast(cmd, drawables);
+	const uint32_t budget = static_cast<uint32_t>(std::max(shadowBudget, 1));
+	const uint32_t cascades = directionLights->cast(cmd, drawables, casterTracker);
+	// At least one face, so that point shadows make progress while the cascades move.
+	const uint32_t faceBudget = cascades < budget ? budget - cascades : 1u;
+	drawnShadowFaces = cascades + pointLights->cast(cmd, drawables, casterTracker, faceBudget);
 }
 
 DfrLightCaster::Handle DfrLightCaster::createDirectionLight(const glm::vec3& direction, float brightness,
 															uint32_t numCascades)
 {
-	uint16_t idx = directionLights->createLight(direction, brightness, numCascades);
-	if (idx == UINT16_MAX)
+	auto idx = directionLights->createLight(direction, brightness, numCascades);
+	if (idx == util::SlotMap<dfr::DirectionLightCaster::LightData>::INVALID_HANDLE)
 	{
 		return 0;
 	}
 
-	HandleExposed exposed = {
-		static_cast<uint8_t>(Type::DIRECTIONAL),
-		directionGeneration,
-		idx,
-	};
-
-	directionGeneration = directionGeneration + 1;
-
-	Handle handle = reinterpret_cast<Handle&>(exposed);
-	validHandles.insert(handle);
-
-	return handle;
+	return lights.add({Type::DIRECTIONAL, idx});
 }
 
 uint32_t DfrLightCaster::getMaxDirectionLights()
@@ -282,4 +365,22 @@ uint32_t DfrLightCaster::getMaxDirectionShadows()
 {
 	return directionLights->getMaxShadows();
 }
-} // namespace blaze
\ No newline at end of file
+void DfrLightCaster::drawSettings()
+{
+	if (ImGui::CollapsingHeader("Shadows##DfrLightCaster"))
+	{
+		ImGui::DragInt("Faces Per Frame##DfrLightCaster", &shadowBudget, 0.5f, 1, 96);
+		ImGui::Text("Faces Drawn: %u", drawnShadowFaces);
+		ImGui::DragFloat("Min Cascade Caster Texels##DfrLightCaster", &directionLights->minCasterTexels, 0.1f, 0.0f,
+						 16.0f);
+		ImGui::DragInt("Moment Blur Radius##DfrLightCaster", &shadowMoments->blurRadius, 0.1f, 0,
+					   dfr::ShadowMoments::MAX_BLUR_RADIUS);
+		bool occlusion = pointLights->isOcclusionEnabled();
+		if (ImGui::Checkbox("Occlusion Culling##DfrLightCaster", &occlusion))
+		{
+			pointLights->setOcclusionEnabled(occlusion);
+		}
+		ImGui::Text("Occluded Lights: %u", pointLights->get_occludedCount());
+	}
+}
+} // namespace blaze
@@ -5,15 +5,15 @@
 #include <core/Context.hpp>
 #include <core/UniformBuffer.hpp>
 #include <rendering/ALightCaster.hpp>
+#include <rendering/CasterTracker.hpp>
 #include <spirv/PipelineFactory.hpp>
-#include <util/PackedHandler.hpp>
+#include <util/SlotMap.hpp>
 #include <core/Camera.hpp>
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 
-#include <set>
 
 #include "PointLightCaster.hpp"
 #include "DirectionLightCaster.hpp"
@@ -26,27 +26,64 @@ private:
 	spirv::SetVector dataSet;
 	spirv::SetSingleton textureSet;
 
+	std::unique_ptr<dfr::ShadowMoments> shadowMoments;
 	std::unique_ptr<dfr::PointLightCaster> pointLights;
 	std::unique_ptr<dfr::DirectionLightCaster> directionLights;
-	uint8_t pointGeneration;
-	uint8_t directionGeneration;
-	std::set<Handle> validHandles;
 
-	struct HandleExposed
+	CasterTracker casterTracker;
+
+	/// Most shadow faces and cascades drawn per frame. Cascades that moved are drawn regardless.
+	int shadowBudget{24};
+	uint32_t drawnShadowFaces{0};
+
+	/**
+	 * @brief The caster and index of the light behind a Handle.
+	 */
+	struct LightRef
 	{
-		uint8_t type;
-		uint8_t gen;
-		uint16_t idx;
+		Type type;
+		/// Handle of the light in the caster of its type.
+		uint32_t idx;
 	};
+	util::SlotMap<LightRef> lights;
+
+	/**
+	 * @brief Resolves \a handle, throwing std::invalid_argument if it is stale.
+	 */
+	const LightRef& getLightRef(Handle handle) const;
 
 public:
-	DfrLightCaster(const Context* context, const spirv::Shader* shader, uint32_t frames) noexcept;
+	DfrLightCaster(const Context* context, const spirv::Shader* shader, uint32_t frames,
+				   const ClusterCuller* culler = nullptr) noexcept;
 
 	void recreate(const Context* context, const spirv::Shader* shader, uint32_t frames);
 
 	void bind(VkCommandBuffer buf, VkPipelineLayout lay, uint32_t frame) const;
 
-	dfr::PointLightCaster::LightIterator getPointLightIterator();
+	/**
+	 * @brief The live point and spot lights, packed in the order they are uploaded.
+	 */
+	const std::vector<dfr::PointLightCaster::LightData>& getPointLights() const;
+
+	/**
+	 * @brief The number of spot lights, which follow the point lights in getPointLights.
+	 */
+	uint32_t getSpotLightCount() const;
+
+	/**
+	 * @brief Applies the occlusion queries drawn in \a frame, before the update of the frame.
+	 */
+	void readOcclusion(uint32_t frame, const std::vector<uint64_t>& samples);
+
+	/**
+	 * @brief The light volumes to query for occlusion this frame, the spheres then the cones.
+	 */
+	const std::vector<glm::mat4>& getOcclusionVolumes() const;
+
+	/**
+	 * @brief The number of cones at the end of getOcclusionVolumes.
+	 */
+	uint32_t getOcclusionConeCount() const;
 
 	// Inherited via ALightCaster
 	virtual Handle createPointLight(const glm::vec3& position, float brightness, float radius,
@@ -54,13 +91,31 @@ public:
 	// Inherited via ALightCaster
 	virtual Handle createPointLight(const glm::vec3& position, const glm::vec3& color, float radius,
 									bool enableShadow) override;
+	virtual Handle createSpotLight(const glm::vec3& position, const glm::vec3& direction, const glm::vec3& color,
+								   float radius, float innerAngle, float outerAngle, bool enableShadow) override;
 	virtual void removeLight(Handle handle) override;
+	virtual std::vector<Handle> createPointLights(const std::vector<PointLightInfo>& infos) override;
 	virtual void setPosition(Handle handle, const glm::vec3& position) override;
 	virtual void setDirection(Handle handle, const glm::vec3& direction) override;
 	virtual void setColor(Handle handle, const glm::vec3& color) override;
 	virtual void setBrightness(Handle handle, float brightness) override;
 	virtual bool setShadow(Handle handle, bool hasShadow) override;
+	virtual void setDualParaboloid(Handle handle, bool enable) override;
 	virtual void setRadius(Handle handle, float radius) override;
+	/**
+	 * @brief Compares the casters with the previous frame's, before update, which fits the cascades to them.
+	 */
+	void trackCasters(const std::vector<Drawable*>& drawables);
+	/**
+	 * @brief Sets the nearest and farthest visible view depths to split the cascades over, before update.
+	 */
+	void setViewDepthRange(const glm::vec2& range);
+	/**
+	 * @brief Builds moment maps of the shadows for the EVSM filter of the lighting, or frees them.
+	 *
+	 * The GPU must be idle.
+	 */
+	void setMomentShadows(const Context* context, bool enable);
 	virtual void update(const Camera* camera, uint32_t frame) override;
 	virtual uint32_t getMaxPointLights() override;
 	virtual uint32_t getMaxPointShadows() override;
@@ -72,5 +127,7 @@ public:
 	virtual Handle createDirectionLight(const glm::vec3& direction, float brightness, uint32_t numCascades) override;
 	virtual uint32_t getMaxDirectionLights() override;
 	virtual uint32_t getMaxDirectionShadows() override;
+
+	void drawSettings();
 };
 } // namespace blaze
@@ -5,6 +5,7 @@
 #include <util/files.hpp>
 
 #include <Version.hpp>
+#include <cmath>
 #include <random>
 
 #include <thirdparty/renderdoc/renderdoc.h>
@@ -21,6 +22,12 @@ DfrRenderer::DfrRenderer(GLFWwindow* window, bool enableValidationLayers) noexce
 	// Depthbuffer
 	depthBuffer = createDepthBuffer();
 
+	// XXX: Meshlet culling
+	clusterCuller = ClusterCuller(context.get());
+
+	// XXX: Cascade fitting
+	depthReduction = DepthReduction(context.get(), depthBuffer, maxFrameInFlight);
+
 	// XXX: G-buffer rendering
 
 	mrtAttachment = createMRTAttachment();
@@ -28,6 +35,10 @@ DfrRenderer::DfrRenderer(GLFWwindow* window, bool enableValidationLayers) noexce
 	// Pipeline
 	mrtShader = createMRTShader();
 	mrtPipeline = createMRTPipeline();
+	if (context->get_descriptorIndexing())
+	{
+		textureHeap = TextureHeap(context.get(), mrtShader, "textures");
+	}
 
 	// Attachments
 	mrtFramebuffer = createRenderFramebuffer();
@@ -58,7 +69,7 @@ DfrRenderer::DfrRenderer(GLFWwindow* window, bool enableValidationLayers) noexce
 	forwardShader = createForwardShader();
 	forwardPipeline = createForwardPipeline();
 
-	environmentSet = context->get_pipelineFactory()->createSet(*dirLightShader.getSetWithUniform("skybox"));
+	environmentSet = createEnvironmentSet();
 
 	// All uniform buffer stuff
 	cameraSets = createCameraSets();
@@ -68,10 +79,13 @@ DfrRenderer::DfrRenderer(GLFWwindow* window, bool enableValidationLayers) noexce
 	// Skybox mesh
 	// Deferred Quad
 	lightVolume = getIcoSphere(context.get());
+	spotLightVolume = getCone(context.get());
 	lightQuad = getUVRect(context.get());
 
 	// Lights
-	lightCaster = std::make_unique<DfrLightCaster>(context.get(), &pointLightShader, maxFrameInFlight);
+	lightCaster = std::make_unique<DfrLightCaster>(context.get(), &pointLightShader, maxFrameInFlight, &clusterCuller);
+	lightOcclusion =
+		dfr::LightOcclusion(context.get(), lightingRenderPass, maxFrameInFlight, lightCaster->getMaxPointShadows());
 
 	// Post process
 	postProcessRenderPass = createPostProcessRenderPass();
@@ -87,6 +101,7 @@ void DfrRenderer::recreateSwapchainDependents()
 {
 	// Depthbuffer
 	depthBuffer = createDepthBuffer();
+	depthReduction = DepthReduction(context.get(), depthBuffer, maxFrameInFlight);
 	// renderpass same since numSwapchain independent
 
 	// All uniform buffer stuff
@@ -388,23 +403,86 @@ spirv::SetSingleton* DfrRenderer::get_environmentSet()
 	return &environmentSet;
 }
 
+spirv::SetSingleton DfrRenderer::createEnvironmentSet()
+{
+	return context->get_pipelineFactory()->createSet(*dirLightShader.getSetWithUniform("skybox"));
+}
+
 void DfrRenderer::update(uint32_t frame)
 {
 	OPTICK_EVENT();
 	cameraUBOs[frame].write(camera->getUbo());
 	settingsUBOs[frame].write(settings);
+
+	{
+		OPTICK_EVENT("SelectLod");
+		// Pixels covered by a unit length at unit distance, per pixel of allowed error.
+		const float height = static_cast<float>(swapchain->get_extent().height);
+		float lodScale = enableLod ? camera->get_projection()[1][1] * 0.5f * height / lodPixelError : 0.0f;
+		// Each step of bias halves the precision of the shadow casters.
+		float shadowLodScale = lodScale * std::exp2(-shadowLodBias);
+		for (Drawable* drawable : drawables)
+		{
+			drawable->selectLod(ClusterCuller::CAMERA_VIEW, camera->get_position(), lodScale);
+			drawable->selectLod(ClusterCuller::SHADOW_VIEW, camera->get_position(), shadowLodScale);
+		}
+	}
+
+	// After the levels are selected, as a change of the shadow levels changes the versions.
+	lightCaster->trackCasters(drawables.get_data());
+
+	// The visible depths of the last time this frame was rendered, converted from the depth buffer to view depths.
+	glm::vec2 viewDepthRange(0.0f);
+	auto depths = depthReduction.read(frame);
+	if (fitCascadesToDepth && depths)
+	{
+		const glm::mat4& projection = camera->get_projection();
+		viewDepthRange = projection[3][2] / (*depths + projection[2][2]);
+		// Headroom for the view moving in the frames the range lags behind.
+		viewDepthRange *= glm::vec2(0.9f, 1.1f);
+	}
+	lightCaster->setViewDepthRange(viewDepthRange);
+	// The queries of the last time this frame was rendered, before the lights are uploaded without the occluded ones.
+	lightCaster->readOcclusion(frame, lightOcclusion.read(frame));
 	lightCaster->update(camera, frame);
 }
 
 void DfrRenderer::recordCommands(uint32_t frame)
 {
 	OPTICK_EVENT();
-	lightCaster->cast(commandBuffers[frame], drawables.get_data());
-
 	auto& extent = swapchain->get_extent();
 
+	for (Drawable* drawable : drawables)
+	{
+		drawable->upload(commandBuffers[frame]);
+	}
+
+	{
+		OPTICK_EVENT("RenderQueue");
+		renderQueue.clear();
+		for (Drawable* drawable : drawables)
+		{
+			drawable->enqueue(renderQueue, camera->get_position());
+		}
+		renderQueue.sort();
+	}
+
+	lightCaster->cast(commandBuffers[frame], drawables.get_data());
+
 	auto [viewport, scissor] = createViewportScissor(extent);
 
+	{
+		OPTICK_EVENT("ClusterCull");
+		auto frustum = ClusterCuller::createFrustum(camera->get_projection() * camera->get_view(),
+													camera->get_position(), true);
+		clusterCuller.begin(commandBuffers[frame]);
+		for (Drawable* drawable : drawables)
+		{
+			drawable->cull(commandBuffers[frame], clusterCuller, ClusterCuller::CAMERA_VIEW, frustum);
+		}
+		clusterCuller.end(commandBuffers[frame]);
+	}
+
 	mrtRenderPass.begin(commandBuffers[frame], mrtFramebuffer);
 
 	vkCmdSetScissor(commandBuffers[frame], 0, 1, &scissor);
@@ -414,15 +492,23 @@ void DfrRenderer::recordCommands(uint32_t frame)
 	mrtPipeline.bind(commandBuffers[frame]);
 	vkCmdBindDescriptorSets(commandBuffers[frame], mrtPipeline.bindPoint, mrtShader.pipelineLayout.get(),
 							cameraSets.setIdx, 1, &cameraSets[frame], 0, nullptr);
-	for (Drawable* drawable : drawables)
+	if (textureHeap.valid())
 	{
-		drawable->drawOpaque(commandBuffers[frame], mrtShader.pipelineLayout.get());
+		textureHeap.bind(commandBuffers[frame], mrtShader.pipelineLayout.get());
 	}
+	renderQueue.draw(commandBuffers[frame], RenderQueue::OPAQUE_PASS, mrtShader.pipelineLayout.get(),
+					 mrtShader.getSetWithUniform("nodeTransforms")->set);
 
 	mrtRenderPass.end(commandBuffers[frame]);
 
+	if (fitCascadesToDepth)
+	{
+		depthReduction.dispatch(commandBuffers[frame], frame);
+	}
+
 	ssao->process(commandBuffers[frame], cameraSets, frame, lightQuad);
 
+	lightOcclusion.reset(commandBuffers[frame], frame);
 	lightingRenderPass.begin(commandBuffers[frame], lightingFramebuffer);
 
 	vkCmdSetScissor(commandBuffers[frame], 0, 1, &scissor);
@@ -433,20 +519,31 @@ void DfrRenderer::recordCommands(uint32_t frame)
 	if (settings.viewRT == Settings::RENDER)
 	{
 		OPTICK_EVENT("DrawPointLights");
+		// Against the depth of this frame, read back when the frame comes around again.
+		lightOcclusion.draw(commandBuffers[frame], frame, cameraSets, lightCaster->getOcclusionVolumes(),
+							lightCaster->getOcclusionConeCount(), lightVolume, spotLightVolume);
+
 		pointLightPipeline.bind(commandBuffers[frame]);
 		lightCaster->bind(commandBuffers[frame], pointLightShader.pipelineLayout.get(), frame);
 		vkCmdBindDescriptorSets(commandBuffers[frame], pointLightPipeline.bindPoint, pointLightShader.pipelineLayout.get(),
 								cameraSets.setIdx, 1, &cameraSets[frame], 0, nullptr);
 		vkCmdBindDescriptorSets(commandBuffers[frame], pointLightPipeline.bindPoint, pointLightShader.pipelineLayout.get(),
 								lightInputSet.setIdx, 1, &lightInputSet.get(), 0, nullptr);
-		lightVolume.bind(commandBuffers[frame]);
-		for (auto it = lightCaster->getPointLightIterator(); it.valid(); ++it)
+		// The lights are packed, so one instanced draw covers the volumes of each kind. The spot lights
+		// follow the point lights, so their instances start after them.
+		const uint32_t spotLightCount = lightCaster->getSpotLightCount();
+		const uint32_t pointLightCount =
+			static_cast<uint32_t>(lightCaster->getPointLights().size()) - spotLightCount;
+		if (pointLightCount > 0)
 		{
-			glm::ivec4 idx(it.index);
-			vkCmdPushConstants(commandBuffers[frame], pointLightShader.pipelineLayout.get(),
-							   pointLightShader.pushConstant.stage, 0, pointLightShader.pushConstant.size, &idx[0]);
-
-			vkCmdDrawIndexed(commandBuffers[frame], lightVolume.get_indexCount(), 1, 0, 0, 0);
+			lightVolume.bind(commandBuffers[frame]);
+			vkCmdDrawIndexed(commandBuffers[frame], lightVolume.get_indexCount(), pointLightCount, 0, 0, 0);
+		}
+		if (spotLightCount > 0)
+		{
+			spotLightVolume.bind(commandBuffers[frame]);
+			vkCmdDrawIndexed(commandBuffers[frame], spotLightVolume.get_indexCount(), spotLightCount, 0, 0,
+							 pointLightCount);
 		}
 	}
 
@@ -474,10 +571,12 @@ void DfrRenderer::recordCommands(uint32_t frame)
 								cameraSets.setIdx, 1, &cameraSets[frame], 0, nullptr);
 		vkCmdBindDescriptorSets(commandBuffers[frame], forwardPipeline.bindPoint, forwardShader.pipelineLayout.get(),
 								environmentSet.setIdx, 1, &environmentSet.get(), 0, nullptr);
-		for (Drawable* drawable : drawables)
+		if (textureHeap.valid())
 		{
-			drawable->drawAlphaBlended(commandBuffers[frame], forwardShader.pipelineLayout.get());
+			textureHeap.bind(commandBuffers[frame], forwardShader.pipelineLayout.get());
 		}
+		renderQueue.draw(commandBuffers[frame], RenderQueue::BLENDED_PASS, forwardShader.pipelineLayout.get(),
+						 forwardShader.getSetWithUniform("nodeTransforms")->set);
 	}
 
 	// Lights vis
@@ -489,13 +588,13 @@ void DfrRenderer::recordCommands(uint32_t frame)
 								lightVisShader.pipelineLayout.get(), cameraSets.setIdx, 1, &cameraSets[frame], 0,
 								nullptr);
 		lightVolume.bind(commandBuffers[frame]);
-		for (auto it = lightCaster->getPointLightIterator(); it.valid(); ++it)
+		for (const auto& light : lightCaster->getPointLights())
 		{
-			glm::mat4 pos = glm::scale(glm::translate(glm::mat4(1.0f), it.data->position), glm::vec3(0.1f));
+			glm::mat4 pos = glm::scale(glm::translate(glm::mat4(1.0f), light.position), glm::vec3(0.1f));
 			vkCmdPushConstants(commandBuffers[frame], lightVisShader.pipelineLayout.get(),
 							   lightVisShader.pushConstant.stage, 0, sizeof(glm::mat4), &pos);
 			vkCmdPushConstants(commandBuffers[frame], lightVisShader.pipelineLayout.get(),
-							   lightVisShader.pushConstant.stage, sizeof(glm::mat4), sizeof(glm::vec4), &it.data->color);
+							   lightVisShader.pushConstant.stage, sizeof(glm::mat4), sizeof(glm::vec4), &light.color);
 			vkCmdDrawIndexed(commandBuffers[frame], lightVolume.get_indexCount(), 1, 0, 0, 0);
 		}
 	}
@@ -532,6 +631,23 @@ void DfrRenderer::drawSettings()
 		{
 			ImGui::Checkbox("Enable IBL", (bool*)&settings.enableIBL);
 			ImGui::Checkbox("Enable Light Visualization", &visualizeLights);
+			ImGui::Checkbox("Enable Meshlet Culling", &clusterCuller.enabled);
+			ImGui::Text("Draw Items: %zu", renderQueue.get_size());
+			ImGui::Checkbox("Enable Mesh LOD", &enableLod);
+			ImGui::DragFloat("LOD Pixel Error", &lodPixelError, 0.1f, 0.25f, 16.0f);
+			ImGui::DragFloat("Shadow LOD Bias", &shadowLodBias, 0.1f, 0.0f, 4.0f);
+			ImGui::Checkbox("Fit Cascades To Visible Depth", &fitCascadesToDepth);
+			ImGui::DragInt("Shadow Filter Taps", &settings.shadowTaps, 0.1f, 1, 16);
+			ImGui::DragFloat("Shadow Filter Radius", &settings.shadowFilterRadius, 0.05f, 0.0f, 4.0f);
+			bool momentShadows = settings.shadowFilter == Settings::SHADOW_EVSM;
+			if (ImGui::Checkbox("Moment Shadows (EVSM)", &momentShadows))
+			{
+				// The moment maps are bound to the texture set of the frames in flight.
+				waitIdle();
+				lightCaster->setMomentShadows(context.get(), momentShadows);
+				settings.shadowFilter = momentShadows ? Settings::SHADOW_EVSM : Settings::SHADOW_PCF;
+			}
+			ImGui::DragFloat("Shadow Bleed Reduction", &settings.shadowBleedReduction, 0.01f, 0.0f, 0.9f);
 			ImGui::Checkbox("Use Vertex Normals", (bool*)&settings.useVertexNormals);
 			bool enableModRoughness = settings.modRoughness >= 0.0f;
 			if (ImGui::Checkbox("Modify Roughness", &enableModRoughness))
@@ -558,6 +674,8 @@ void DfrRenderer::drawSettings()
 
 		ssao->drawSettings();
 
+		lightCaster->drawSettings();
+
 		if (ImGui::CollapsingHeader("MRT Debug Output"))
 		{
 			if (ImGui::RadioButton("Full Render", settings.viewRT == settings.RENDER))
@@ -615,6 +733,11 @@ ALightCaster* DfrRenderer::get_lightCaster()
 	return lightCaster.get();
 }
 
+TextureHeap* DfrRenderer::get_textureHeap()
+{
+	return textureHeap.valid() ? &textureHeap : nullptr;
+}
+
 spirv::Shader DfrRenderer::createMRTShader()
 {
 	std::vector<spirv::ShaderStageData> stages;
@@ -625,7 +748,8 @@ spirv::Shader DfrRenderer::createMRTShader()
 	stage->stage = VK_SHADER_STAGE_VERTEX_BIT;
 
 	stage = &stages.emplace_back();
-	stage->spirv = util::loadBinaryFile(fMRTShaderFileName);
+	stage->spirv = util::loadBinaryFile(context->get_descriptorIndexing() ? fMRTBindlessShaderFileName
+																		   : fMRTShaderFileName);
 	stage->stage = VK_SHADER_STAGE_FRAGMENT_BIT;
 
 	return context->get_pipelineFactory()->createShader(stages);
@@ -1117,7 +1241,8 @@ spirv::Shader DfrRenderer::createForwardShader()
 	stage->stage = VK_SHADER_STAGE_VERTEX_BIT;
 
 	stage = &stages.emplace_back();
-	stage->spirv = util::loadBinaryFile(fTransparencyShaderFileName);
+	stage->spirv = util::loadBinaryFile(context->get_descriptorIndexing() ? fTransparencyBindlessShaderFileName
+																		   : fTransparencyShaderFileName);
 	stage->stage = VK_SHADER_STAGE_FRAGMENT_BIT;
 
 	return context->get_pipelineFactory()->createShader(stages);
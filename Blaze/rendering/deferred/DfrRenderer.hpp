@@ -6,7 +6,11 @@
 
 #include <core/Texture2D.hpp>
 #include <rendering/ARenderer.hpp>
+#include <rendering/ClusterCuller.hpp>
+#include <rendering/DepthReduction.hpp>
+#include <rendering/RenderQueue.hpp>
 #include <rendering/deferred/DfrLightCaster.hpp>
+#include <rendering/deferred/LightOcclusion.hpp>
 #include <core/VertexBuffer.hpp>
 #include <rendering/postprocess/HdrTonemap.hpp>
 #include <rendering/postprocess/Bloom.hpp>
@@ -25,6 +29,7 @@ class DfrRenderer final : public ARenderer
 private:
 	constexpr static std::string_view vMRTShaderFileName = "shaders/deferred/vMRT.vert.spv";
 	constexpr static std::string_view fMRTShaderFileName = "shaders/deferred/fMRT.frag.spv";
+	constexpr static std::string_view fMRTBindlessShaderFileName = "shaders/deferred/fMRT.frag.bindless.spv";
 
 	constexpr static std::string_view vLightingShaderFileName = "shaders/deferred/vLighting.vert.spv";
 	constexpr static std::string_view fLightingShaderFileName = "shaders/deferred/fLighting.frag.spv";
@@ -34,6 +39,8 @@ private:
 
 	constexpr static std::string_view vTransparencyShaderFileName = "shaders/deferred/vTransparency.vert.spv";
 	constexpr static std::string_view fTransparencyShaderFileName = "shaders/deferred/fTransparency.frag.spv";
+	constexpr static std::string_view fTransparencyBindlessShaderFileName =
+		"shaders/deferred/fTransparency.frag.bindless.spv";
 
 	constexpr static std::string_view vLightVisShaderFileName = "shaders/deferred/vLightVis.vert.spv";
 	constexpr static std::string_view fLightVisShaderFileName = "shaders/deferred/fLightVis.frag.spv";
@@ -55,6 +62,18 @@ private:
 		} viewRT{RENDER};
 		int useVertexNormals{0};
 		float modRoughness{-1.0f};
+		/// Rotated Poisson taps of the shadow filter, each a hardware filtered compare.
+		int shadowTaps{4};
+		/// Radius of the shadow filter in shadow map texels.
+		float shadowFilterRadius{1.5f};
+		/// Filter of the shadows, the moment maps of EVSM are filtered with a single trilinear fetch.
+		enum : int
+		{
+			SHADOW_PCF = 0x0,
+			SHADOW_EVSM = 0x1,
+		} shadowFilter{SHADOW_PCF};
+		/// Fraction of the upper bound of the moment filter that is cut off, to hide light bleeding.
+		float shadowBleedReduction{0.2f};
 
 		void draw();
 	} settings;
@@ -80,6 +99,24 @@ private:
 		}
 	};
 
+	// Meshlet culling
+	ClusterCuller clusterCuller;
+
+	// Visible depth range for the shadow cascades
+	DepthReduction depthReduction;
+	bool fitCascadesToDepth{true};
+
+	// Sorted draws of the MRT and transparency passes
+	RenderQueue renderQueue;
+
+	// Level of detail
+	bool enableLod{true};
+	float lodPixelError{1.0f};
+	float shadowLodBias{1.0f};
+
+	// Material textures of all the models, when descriptor indexing is supported.
+	TextureHeap textureHeap;
+
 	// MRT
 	spirv::RenderPass mrtRenderPass;
 	MRTAttachment mrtAttachment;
@@ -115,12 +152,16 @@ private:
 
 	// Lights
 	IndexedVertexBuffer<Vertex> lightVolume;
+	IndexedVertexBuffer<Vertex> spotLightVolume;
 	IndexedVertexBuffer<Vertex> lightQuad;
 
 	bool visualizeLights;
 
 	std::unique_ptr<DfrLightCaster> lightCaster;
 
+	// Occlusion queries of the shadowed light volumes
+	dfr::LightOcclusion lightOcclusion;
+
 	spirv::SetSingleton environmentSet;
 
 	spirv::Shader lightVisShader;
@@ -171,6 +212,7 @@ public:
 	// Inherited via ARenderer
 	virtual const spirv::Shader* get_shader() const override;
 	virtual ALightCaster* get_lightCaster() override;
+	virtual TextureHeap* get_textureHeap() override;
 	virtual void drawSettings() override;
 
 protected:
@@ -217,5 +259,6 @@ private:
 
 	// Inherited via ARenderer
 	virtual spirv::SetSingleton* get_environmentSet() override;
+	virtual spirv::SetSingleton createEnvironmentSet() override;
 };
 } // namespace blaze
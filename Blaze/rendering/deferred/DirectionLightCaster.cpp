@@ -3,6 +3,10 @@
 
 #include <util/files.hpp>
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 
@@ -17,31 +21,19 @@
 namespace blaze::dfr
 {
 DirectionLightCaster::DirectionLightCaster(const Context* context, uint32_t numLights, const spirv::SetVector& sets,
-										   const spirv::SetSingleton& texSet) noexcept
+										   const spirv::SetSingleton& texSet, const ClusterCuller* culler,
+										   const ShadowMoments* moments) noexcept
+	: culler(culler), moments(moments)
 {
 	renderPass = createRenderPass(context);
 	shadowShader = createShader(context);
 	shadowPipeline = createPipeline(context);
 
-	auto uniform = sets.getUniform(dataUniformName);
 	maxLights = numLights;
-	lights = std::vector<LightData>(maxLights);
 	ubos = SSBODataVector(context, maxLights * sizeof(LightData), sets.size());
-	count = 0;
+	lights.reserve(maxLights);
 
-	int i = -1;
-	for (auto& light : lights)
-	{
-		light.direction = glm::vec3(0);
-		light.brightness = static_cast<float>(i);
-		light.shadowIdx = -1;
-		i--;
-	}
-	i = std::numeric_limits<int>::min();
-	lights.back().brightness = static_cast<float>(i);
-	freeLight = 0;
-
-	uniform = texSet.getUniform(textureUniformName);
+	auto uniform = texSet.getUniform(textureUniformName);
 	maxShadows = uniform->arrayLength;
 
 	for (uint32_t i = 0; i < maxShadows; ++i)
@@ -51,6 +43,7 @@ DirectionLightCaster::DirectionLightCaster(const Context* context, uint32_t numL
 	}
 	shadows.back().next = -1;
 	freeShadow = 0;
+	shadowCount = 0;
 
 	bindDataSet(context, sets);
 	bindTextureSet(context, texSet);
@@ -84,14 +77,49 @@ glm::vec4 DirectionLightCaster::createCascadeSplits(int numSplits, float nearPla
 
 float DirectionLightCaster::centerDist(float n, float f, float cosine) const
 {
-	// TODO: FIX: Min waste
+	// Equidistant from the near and far corners of the slice. Past the far plane, the sphere around the
+	// far corners is smaller and still holds the near ones.
 	float secTheta = 1.0f / cosine;
-	return 0.5f * (f + n) * secTheta * secTheta;
+	return std::min(0.5f * (f + n) * secTheta * secTheta, f);
 }
 
-void DirectionLightCaster::updateLight(const Camera* camera, LightData* light)
+glm::vec2 DirectionLightCaster::fitDepthRange(const glm::mat4& lightView, float radius,
+											   const CasterTracker& casters) const
+{
+	// The view is centered on the cascade, so the receivers are within radius of depth 0.
+	float nearDepth = std::numeric_limits<float>::max();
+	float farDepth = -std::numeric_limits<float>::max();
+	for (const auto& caster : casters.get_casters())
+	{
+		const glm::vec4& bounds = caster.bounds;
+		if (std::isinf(bounds.w))
+		{
+			// Unbounded casters could be anywhere in front of the cascade.
+			return glm::vec2(-3.0f * radius, radius);
+		}
+
+		const glm::vec3 position = glm::vec3(lightView * glm::vec4(glm::vec3(bounds), 1.0f));
+		const float depth = -position.z;
+		if (std::abs(position.x) > radius + bounds.w || std::abs(position.y) > radius + bounds.w ||
+			depth - bounds.w > radius)
+		{
+			continue;
+		}
+		nearDepth = std::min(nearDepth, depth - bounds.w);
+		farDepth = std::max(farDepth, depth + bounds.w);
+	}
+
+	if (nearDepth >= farDepth)
+	{
+		// Nothing in the box.
+		return glm::vec2(-radius, radius);
+	}
+	// Nothing behind the receivers in the cascade's sphere needs depth.
+	return glm::vec2(nearDepth, std::min(farDepth, radius));
+}
+
+void DirectionLightCaster::updateLight(const Camera* camera, const CasterTracker& casters, LightData* light)
 {
-	// TODO: Recheck
 	glm::vec4 frustumCorners[] = {
 		{-1, -1, -1, 1}, // ---
 		{-1, 1, -1, 1},	 // -+-
@@ -110,13 +138,22 @@ void DirectionLightCaster::updateLight(const Camera* camera, LightData* light)
 		vert /= vert.w;
 	}
 
-	light->cascadeSplits = createCascadeSplits(light->numCascades, camera->get_nearPlane(), camera->get_farPlane());
+	// The splits only cover the visible depths when they are known.
+	float nearPlane = camera->get_nearPlane();
+	float farPlane = camera->get_farPlane();
+	if (viewDepthRange.x < viewDepthRange.y)
+	{
+		nearPlane = std::max(viewDepthRange.x, nearPlane);
+		farPlane = std::min(viewDepthRange.y, farPlane);
+	}
+	light->cascadeSplits = createCascadeSplits(light->numCascades, nearPlane, farPlane);
 
 	float cosine =
 		glm::dot(glm::normalize(glm::vec3(frustumCorners[4]) - camera->get_position()), camera->get_direction());
-	glm::vec3 cornerRay = glm::normalize(glm::vec3(frustumCorners[4] - frustumCorners[0]));
-	
-	float prevPlane = camera->get_nearPlane();
+	// Squared tangent of the angle between the view direction and the corner rays.
+	float tan2 = 1.0f / (cosine * cosine) - 1.0f;
+
+	float prevPlane = nearPlane;
 	float plane = 0;
 	for (int i = 0; i < light->numCascades; ++i)
 	{
@@ -124,16 +161,16 @@ void DirectionLightCaster::updateLight(const Camera* camera, LightData* light)
 		float cDist = centerDist(prevPlane, plane, cosine);
 		auto center = camera->get_direction() * cDist + camera->get_position();
 
-		float nearRatio = (prevPlane / camera->get_farPlane());
-		auto corner = cornerRay * nearRatio + camera->get_position();
-
-		float r = glm::distance(center, corner);
+		// The corners of the slice are at a distance of depth * tan from the view axis.
+		float nearOffset = cDist - prevPlane;
+		float farOffset = plane - cDist;
+		float r = std::sqrt(std::max(nearOffset * nearOffset + prevPlane * prevPlane * tan2,
+									 farOffset * farOffset + plane * plane * tan2));
 		auto& bz = light->direction;
 
-		// TODO Farplane fixes
-		auto lightOrthoMatrix = glm::ortho(-r, r, -r, r, 0.0f, 4*r);
-		auto lightViewMatrix =
-			glm::lookAt(center - 3.0f * bz * r, center, glm::vec3(0, 1, 0));
+		auto lightViewMatrix = glm::lookAt(center, center + bz, glm::vec3(0, 1, 0));
+		glm::vec2 depthRange = fitDepthRange(lightViewMatrix, r, casters);
+		auto lightOrthoMatrix = glm::ortho(-r, r, -r, r, depthRange.x, depthRange.y);
 		glm::mat4 shadowMatrix = lightOrthoMatrix * lightViewMatrix;
 		glm::vec4 shadowOrigin = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
 		shadowOrigin = shadowMatrix * shadowOrigin;
@@ -155,77 +192,66 @@ void DirectionLightCaster::updateLight(const Camera* camera, LightData* light)
 	}
 }
 
-void DirectionLightCaster::update(const Camera* camera, uint32_t frame)
+void DirectionLightCaster::update(const Camera* camera, uint32_t frame, const CasterTracker& casters)
 {
+	OPTICK_EVENT();
 	for (auto& light : lights)
 	{
-		updateLight(camera, &light);
+		updateLight(camera, casters, &light);
 	}
-	ubos[frame].writeData(lights.data(), maxLights * sizeof(LightData));
-}
 
-uint16_t DirectionLightCaster::createLight(const glm::vec3& direction, float brightness, uint32_t numCascades)
-{
-	if (freeLight < 0)
+	const uint32_t count = lights.get_size();
+	if (count > 0)
 	{
-		return UINT16_MAX;
+		ubos[frame].writeData(lights.get_data().data(), 0, count * sizeof(LightData));
 	}
-
-	LightData* pLight = &lights[freeLight];
-	uint16_t idx = static_cast<uint16_t>(freeLight);
-
-	freeLight = -static_cast<int>(pLight->brightness);
-
-	pLight->direction = glm::normalize(direction);
-	pLight->brightness = brightness;
-	pLight->numCascades = numCascades;
-	pLight->shadowIdx = -1;
-	// TODO Shadow
-
-	if (numCascades > 0)
+	if (count < maxLights)
 	{
-		pLight->shadowIdx = createShadow();
-		shadows[pLight->shadowIdx].next = idx;
+		// Ends the loops over the lights in the shaders.
+		LightData terminator = {};
+		terminator.brightness = -1.0f;
+		terminator.shadowIdx = -1;
+		ubos[frame].writeData(&terminator, count * sizeof(LightData), sizeof(LightData));
 	}
-
-	count++;
-
-	return idx;
 }
 
-void DirectionLightCaster::removeLight(uint16_t idx)
+DirectionLightCaster::Handle DirectionLightCaster::createLight(const glm::vec3& direction, float brightness,
+															   uint32_t numCascades)
 {
-	assert(idx < maxLights);
-
-	LightData* pLight = &lights[idx];
+	if (lights.get_size() >= maxLights)
+	{
+		return util::SlotMap<LightData>::INVALID_HANDLE;
+	}
 
-	assert(pLight->brightness > 0);
+	LightData light = {};
+	light.direction = glm::normalize(direction);
+	light.brightness = brightness;
+	light.numCascades = numCascades;
+	light.shadowIdx = numCascades > 0 ? createShadow() : -1;
+	return lights.add(light);
+}
 
-	pLight->brightness = -static_cast<float>(freeLight);
-	pLight->direction = glm::vec3(0.0f);
+void DirectionLightCaster::removeLight(Handle handle)
+{
+	LightData* pLight = lights.get(handle);
+	if (pLight == nullptr)
+	{
+		return;
+	}
 
 	if (pLight->shadowIdx >= 0)
 	{
-		assert(shadows[pLight->shadowIdx].next == idx);
 		removeShadow(pLight->shadowIdx);
 	}
-
-	pLight->shadowIdx = -1;
-
-	count--;
-	freeLight = idx;
+	lights.remove(handle);
 }
 
-bool DirectionLightCaster::setShadow(uint16_t idx, bool enableShadow)
+bool DirectionLightCaster::setShadow(Handle handle, bool enableShadow)
 {
-	assert(idx < maxLights);
-
-	LightData* pLight = &lights[idx];
-
-	assert(pLight->brightness > 0);
+	LightData* pLight = lights.get(handle);
+	assert(pLight != nullptr);
 
 	bool hasShadow = pLight->shadowIdx >= 0;
-
 	if (hasShadow == enableShadow)
 	{
 		return hasShadow;
@@ -233,11 +259,7 @@ bool DirectionLightCaster::setShadow(uint16_t idx, bool enableShadow)
 	else if (enableShadow)
 	{
 		pLight->shadowIdx = createShadow();
-		if (pLight->shadowIdx >= 0)
-		{
-			shadows[pLight->shadowIdx].next = idx;
-			return true;
-		}
+		return pLight->shadowIdx >= 0;
 	}
 	else
 	{
@@ -255,6 +277,7 @@ int DirectionLightCaster::createShadow()
 	}
 	auto i = freeShadow;
 	freeShadow = shadows[i].next;
+	shadows[i].cachedCascades = 0;
 	shadowCount++;
 
 	return i;
@@ -267,32 +290,126 @@ void DirectionLightCaster::removeShadow(int idx)
 	shadowCount--;
 }
 
-void DirectionLightCaster::cast(VkCommandBuffer cmd, const std::vector<Drawable*>& drawables)
+uint32_t DirectionLightCaster::cast(VkCommandBuffer cmd, const std::vector<Drawable*>& drawables,
+									const CasterTracker& casters)
 {
 	OPTICK_EVENT();
+	uint32_t drawnCount = 0;
+	std::vector<Drawable*> cascadeCasters;
+	cascadeCasters.reserve(drawables.size());
+	std::vector<ShadowMoments::Region> momentRegions;
+	uint32_t objectSet = shadowShader.getSetWithUniform("nodeTransforms")->set;
 	for (auto& light : lights)
 	{
 		if (light.shadowIdx < 0)
 			continue;
 		DirectionShadow* shadow = &shadows[light.shadowIdx];
+		momentRegions.clear();
 
 		for (int i = 0; i < light.numCascades; ++i)
 		{
+			// Casters between the light and the cascade cast into it, so the near plane isn't tested.
+			const auto bounds = ClusterCuller::createFrustum(light.cascadeViewProj[i], glm::vec3(0.0f), false, false);
+			if (i < shadow->cachedCascades && shadow->cachedViewProj[i] == light.cascadeViewProj[i] &&
+				!casters.intersects(bounds))
+			{
+				continue;
+			}
+			shadow->cachedViewProj[i] = light.cascadeViewProj[i];
+			drawnCount++;
+
+			// The first row of the ortho view projection is the light's x axis over the half width of the box.
+			const glm::mat4& viewProj = light.cascadeViewProj[i];
+			const glm::vec3 xAxis = glm::vec3(viewProj[0][0], viewProj[1][0], viewProj[2][0]);
+			const float texelSize = 2.0f / (DIRECTION_MAP_RESOLUTION * glm::length(xAxis));
+			const float minRadius = i > 0 ? 0.5f * minCasterTexels * texelSize : 0.0f;
+
+			cascadeCasters.clear();
+			for (Drawable* d : drawables)
+			{
+				const glm::vec4 casterBounds = d->get_bounds();
+				if (casterBounds.w >= minRadius && ClusterCuller::intersects(bounds, casterBounds))
+				{
+					cascadeCasters.push_back(d);
+				}
+			}
+
+			if (culler)
+			{
+				auto frustum = ClusterCuller::createFrustum(light.cascadeViewProj[i], glm::vec3(0.0f), false);
+				culler->begin(cmd);
+				for (Drawable* d : cascadeCasters)
+				{
+					d->cull(cmd, *culler, ClusterCuller::SHADOW_VIEW, frustum);
+				}
+				culler->end(cmd);
+			}
+
 			renderPass.begin(cmd, shadow->framebuffer[i]);
 
 			shadowPipeline.bind(cmd);
 			vkCmdSetViewport(cmd, 0, 1, &shadow->viewport);
 			vkCmdSetScissor(cmd, 0, 1, &shadow->scissor);
 			vkCmdPushConstants(cmd, shadowShader.pipelineLayout.get(), shadowShader.pushConstant.stage,
-							   sizeof(ModelPushConstantBlock), sizeof(glm::mat4), &light.cascadeViewProj[i]);
-			for (Drawable* d : drawables)
+							   0, sizeof(glm::mat4), &light.cascadeViewProj[i]);
+			for (Drawable* d : cascadeCasters)
 			{
-				d->drawGeometry(cmd, shadowShader.pipelineLayout.get());
+				d->drawGeometry(cmd, shadowShader.pipelineLayout.get(), objectSet);
 			}
 
 			renderPass.end(cmd);
+
+			if (shadow->momentMap.valid())
+			{
+				momentRegions.push_back({static_cast<uint32_t>(i), shadow->scissor});
+			}
+		}
+		shadow->cachedCascades = light.numCascades;
+
+		if (!momentRegions.empty())
+		{
+			moments->build(cmd, shadow->momentMap, momentRegions);
+		}
+	}
+	return drawnCount;
+}
+
+void DirectionLightCaster::setMomentsEnabled(const Context* context, bool enable, const spirv::SetSingleton& texSet)
+{
+	assert(moments);
+
+	if (enable == momentsEnabled)
+	{
+		return;
+	}
+	momentsEnabled = enable;
+
+	// Every shadow has a map, as the maps are bound once here and not as the shadows are created.
+	VkCommandBuffer cmd = enable ? context->startCommandBufferRecord() : VK_NULL_HANDLE;
+	for (auto& shadow : shadows)
+	{
+		if (!enable)
+		{
+			shadow.momentMap = ShadowMoments::MomentMap();
+			continue;
+		}
+
+		shadow.momentMap = moments->createMomentMap(shadow.shadowMap);
+
+		// The cached cascades would otherwise be without moments until they are drawn again.
+		std::vector<ShadowMoments::Region> regions;
+		for (int i = 0; i < shadow.cachedCascades; ++i)
+		{
+			regions.push_back({static_cast<uint32_t>(i), shadow.scissor});
 		}
+		moments->build(cmd, shadow.momentMap, regions);
 	}
+	if (enable)
+	{
+		context->flushCommandBuffer(cmd);
+	}
+
+	bindTextureSet(context, texSet);
 }
 
 void DirectionLightCaster::bindDataSet(const Context* context, const spirv::SetVector& sets)
@@ -337,6 +454,26 @@ void DirectionLightCaster::bindTextureSet(const Context* context, const spirv::S
 	write.pImageInfo = infos.data();
 
 	vkUpdateDescriptorSets(context->get_device(), 1, &write, 0, nullptr);
+
+	if (!moments)
+	{
+		return;
+	}
+
+	unif = set.getUniform(momentUniformName);
+
+	infos.clear();
+	for (auto& shadow : shadows)
+	{
+		infos.push_back(shadow.momentMap.valid() ? shadow.momentMap.get_texture().get_imageInfo()
+												 : moments->get_placeholderArrayInfo());
+	}
+
+	write.descriptorType = unif->type;
+	write.descriptorCount = unif->arrayLength;
+	write.dstBinding = unif->binding;
+
+	vkUpdateDescriptorSets(context->get_device(), 1, &write, 0, nullptr);
 }
 
 spirv::RenderPass DirectionLightCaster::createRenderPass(const Context* context)
@@ -455,6 +592,7 @@ DirectionShadow::DirectionShadow(const Context* context, const spirv::RenderPass
 	id2d.size = mapResolution * mapResolution;
 	id2d.layerCount = numCascades;
 	id2d.anisotropy = VK_FALSE;
+	id2d.depthCompare = VK_TRUE;
 	id2d.samplerAddressMode = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
 	id2d.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
 	id2d.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
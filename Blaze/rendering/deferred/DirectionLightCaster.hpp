@@ -3,10 +3,14 @@
 
 #include <core/Context.hpp>
 #include <core/Drawable.hpp>
+#include <rendering/CasterTracker.hpp>
+#include <rendering/ClusterCuller.hpp>
+#include <rendering/deferred/ShadowMoments.hpp>
 #include <core/Texture2D.hpp>
 #include <core/UniformBuffer.hpp>
 #include <core/StorageBuffer.hpp>
 #include <spirv/PipelineFactory.hpp>
+#include <util/SlotMap.hpp>
 #include <core/Camera.hpp>
 
 namespace blaze::dfr
@@ -26,10 +30,16 @@ namespace blaze::dfr
 struct DirectionShadow
 {
 	Texture2D shadowMap;
+	/// The moments of the cascades, only while moments are enabled.
+	ShadowMoments::MomentMap momentMap;
 	std::vector<spirv::Framebuffer> framebuffer;
 	VkViewport viewport;
 	VkRect2D scissor;
-	uint16_t next;
+	/// Next free shadow, -1 at the end of the free list.
+	int next;
+	/// The cascades that were last drawn, the first cachedCascades maps hold valid shadows.
+	glm::mat4 cachedViewProj[MAX_CSM_SPLITS];
+	int cachedCascades{0};
 
 	struct PCB
 	{
@@ -46,11 +56,23 @@ struct DirectionShadow
  * @endcond
  */
 
+/**
+ * @brief Owns the directional lights and their cascaded shadows.
+ *
+ * Packed and uploaded like the lights of PointLightCaster, ended by a negative brightness.
+ * A cascade is only drawn again when its matrix changed, which follows the camera, or a changed
+ * caster touches it.
+ *
+ * The cascades are split over the visible depths if they are set with setViewDepthRange, else over the
+ * camera's near to far range. The depth range of each cascade is fitted to the casters in its light space
+ * box, and each cascade only draws the casters in that box. The cascades after the first skip the casters
+ * that would cover less than minCasterTexels of their map.
+ *
+ * While moments are enabled, each shadow also has a moment map, whose drawn cascades are built after each cast.
+ */
 class DirectionLightCaster
 {
-private:
-	constexpr static uint32_t DIRECTION_MAP_RESOLUTION = 1024;
-
+public:
 	struct LightData
 	{
 		alignas(16) glm::vec3 direction;
@@ -61,15 +83,19 @@ private:
 		alignas(4) int shadowIdx;
 	};
 
+	using Handle = util::SlotMap<LightData>::Handle;
+
+private:
+	constexpr static uint32_t DIRECTION_MAP_RESOLUTION = 1024;
+
 	uint32_t maxLights;
 	uint32_t maxShadows;
 
-	uint32_t count;
-	int16_t freeLight;
-	std::vector<LightData> lights;
+	util::SlotMap<LightData> lights;
 
 	constexpr static std::string_view dataUniformName = "dirLights";
 	constexpr static std::string_view textureUniformName = "dirShadows";
+	constexpr static std::string_view momentUniformName = "dirShadowMoments";
 	
 	constexpr static std::string_view vertShaderFileName = "shaders/forward/vDirectionShadow.vert.spv";
 	constexpr static std::string_view fragShaderFileName = "shaders/forward/fDirectionShadow.frag.spv";
@@ -84,27 +110,63 @@ private:
 	int freeShadow;
 	std::vector<DirectionShadow> shadows;
 
+	const ClusterCuller* culler{nullptr};
+	const ShadowMoments* moments{nullptr};
+	bool momentsEnabled{false};
+
+	/// Nearest and farthest visible view depths, empty if unknown.
+	glm::vec2 viewDepthRange{0.0f};
+
 public:
+	/// Diameter in texels under which casters are left out of all but the first cascade.
+	float minCasterTexels{2.0f};
+
 	DirectionLightCaster(const Context* context, uint32_t numLights, const spirv::SetVector& sets,
-						const spirv::SetSingleton& texSet) noexcept;
+						const spirv::SetSingleton& texSet, const ClusterCuller* culler = nullptr,
+						const ShadowMoments* moments = nullptr) noexcept;
 	void recreate(const Context* context, const spirv::SetVector& sets);
-	void update(const Camera* camera, uint32_t frame);
+	/**
+	 * @brief Sets the view depths the cascades are split over, instead of the near and far planes of the camera.
+	 *
+	 * @param range The nearest and farthest visible view depths, or an empty range to use the camera's.
+	 */
+	void setViewDepthRange(const glm::vec2& range)
+	{
+		viewDepthRange = range;
+	}
 
-	uint16_t createLight(const glm::vec3& direction, float brightness, uint32_t numCascades);
-	void removeLight(uint16_t idx);
-	bool setShadow(uint16_t idx, bool enableShadow);
+	/**
+	 * @brief Fits the cascades to the view of \a camera and the casters, and uploads the lights.
+	 *
+	 * @param camera The camera the cascades cover.
+	 * @param frame The frame in flight.
+	 * @param casters The casters of this frame, updated before.
+	 */
+	void update(const Camera* camera, uint32_t frame, const CasterTracker& casters);
+
+	/**
+	 * @brief Creates a light.
+	 *
+	 * @returns The handle of the light, or INVALID_HANDLE if the table is full.
+	 */
+	Handle createLight(const glm::vec3& direction, float brightness, uint32_t numCascades);
+	void removeLight(Handle handle);
+	bool setShadow(Handle handle, bool enableShadow);
 
 	int createShadow();
 	void removeShadow(int idx);
 
-	LightData* getLight(uint16_t idx)
+	/**
+	 * @brief Returns the light of \a handle, or nullptr if it was removed.
+	 */
+	LightData* getLight(Handle handle)
 	{
-		return &lights[idx];
+		return lights.get(handle);
 	}
 
 	inline uint32_t get_count() const
 	{
-		return count;
+		return lights.get_size();
 	}
 
 	inline uint32_t getMaxLights() const
@@ -117,7 +179,26 @@ public:
 		return maxShadows;
 	}
 
-	void cast(VkCommandBuffer cmd, const std::vector<Drawable*>& drawables);
+	/**
+	 * @brief Draws the cascades whose cached maps are out of date.
+	 *
+	 * @param cmd The command buffer to record to.
+	 * @param drawables The shadow casters.
+	 * @param casters The changes of the casters since the previous frame.
+	 *
+	 * The cascades follow the camera and the new matrices are already uploaded, so they are always drawn
+	 * and not deferred like the point light faces.
+	 *
+	 * @returns The number of cascades drawn.
+	 */
+	uint32_t cast(VkCommandBuffer cmd, const std::vector<Drawable*>& drawables, const CasterTracker& casters);
+
+	/**
+	 * @brief Creates or frees the moment maps of the shadows, and builds the moments of the cached cascades.
+	 *
+	 * The GPU must be idle, as the texture set is rebound.
+	 */
+	void setMomentsEnabled(const Context* context, bool enable, const spirv::SetSingleton& texSet);
 
 private:
 	void bindDataSet(const Context* context, const spirv::SetVector& sets);
@@ -128,6 +209,7 @@ private:
 
 	float centerDist(float n, float f, float cosine) const;
 	glm::vec4 createCascadeSplits(int numSplits, float nearPlane, float farPlane, float lambda = 0.5f) const;
-	void updateLight(const Camera* camera, LightData* light);
+	void updateLight(const Camera* camera, const CasterTracker& casters, LightData* light);
+	glm::vec2 fitDepthRange(const glm::mat4& lightView, float radius, const CasterTracker& casters) const;
 };
 }
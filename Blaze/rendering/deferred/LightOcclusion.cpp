@@ -0,0 +1,170 @@
+#include "LightOcclusion.hpp"
+
+#include <util/files.hpp>
+
+#include <algorithm>
+
+#include <thirdparty/optick/optick.h>
+
+namespace blaze::dfr
+{
+LightOcclusion::LightOcclusion(const Context* context, const spirv::RenderPass& renderPass, uint32_t frames,
+							   uint32_t maxQueries)
+	: context(context), maxQueries(maxQueries)
+{
+	shader = createShader();
+	pipeline = createPipeline(renderPass);
+
+	queryPools.reserve(frames);
+	for (uint32_t i = 0; i < frames; i++)
+	{
+		queryPools.emplace_back(util::createQueryPool(context->get_device(), VK_QUERY_TYPE_OCCLUSION, maxQueries),
+								context->get_device());
+	}
+	queryCounts.resize(frames, 0);
+	samples.reserve(maxQueries);
+}
+
+void LightOcclusion::reset(VkCommandBuffer cmd, uint32_t frame) const
+{
+	vkCmdResetQueryPool(cmd, queryPools[frame].get(), 0, maxQueries);
+}
+
+void LightOcclusion::draw(VkCommandBuffer cmd, uint32_t frame, const spirv::SetVector& cameraSets,
+						  const std::vector<glm::mat4>& volumes, uint32_t coneCount,
+						  const IndexedVertexBuffer<Vertex>& sphere, const IndexedVertexBuffer<Vertex>& cone)
+{
+	OPTICK_EVENT();
+	assert(valid());
+	assert(coneCount <= volumes.size());
+
+	const uint32_t count = std::min(static_cast<uint32_t>(volumes.size()), maxQueries);
+	queryCounts[frame] = count;
+	if (count == 0)
+	{
+		return;
+	}
+
+	VkQueryPool pool = queryPools[frame].get();
+	const uint32_t sphereCount = static_cast<uint32_t>(volumes.size()) - coneCount;
+
+	pipeline.bind(cmd);
+	vkCmdBindDescriptorSets(cmd, pipeline.bindPoint, shader.pipelineLayout.get(), cameraSets.setIdx, 1,
+							&cameraSets[frame], 0, nullptr);
+	sphere.bind(cmd);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (i == sphereCount)
+		{
+			cone.bind(cmd);
+		}
+		const uint32_t indexCount = i < sphereCount ? sphere.get_indexCount() : cone.get_indexCount();
+
+		vkCmdPushConstants(cmd, shader.pipelineLayout.get(), shader.pushConstant.stage, 0, sizeof(glm::mat4),
+						   &volumes[i]);
+		vkCmdBeginQuery(cmd, pool, i, 0);
+		vkCmdDrawIndexed(cmd, indexCount, 1, 0, 0, 0);
+		vkCmdEndQuery(cmd, pool, i);
+	}
+}
+
+const std::vector<uint64_t>& LightOcclusion::read(uint32_t frame)
+{
+	samples.clear();
+	const uint32_t count = queryCounts[frame];
+	queryCounts[frame] = 0;
+	if (count == 0)
+	{
+		return samples;
+	}
+
+	// The frame's fence was waited on, so the results are available without waiting.
+	samples.resize(count);
+	auto result = vkGetQueryPoolResults(context->get_device(), queryPools[frame].get(), 0, count,
+										count * sizeof(uint64_t), samples.data(), sizeof(uint64_t),
+										VK_QUERY_RESULT_64_BIT);
+	if (result != VK_SUCCESS)
+	{
+		samples.clear();
+	}
+	return samples;
+}
+
+spirv::Shader LightOcclusion::createShader()
+{
+	std::vector<spirv::ShaderStageData> stages;
+
+	spirv::ShaderStageData* stage;
+	stage = &stages.emplace_back();
+	stage->spirv = util::loadBinaryFile(vertShaderFileName);
+	stage->stage = VK_SHADER_STAGE_VERTEX_BIT;
+
+	stage = &stages.emplace_back();
+	stage->spirv = util::loadBinaryFile(fragShaderFileName);
+	stage->stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	return context->get_pipelineFactory()->createShader(stages);
+}
+
+spirv::Pipeline LightOcclusion::createPipeline(const spirv::RenderPass& renderPass)
+{
+	assert(shader.valid());
+	assert(renderPass.valid());
+
+	spirv::GraphicsPipelineCreateInfo info = {};
+
+	info.inputAssemblyCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	info.inputAssemblyCreateInfo.flags = 0;
+	info.inputAssemblyCreateInfo.pNext = nullptr;
+	info.inputAssemblyCreateInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	info.inputAssemblyCreateInfo.primitiveRestartEnable = VK_FALSE;
+
+	// The front faces, as the lighting draws the back faces to also cover the view from inside.
+	info.rasterizerCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	info.rasterizerCreateInfo.rasterizerDiscardEnable = VK_FALSE;
+	info.rasterizerCreateInfo.polygonMode = VK_POLYGON_MODE_FILL;
+	info.rasterizerCreateInfo.lineWidth = 1.0f;
+	info.rasterizerCreateInfo.cullMode = VK_CULL_MODE_BACK_BIT;
+	info.rasterizerCreateInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+	info.rasterizerCreateInfo.depthBiasEnable = VK_FALSE;
+	info.rasterizerCreateInfo.depthClampEnable = VK_FALSE;
+	info.rasterizerCreateInfo.pNext = nullptr;
+	info.rasterizerCreateInfo.flags = 0;
+
+	info.multisampleCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	info.multisampleCreateInfo.sampleShadingEnable = VK_FALSE;
+	info.multisampleCreateInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+	// Only the samples are counted.
+	VkPipelineColorBlendAttachmentState colorblendAttachment = {};
+	colorblendAttachment.colorWriteMask = 0;
+	colorblendAttachment.blendEnable = VK_FALSE;
+
+	info.colorblendCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	info.colorblendCreateInfo.logicOpEnable = VK_FALSE;
+	info.colorblendCreateInfo.attachmentCount = 1;
+	info.colorblendCreateInfo.pAttachments = &colorblendAttachment;
+
+	info.depthStencilCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	info.depthStencilCreateInfo.depthTestEnable = VK_TRUE;
+	info.depthStencilCreateInfo.depthWriteEnable = VK_FALSE;
+	info.depthStencilCreateInfo.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+	info.depthStencilCreateInfo.depthBoundsTestEnable = VK_FALSE;
+	info.depthStencilCreateInfo.maxDepthBounds = 0.0f; // Don't care
+	info.depthStencilCreateInfo.minDepthBounds = 1.0f; // Don't care
+	info.depthStencilCreateInfo.stencilTestEnable = VK_FALSE;
+	info.depthStencilCreateInfo.front = {}; // Don't Care
+	info.depthStencilCreateInfo.back = {};	// Don't Care
+
+	std::vector<VkDynamicState> dynamicStates = {
+		VK_DYNAMIC_STATE_VIEWPORT,
+		VK_DYNAMIC_STATE_SCISSOR,
+	};
+
+	info.dynamicStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	info.dynamicStateCreateInfo.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+	info.dynamicStateCreateInfo.pDynamicStates = dynamicStates.data();
+
+	return context->get_pipelineFactory()->createGraphicsPipeline(shader, renderPass, info);
+}
+} // namespace blaze::dfr
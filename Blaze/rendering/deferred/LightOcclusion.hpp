@@ -0,0 +1,103 @@
+#pragma once
+
+#include <core/Context.hpp>
+#include <core/VertexBuffer.hpp>
+#include <spirv/PipelineFactory.hpp>
+
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+namespace blaze::dfr
+{
+/**
+ * @brief Occlusion queries of light volumes against the depth of the G-buffer.
+ *
+ * Each volume is drawn with the depth test and without writes, and counts the samples of its front
+ * faces that are in front of the scene. A light whose front faces are all hidden lights no visible
+ * surface, as those are in front of its whole volume.
+ *
+ * Each frame in flight has its own query pool, which is read back by the next update of the same
+ * frame, after its fence was waited on. Reading never stalls, and the results lag the view by the
+ * frames in flight.
+ *
+ * Usage per frame:
+ * \arg read() before recording, for the samples of the last time the frame was rendered.
+ * \arg reset() outside of a render pass, before the draw.
+ * \arg draw() inside a pass with the depth buffer of the G-buffer.
+ */
+class LightOcclusion
+{
+private:
+	constexpr static std::string_view vertShaderFileName = "shaders/deferred/vLightOcclusion.vert.spv";
+	constexpr static std::string_view fragShaderFileName = "shaders/deferred/fLightOcclusion.frag.spv";
+
+	const Context* context{nullptr};
+
+	spirv::Shader shader;
+	spirv::Pipeline pipeline;
+
+	uint32_t maxQueries{0};
+	std::vector<vkw::QueryPool> queryPools;
+	/// The number of queries drawn in each frame, 0 if none since the last read.
+	std::vector<uint32_t> queryCounts;
+	std::vector<uint64_t> samples;
+
+public:
+	/**
+	 * @brief Default constructor.
+	 */
+	LightOcclusion() noexcept
+	{
+	}
+
+	/**
+	 * @brief Main constructor.
+	 *
+	 * @param context The Vulkan Context in use.
+	 * @param renderPass The pass the queries are drawn in, with the depth of the G-buffer.
+	 * @param frames The number of frames in flight.
+	 * @param maxQueries The most volumes queried in a frame.
+	 */
+	LightOcclusion(const Context* context, const spirv::RenderPass& renderPass, uint32_t frames,
+				   uint32_t maxQueries);
+
+	/**
+	 * @brief Resets the queries of \a frame, outside of a render pass.
+	 */
+	void reset(VkCommandBuffer cmd, uint32_t frame) const;
+
+	/**
+	 * @brief Records a query per volume, in the order of \a volumes.
+	 *
+	 * @param cmd The command buffer to record to, inside the render pass.
+	 * @param frame The frame in flight.
+	 * @param cameraSets The camera sets of the frames.
+	 * @param volumes The transforms of the unit volumes, the spheres followed by the cones.
+	 * @param coneCount The number of cones at the end of \a volumes.
+	 * @param sphere The unit sphere of the point lights.
+	 * @param cone The unit cone of the spot lights.
+	 */
+	void draw(VkCommandBuffer cmd, uint32_t frame, const spirv::SetVector& cameraSets,
+			  const std::vector<glm::mat4>& volumes, uint32_t coneCount, const IndexedVertexBuffer<Vertex>& sphere,
+			  const IndexedVertexBuffer<Vertex>& cone);
+
+	/**
+	 * @brief Reads the samples of each volume of the last draw for \a frame.
+	 *
+	 * The frame must not be in flight.
+	 *
+	 * @returns The samples in the order of the volumes, empty if the frame drew none since the last read.
+	 */
+	const std::vector<uint64_t>& read(uint32_t frame);
+
+	inline bool valid() const
+	{
+		return pipeline.pipeline.valid();
+	}
+
+private:
+	spirv::Shader createShader();
+	spirv::Pipeline createPipeline(const spirv::RenderPass& renderPass);
+};
+} // namespace blaze::dfr
@@ -3,6 +3,8 @@
 
 #include <util/files.hpp>
 
+#include <algorithm>
+
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
@@ -16,41 +18,45 @@
 namespace blaze::dfr
 {
 PointLightCaster::PointLightCaster(const Context* context, uint32_t maxLights, const spirv::SetVector& sets,
-								   const spirv::SetSingleton& texSet) noexcept
-	: maxLights(maxLights)
+								   const spirv::SetSingleton& texSet, const ClusterCuller* culler,
+								   const ShadowMoments* moments) noexcept
+	: maxLights(maxLights), tileAllocator(ATLAS_RESOLUTION, MIN_TILE_RESOLUTION), culler(culler), moments(moments)
 {
 	renderPass = createRenderPass(context);
 	shadowShader = createShader(context);
 	shadowPipeline = createPipeline(context);
 
-	auto uniform = sets.getUniform(dataUniformName);
-	lights = std::vector<LightData>(maxLights);
 	ubos = SSBODataVector(context, maxLights * sizeof(LightData), sets.size());
-	count = 0;
-
-	int i = -1;
-	for (auto& light : lights)
+	occlusionQueries.resize(sets.size());
+	lights.reserve(maxLights);
+	uploadedLights.reserve(maxLights);
+	for (uint32_t i = 0; i < sets.size(); ++i)
 	{
-		light.position = glm::vec3(0);
-		light.radius = static_cast<float>(i);
-		light.color = glm::vec3(1.0f);
-		light.shadowIdx = -1;
-		i--;
+		uploadLights(i);
 	}
-	i = std::numeric_limits<int>::min();
-	lights.back().radius = static_cast<float>(i);
-	freeLight = 0;
 
-	uniform = texSet.getUniform(textureUniformName);
-	maxShadows = uniform->arrayLength;
-
-	for (uint32_t i = 0; i < maxShadows; ++i)
-	{
-		auto& shadow = shadows.emplace_back(context, renderPass, OMNI_MAP_RESOLUTION);
-		shadow.next = i + 1;
-	}
-	shadows.back().next = -1;
-	freeShadow = 0;
+	// As many lights as fit in the atlas with the smallest tiles.
+	constexpr uint32_t tilesPerSide = ATLAS_RESOLUTION / MIN_TILE_RESOLUTION;
+	maxShadows = tilesPerSide * tilesPerSide / 6;
+
+	ImageData2D id2d{};
+	id2d.height = ATLAS_RESOLUTION;
+	id2d.width = ATLAS_RESOLUTION;
+	id2d.numChannels = 1;
+	id2d.size = ATLAS_RESOLUTION * ATLAS_RESOLUTION;
+	id2d.anisotropy = VK_FALSE;
+	id2d.depthCompare = VK_TRUE;
+	id2d.samplerAddressMode = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	id2d.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	id2d.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+	id2d.format = VK_FORMAT_D32_SFLOAT;
+	id2d.aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+	id2d.access = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	shadowAtlas = Texture2D(context, id2d, false);
+
+	std::vector<VkImageView> attachments = {shadowAtlas.get_imageView()};
+	atlasFramebuffer = context->get_pipelineFactory()->createFramebuffer(
+		renderPass, {shadowAtlas.get_width(), shadowAtlas.get_height()}, attachments);
 
 	bindDataSet(context, sets);
 	bindTextureSet(context, texSet);
@@ -73,6 +79,8 @@ PointLightCaster::PointLightCaster(const Context* context, uint32_t maxLights, c
 		},
 	};
 
+	std::copy(std::begin(block.view), std::end(block.view), std::begin(faceViews));
+
 	viewSet = context->get_pipelineFactory()->createSet(*shadowShader.getSetWithUniform("views"));
 	viewUBO = UBO(context, block);
 	{
@@ -95,157 +103,846 @@ PointLightCaster::PointLightCaster(const Context* context, uint32_t maxLights, c
 void PointLightCaster::recreate(const Context* context, const spirv::SetVector& sets)
 {
 	ubos = SSBODataVector(context, maxLights * sizeof(LightData), sets.size());
+	occlusionQueries.assign(sets.size(), {});
 
 	for (uint32_t i = 0; i < sets.size(); ++i)
 	{
-		update(i);
+		uploadLights(i);
 	}
 
 	bindDataSet(context, sets);
 }
 
-void PointLightCaster::update(uint32_t frame)
+void PointLightCaster::update(const Camera* camera, uint32_t frame)
 {
-	ubos[frame].writeData(lights.data(), maxLights * sizeof(LightData));
+	updateCount++;
+	viewFrustum = ClusterCuller::createFrustum(camera->get_projection() * camera->get_view(), camera->get_position(),
+											   false);
+	checkCameraCut(camera);
+	assignShadowTiles(camera);
+	prepareOcclusionQueries(frame);
+	uploadLights(frame);
 }
 
-uint16_t PointLightCaster::createLight(const glm::vec3& position, const glm::vec3& color, float radius, bool enableShadow)
+void PointLightCaster::readOcclusion(uint32_t frame, const std::vector<uint64_t>& samples)
 {
-	if (freeLight < 0)
+	auto& queries = occlusionQueries[frame];
+	for (size_t i = 0; i < queries.size(); ++i)
 	{
-		return UINT16_MAX;
+		const OcclusionQuery& query = queries[i];
+		Light* light = lights.get(query.handle);
+		if (light == nullptr)
+		{
+			continue;
+		}
+
+		// A query from before a camera cut, or of a light that changed since, doesn't hold anymore, and
+		// the light is visible until a query of its current volume says otherwise. Whether the light is
+		// still in view is checked by the update.
+		const bool current = query.update >= cameraCutUpdate && query.position == light->data.position &&
+							 query.direction == light->data.direction && query.radius == light->data.radius;
+		light->occluded = current && i < samples.size() && samples[i] == 0;
 	}
+	queries.clear();
+}
+
+void PointLightCaster::setOcclusionEnabled(bool enable)
+{
+	occlusionEnabled = enable;
+	if (!enable)
+	{
+		for (auto& light : lights)
+		{
+			light.occluded = false;
+		}
+		for (auto& queries : occlusionQueries)
+		{
+			queries.clear();
+		}
+	}
+}
+
+void PointLightCaster::checkCameraCut(const Camera* camera)
+{
+	const glm::vec3& position = camera->get_position();
+	const glm::vec3& direction = camera->get_direction();
+	if (glm::distance(position, lastCameraPosition) > CAMERA_CUT_DISTANCE ||
+		glm::dot(direction, lastCameraDirection) < CAMERA_CUT_COS)
+	{
+		// The queries in flight saw another view, so everything is visible until queried again.
+		cameraCutUpdate = updateCount;
+		for (auto& light : lights)
+		{
+			light.occluded = false;
+		}
+	}
+	lastCameraPosition = position;
+	lastCameraDirection = direction;
+
+	// No samples only mean occlusion while the volume is in view. A light that left the view since the query
+	// is visible, so that it doesn't pop in when the view turns back to it.
+	for (auto& light : lights)
+	{
+		if (light.occluded && !isInView(light.data))
+		{
+			light.occluded = false;
+		}
+	}
+}
 
-	LightData* pLight = &lights[freeLight];
-	uint16_t idx = static_cast<uint16_t>(freeLight);
+bool PointLightCaster::isInView(const LightData& light) const
+{
+	return ClusterCuller::contains(viewFrustum, glm::vec4(light.position, light.radius * OCCLUSION_MARGIN));
+}
 
-	freeLight = -static_cast<int>(pLight->radius);
+void PointLightCaster::prepareOcclusionQueries(uint32_t frame)
+{
+	auto& queries = occlusionQueries[frame];
+	queries.clear();
+	occlusionVolumes.clear();
+	occlusionConeCount = 0;
+	if (!occlusionEnabled)
+	{
+		return;
+	}
+
+	// Only the volumes entirely in view are queried. A volume that crosses the near plane may be clipped, and
+	// one outside the view passes no samples without being hidden, so neither is ever occluded.
+	auto query = [&](Light& light) {
+		const LightData& data = light.data;
+		if (!data.castShadow || !isInView(data))
+		{
+			light.occluded = false;
+			return false;
+		}
+		queries.push_back({light.handle, data.position, data.direction, data.radius, updateCount});
+		occlusionVolumes.push_back(getOcclusionVolume(data));
+		return true;
+	};
 
-	pLight->position = position;
-	pLight->color = color;
-	pLight->radius = radius;
-	pLight->shadowIdx = -1;
-	if (enableShadow)
+	// The spheres first, then the cones, as the volumes are drawn.
+	for (auto& light : lights)
 	{
-		pLight->shadowIdx = createShadow();
-		shadows[pLight->shadowIdx].next = idx;
+		if (!isSpot(light.data))
+		{
+			query(light);
+		}
 	}
+	for (auto& light : lights)
+	{
+		if (isSpot(light.data) && query(light))
+		{
+			occlusionConeCount++;
+		}
+	}
+}
 
-	count++;
+glm::mat4 PointLightCaster::getOcclusionVolume(const LightData& light) const
+{
+	const float radius = light.radius * OCCLUSION_MARGIN;
+	if (!isSpot(light))
+	{
+		return glm::scale(glm::translate(glm::mat4(1.0f), light.position), glm::vec3(radius));
+	}
 
-	return idx;
+	// The cone stretched down the spot light, in the basis of the lighting volume.
+	const glm::vec3 forward = light.direction;
+	glm::vec3 up = glm::abs(forward.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+	const glm::vec3 side = glm::normalize(glm::cross(up, forward));
+	up = glm::cross(forward, side);
+	const float tanOuter = glm::sqrt(1.0f - light.cosOuter * light.cosOuter) / light.cosOuter;
+
+	glm::mat4 volume(1.0f);
+	volume[0] = glm::vec4(side * radius * tanOuter, 0.0f);
+	volume[1] = glm::vec4(up * radius * tanOuter, 0.0f);
+	volume[2] = glm::vec4(forward * radius, 0.0f);
+	volume[3] = glm::vec4(light.position, 1.0f);
+	return volume;
 }
 
-void PointLightCaster::removeLight(uint16_t idx)
+void PointLightCaster::uploadLights(uint32_t frame)
 {
-	assert(idx < maxLights);
+	uploadedLights.clear();
+	uploadedSpotCount = 0;
+	occludedCount = 0;
+	auto upload = [this](const Light& light) {
+		if (light.occluded)
+		{
+			occludedCount++;
+			return false;
+		}
+
+		LightData data = light.data;
+		const Shadow& shadow = light.shadow;
+		if (shadow.resolution != 0 && shadow.drawnFaces == shadow.faces)
+		{
+			data.shadowResolution = shadow.resolution;
+			for (uint32_t face = 0; face < 6; ++face)
+			{
+				if (shadow.faces & (1u << face))
+				{
+					data.shadowTiles[face] = shadow.tiles[face].x | (shadow.tiles[face].y << 16);
+				}
+			}
+		}
+		uploadedLights.push_back(data);
+		return true;
+	};
+
+	// The point lights first, so that the spot lights are one range of instances of the cone volume.
+	for (const auto& light : lights)
+	{
+		if (!isSpot(light.data))
+		{
+			upload(light);
+		}
+	}
+	for (const auto& light : lights)
+	{
+		if (isSpot(light.data) && upload(light))
+		{
+			uploadedSpotCount++;
+		}
+	}
 
-	LightData* pLight = &lights[idx];
+	const uint32_t count = static_cast<uint32_t>(uploadedLights.size());
+	if (count > 0)
+	{
+		ubos[frame].writeData(uploadedLights.data(), 0, count * sizeof(LightData));
+	}
+	if (count < maxLights)
+	{
+		// Ends the loops over the lights in the shaders.
+		const LightData terminator = {glm::vec3(0.0f), -1.0f, glm::vec3(0.0f), 0};
+		ubos[frame].writeData(&terminator, count * sizeof(LightData), sizeof(LightData));
+	}
+}
+
+PointLightCaster::Handle PointLightCaster::createLight(const glm::vec3& position, const glm::vec3& color, float radius,
+													   bool enableShadow)
+{
+	if (lights.get_size() >= maxLights)
+	{
+		return INVALID_HANDLE;
+	}
 
-	assert(pLight->radius > 0);
+	assert(radius > 0.0f);
+	Light light = {};
+	light.data = {position, radius, color, 0};
+	light.data.cosOuter = -1.0f;
+	light.data.cosInner = -1.0f;
+	Handle handle = lights.add(std::move(light));
+	lights.get(handle)->handle = handle;
+	setShadow(handle, enableShadow);
+	return handle;
+}
 
-	pLight->radius = -static_cast<float>(freeLight);
-	pLight->position = glm::vec3(0.0f);
+std::vector<PointLightCaster::Handle> PointLightCaster::createLights(
+	const std::vector<ALightCaster::PointLightInfo>& infos)
+{
+	const uint32_t count = std::min(static_cast<uint32_t>(infos.size()), maxLights - lights.get_size());
+	lights.reserve(lights.get_size() + count);
 
-	if (pLight->shadowIdx >= 0)
+	std::vector<Handle> handles;
+	handles.reserve(count);
+	for (uint32_t i = 0; i < count; ++i)
 	{
-		assert(shadows[pLight->shadowIdx].next == idx);
-		removeShadow(pLight->shadowIdx);
+		const auto& info = infos[i];
+		assert(info.radius > 0.0f);
+
+		Light light = {};
+		light.data = {info.position, info.radius, info.color, 0};
+		light.data.cosOuter = -1.0f;
+		light.data.cosInner = -1.0f;
+		if (info.enableShadow && shadowCount < maxShadows)
+		{
+			light.data.castShadow = 1;
+			shadowCount++;
+		}
+		Handle handle = lights.add(std::move(light));
+		lights.get(handle)->handle = handle;
+		handles.push_back(handle);
 	}
+	return handles;
+}
 
-	pLight->shadowIdx = -1;
+PointLightCaster::Handle PointLightCaster::createSpotLight(const glm::vec3& position, const glm::vec3& direction,
+														   const glm::vec3& color, float radius, float innerAngle,
+														   float outerAngle, bool enableShadow)
+{
+	if (lights.get_size() >= maxLights)
+	{
+		return INVALID_HANDLE;
+	}
 
-	count--;
-	freeLight = idx;
+	assert(radius > 0.0f);
+	assert(innerAngle <= outerAngle);
+	const float outer = std::clamp(outerAngle, 0.01f, MAX_SPOT_ANGLE);
+
+	Light light = {};
+	light.data = {position, radius, color, 0};
+	light.data.direction = glm::normalize(direction);
+	light.data.cosOuter = glm::cos(outer);
+	light.data.cosInner = glm::cos(std::clamp(innerAngle, 0.0f, outer));
+	light.shadow.faces = SPOT_FACES;
+	Handle handle = lights.add(std::move(light));
+	lights.get(handle)->handle = handle;
+	setShadow(handle, enableShadow);
+	return handle;
 }
 
-bool PointLightCaster::setShadow(uint16_t idx, bool enableShadow)
+void PointLightCaster::removeLight(Handle handle)
 {
-	assert(idx < maxLights);
+	Light* pLight = lights.get(handle);
+	if (pLight == nullptr)
+	{
+		return;
+	}
 
-	LightData* pLight = &lights[idx];
+	if (pLight->data.castShadow)
+	{
+		shadowCount--;
+	}
+	releaseTiles(pLight->shadow);
+	lights.remove(handle);
+}
 
-	assert(pLight->radius >= 0);
+bool PointLightCaster::setShadow(Handle handle, bool enableShadow)
+{
+	Light* pLight = lights.get(handle);
+	assert(pLight != nullptr);
 
-	if ((pLight->shadowIdx < 0) != enableShadow)
+	bool hasShadow = pLight->data.castShadow != 0;
+	if (hasShadow == enableShadow)
 	{
-		return pLight->shadowIdx >= 0;
+		return hasShadow;
 	}
 	else if (enableShadow)
 	{
-		pLight->shadowIdx = createShadow();
-		if (pLight->shadowIdx >= 0)
+		if (shadowCount >= maxShadows)
 		{
-			shadows[pLight->shadowIdx].next = idx;
-			return true;
+			return false;
 		}
+		pLight->data.castShadow = 1;
+		shadowCount++;
+		return true;
 	}
 	else
 	{
-		removeShadow(pLight->shadowIdx);
-		pLight->shadowIdx = -1;
+		pLight->data.castShadow = 0;
+		releaseTiles(pLight->shadow);
+		shadowCount--;
 	}
 	return false;
 }
 
-int PointLightCaster::createShadow()
+void PointLightCaster::setDualParaboloid(Handle handle, bool enable)
+{
+	Light* pLight = lights.get(handle);
+	assert(pLight != nullptr && !isSpot(pLight->data));
+
+	if ((pLight->data.dualParaboloid != 0) == enable)
+	{
+		return;
+	}
+
+	// The tiles of the other faces are released, and the next update allocates the new ones.
+	releaseTiles(pLight->shadow);
+	pLight->data.dualParaboloid = enable ? 1 : 0;
+	pLight->shadow.faces = enable ? PARABOLOID_FACES : ALL_FACES;
+	pLight->shadow.nextFace = 0;
+}
+
+float PointLightCaster::getCoverage(const Camera* camera, const LightData& light) const
+{
+	const float distance = glm::distance(camera->get_position(), light.position);
+	const float screenHeight = camera->get_screenSize().y;
+	if (distance <= light.radius)
+	{
+		return screenHeight;
+	}
+
+	// Height of the light's sphere on screen in pixels.
+	const float coverage = screenHeight * light.radius / (distance * glm::tan(0.5f * camera->get_fov()));
+	return std::min(coverage, screenHeight);
+}
+
+uint32_t PointLightCaster::getShadowResolution(const Shadow& shadow) const
 {
-	if (freeShadow < 0)
+	// A face spans about half of the sphere. A paraboloid spans the whole sphere, with half the texels
+	// per angle of a face in its center.
+	const float span = shadow.faces == PARABOLOID_FACES ? 1.0f : 0.5f;
+	uint32_t resolution = MIN_TILE_RESOLUTION;
+	while (resolution < MAX_TILE_RESOLUTION && static_cast<float>(resolution) < span * shadow.coverage)
 	{
-		return -1;
+		resolution <<= 1;
+	}
+	return resolution;
+}
+
+bool PointLightCaster::allocateTiles(Shadow& shadow, uint32_t resolution)
+{
+	util::TileAllocator::Tile tiles[6];
+	for (uint32_t face = 0; face < 6; ++face)
+	{
+		if (!(shadow.faces & (1u << face)))
+		{
+			continue;
+		}
+		auto tile = tileAllocator.allocate(resolution);
+		if (!tile)
+		{
+			for (uint32_t i = 0; i < face; ++i)
+			{
+				if (shadow.faces & (1u << i))
+				{
+					tileAllocator.release(tiles[i]);
+				}
+			}
+			return false;
+		}
+		tiles[face] = *tile;
 	}
-	auto i = freeShadow;
-	freeShadow = shadows[i].next;
-	shadowCount++;
 
-	return i;
+	std::copy(std::begin(tiles), std::end(tiles), std::begin(shadow.tiles));
+	shadow.resolution = resolution;
+	shadow.drawnFaces = 0;
+	shadow.staleFaces = shadow.faces;
+	return true;
 }
 
-void PointLightCaster::removeShadow(int idx)
+void PointLightCaster::releaseTiles(Shadow& shadow)
 {
-	shadows[idx].next = freeShadow;
-	freeShadow = idx;
-	shadowCount--;
+	if (shadow.resolution == 0)
+	{
+		return;
+	}
+	for (uint32_t face = 0; face < 6; ++face)
+	{
+		if (shadow.faces & (1u << face))
+		{
+			tileAllocator.release(shadow.tiles[face]);
+		}
+	}
+	shadow.resolution = 0;
+	shadow.drawnFaces = 0;
+	shadow.staleFaces = 0;
 }
 
-void PointLightCaster::cast(VkCommandBuffer cmd, const std::vector<Drawable*>& drawables)
+void PointLightCaster::assignShadowTiles(const Camera* camera)
 {
 	OPTICK_EVENT();
-	for (auto it = getLightIterator(); it.valid(); ++it)
+
+	std::vector<Light*> shadowed;
+	shadowed.reserve(shadowCount);
+	for (auto& light : lights)
 	{
-		LightData* light = it.data;
+		if (light.data.castShadow)
+		{
+			light.shadow.coverage = getCoverage(camera, light.data);
+			shadowed.push_back(&light);
+		}
+	}
 
-		if (light->shadowIdx < 0)
+	// Tiles are only shrunk once they are four times too large, so that a light near a threshold isn't
+	// redrawn every few frames. Shrinking first frees the area for the lights that grow.
+	for (Light* light : shadowed)
+	{
+		Shadow& shadow = light->shadow;
+		const uint32_t resolution = getShadowResolution(shadow);
+		if (shadow.resolution != 0 && resolution * 4 <= shadow.resolution)
+		{
+			releaseTiles(shadow);
+			allocateTiles(shadow, resolution);
+		}
+	}
+
+	// The largest lights on screen pick their tiles first.
+	std::sort(shadowed.begin(), shadowed.end(),
+			  [](const Light* a, const Light* b) { return a->shadow.coverage > b->shadow.coverage; });
+
+	for (Light* light : shadowed)
+	{
+		Shadow& shadow = light->shadow;
+		const uint32_t resolution = getShadowResolution(shadow);
+
+		if (shadow.resolution != 0)
+		{
+			// The old tiles are kept until the larger ones are found.
+			if (resolution > shadow.resolution)
+			{
+				Shadow previous = shadow;
+				if (allocateTiles(shadow, resolution))
+				{
+					releaseTiles(previous);
+				}
+			}
 			continue;
-		PointShadow* shadow = &shadows[light->shadowIdx];
+		}
 
-		renderPass.begin(cmd, shadow->framebuffer);
+		while (shadow.resolution == 0)
+		{
+			uint32_t r = resolution;
+			while (r >= MIN_TILE_RESOLUTION && !allocateTiles(shadow, r))
+			{
+				r /= 2;
+			}
+			if (shadow.resolution != 0)
+			{
+				break;
+			}
+
+			// The atlas is full, halve the largest tiles of a smaller light.
+			// shadowCount <= maxShadows, so at the smallest size all lights fit.
+			Light* victim = nullptr;
+			for (Light* other : shadowed)
+			{
+				const Shadow& otherShadow = other->shadow;
+				if (otherShadow.resolution > MIN_TILE_RESOLUTION && otherShadow.coverage <= shadow.coverage &&
+					(victim == nullptr || otherShadow.resolution > victim->shadow.resolution))
+				{
+					victim = other;
+				}
+			}
+			if (victim == nullptr)
+			{
+				break;
+			}
+
+			// The released tiles fit the halved ones.
+			const uint32_t halved = victim->shadow.resolution / 2;
+			releaseTiles(victim->shadow);
+			allocateTiles(victim->shadow, halved);
+		}
+	}
+}
+
+uint32_t PointLightCaster::cast(VkCommandBuffer cmd, const std::vector<Drawable*>& drawables,
+								const CasterTracker& casters, uint32_t faceBudget)
+{
+	OPTICK_EVENT();
+	frameCount++;
+
+	std::vector<Light*> pending;
+	for (auto& light : lights)
+	{
+		Shadow& shadow = light.shadow;
+		if (shadow.resolution == 0)
+		{
+			continue;
+		}
+
+		if (shadow.drawnPosition != light.data.position || shadow.drawnRadius != light.data.radius ||
+			shadow.drawnDirection != light.data.direction ||
+			casters.intersects(glm::vec4(light.data.position, light.data.radius)))
+		{
+			shadow.staleFaces = shadow.faces;
+		}
+		// The faces of an occluded light stay stale until it is seen.
+		if (shadow.staleFaces != 0 && !light.occluded)
+		{
+			pending.push_back(&light);
+		}
+	}
+
+	// Lights whose shadow is not complete yet go first, as they are drawn without one. The rest by their
+	// coverage weighted with the frames since they were last drawn, so that small lights are not starved.
+	auto priority = [this](const Light* light) {
+		return light->shadow.coverage * static_cast<float>(frameCount - light->shadow.lastDrawnFrame);
+	};
+	std::sort(pending.begin(), pending.end(), [&priority](const Light* a, const Light* b) {
+		const bool aComplete = a->shadow.drawnFaces == a->shadow.faces;
+		const bool bComplete = b->shadow.drawnFaces == b->shadow.faces;
+		if (aComplete != bComplete)
+		{
+			return bComplete;
+		}
+		return priority(a) > priority(b);
+	});
+
+	uint32_t drawnCount = 0;
+	std::vector<ShadowMoments::Region> momentRegions;
+	for (Light* light : pending)
+	{
+		if (drawnCount >= faceBudget)
+		{
+			break;
+		}
+
+		// Continue from the face after the last one drawn, so that a light that only gets some of its
+		// faces each frame updates all of them in turn.
+		Shadow& shadow = light->shadow;
+		uint8_t faces = 0;
+		for (uint32_t i = 0; i < 6 && drawnCount < faceBudget; ++i)
+		{
+			const uint32_t face = (shadow.nextFace + i) % 6;
+			if (shadow.staleFaces & (1u << face))
+			{
+				faces |= 1u << face;
+				shadow.nextFace = static_cast<uint8_t>((face + 1) % 6);
+				drawnCount++;
+			}
+		}
+
+		drawFaces(cmd, drawables, *light, faces);
+		if (momentAtlas.valid())
+		{
+			addMomentRegions(momentRegions, shadow, faces);
+		}
+
+		// The faces not drawn stay stale, even if the light doesn't move again.
+		shadow.staleFaces &= ~faces;
+		shadow.drawnFaces |= faces;
+		shadow.drawnPosition = light->data.position;
+		shadow.drawnDirection = light->data.direction;
+		shadow.drawnRadius = light->data.radius;
+		shadow.lastDrawnFrame = frameCount;
+	}
+
+	if (!momentRegions.empty())
+	{
+		moments->build(cmd, momentAtlas, momentRegions);
+	}
+	return drawnCount;
+}
 
-		constexpr float nearPlane = 0.05f;
+void PointLightCaster::setMomentsEnabled(const Context* context, bool enable, const spirv::SetSingleton& texSet)
+{
+	assert(moments);
 
-		float denom = (nearPlane - light->radius);
-		float p22 = light->radius / denom;
-		float p32 = (nearPlane * light->radius) / denom;
+	if (enable == momentAtlas.valid())
+	{
+		return;
+	}
+
+	if (enable)
+	{
+		momentAtlas = moments->createMomentMap(shadowAtlas);
+
+		// The faces drawn before are cached, and would otherwise be without moments until they go stale.
+		std::vector<ShadowMoments::Region> regions;
+		for (const auto& light : lights)
+		{
+			addMomentRegions(regions, light.shadow, light.shadow.drawnFaces);
+		}
+		if (!regions.empty())
+		{
+			VkCommandBuffer cmd = context->startCommandBufferRecord();
+			moments->build(cmd, momentAtlas, regions);
+			context->flushCommandBuffer(cmd);
+		}
+	}
+	else
+	{
+		momentAtlas = ShadowMoments::MomentMap();
+	}
 
-		PointShadow::PCB pcb = {
-			light->position,
-			light->radius,
-			p22,
-			p32,
-		};
+	bindTextureSet(context, texSet);
+}
+
+void PointLightCaster::addMomentRegions(std::vector<ShadowMoments::Region>& regions, const Shadow& shadow,
+										uint8_t faces) const
+{
+	if (shadow.resolution == 0)
+	{
+		return;
+	}
+	for (uint32_t face = 0; face < 6; ++face)
+	{
+		if (faces & (1u << face))
+		{
+			VkRect2D rect = {{static_cast<int32_t>(shadow.tiles[face].x), static_cast<int32_t>(shadow.tiles[face].y)},
+							 {shadow.resolution, shadow.resolution}};
+			regions.push_back({0, rect});
+		}
+	}
+}
+
+ClusterCuller::Frustum PointLightCaster::createFaceFrustum(const LightData& light, uint32_t face) const
+{
+	const glm::mat4 translation = glm::translate(glm::mat4(1.0f), -light.position);
+	glm::mat4 viewProj;
+	if (isSpot(light))
+	{
+		const float fov = 2.0f * glm::acos(light.cosOuter);
+		viewProj = glm::perspective(fov, 1.0f, NEAR_PLANE, light.radius) * getSpotView(light) * translation;
+	}
+	else if (light.dualParaboloid)
+	{
+		// The box around the hemisphere, in the view of the +z or -z face.
+		const float r = light.radius;
+		viewProj = glm::ortho(-r, r, -r, r, 0.0f, r) * faceViews[4 + face] * translation;
+	}
+	else
+	{
+		viewProj = glm::perspective(glm::radians(90.0f), 1.0f, NEAR_PLANE, light.radius) * faceViews[face] *
+				   translation;
+	}
+	return ClusterCuller::createFrustum(viewProj, light.position, false);
+}
+
+glm::mat4 PointLightCaster::getSpotView(const LightData& light) const
+{
+	// The lighting shaders rebuild the view from the direction with the same up.
+	const glm::vec3 up =
+		glm::abs(light.direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+	return glm::lookAt(glm::vec3(0.0f), light.direction, up);
+}
+
+void PointLightCaster::drawFaces(VkCommandBuffer cmd, const std::vector<Drawable*>& drawables, const Light& light,
+								 uint8_t faces)
+{
+	const LightData& data = light.data;
+	const Shadow& shadow = light.shadow;
+
+	// The casters in the light's sphere, then in each face, or in the cone of a spot light. A caster near a wall
+	// of the cube is in up to three faces, so most faces of a light near a wall or floor have a fraction of the
+	// casters, or none.
+	const auto sphere = ClusterCuller::createSphere(data.position, data.radius);
+	std::vector<Drawable*> lightCasters;
+	for (Drawable* d : drawables)
+	{
+		if (ClusterCuller::intersects(sphere, d->get_bounds()))
+		{
+			lightCasters.push_back(d);
+		}
+	}
+
+	ClusterCuller::Frustum frusta[6];
+	std::vector<Drawable*> faceCasters[6];
+	for (uint32_t face = 0; face < 6; ++face)
+	{
+		if (!(faces & (1u << face)))
+		{
+			continue;
+		}
+		frusta[face] = createFaceFrustum(data, face);
+		for (Drawable* d : lightCasters)
+		{
+			if (ClusterCuller::intersects(frusta[face], d->get_bounds()))
+			{
+				faceCasters[face].push_back(d);
+			}
+		}
+	}
+
+	const uint32_t resolution = shadow.resolution;
+	VkRect2D tiles[6];
+	for (uint32_t face = 0; face < 6; ++face)
+	{
+		tiles[face].offset = {static_cast<int32_t>(shadow.tiles[face].x), static_cast<int32_t>(shadow.tiles[face].y)};
+		tiles[face].extent = {resolution, resolution};
+	}
+
+	float denom = (NEAR_PLANE - data.radius);
+	float p22 = data.radius / denom;
+	float p32 = (NEAR_PLANE * data.radius) / denom;
+
+	ShadowPCB pcb = {
+		data.position,
+		data.radius,
+		p22,
+		p32,
+		0,
+		1.0f,
+		glm::mat4(1.0f),
+	};
+	if (isSpot(data))
+	{
+		pcb.spotScale = 1.0f / glm::tan(glm::acos(data.cosOuter));
+		pcb.spotView = getSpotView(data);
+	}
+
+	uint32_t objectSet = shadowShader.getSetWithUniform("nodeTransforms")->set;
+
+	// The atlas is loaded, so only the drawn tiles are cleared, all in the first pass.
+	uint8_t uncleared = faces;
+	bool inPass = false;
+	auto beginPass = [&]() {
+		renderPass.begin(cmd, atlasFramebuffer);
+		inPass = true;
+
+		VkClearRect clearRects[6];
+		uint32_t clearCount = 0;
+		for (uint32_t face = 0; face < 6; ++face)
+		{
+			if (uncleared & (1u << face))
+			{
+				clearRects[clearCount++] = {tiles[face], 0, 1};
+			}
+		}
+		uncleared = 0;
+		if (clearCount > 0)
+		{
+			VkClearAttachment clear = {};
+			clear.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+			clear.clearValue.depthStencil = {1.0f, 0};
+			vkCmdClearAttachments(cmd, 1, &clear, clearCount, clearRects);
+		}
 
 		shadowPipeline.bind(cmd);
-		vkCmdSetViewport(cmd, 0, 1, &shadow->viewport);
-		vkCmdSetScissor(cmd, 0, 1, &shadow->scissor);
-		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, shadowShader.pipelineLayout.get(), viewSet.setIdx,
-								1, &viewSet.get(), 0, nullptr);
-		vkCmdPushConstants(cmd, shadowShader.pipelineLayout.get(), shadowShader.pushConstant.stage,
-						   sizeof(ModelPushConstantBlock), sizeof(PointShadow::PCB), &pcb);
-		for (Drawable* d : drawables)
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, shadowShader.pipelineLayout.get(),
+								viewSet.setIdx, 1, &viewSet.get(), 0, nullptr);
+	};
+
+	for (uint32_t face = 0; face < 6; ++face)
+	{
+		if (faceCasters[face].empty())
 		{
-			d->drawGeometry(cmd, shadowShader.pipelineLayout.get());
+			continue;
 		}
 
+		// The meshlets are culled per face, which has to be recorded outside of a render pass.
+		if (culler)
+		{
+			if (inPass)
+			{
+				renderPass.end(cmd);
+				inPass = false;
+			}
+			culler->begin(cmd);
+			for (Drawable* d : faceCasters[face])
+			{
+				d->cull(cmd, *culler, ClusterCuller::SHADOW_VIEW, frusta[face]);
+			}
+			culler->end(cmd);
+		}
+		if (!inPass)
+		{
+			beginPass();
+		}
+
+		VkViewport viewport = {static_cast<float>(tiles[face].offset.x),
+							   static_cast<float>(tiles[face].offset.y + resolution),
+							   static_cast<float>(resolution),
+							   -static_cast<float>(resolution),
+							   0.0f,
+							   1.0f};
+		vkCmdSetViewport(cmd, 0, 1, &viewport);
+		vkCmdSetScissor(cmd, 0, 1, &tiles[face]);
+
+		if (isSpot(data))
+		{
+			pcb.face = SPOT_FACE;
+		}
+		else
+		{
+			pcb.face = static_cast<int>(face) + (data.dualParaboloid ? PARABOLOID_FACE : 0);
+		}
+		vkCmdPushConstants(cmd, shadowShader.pipelineLayout.get(), shadowShader.pushConstant.stage, 0,
+						   sizeof(ShadowPCB), &pcb);
+		for (Drawable* d : faceCasters[face])
+		{
+			d->drawGeometry(cmd, shadowShader.pipelineLayout.get(), objectSet);
+		}
+	}
+
+	if (!inPass && uncleared != 0)
+	{
+		beginPass();
+	}
+	if (inPass)
+	{
 		renderPass.end(cmd);
 	}
 }
@@ -275,12 +972,7 @@ void PointLightCaster::bindTextureSet(const Context* context, const spirv::SetSi
 {
 	const spirv::UniformInfo* unif = set.getUniform(textureUniformName);
 
-	std::vector<VkDescriptorImageInfo> infos;
-	infos.reserve(maxShadows);
-	for (auto& shadow : shadows)
-	{
-		infos.push_back(shadow.shadowMap.get_imageInfo());
-	}
+	VkDescriptorImageInfo info = shadowAtlas.get_imageInfo();
 
 	VkWriteDescriptorSet write = {};
 	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -289,7 +981,21 @@ void PointLightCaster::bindTextureSet(const Context* context, const spirv::SetSi
 	write.dstSet = set.get();
 	write.dstBinding = unif->binding;
 	write.dstArrayElement = 0;
-	write.pImageInfo = infos.data();
+	write.pImageInfo = &info;
+
+	vkUpdateDescriptorSets(context->get_device(), 1, &write, 0, nullptr);
+
+	if (!moments)
+	{
+		return;
+	}
+
+	// The placeholder while moments are disabled, as the binding is declared by the lighting shaders regardless.
+	unif = set.getUniform(momentUniformName);
+	info = momentAtlas.valid() ? momentAtlas.get_texture().get_imageInfo() : moments->get_placeholderInfo();
+	write.descriptorType = unif->type;
+	write.descriptorCount = unif->arrayLength;
+	write.dstBinding = unif->binding;
 
 	vkUpdateDescriptorSets(context->get_device(), 1, &write, 0, nullptr);
 }
@@ -301,7 +1007,7 @@ spirv::RenderPass PointLightCaster::createRenderPass(const Context* context)
 	format[0].usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
 	format[0].format = VK_FORMAT_D32_SFLOAT;
 	format[0].sampleCount = VK_SAMPLE_COUNT_1_BIT;
-	format[0].loadStoreConfig = LoadStoreConfig(LoadStoreConfig::LoadAction::CLEAR, LoadStoreConfig::StoreAction::READ);
+	format[0].loadStoreConfig = LoadStoreConfig(LoadStoreConfig::LoadAction::READ, LoadStoreConfig::StoreAction::READ);
 
 	VkAttachmentReference depthRef = {};
 	depthRef.attachment = 0;
@@ -319,22 +1025,10 @@ spirv::RenderPass PointLightCaster::createRenderPass(const Context* context)
 	subpass[0].pResolveAttachments = nullptr;
 	subpass[0].flags = 0;
 
-	uint32_t viewmask = 0b111111;
-
-	VkRenderPassMultiviewCreateInfo multiview = {};
-	multiview.sType = VK_STRUCTURE_TYPE_RENDER_PASS_MULTIVIEW_CREATE_INFO;
-	multiview.pNext = nullptr;
-	multiview.subpassCount = 1;
-	multiview.pViewMasks = &viewmask;
-	multiview.correlationMaskCount = 0;
-	multiview.pCorrelationMasks = nullptr;
-	multiview.dependencyCount = 0;
-	multiview.pViewOffsets = nullptr;
-
 	VkClearValue clearColor;
 	clearColor.depthStencil = {1.0f, 0};
 
-	auto rp = context->get_pipelineFactory()->createRenderPass(format, subpass, &multiview);
+	auto rp = context->get_pipelineFactory()->createRenderPass(format, subpass);
 	rp.clearValues = {clearColor};
 	return std::move(rp);
 }
@@ -411,34 +1105,4 @@ spirv::Pipeline PointLightCaster::createPipeline(const Context* context)
 	return context->get_pipelineFactory()->createGraphicsPipeline(shadowShader, renderPass, info);
 }
 
-// Point Shadow 2
-PointShadow::PointShadow(const Context* context, const spirv::RenderPass& renderPass, uint32_t mapResolution) noexcept
-{
-	ImageDataCube idc{};
-	idc.height = mapResolution;
-	idc.width = mapResolution;
-	idc.numChannels = 1;
-	idc.size = 6 * mapResolution * mapResolution;
-	idc.layerSize = mapResolution * mapResolution;
-	idc.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-	idc.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
-	idc.format = VK_FORMAT_D32_SFLOAT;
-	idc.aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
-	idc.access = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-	shadowMap = TextureCube(context, idc, false);
-
-	viewport = VkViewport{0.0f,
-						  static_cast<float>(mapResolution),
-						  static_cast<float>(mapResolution),
-						  -static_cast<float>(mapResolution),
-						  0.0f,
-						  1.0f};
-
-	scissor.extent = {mapResolution, mapResolution};
-	scissor.offset = {0, 0};
-
-	std::vector<VkImageView> attachments = {shadowMap.get_imageView()};
-	framebuffer = context->get_pipelineFactory()->createFramebuffer(renderPass, scissor.extent, attachments);
-}
-
 } // namespace blaze
\ No newline at end of file
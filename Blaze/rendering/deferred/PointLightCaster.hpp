@@ -3,72 +3,184 @@
 
 #include <core/Context.hpp>
 #include <core/Drawable.hpp>
-#include <core/TextureCube.hpp>
+#include <rendering/ALightCaster.hpp>
+#include <rendering/CasterTracker.hpp>
+#include <rendering/ClusterCuller.hpp>
+#include <rendering/deferred/ShadowMoments.hpp>
+#include <core/Camera.hpp>
+#include <core/Texture2D.hpp>
 #include <core/StorageBuffer.hpp>
 #include <core/UniformBuffer.hpp>
 #include <spirv/PipelineFactory.hpp>
+#include <util/SlotMap.hpp>
+#include <util/TileAllocator.hpp>
 
 namespace blaze::dfr
 {
 /**
- * @class PointShadow
+ * @brief Owns the point and spot lights and their shadows.
  *
- * @brief Encapsulates the attachments and framebuffer for a point light shadow.
+ * The lights are kept densely packed in a SlotMap, so the live lights are uploaded and
+ * iterated contiguously. When the table isn't full, the uploaded lights are followed by a
+ * light with a negative radius, which ends the loops in the shaders.
  *
- * Contains the shadowMap (D32) along with the framebuffer and
- * viewport configured.
+ * The shadows of all lights share one depth atlas. Each shadowed light owns six square tiles,
+ * one per cube face, from a TileAllocator. The size of the tiles follows the screen coverage of
+ * the light, and the tiles are only reallocated when the size has to change, so that they keep
+ * their contents between frames.
  *
- * @note Not supposed to be used externally.
+ * A spot light is a point light limited to a cone. It owns a single tile, the perspective view of its
+ * cone, which is drawn and sampled as the first face of a point light. The spot lights are uploaded
+ * after the point lights, so that each kind has a contiguous range of lights to draw its volumes for.
  *
- * @cond PRIVATE
+ * A point light can instead have a dual paraboloid shadow, two tiles that each hold a hemisphere around
+ * the z axis, drawn as the first two faces. It costs two views instead of six, for the distortion of the
+ * paraboloid on coarse casters, so it suits distant and small lights.
+ *
+ * The casters are culled against each face, and the faces that no caster touches are only cleared.
+ *
+ * A face is stale when the light moved or a changed caster touches the light. Each frame only
+ * a budget of stale faces is drawn, the lights without a complete shadow first, then by their
+ * coverage weighted with the frames since their last update. A light's shadow is used by the
+ * lighting shaders once all six faces were drawn in its current tiles.
+ *
+ * While moments are enabled, the drawn tiles are also built into a moment atlas after each cast.
+ *
+ * The volumes of the shadowed lights are queried for occlusion by the renderer. A light whose volume
+ * was hidden is neither uploaded nor drawn to until a query sees it again. The results lag by the frames
+ * in flight, so a light is only occluded by a query of its current volume since the last camera cut, while
+ * the volume lies entirely inside the current view. Only such volumes are queried, a little larger than
+ * the lights, as a volume outside the view passes no samples without being hidden.
  */
-struct PointShadow
+class PointLightCaster
 {
-	TextureCube shadowMap;
-	spirv::Framebuffer framebuffer;
-	VkRect2D scissor;
-	VkViewport viewport;
-	uint16_t next;
-
-	struct PCB
+public:
+	struct LightData
 	{
 		alignas(16) glm::vec3 position;
 		alignas(4) float radius;
-		alignas(4) float p22;
-		alignas(4) float p32;
+		alignas(16) glm::vec3 color;
+		/// Non zero if the light casts a shadow.
+		alignas(4) int castShadow;
+		/// Size of the tiles of the light in texels, 0 if the light has no complete shadow.
+		alignas(4) uint32_t shadowResolution;
+		/// Origin of the tile of each face in texels, packed as x | y << 16.
+		alignas(4) uint32_t shadowTiles[6];
+		/// Axis of the cone of a spot light.
+		alignas(16) glm::vec3 direction;
+		/// Cosine of the half angle where a spot light ends, -1 for a point light.
+		alignas(4) float cosOuter;
+		/// Cosine of the half angle where a spot light starts to fade.
+		alignas(4) float cosInner;
+		/// Non zero if the shadow is two paraboloid hemispheres instead of six faces.
+		alignas(4) int dualParaboloid;
 	};
 
-	PointShadow(const Context* context, const spirv::RenderPass& renderPass, uint32_t mapResolution) noexcept;
-};
-/**
- * @endcond
- */
+private:
+	constexpr static uint32_t ATLAS_RESOLUTION = 4096;
+	constexpr static uint32_t MAX_TILE_RESOLUTION = 512;
+	constexpr static uint32_t MIN_TILE_RESOLUTION = 64;
+	constexpr static uint8_t ALL_FACES = 0b111111;
+	/// The single face of a spot light.
+	constexpr static uint8_t SPOT_FACES = 0b1;
+	/// The hemispheres around +z and -z of a dual paraboloid shadow.
+	constexpr static uint8_t PARABOLOID_FACES = 0b11;
+	/// Widest half angle of a spot light, 80 degrees, as the cone and its shadow are perspective views.
+	constexpr static float MAX_SPOT_ANGLE = 1.3962634f;
+	constexpr static float NEAR_PLANE = 0.05f;
+
+	/**
+	 * @brief The tiles of the shadow of a light and how up to date they are.
+	 */
+	struct Shadow
+	{
+		util::TileAllocator::Tile tiles[6];
+		/// Faces of the light, only the first for a spot light.
+		uint8_t faces{ALL_FACES};
+		/// Size of the tiles, 0 if the light has none.
+		uint32_t resolution{0};
+		/// Faces drawn since the tiles were allocated.
+		uint8_t drawnFaces{0};
+		/// Faces that are out of date.
+		uint8_t staleFaces{0};
+		/// The face to continue from when only some of the stale faces fit in the budget.
+		uint8_t nextFace{0};
+		/// The light as the faces were last drawn.
+		glm::vec3 drawnPosition{0.0f};
+		glm::vec3 drawnDirection{0.0f};
+		float drawnRadius{-1.0f};
+		uint64_t lastDrawnFrame{0};
+		/// Height of the light on screen in pixels.
+		float coverage{0.0f};
+	};
+
+	struct Light;
+
+public:
+	using Handle = util::SlotMap<Light>::Handle;
+	constexpr static Handle INVALID_HANDLE = util::SlotMap<Light>::INVALID_HANDLE;
 
-class PointLightCaster
-{
 private:
-	constexpr static uint32_t OMNI_MAP_RESOLUTION = 512;
+	struct Light
+	{
+		LightData data;
+		Shadow shadow;
+		/// The handle of the light itself, to refer to it from the occlusion queries.
+		Handle handle{INVALID_HANDLE};
+		/// Whether the last query of the volume found it hidden.
+		bool occluded{false};
+	};
 
-	struct LightData
+	/**
+	 * @brief A light whose volume is queried in a frame, as it was when queried.
+	 */
+	struct OcclusionQuery
+	{
+		Handle handle;
+		glm::vec3 position;
+		glm::vec3 direction;
+		float radius;
+		uint64_t update;
+	};
+
+	/// The scale of the queried volumes, so that lights are seen a little before their volume is.
+	constexpr static float OCCLUSION_MARGIN = 1.1f;
+	/// A camera that moves farther in an update cuts, and drops the queries of the frames in flight.
+	constexpr static float CAMERA_CUT_DISTANCE = 2.0f;
+	/// Cosine of the most a camera turns in an update without a cut.
+	constexpr static float CAMERA_CUT_COS = 0.9f;
+
+private:
+	struct ShadowPCB
 	{
 		alignas(16) glm::vec3 position;
 		alignas(4) float radius;
-		alignas(16) glm::vec3 color;
-		alignas(4) int shadowIdx;
+		alignas(4) float p22;
+		alignas(4) float p32;
+		/// The face to draw, or SPOT_FACE for the view of a spot light.
+		alignas(4) int face;
+		/// The scale of the projection of a spot light, the reciprocal of the tangent of its half angle.
+		alignas(4) float spotScale;
+		alignas(16) glm::mat4 spotView;
 	};
+	constexpr static int SPOT_FACE = 6;
+	/// The face to draw for the first hemisphere of a dual paraboloid shadow, followed by the second.
+	constexpr static int PARABOLOID_FACE = 7;
 
 	uint32_t maxLights;
 	uint32_t maxShadows;
 
-	uint32_t count;
-	int16_t freeLight;
-	std::vector<LightData> lights;
+	util::SlotMap<Light> lights;
+	/// The lights as uploaded this frame, the point lights then the spot lights.
+	std::vector<LightData> uploadedLights;
+	uint32_t uploadedSpotCount{0};
 
 	constexpr static std::string_view dataUniformName = "lights";
-	constexpr static std::string_view textureUniformName = "shadows";
+	constexpr static std::string_view textureUniformName = "shadowAtlas";
+	constexpr static std::string_view momentUniformName = "shadowMomentAtlas";
 
-	constexpr static std::string_view vertShaderFileName = "shaders/forward/vPointShadow.vert.spv";
-	constexpr static std::string_view fragShaderFileName = "shaders/forward/fPointShadow.frag.spv";
+	constexpr static std::string_view vertShaderFileName = "shaders/deferred/vPointShadow.vert.spv";
+	constexpr static std::string_view fragShaderFileName = "shaders/deferred/fPointShadow.frag.spv";
 
 	spirv::RenderPass renderPass;
 	spirv::Shader shadowShader;
@@ -76,33 +188,124 @@ private:
 
 	spirv::SetSingleton viewSet;
 	UBO<CubemapUBlock> viewUBO;
+	/// The views of the faces as in viewUBO, to cull the casters of each face.
+	glm::mat4 faceViews[6];
 
 	SSBODataVector ubos;
 
-	uint32_t shadowCount;
-	int freeShadow;
-	std::vector<PointShadow> shadows;
+	uint32_t shadowCount{0};
+	Texture2D shadowAtlas;
+	spirv::Framebuffer atlasFramebuffer;
+	util::TileAllocator tileAllocator;
+	uint64_t frameCount{0};
+
+	const ClusterCuller* culler{nullptr};
+	const ShadowMoments* moments{nullptr};
+	ShadowMoments::MomentMap momentAtlas;
+
+	/// The lights queried in each frame in flight, in the order of their volumes.
+	std::vector<std::vector<OcclusionQuery>> occlusionQueries;
+	/// The volumes to query this frame, the spheres then the cones.
+	std::vector<glm::mat4> occlusionVolumes;
+	uint32_t occlusionConeCount{0};
+	uint32_t occludedCount{0};
+	bool occlusionEnabled{true};
+	uint64_t updateCount{0};
+	uint64_t cameraCutUpdate{0};
+	glm::vec3 lastCameraPosition{0.0f};
+	glm::vec3 lastCameraDirection{0.0f};
+	/// The frustum of the camera of the last update.
+	ClusterCuller::Frustum viewFrustum{};
 
 public:
-	PointLightCaster(const Context* context, uint32_t numLights, const spirv::SetVector& sets, const spirv::SetSingleton& texSet) noexcept;
+	PointLightCaster(const Context* context, uint32_t numLights, const spirv::SetVector& sets,
+					 const spirv::SetSingleton& texSet, const ClusterCuller* culler = nullptr,
+					 const ShadowMoments* moments = nullptr) noexcept;
 	void recreate(const Context* context, const spirv::SetVector& sets);
-	void update(uint32_t frame);
+	/**
+	 * @brief Sizes the shadow tiles for the view of \a camera and uploads the lights.
+	 */
+	void update(const Camera* camera, uint32_t frame);
+
+	/**
+	 * @brief Creates a light.
+	 *
+	 * @returns The handle of the light, or INVALID_HANDLE if the table is full.
+	 */
+	Handle createLight(const glm::vec3& position, const glm::vec3& color, float radius, bool enableShadow);
+
+	/**
+	 * @brief Creates as many of the lights as fit, growing the table once.
+	 *
+	 * @returns The handles of the lights created in order, fewer than \a infos if the table is full.
+	 */
+	std::vector<Handle> createLights(const std::vector<ALightCaster::PointLightInfo>& infos);
+
+	/**
+	 * @brief Creates a spot light.
+	 *
+	 * @param direction The axis of the cone.
+	 * @param innerAngle The half angle in radians where the light starts to fade.
+	 * @param outerAngle The half angle in radians where the light ends, up to MAX_SPOT_ANGLE.
+	 *
+	 * @returns The handle of the light, or INVALID_HANDLE if the table is full.
+	 */
+	Handle createSpotLight(const glm::vec3& position, const glm::vec3& direction, const glm::vec3& color, float radius,
+						   float innerAngle, float outerAngle, bool enableShadow);
+	void removeLight(Handle handle);
+	bool setShadow(Handle handle, bool enableShadow);
+
+	/**
+	 * @brief Switches the shadow of a point light between six cube faces and two paraboloid hemispheres.
+	 *
+	 * The shadow is drawn again in new tiles.
+	 */
+	void setDualParaboloid(Handle handle, bool enable);
 
-	uint16_t createLight(const glm::vec3& position, const glm::vec3& color, float radius, bool enableShadow);
-	void removeLight(uint16_t idx);
-	bool setShadow(uint16_t idx, bool enableShadow);
+	/**
+	 * @brief Makes room for \a count more lights.
+	 */
+	void reserve(uint32_t count)
+	{
+		lights.reserve(lights.get_size() + count);
+	}
+
+	/**
+	 * @brief Returns the light of \a handle, or nullptr if it was removed.
+	 */
+	LightData* getLight(Handle handle)
+	{
+		Light* light = lights.get(handle);
+		return light ? &light->data : nullptr;
+	}
 
-	int createShadow();
-	void removeShadow(int idx);
+	/**
+	 * @brief The lights as uploaded by the last update, the point lights then the spot lights.
+	 */
+	const std::vector<LightData>& get_lights() const
+	{
+		return uploadedLights;
+	}
 
-	LightData* getLight(uint16_t idx)
+	/**
+	 * @brief The number of spot lights at the end of the uploaded lights.
+	 */
+	inline uint32_t get_spotCount() const
 	{
-		return &lights[idx];
+		return uploadedSpotCount;
+	}
+
+	/**
+	 * @brief Whether \a light is a spot light.
+	 */
+	static bool isSpot(const LightData& light)
+	{
+		return light.cosOuter > -1.0f;
 	}
 
 	inline uint32_t get_count() const
 	{
-		return count;
+		return lights.get_size();
 	}
 
 	inline uint32_t getMaxLights() const
@@ -115,60 +318,89 @@ public:
 		return maxShadows;
 	}
 
-	void cast(VkCommandBuffer cmd, const std::vector<Drawable*>& drawables);
-
-	struct LightIterator
-	{
-		int index;
-		LightData* data;
-		int end;
-
-		LightIterator& operator++()
-		{
-			do
-			{
-				data++;
-				index++;
-			} while (data->radius < 0 && index < end);
-			return *this;
-		}
-
-		bool valid()
-		{
-			return index < end;
-		}
-
-	private:
-		LightIterator(std::vector<LightData>& lights)
-		{
-			end = static_cast<int>(lights.size());
-			data = lights.data();
-			index = end;
-			int i = 0;
-			for (auto& light : lights)
-			{
-				if (light.radius > 0)
-				{
-					index = i;
-					break;
-				}
-				i++;
-			}
-		}
-
-		friend class PointLightCaster;
-	};
+	/**
+	 * @brief Draws the most important stale shadow faces.
+	 *
+	 * @param cmd The command buffer to record to.
+	 * @param drawables The shadow casters.
+	 * @param casters The changes of the casters since the previous frame.
+	 * @param faceBudget The most faces to draw.
+	 *
+	 * @returns The number of faces drawn.
+	 */
+	uint32_t cast(VkCommandBuffer cmd, const std::vector<Drawable*>& drawables, const CasterTracker& casters,
+				  uint32_t faceBudget);
+
+	/**
+	 * @brief Creates or frees the moment atlas, and builds the moments of the faces drawn so far.
+	 *
+	 * The GPU must be idle, as the texture set is rebound.
+	 */
+	void setMomentsEnabled(const Context* context, bool enable, const spirv::SetSingleton& texSet);
+
+	/**
+	 * @brief Marks the lights queried in \a frame as occluded if none of the samples of their volume passed.
+	 *
+	 * Called before the update of \a frame, once the frame is not in flight. The update clears the occlusion
+	 * of the lights that are no longer entirely in view.
+	 *
+	 * @param samples The samples of each volume queried in the frame, empty if it drew no queries.
+	 */
+	void readOcclusion(uint32_t frame, const std::vector<uint64_t>& samples);
+
+	/**
+	 * @brief Enables the occlusion queries, or uploads and casts all the lights again.
+	 */
+	void setOcclusionEnabled(bool enable);
+
+	inline bool isOcclusionEnabled() const
+	{
+		return occlusionEnabled;
+	}
+
+	/**
+	 * @brief The volumes to query by the last update, the unit spheres then the unit cones transformed.
+	 */
+	const std::vector<glm::mat4>& get_occlusionVolumes() const
+	{
+		return occlusionVolumes;
+	}
+
+	/**
+	 * @brief The number of cones at the end of the occlusion volumes.
+	 */
+	inline uint32_t get_occlusionConeCount() const
+	{
+		return occlusionConeCount;
+	}
 
-	LightIterator getLightIterator()
+	/**
+	 * @brief The number of lights that were not uploaded by the last update, as they are occluded.
+	 */
+	inline uint32_t get_occludedCount() const
 	{
-		return LightIterator(lights);
+		return occludedCount;
 	}
 
 private:
+	void uploadLights(uint32_t frame);
+	void assignShadowTiles(const Camera* camera);
+	void checkCameraCut(const Camera* camera);
+	void prepareOcclusionQueries(uint32_t frame);
+	bool isInView(const LightData& light) const;
+	glm::mat4 getOcclusionVolume(const LightData& light) const;
+	bool allocateTiles(Shadow& shadow, uint32_t resolution);
+	void releaseTiles(Shadow& shadow);
+	void drawFaces(VkCommandBuffer cmd, const std::vector<Drawable*>& drawables, const Light& light, uint8_t faces);
+	ClusterCuller::Frustum createFaceFrustum(const LightData& light, uint32_t face) const;
+	glm::mat4 getSpotView(const LightData& light) const;
+	void addMomentRegions(std::vector<ShadowMoments::Region>& regions, const Shadow& shadow, uint8_t faces) const;
+	float getCoverage(const Camera* camera, const LightData& light) const;
+	uint32_t getShadowResolution(const Shadow& shadow) const;
 	void bindDataSet(const Context* context, const spirv::SetVector& sets);
 	void bindTextureSet(const Context* context, const spirv::SetSingleton& set);
 	spirv::RenderPass createRenderPass(const Context* context);
 	spirv::Shader createShader(const Context* context);
 	spirv::Pipeline createPipeline(const Context* context);
 };
-} // namespace blaze
\ No newline at end of file
+} // namespace blaze
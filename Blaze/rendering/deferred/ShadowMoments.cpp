@@ -0,0 +1,222 @@
+#include "ShadowMoments.hpp"
+
+#include <util/files.hpp>
+
+#include <algorithm>
+#include <array>
+
+#include <thirdparty/optick/optick.h>
+
+namespace blaze::dfr
+{
+ShadowMoments::ShadowMoments(const Context* context) : context(context)
+{
+	shader = createShader();
+	pipeline = createPipeline();
+
+	depthSampler = vkw::Sampler(util::createSampler(context->get_device(), 1, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+													 VK_FALSE),
+								context->get_device());
+
+	placeholder = createPlaceholder(1);
+	placeholderArray = createPlaceholder(2);
+}
+
+ShadowMoments::MomentMap ShadowMoments::createMomentMap(const Texture2D& depthMap) const
+{
+	assert(valid());
+
+	const uint32_t width = depthMap.get_width() / DOWNSAMPLE;
+	const uint32_t height = depthMap.get_height() / DOWNSAMPLE;
+	const uint32_t layerCount = depthMap.get_layerCount();
+
+	ImageData2D id2d{};
+	id2d.width = width;
+	id2d.height = height;
+	id2d.numChannels = 4;
+	id2d.size = width * height * 4 * sizeof(uint16_t);
+	id2d.layerCount = layerCount;
+	id2d.anisotropy = VK_FALSE;
+	id2d.samplerAddressMode = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	id2d.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+	id2d.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+				 VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	// Written by the compute shader and the blits, and sampled, without changing layouts.
+	id2d.layout = VK_IMAGE_LAYOUT_GENERAL;
+	id2d.access = VK_ACCESS_SHADER_READ_BIT;
+
+	MomentMap map;
+	map.texture = Texture2D(context, id2d, true);
+
+	std::vector<VkImageView> views(layerCount);
+	for (uint32_t layer = 0; layer < layerCount; layer++)
+	{
+		views[layer] = util::createImageView(context->get_device(), map.texture.get_image(), VK_IMAGE_VIEW_TYPE_2D,
+											 id2d.format, VK_IMAGE_ASPECT_COLOR_BIT, 1, 1, layer);
+	}
+	map.storageViews = vkw::ImageViewVector(std::move(views), context->get_device());
+
+	map.sets.reserve(layerCount);
+	for (uint32_t layer = 0; layer < layerCount; layer++)
+	{
+		auto& set =
+			map.sets.emplace_back(context->get_pipelineFactory()->createSet(*shader.getSetWithUniform("depthMap")));
+
+		VkDescriptorImageInfo depthInfo = {depthSampler.get(), depthMap.get_imageView(layer), depthMap.get_layout()};
+		VkDescriptorImageInfo momentInfo = {VK_NULL_HANDLE, map.storageViews[layer], VK_IMAGE_LAYOUT_GENERAL};
+
+		const char* names[] = {"depthMap", "moments"};
+		std::array<VkWriteDescriptorSet, 2> writes;
+		for (size_t j = 0; j < writes.size(); j++)
+		{
+			auto unif = shader.getUniform(names[j]);
+
+			writes[j] = {};
+			writes[j].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[j].descriptorType = unif->type;
+			writes[j].descriptorCount = 1;
+			writes[j].dstSet = set.get();
+			writes[j].dstBinding = unif->binding;
+			writes[j].dstArrayElement = 0;
+		}
+		writes[0].pImageInfo = &depthInfo;
+		writes[1].pImageInfo = &momentInfo;
+
+		vkUpdateDescriptorSets(context->get_device(), static_cast<uint32_t>(writes.size()), writes.data(), 0,
+							   nullptr);
+	}
+
+	return map;
+}
+
+void ShadowMoments::build(VkCommandBuffer cmd, const MomentMap& map, const std::vector<Region>& regions) const
+{
+	OPTICK_EVENT();
+	assert(valid() && map.valid());
+
+	if (regions.empty())
+	{
+		return;
+	}
+
+	// The depths were drawn by the shadow passes, and the moments were last read by the lighting
+	// and written by the previous build.
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(cmd,
+						 VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+							 VK_PIPELINE_STAGE_TRANSFER_BIT,
+						 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+	vkCmdBindPipeline(cmd, pipeline.bindPoint, pipeline.pipeline.get());
+	const int radius = std::clamp(blurRadius, 0, MAX_BLUR_RADIUS);
+	for (const Region& region : regions)
+	{
+		const PCB pcb = {
+			glm::ivec2(region.rect.offset.x, region.rect.offset.y) / static_cast<int>(DOWNSAMPLE),
+			glm::ivec2(region.rect.extent.width, region.rect.extent.height) / static_cast<int>(DOWNSAMPLE),
+			radius,
+		};
+
+		const auto& set = map.sets[region.layer];
+		vkCmdBindDescriptorSets(cmd, pipeline.bindPoint, shader.pipelineLayout.get(), set.setIdx, 1, &set.get(), 0,
+								nullptr);
+		vkCmdPushConstants(cmd, shader.pipelineLayout.get(), shader.pushConstant.stage, 0, sizeof(PCB), &pcb);
+		vkCmdDispatch(cmd, (pcb.size.x + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE,
+					  (pcb.size.y + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1);
+	}
+
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0,
+						 nullptr, 0, nullptr);
+
+	// Each level of all the regions at once. The regions are aligned to their size, so their mips
+	// stay inside the region down to a single texel.
+	VkImage image = map.texture.get_image();
+	std::vector<VkImageBlit> blits;
+	blits.reserve(regions.size());
+	for (uint32_t level = 1; level < map.texture.get_miplevels(); level++)
+	{
+		blits.clear();
+		for (const Region& region : regions)
+		{
+			const int32_t x = region.rect.offset.x / DOWNSAMPLE;
+			const int32_t y = region.rect.offset.y / DOWNSAMPLE;
+			const int32_t width = region.rect.extent.width / DOWNSAMPLE;
+			const int32_t height = region.rect.extent.height / DOWNSAMPLE;
+			if ((width >> level) == 0 || (height >> level) == 0)
+			{
+				continue;
+			}
+
+			VkImageBlit blit = {};
+			blit.srcOffsets[0] = {x >> (level - 1), y >> (level - 1), 0};
+			blit.srcOffsets[1] = {(x + width) >> (level - 1), (y + height) >> (level - 1), 1};
+			blit.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - 1, region.layer, 1};
+			blit.dstOffsets[0] = {x >> level, y >> level, 0};
+			blit.dstOffsets[1] = {(x + width) >> level, (y + height) >> level, 1};
+			blit.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, region.layer, 1};
+			blits.push_back(blit);
+		}
+		if (blits.empty())
+		{
+			break;
+		}
+
+		vkCmdBlitImage(cmd, image, VK_IMAGE_LAYOUT_GENERAL, image, VK_IMAGE_LAYOUT_GENERAL,
+					   static_cast<uint32_t>(blits.size()), blits.data(), VK_FILTER_LINEAR);
+
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0,
+							 nullptr, 0, nullptr);
+	}
+
+	// Read by the lighting passes.
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+						 VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+Texture2D ShadowMoments::createPlaceholder(uint32_t layerCount) const
+{
+	// Never sampled, as the lighting only reads the moments while they are enabled.
+	std::vector<uint16_t> zeros(4 * layerCount, 0);
+
+	ImageData2D id2d{};
+	id2d.data = reinterpret_cast<uint8_t*>(zeros.data());
+	id2d.width = 1;
+	id2d.height = 1;
+	id2d.numChannels = 4;
+	id2d.size = static_cast<uint32_t>(zeros.size() * sizeof(uint16_t));
+	id2d.layerCount = layerCount;
+	id2d.anisotropy = VK_FALSE;
+	id2d.samplerAddressMode = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	id2d.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+	id2d.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	return Texture2D(context, id2d, false);
+}
+
+spirv::Shader ShadowMoments::createShader()
+{
+	std::vector<spirv::ShaderStageData> stages;
+
+	spirv::ShaderStageData* stage;
+	stage = &stages.emplace_back();
+	stage->spirv = util::loadBinaryFile(compShaderFileName);
+	stage->stage = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	return context->get_pipelineFactory()->createShader(stages);
+}
+
+spirv::Pipeline ShadowMoments::createPipeline()
+{
+	assert(shader.valid());
+
+	return context->get_pipelineFactory()->createComputePipeline(shader);
+}
+} // namespace blaze::dfr
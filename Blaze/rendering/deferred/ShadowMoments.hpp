@@ -0,0 +1,145 @@
+#pragma once
+
+#include <core/Context.hpp>
+#include <core/Texture2D.hpp>
+#include <spirv/PipelineFactory.hpp>
+
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+namespace blaze::dfr
+{
+/**
+ * @brief Builds exponential variance shadow maps (EVSM) from shadow depth maps.
+ *
+ * Each texel of a moment map holds the first two moments of a positive and a negative exponential
+ * warp of the depth. Unlike depths, moments can be filtered linearly, so the maps are blurred and
+ * mipmapped once when a shadow is drawn, and the lighting filters them with a single trilinear fetch.
+ * Cached shadows keep their moments, so the blur is only paid for the regions drawn in a frame.
+ *
+ * The moment maps are half the resolution of the depth maps, each texel the mean moments of 2x2 depths.
+ */
+class ShadowMoments
+{
+public:
+	constexpr static uint32_t DOWNSAMPLE = 2;
+	constexpr static int MAX_BLUR_RADIUS = 4;
+
+	/**
+	 * @brief The moment map of a depth map, with a set of each layer to build it from the depths.
+	 */
+	class MomentMap
+	{
+	private:
+		Texture2D texture;
+		vkw::ImageViewVector storageViews;
+		std::vector<spirv::SetSingleton> sets;
+
+		friend class ShadowMoments;
+
+	public:
+		const Texture2D& get_texture() const
+		{
+			return texture;
+		}
+
+		inline bool valid() const
+		{
+			return texture.valid();
+		}
+	};
+
+	/**
+	 * @brief A region of a layer of the depth map, in depth texels.
+	 *
+	 * Regions are mipmapped down to a texel, so they must be aligned to their size, as the tiles of the atlas are.
+	 */
+	struct Region
+	{
+		uint32_t layer;
+		VkRect2D rect;
+	};
+
+	/// Radius of the box blur in moment texels.
+	int blurRadius{1};
+
+private:
+	constexpr static std::string_view compShaderFileName = "shaders/deferred/cShadowMoments.comp.spv";
+	constexpr static uint32_t WORKGROUP_SIZE = 16;
+
+	struct PCB
+	{
+		alignas(8) glm::ivec2 offset;
+		alignas(8) glm::ivec2 size;
+		alignas(4) int radius;
+	};
+
+	const Context* context{nullptr};
+
+	spirv::Shader shader;
+	spirv::Pipeline pipeline;
+	/// The depth maps have comparison samplers, which can't be fetched from.
+	vkw::Sampler depthSampler;
+
+	Texture2D placeholder;
+	Texture2D placeholderArray;
+
+public:
+	/**
+	 * @brief Default constructor.
+	 */
+	ShadowMoments() noexcept
+	{
+	}
+
+	/**
+	 * @brief Main constructor.
+	 *
+	 * @param context The Vulkan Context in use.
+	 */
+	ShadowMoments(const Context* context);
+
+	/**
+	 * @brief Creates the moment map of \a depthMap, with the same layers and a full mip chain.
+	 *
+	 * @param depthMap The depth map, sampled in its read only layout.
+	 */
+	[[nodiscard]] MomentMap createMomentMap(const Texture2D& depthMap) const;
+
+	/**
+	 * @brief Records building the moments of \a regions and their mips.
+	 *
+	 * @param cmd The command buffer to record to, outside of a render pass, after the depths were drawn.
+	 * @param map The moment map of the depth map the regions were drawn to.
+	 * @param regions The regions to build.
+	 */
+	void build(VkCommandBuffer cmd, const MomentMap& map, const std::vector<Region>& regions) const;
+
+	/**
+	 * @brief The image to bind instead of a moment map with a single layer, while moments are disabled.
+	 */
+	const VkDescriptorImageInfo& get_placeholderInfo() const
+	{
+		return placeholder.get_imageInfo();
+	}
+
+	/**
+	 * @brief The image to bind instead of a moment map with layers, while moments are disabled.
+	 */
+	const VkDescriptorImageInfo& get_placeholderArrayInfo() const
+	{
+		return placeholderArray.get_imageInfo();
+	}
+
+	inline bool valid() const
+	{
+		return pipeline.pipeline.valid();
+	}
+
+private:
+	Texture2D createPlaceholder(uint32_t layerCount) const;
+	spirv::Shader createShader();
+	spirv::Pipeline createPipeline();
+};
+} // namespace blaze::dfr
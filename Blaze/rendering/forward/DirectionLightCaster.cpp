@@ -58,7 +58,7 @@ DirectionLightCaster::DirectionLightCaster(const Context* context, const spirv::
 
 void DirectionLightCaster::recreate(const Context* context, const spirv::SetVector& sets)
 {
-	ubos = UBODataVector(context, maxLights * sizeof(LightData), sets.size());
+	ubos = UBODataVector(context, sets.getUniform(dataUniformName)->size, sets.size());
 
 	bindDataSet(context, sets);
 }
@@ -270,6 +270,7 @@ void DirectionLightCaster::removeShadow(int idx)
 void DirectionLightCaster::cast(VkCommandBuffer cmd, const std::vector<Drawable*>& drawables)
 {
 	OPTICK_EVENT();
+	uint32_t objectSet = shadowShader.getSetWithUniform("nodeTransforms")->set;
 	for (auto& light : lights)
 	{
 		if (light.shadowIdx < 0)
@@ -284,10 +285,10 @@ void DirectionLightCaster::cast(VkCommandBuffer cmd, const std::vector<Drawable*
 			vkCmdSetViewport(cmd, 0, 1, &shadow->viewport);
 			vkCmdSetScissor(cmd, 0, 1, &shadow->scissor);
 			vkCmdPushConstants(cmd, shadowShader.pipelineLayout.get(), shadowShader.pushConstant.stage,
-							   sizeof(ModelPushConstantBlock), sizeof(glm::mat4), &light.cascadeViewProj[i]);
+							   0, sizeof(glm::mat4), &light.cascadeViewProj[i]);
 			for (Drawable* d : drawables)
 			{
-				d->drawGeometry(cmd, shadowShader.pipelineLayout.get());
+				d->drawGeometry(cmd, shadowShader.pipelineLayout.get(), objectSet);
 			}
 
 			renderPass.end(cmd);
@@ -2,6 +2,8 @@
 #include "FwdLightCaster.hpp"
 
 #include <iostream>
+#include <stdexcept>
+#include <string>
 
 #undef max
 #undef min
@@ -19,6 +21,7 @@ FwdLightCaster::FwdLightCaster(const Context* context, const spirv::Shader* shad
 	textureSet = context->get_pipelineFactory()->createSet(*texSet);
 	pointLights = std::make_unique<fwd::PointLightCaster>(context, dataSet, textureSet);
 	directionLights = std::make_unique<fwd::DirectionLightCaster>(context, dataSet, textureSet);
+	spotLights = std::make_unique<fwd::SpotLightCaster>(context, dataSet, textureSet);
 }
 
 void FwdLightCaster::recreate(const Context* context, const spirv::Shader* shader, uint32_t frames)
@@ -27,6 +30,7 @@ void FwdLightCaster::recreate(const Context* context, const spirv::Shader* shade
 	dataSet = context->get_pipelineFactory()->createSets(*set, frames);
 	pointLights->recreate(context, dataSet);
 	directionLights->recreate(context, dataSet);
+	spotLights->recreate(context, dataSet);
 }
 
 void FwdLightCaster::bind(VkCommandBuffer buf, VkPipelineLayout lay, uint32_t frame) const
@@ -44,18 +48,7 @@ FwdLightCaster::Handle FwdLightCaster::createPointLight(const glm::vec3& positio
 		return 0;
 	}
 
-	HandleExposed exposed = {
-		static_cast<uint8_t>(Type::POINT),
-		pointGeneration,
-		idx,
-	};
-
-	pointGeneration = pointGeneration + 1;
-
-	Handle handle = reinterpret_cast<Handle&>(exposed);
-	validHandles.insert(handle);
-
-	return handle;
+	return lights.add({Type::POINT, idx});
 }
 
 FwdLightCaster::Handle FwdLightCaster::createPointLight(const glm::vec3& position, const glm::vec3& color, float radius,
@@ -64,14 +57,31 @@ FwdLightCaster::Handle FwdLightCaster::createPointLight(const glm::vec3& positio
 	return createPointLight(position, color.r, radius, enableShadow);
 }
 
+FwdLightCaster::Handle FwdLightCaster::createSpotLight(const glm::vec3& position, const glm::vec3& direction,
+													   const glm::vec3& color, float radius, float innerAngle,
+													   float outerAngle, bool enableShadow)
+{
+	auto handle = spotLights->createLight(position, direction, color, radius, innerAngle, outerAngle, enableShadow);
+	if (handle == fwd::SpotLightCaster::INVALID_HANDLE)
+	{
+		return 0;
+	}
+
+	return lights.add({Type::SPOT, handle});
+}
+
 void FwdLightCaster::setPosition(Handle handle, const glm::vec3& position)
 {
-	HandleExposed exposed = reinterpret_cast<HandleExposed&>(handle);
-	Type type = static_cast<Type>(exposed.type);
+	const LightRef& ref = getLightRef(handle);
+	Type type = ref.type;
 	switch (type)
 	{
 	case Type::POINT: {
-		pointLights->getLight(exposed.idx)->position = position;
+		pointLights->getLight(ref.idx)->position = position;
+	};
+	break;
+	case Type::SPOT: {
+		spotLights->getLight(ref.idx)->position = position;
 	};
 	break;
 	case Type::DIRECTIONAL: {
@@ -85,8 +95,8 @@ void FwdLightCaster::setPosition(Handle handle, const glm::vec3& position)
 
 void FwdLightCaster::setDirection(Handle handle, const glm::vec3& direction)
 {
-	HandleExposed exposed = reinterpret_cast<HandleExposed&>(handle);
-	Type type = static_cast<Type>(exposed.type);
+	const LightRef& ref = getLightRef(handle);
+	Type type = ref.type;
 	switch (type)
 	{
 	case Type::POINT: {
@@ -94,7 +104,11 @@ void FwdLightCaster::setDirection(Handle handle, const glm::vec3& direction)
 	};
 	break;
 	case Type::DIRECTIONAL: {
-		directionLights->getLight(exposed.idx)->direction = glm::normalize(direction);
+		directionLights->getLight(ref.idx)->direction = glm::normalize(direction);
+	}
+	break;
+	case Type::SPOT: {
+		spotLights->getLight(ref.idx)->direction = glm::normalize(direction);
 	}
 	break;
 	default:
@@ -106,12 +120,16 @@ void FwdLightCaster::setColor(Handle handle, const glm::vec3& color)
 {
 	assert(color.x >= 0.0f && color.y >= 0.0f && color.z >= 0.0f);
 
-	HandleExposed exposed = reinterpret_cast<HandleExposed&>(handle);
-	Type type = static_cast<Type>(exposed.type);
+	const LightRef& ref = getLightRef(handle);
+	Type type = ref.type;
 	switch (type)
 	{
 	case Type::POINT: {
-		pointLights->getLight(exposed.idx)->color = color;
+		pointLights->getLight(ref.idx)->color = color;
+	};
+	break;
+	case Type::SPOT: {
+		spotLights->getLight(ref.idx)->color = color;
 	};
 	break;
 	case Type::DIRECTIONAL: {
@@ -127,8 +145,8 @@ void FwdLightCaster::setBrightness(Handle handle, float brightness)
 {
 	assert(brightness >= 0.0f);
 
-	HandleExposed exposed = reinterpret_cast<HandleExposed&>(handle);
-	Type type = static_cast<Type>(exposed.type);
+	const LightRef& ref = getLightRef(handle);
+	Type type = ref.type;
 	switch (type)
 	{
 	case Type::POINT: {
@@ -136,7 +154,7 @@ void FwdLightCaster::setBrightness(Handle handle, float brightness)
 	};
 	break;
 	case Type::DIRECTIONAL: {
-		directionLights->getLight(exposed.idx)->brightness = brightness;
+		directionLights->getLight(ref.idx)->brightness = brightness;
 	}
 	break;
 	default:
@@ -146,16 +164,43 @@ void FwdLightCaster::setBrightness(Handle handle, float brightness)
 
 bool FwdLightCaster::setShadow(Handle handle, bool hasShadow)
 {
-	HandleExposed exposed = reinterpret_cast<HandleExposed&>(handle);
-	Type type = static_cast<Type>(exposed.type);
+	const LightRef& ref = getLightRef(handle);
+	Type type = ref.type;
+	switch (type)
+	{
+	case Type::POINT: {
+		return pointLights->setShadow(ref.idx, hasShadow);
+	};
+	break;
+	case Type::SPOT: {
+		return spotLights->setShadow(ref.idx, hasShadow);
+	};
+	break;
+	case Type::DIRECTIONAL: {
+		return directionLights->setShadow(ref.idx, hasShadow);
+	}
+	break;
+	default:
+		throw std::invalid_argument("Unimplemented");
+	}
+}
+
+void FwdLightCaster::setDualParaboloid(Handle handle, bool enable)
+{
+	const LightRef& ref = getLightRef(handle);
+	Type type = ref.type;
 	switch (type)
 	{
 	case Type::POINT: {
-		return pointLights->setShadow(exposed.idx, hasShadow);
+		pointLights->setDualParaboloid(ref.idx, enable);
 	};
 	break;
+	case Type::SPOT: {
+		throw std::invalid_argument("Spot light shadows are a single view");
+	}
+	break;
 	case Type::DIRECTIONAL: {
-		return directionLights->setShadow(exposed.idx, hasShadow);
+		throw std::invalid_argument("Directional light shadows are cascades");
 	}
 	break;
 	default:
@@ -165,12 +210,16 @@ bool FwdLightCaster::setShadow(Handle handle, bool hasShadow)
 
 void FwdLightCaster::setRadius(Handle handle, float radius)
 {
-	HandleExposed exposed = reinterpret_cast<HandleExposed&>(handle);
-	Type type = static_cast<Type>(exposed.type);
+	const LightRef& ref = getLightRef(handle);
+	Type type = ref.type;
 	switch (type)
 	{
 	case Type::POINT: {
-		pointLights->getLight(exposed.idx)->radius = radius;
+		pointLights->getLight(ref.idx)->radius = radius;
+	};
+	break;
+	case Type::SPOT: {
+		spotLights->getLight(ref.idx)->radius = radius;
 	};
 	break;
 	case Type::DIRECTIONAL: {
@@ -184,33 +233,45 @@ void FwdLightCaster::setRadius(Handle handle, float radius)
 
 void FwdLightCaster::removeLight(Handle handle)
 {
-	if (validHandles.find(handle) == validHandles.end())
+	const LightRef* ref = lights.get(handle);
+	if (ref == nullptr)
 	{
 		return;
 	}
 
-	HandleExposed exposed = reinterpret_cast<HandleExposed&>(handle);
-	uint32_t idx = static_cast<uint32_t>(exposed.idx);
-	Type type = static_cast<Type>(exposed.type);
-	switch (type)
+	switch (ref->type)
 	{
 	case Type::POINT:
-		pointLights->removeLight(idx);
+		pointLights->removeLight(ref->idx);
 		break;
 	case Type::DIRECTIONAL:
-		directionLights->removeLight(idx);
+		directionLights->removeLight(ref->idx);
+		break;
+	case Type::SPOT:
+		spotLights->removeLight(ref->idx);
 		break;
 	default:
 		throw std::invalid_argument("Only point lights are supported so far");
 	}
 
-	validHandles.erase(handle);
+	lights.remove(handle);
+}
+
+const FwdLightCaster::LightRef& FwdLightCaster::getLightRef(Handle handle) const
+{
+	const LightRef* ref = lights.get(handle);
+	if (ref == nullptr)
+	{
+		throw std::invalid_argument("Stale light handle " + std::to_string(handle));
+	}
+	return *ref;
 }
 
 void FwdLightCaster::update(const Camera* camera, uint32_t frame)
 {
 	pointLights->update(frame);
 	directionLights->update(camera, frame);
+	spotLights->update(frame);
 }
 
 uint32_t FwdLightCaster::getMaxPointLights()
@@ -227,6 +288,7 @@ void FwdLightCaster::cast(VkCommandBuffer cmd, const std::vector<Drawable*>& dra
 {
 	pointLights->cast(cmd, drawables);
 	directionLights->cast(cmd, drawables);
+	spotLights->cast(cmd, drawables);
 }
 
 
@@ -239,18 +301,7 @@ FwdLightCaster::Handle FwdLightCaster::createDirectionLight(const glm::vec3& dir
 		return 0;
 	}
 
-	HandleExposed exposed = {
-		static_cast<uint8_t>(Type::DIRECTIONAL),
-		directionGeneration,
-		idx,
-	};
-
-	directionGeneration = directionGeneration + 1;
-
-	Handle handle = reinterpret_cast<Handle&>(exposed);
-	validHandles.insert(handle);
-
-	return handle;
+	return lights.add({Type::DIRECTIONAL, idx});
 }
 
 uint32_t FwdLightCaster::getMaxDirectionLights()
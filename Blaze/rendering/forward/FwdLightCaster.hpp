@@ -6,17 +6,17 @@
 #include <core/UniformBuffer.hpp>
 #include <rendering/ALightCaster.hpp>
 #include <spirv/PipelineFactory.hpp>
-#include <util/PackedHandler.hpp>
+#include <util/SlotMap.hpp>
 #include <core/Camera.hpp>
 
 #include "PointLightCaster.hpp"
 #include "DirectionLightCaster.hpp"
+#include "SpotLightCaster.hpp"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 
-#include <set>
 
 namespace blaze
 {
@@ -28,16 +28,23 @@ private:
 
 	std::unique_ptr<fwd::PointLightCaster> pointLights;
 	std::unique_ptr<fwd::DirectionLightCaster> directionLights;
-	uint8_t pointGeneration;
-	uint8_t directionGeneration;
-	std::set<Handle> validHandles;
+	std::unique_ptr<fwd::SpotLightCaster> spotLights;
 
-	struct HandleExposed
+	/**
+	 * @brief The caster and index of the light behind a Handle.
+	 */
+	struct LightRef
 	{
-		uint8_t type;
-		uint8_t gen;
-		uint16_t idx;
+		Type type;
+		/// Index of the light in the caster of its type, or its handle for a spot light.
+		uint32_t idx;
 	};
+	util::SlotMap<LightRef> lights;
+
+	/**
+	 * @brief Resolves \a handle, throwing std::invalid_argument if it is stale.
+	 */
+	const LightRef& getLightRef(Handle handle) const;
 
 public:
 	FwdLightCaster(const Context* context, const spirv::Shader* shader, uint32_t frames) noexcept;
@@ -51,12 +58,15 @@ public:
 									bool enableShadow) override;
 	virtual Handle createPointLight(const glm::vec3& position, const glm::vec3& color, float radius,
 									bool enableShadow) override;
+	virtual Handle createSpotLight(const glm::vec3& position, const glm::vec3& direction, const glm::vec3& color,
+								   float radius, float innerAngle, float outerAngle, bool enableShadow) override;
 	virtual void removeLight(Handle handle) override;
 	virtual void setPosition(Handle handle, const glm::vec3& position) override;
 	virtual void setDirection(Handle handle, const glm::vec3& direction) override;
 	virtual void setColor(Handle handle, const glm::vec3& color) override;
 	virtual void setBrightness(Handle handle, float brightness) override;
 	virtual bool setShadow(Handle handle, bool hasShadow) override;
+	virtual void setDualParaboloid(Handle handle, bool enable) override;
 	virtual void setRadius(Handle handle, float radius) override;
 	virtual void update(const Camera* camera, uint32_t frame) override;
 	virtual uint32_t getMaxPointLights() override;
@@ -33,7 +33,7 @@ FwdRenderer::FwdRenderer(GLFWwindow* window, bool enableValidationLayers) noexce
 	// Skybox mesh
 	skyboxCube = getUVCube(context.get());
 	// Environment
-	environmentSet = context->get_pipelineFactory()->createSet(*shader.getSetWithUniform("skybox"));
+	environmentSet = createEnvironmentSet();
 
 	// Lights
 	lightCaster = std::make_unique<FwdLightCaster>(context.get(), &shader, maxFrameInFlight);
@@ -65,6 +65,11 @@ spirv::SetSingleton* FwdRenderer::get_environmentSet()
 	return &environmentSet;
 }
 
+spirv::SetSingleton FwdRenderer::createEnvironmentSet()
+{
+	return context->get_pipelineFactory()->createSet(*shader.getSetWithUniform("skybox"));
+}
+
 void FwdRenderer::update(uint32_t frame)
 {
 	lightCaster->update(camera, frame);
@@ -76,6 +81,11 @@ void FwdRenderer::recordCommands(uint32_t frame)
 {
 	OPTICK_EVENT();
 
+	for (Drawable* drawable : drawables)
+	{
+		drawable->upload(commandBuffers[frame]);
+	}
+
 	lightCaster->cast(commandBuffers[frame], drawables.get_data());
 
 	auto& extent = swapchain->get_extent();
@@ -104,13 +114,14 @@ void FwdRenderer::recordCommands(uint32_t frame)
 							environmentSet.setIdx, 1, &environmentSet.get(), 0, nullptr);
 	vkCmdBindDescriptorSets(commandBuffers[frame], VK_PIPELINE_BIND_POINT_GRAPHICS, shader.pipelineLayout.get(),
 							cameraSets.setIdx, 1, &cameraSets[frame], 0, nullptr);
+	uint32_t objectSet = shader.getSetWithUniform("nodeTransforms")->set;
 	for (Drawable* drawable : drawables)
 	{
-		drawable->drawOpaque(commandBuffers[frame], shader.pipelineLayout.get());
+		drawable->drawOpaque(commandBuffers[frame], shader.pipelineLayout.get(), objectSet);
 	}
 	for (Drawable* drawable : drawables)
 	{
-		drawable->drawAlphaBlended(commandBuffers[frame], shader.pipelineLayout.get());
+		drawable->drawAlphaBlended(commandBuffers[frame], shader.pipelineLayout.get(), objectSet);
 	}
 
 	skyboxPipeline.bind(commandBuffers[frame]);
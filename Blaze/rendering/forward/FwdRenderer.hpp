@@ -112,6 +112,7 @@ protected:
 	virtual void recreateSwapchainDependents() override;
 
 	virtual spirv::SetSingleton* get_environmentSet() override;
+	virtual spirv::SetSingleton createEnvironmentSet() override;
 
 private:
 	spirv::RenderPass createRenderpass();
@@ -1,7 +1,6 @@
 
 #include "PointLightCaster.hpp"
-
-#include <util/files.hpp>
+#include "ShadowPass.hpp"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -17,10 +16,15 @@ namespace blaze::fwd
 {
 PointLightCaster::PointLightCaster(const Context* context, const spirv::SetVector& sets,
 								   const spirv::SetSingleton& texSet) noexcept
+	: context(context), textureSet(&texSet)
 {
-	renderPass = createRenderPass(context);
-	shadowShader = createShader(context);
-	shadowPipeline = createPipeline(context);
+	renderPass = createShadowRenderPass(context, 0b111111);
+	shadowShader = createShadowShader(context, vertShaderFileName, fragShaderFileName);
+	shadowPipeline = createShadowPipeline(context, shadowShader, renderPass);
+
+	paraboloidRenderPass = createShadowRenderPass(context, 0b11);
+	paraboloidShader = createShadowShader(context, paraboloidVertShaderFileName, paraboloidFragShaderFileName);
+	paraboloidPipeline = createShadowPipeline(context, paraboloidShader, paraboloidRenderPass);
 
 	auto uniform = sets.getUniform(dataUniformName);
 	maxLights = uniform->size / static_cast<uint32_t>(sizeof(LightData));
@@ -28,31 +32,35 @@ PointLightCaster::PointLightCaster(const Context* context, const spirv::SetVecto
 	ubos = UBODataVector(context, uniform->size, sets.size());
 	count = 0;
 
-	int i = -1;
+	// The free lights are chained through their negative radius, -(next + 1), ending at maxLights.
+	int i = -2;
 	for (auto& light : lights)
 	{
 		light.position = glm::vec3(0);
 		light.radius = static_cast<float>(i);
 		light.color = glm::vec3(1.0f);
 		light.shadowIdx = -1;
+		light.dualParaboloid = 0;
 		i--;
 	}
-	i = std::numeric_limits<int>::min();
-	lights.back().radius = static_cast<float>(i);
 	freeLight = 0;
 
 	uniform = texSet.getUniform(textureUniformName);
 	maxShadows = uniform->arrayLength;
 
+	shadows.reserve(maxShadows);
+	freeShadows.reserve(maxShadows);
 	for (uint32_t i = 0; i < maxShadows; ++i)
 	{
-		auto& shadow = shadows.emplace_back(context, renderPass, OMNI_MAP_RESOLUTION);
-		shadow.next = i + 1;
+		shadows.emplace_back(context, renderPass, OMNI_MAP_RESOLUTION);
+		// Popped from the back, so the first shadows are used first.
+		freeShadows.push_back(maxShadows - 1 - i);
 	}
-	shadows.back().next = -1;
-	freeShadow = 0;
+	shadowCount = 0;
+	emptyCubeMap = PointShadow::createCubeMap(context, 1);
+	emptyParaboloidMap = PointShadow::createParaboloidMap(context, 1);
 
-	bindDataSet(context, sets);
+	bindLightData(context, sets, dataUniformName, ubos);
 	bindTextureSet(context, texSet);
 
 	CubemapUBlock block = {
@@ -94,14 +102,14 @@ PointLightCaster::PointLightCaster(const Context* context, const spirv::SetVecto
 
 void PointLightCaster::recreate(const Context* context, const spirv::SetVector& sets)
 {
-	ubos = UBODataVector(context, maxLights * sizeof(LightData), sets.size());
+	ubos = UBODataVector(context, sets.getUniform(dataUniformName)->size, sets.size());
 
 	for (uint32_t i = 0; i < sets.size(); ++i)
 	{
 		update(i);
 	}
 
-	bindDataSet(context, sets);
+	bindLightData(context, sets, dataUniformName, ubos);
 }
 
 void PointLightCaster::update(uint32_t frame)
@@ -111,7 +119,7 @@ void PointLightCaster::update(uint32_t frame)
 
 uint16_t PointLightCaster::createLight(const glm::vec3& position, float brightness, float radius, bool enableShadow)
 {
-	if (freeLight < 0)
+	if (freeLight >= static_cast<int>(maxLights))
 	{
 		return UINT16_MAX;
 	}
@@ -119,16 +127,21 @@ uint16_t PointLightCaster::createLight(const glm::vec3& position, float brightne
 	LightData* pLight = &lights[freeLight];
 	uint16_t idx = static_cast<uint16_t>(freeLight);
 
-	freeLight = -static_cast<int>(pLight->radius);
+	freeLight = -static_cast<int>(pLight->radius) - 1;
 
 	pLight->position = position;
 	pLight->color = glm::vec3(brightness);
 	pLight->radius = radius;
 	pLight->shadowIdx = -1;
+	pLight->dualParaboloid = 0;
 	if (enableShadow)
 	{
 		pLight->shadowIdx = createShadow();
-		shadows[pLight->shadowIdx].next = idx;
+		if (pLight->shadowIdx >= 0)
+		{
+			shadows[pLight->shadowIdx].light = idx;
+			setShadowMode(pLight->shadowIdx, false);
+		}
 	}
 
 	count++;
@@ -144,12 +157,12 @@ void PointLightCaster::removeLight(uint16_t idx)
 
 	assert(pLight->radius > 0);
 
-	pLight->radius = -static_cast<float>(freeLight);
+	pLight->radius = -static_cast<float>(freeLight + 1);
 	pLight->position = glm::vec3(0.0f);
 
 	if (pLight->shadowIdx >= 0)
 	{
-		assert(shadows[pLight->shadowIdx].next == idx);
+		assert(shadows[pLight->shadowIdx].light == idx);
 		removeShadow(pLight->shadowIdx);
 	}
 
@@ -176,7 +189,8 @@ bool PointLightCaster::setShadow(uint16_t idx, bool enableShadow)
 		pLight->shadowIdx = createShadow();
 		if (pLight->shadowIdx >= 0)
 		{
-			shadows[pLight->shadowIdx].next = idx;
+			shadows[pLight->shadowIdx].light = idx;
+			setShadowMode(pLight->shadowIdx, pLight->dualParaboloid != 0);
 			return true;
 		}
 	}
@@ -188,14 +202,43 @@ bool PointLightCaster::setShadow(uint16_t idx, bool enableShadow)
 	return false;
 }
 
+void PointLightCaster::setDualParaboloid(uint16_t idx, bool enable)
+{
+	assert(idx < maxLights);
+
+	LightData* pLight = &lights[idx];
+
+	assert(pLight->radius > 0);
+
+	pLight->dualParaboloid = enable ? 1 : 0;
+	if (pLight->shadowIdx >= 0)
+	{
+		setShadowMode(pLight->shadowIdx, enable);
+	}
+}
+
+void PointLightCaster::setShadowMode(int shadowIdx, bool dualParaboloid)
+{
+	PointShadow& shadow = shadows[shadowIdx];
+	if (shadow.dualParaboloid == dualParaboloid)
+	{
+		return;
+	}
+
+	// The old map may still be drawn or sampled by the frames in flight, and its descriptors are in use.
+	vkDeviceWaitIdle(context->get_device());
+	shadow.setDualParaboloid(context, dualParaboloid ? paraboloidRenderPass : renderPass, dualParaboloid);
+	bindShadow(shadowIdx);
+}
+
 int PointLightCaster::createShadow()
 {
-	if (freeShadow < 0)
+	if (freeShadows.empty())
 	{
 		return -1;
 	}
-	auto i = freeShadow;
-	freeShadow = shadows[i].next;
+	int i = freeShadows.back();
+	freeShadows.pop_back();
 	shadowCount++;
 
 	return i;
@@ -203,19 +246,57 @@ int PointLightCaster::createShadow()
 
 void PointLightCaster::removeShadow(int idx)
 {
-	shadows[idx].next = freeShadow;
-	freeShadow = idx;
+	freeShadows.push_back(idx);
 	shadowCount--;
 }
 
 void PointLightCaster::cast(VkCommandBuffer cmd, const std::vector<Drawable*>& drawables)
 {
 	OPTICK_EVENT();
+	uint32_t objectSet = shadowShader.getSetWithUniform("nodeTransforms")->set;
+	uint32_t paraboloidObjectSet = paraboloidShader.getSetWithUniform("nodeTransforms")->set;
+	std::vector<Drawable*> casters;
 	for (auto& light : lights)
 	{
 		if (light.shadowIdx < 0)
 			continue;
 		PointShadow* shadow = &shadows[light.shadowIdx];
+		assert(shadow->dualParaboloid == (light.dualParaboloid != 0));
+
+		// Only the casters in the light's sphere.
+		const auto sphere = ClusterCuller::createSphere(light.position, light.radius);
+		casters.clear();
+		for (Drawable* d : drawables)
+		{
+			if (ClusterCuller::intersects(sphere, d->get_bounds()))
+			{
+				casters.push_back(d);
+			}
+		}
+
+		if (light.dualParaboloid)
+		{
+			// Two views of the hemispheres instead of the six faces, with no projection.
+			PointShadow::PCB pcb = {
+				light.position,
+				light.radius,
+				0.0f,
+				0.0f,
+			};
+
+			paraboloidRenderPass.begin(cmd, shadow->framebuffer);
+			paraboloidPipeline.bind(cmd);
+			vkCmdSetViewport(cmd, 0, 1, &shadow->viewport);
+			vkCmdSetScissor(cmd, 0, 1, &shadow->scissor);
+			vkCmdPushConstants(cmd, paraboloidShader.pipelineLayout.get(), paraboloidShader.pushConstant.stage, 0,
+							   sizeof(PointShadow::PCB), &pcb);
+			for (Drawable* d : casters)
+			{
+				d->drawGeometry(cmd, paraboloidShader.pipelineLayout.get(), paraboloidObjectSet);
+			}
+			paraboloidRenderPass.end(cmd);
+			continue;
+		}
 
 		renderPass.begin(cmd, shadow->framebuffer);
 
@@ -236,180 +317,85 @@ void PointLightCaster::cast(VkCommandBuffer cmd, const std::vector<Drawable*>& d
 		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, shadowShader.pipelineLayout.get(), viewSet.setIdx,
 								1, &viewSet.get(), 0, nullptr);
 		vkCmdPushConstants(cmd, shadowShader.pipelineLayout.get(), shadowShader.pushConstant.stage,
-						   sizeof(ModelPushConstantBlock), sizeof(PointShadow::PCB), &pcb);
-		for (Drawable* d : drawables)
+						   0, sizeof(PointShadow::PCB), &pcb);
+		for (Drawable* d : casters)
 		{
-			d->drawGeometry(cmd, shadowShader.pipelineLayout.get());
+			d->drawGeometry(cmd, shadowShader.pipelineLayout.get(), objectSet);
 		}
 
 		renderPass.end(cmd);
 	}
 }
 
-void PointLightCaster::bindDataSet(const Context* context, const spirv::SetVector& sets)
-{
-	const spirv::UniformInfo* unif = sets.getUniform(dataUniformName);
-
-	for (uint32_t i = 0; i < sets.size(); i++)
-	{
-		VkDescriptorBufferInfo info = ubos[i].get_descriptorInfo();
-
-		VkWriteDescriptorSet write = {};
-		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		write.descriptorType = unif->type;
-		write.descriptorCount = unif->arrayLength;
-		write.dstSet = sets[i];
-		write.dstBinding = unif->binding;
-		write.dstArrayElement = 0;
-		write.pBufferInfo = &info;
-
-		vkUpdateDescriptorSets(context->get_device(), 1, &write, 0, nullptr);
-	}
-}
-
 void PointLightCaster::bindTextureSet(const Context* context, const spirv::SetSingleton& set)
 {
-	const spirv::UniformInfo* unif = set.getUniform(textureUniformName);
-
 	std::vector<VkDescriptorImageInfo> infos;
+	std::vector<VkDescriptorImageInfo> paraboloidInfos;
 	infos.reserve(maxShadows);
+	paraboloidInfos.reserve(maxShadows);
 	for (auto& shadow : shadows)
 	{
-		infos.push_back(shadow.shadowMap.get_imageInfo());
+		infos.push_back(shadow.dualParaboloid ? emptyCubeMap.get_imageInfo() : shadow.shadowMap.get_imageInfo());
+		paraboloidInfos.push_back(shadow.dualParaboloid ? shadow.paraboloidMap.get_imageInfo()
+														: emptyParaboloidMap.get_imageInfo());
 	}
 
-	VkWriteDescriptorSet write = {};
-	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-	write.descriptorType = unif->type;
-	write.descriptorCount = unif->arrayLength;
-	write.dstSet = set.get();
-	write.dstBinding = unif->binding;
-	write.dstArrayElement = 0;
-	write.pImageInfo = infos.data();
-
-	vkUpdateDescriptorSets(context->get_device(), 1, &write, 0, nullptr);
+	bindShadowMaps(context, set, textureUniformName, infos);
+	bindShadowMaps(context, set, paraboloidUniformName, paraboloidInfos);
 }
 
-spirv::RenderPass PointLightCaster::createRenderPass(const Context* context)
+void PointLightCaster::bindShadow(uint32_t shadowIdx)
 {
-	using namespace spirv;
-
-	std::vector<AttachmentFormat> format(1);
-	format[0].usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-	format[0].format = VK_FORMAT_D32_SFLOAT;
-	format[0].sampleCount = VK_SAMPLE_COUNT_1_BIT;
-	format[0].loadStoreConfig = LoadStoreConfig(LoadStoreConfig::LoadAction::CLEAR, LoadStoreConfig::StoreAction::READ);
-
-	VkAttachmentReference depthRef = {};
-	depthRef.attachment = 0;
-	depthRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-	std::vector<VkSubpassDescription> subpass(1);
-	subpass[0].pDepthStencilAttachment = &depthRef;
-	subpass[0].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-	subpass[0].inputAttachmentCount = 0;
-	subpass[0].pInputAttachments = nullptr;
-	subpass[0].colorAttachmentCount = 0;
-	subpass[0].pColorAttachments = nullptr;
-	subpass[0].preserveAttachmentCount = 0;
-	subpass[0].pPreserveAttachments = nullptr;
-	subpass[0].pResolveAttachments = nullptr;
-	subpass[0].flags = 0;
-
-	uint32_t viewmask = 0b111111;
-
-	VkRenderPassMultiviewCreateInfo multiview = {};
-	multiview.sType = VK_STRUCTURE_TYPE_RENDER_PASS_MULTIVIEW_CREATE_INFO;
-	multiview.pNext = nullptr;
-	multiview.subpassCount = 1;
-	multiview.pViewMasks = &viewmask;
-	multiview.correlationMaskCount = 0;
-	multiview.pCorrelationMasks = nullptr;
-	multiview.dependencyCount = 0;
-	multiview.pViewOffsets = nullptr;
-
-	VkClearValue clear = {};
-	clear.depthStencil = {1.0f, 0};
-
-	auto rp = context->get_pipelineFactory()->createRenderPass(format, subpass, &multiview);
-	rp.clearValues = {clear};
-	return std::move(rp);
+	const PointShadow& shadow = shadows[shadowIdx];
+	bindShadowMaps(context, *textureSet, textureUniformName,
+				   {shadow.dualParaboloid ? emptyCubeMap.get_imageInfo() : shadow.shadowMap.get_imageInfo()},
+				   shadowIdx);
+	bindShadowMaps(context, *textureSet, paraboloidUniformName,
+				   {shadow.dualParaboloid ? shadow.paraboloidMap.get_imageInfo() : emptyParaboloidMap.get_imageInfo()},
+				   shadowIdx);
 }
 
-spirv::Shader PointLightCaster::createShader(const Context* context)
+// Point Shadow 2
+PointShadow::PointShadow(const Context* context, const spirv::RenderPass& renderPass, uint32_t mapResolution) noexcept
 {
-	std::vector<spirv::ShaderStageData> stages;
+	shadowMap = createCubeMap(context, mapResolution);
+
+	viewport = VkViewport{0.0f,
+						  static_cast<float>(mapResolution),
+						  static_cast<float>(mapResolution),
+						  -static_cast<float>(mapResolution),
+						  0.0f,
+						  1.0f};
 
-	spirv::ShaderStageData* stage;
-	stage = &stages.emplace_back();
-	stage->spirv = util::loadBinaryFile(vertShaderFileName);
-	stage->stage = VK_SHADER_STAGE_VERTEX_BIT;
+	scissor.offset = {0, 0};
+	scissor.extent = {mapResolution, mapResolution};
 
-	stage = &stages.emplace_back();
-	stage->spirv = util::loadBinaryFile(fragShaderFileName);
-	stage->stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	std::vector<VkImageView> attachments = {shadowMap.get_imageView()};
 
-	return context->get_pipelineFactory()->createShader(stages);
+	framebuffer = context->get_pipelineFactory()->createFramebuffer(renderPass, scissor.extent, attachments);
 }
 
-spirv::Pipeline PointLightCaster::createPipeline(const Context* context)
+void PointShadow::setDualParaboloid(const Context* context, const spirv::RenderPass& renderPass, bool enable)
 {
-	assert(shadowShader.valid());
-	assert(renderPass.valid());
-
-	spirv::GraphicsPipelineCreateInfo info = {};
-
-	info.inputAssemblyCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-	info.inputAssemblyCreateInfo.flags = 0;
-	info.inputAssemblyCreateInfo.pNext = nullptr;
-	info.inputAssemblyCreateInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-	info.inputAssemblyCreateInfo.primitiveRestartEnable = VK_FALSE;
-
-	info.rasterizerCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-	info.rasterizerCreateInfo.rasterizerDiscardEnable = VK_FALSE;
-	info.rasterizerCreateInfo.polygonMode = VK_POLYGON_MODE_FILL;
-	info.rasterizerCreateInfo.lineWidth = 1.0f;
-	info.rasterizerCreateInfo.cullMode = VK_CULL_MODE_BACK_BIT;
-	info.rasterizerCreateInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-	info.rasterizerCreateInfo.depthBiasEnable = VK_TRUE;
-	info.rasterizerCreateInfo.depthClampEnable = VK_FALSE;
-	info.rasterizerCreateInfo.pNext = nullptr;
-	info.rasterizerCreateInfo.flags = 0;
-
-	info.multisampleCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-	info.multisampleCreateInfo.sampleShadingEnable = VK_FALSE;
-	info.multisampleCreateInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-
-	info.colorblendCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-	info.colorblendCreateInfo.logicOpEnable = VK_FALSE;
-	info.colorblendCreateInfo.attachmentCount = 0;
-	info.colorblendCreateInfo.pAttachments = nullptr;
-
-	info.depthStencilCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-	info.depthStencilCreateInfo.depthTestEnable = VK_TRUE;
-	info.depthStencilCreateInfo.depthWriteEnable = VK_TRUE;
-	info.depthStencilCreateInfo.depthCompareOp = VK_COMPARE_OP_LESS;
-	info.depthStencilCreateInfo.depthBoundsTestEnable = VK_FALSE;
-	info.depthStencilCreateInfo.maxDepthBounds = 0.0f; // Don't care
-	info.depthStencilCreateInfo.minDepthBounds = 1.0f; // Don't care
-	info.depthStencilCreateInfo.stencilTestEnable = VK_FALSE;
-	info.depthStencilCreateInfo.front = {}; // Don't Care
-	info.depthStencilCreateInfo.back = {};	// Don't Care
-
-	std::vector<VkDynamicState> dynamicStates = {
-		VK_DYNAMIC_STATE_VIEWPORT,
-		VK_DYNAMIC_STATE_SCISSOR,
-	};
-
-	info.dynamicStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-	info.dynamicStateCreateInfo.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
-	info.dynamicStateCreateInfo.pDynamicStates = dynamicStates.data();
-
-	return context->get_pipelineFactory()->createGraphicsPipeline(shadowShader, renderPass, info);
+	dualParaboloid = enable;
+	std::vector<VkImageView> attachments;
+	if (enable)
+	{
+		shadowMap = TextureCube();
+		paraboloidMap = createParaboloidMap(context, scissor.extent.width);
+		// The array view of both layers.
+		attachments = {paraboloidMap.get_allImageViews()};
+	}
+	else
+	{
+		paraboloidMap = Texture2D();
+		shadowMap = createCubeMap(context, scissor.extent.width);
+		attachments = {shadowMap.get_imageView()};
+	}
+	framebuffer = context->get_pipelineFactory()->createFramebuffer(renderPass, scissor.extent, attachments);
 }
 
-// Point Shadow 2
-PointShadow::PointShadow(const Context* context, const spirv::RenderPass& renderPass, uint32_t mapResolution) noexcept
+TextureCube PointShadow::createCubeMap(const Context* context, uint32_t mapResolution)
 {
 	ImageDataCube idc{};
 	idc.height = mapResolution;
@@ -422,21 +408,25 @@ PointShadow::PointShadow(const Context* context, const spirv::RenderPass& render
 	idc.format = VK_FORMAT_D32_SFLOAT;
 	idc.aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
 	idc.access = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-	shadowMap = TextureCube(context, idc, false);
-
-	viewport = VkViewport{0.0f,
-						  static_cast<float>(mapResolution),
-						  static_cast<float>(mapResolution),
-						  -static_cast<float>(mapResolution),
-						  0.0f,
-						  1.0f};
-
-	scissor.offset = {0, 0};
-	scissor.extent = {mapResolution, mapResolution};
-
-	std::vector<VkImageView> attachments = {shadowMap.get_imageView()};
+	return TextureCube(context, idc, false);
+}
 
-	framebuffer = context->get_pipelineFactory()->createFramebuffer(renderPass, scissor.extent, attachments);
+Texture2D PointShadow::createParaboloidMap(const Context* context, uint32_t mapResolution)
+{
+	ImageData2D id2d{};
+	id2d.height = mapResolution;
+	id2d.width = mapResolution;
+	id2d.numChannels = 1;
+	id2d.size = mapResolution * mapResolution;
+	id2d.layerCount = 2;
+	id2d.anisotropy = VK_FALSE;
+	id2d.samplerAddressMode = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	id2d.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	id2d.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+	id2d.format = VK_FORMAT_D32_SFLOAT;
+	id2d.aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+	id2d.access = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	return Texture2D(context, id2d, false);
 }
 
-} // namespace blaze
\ No newline at end of file
+} // namespace blaze
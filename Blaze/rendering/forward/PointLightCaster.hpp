@@ -3,6 +3,7 @@
 
 #include <core/Context.hpp>
 #include <core/Drawable.hpp>
+#include <core/Texture2D.hpp>
 #include <core/TextureCube.hpp>
 #include <core/UniformBuffer.hpp>
 #include <spirv/PipelineFactory.hpp>
@@ -15,7 +16,9 @@ namespace blaze::fwd
  * @brief Encapsulates the attachments and framebuffer for a point light shadow.
  *
  * Contains the shadowMap (D32) along with the framebuffer and
- * viewport configured.
+ * viewport configured. While the light has a dual paraboloid shadow,
+ * the paraboloidMap of the two hemispheres replaces the shadowMap.
+ * Only the map of the current mode is allocated, the other is empty.
  *
  * @note Not supposed to be used externally.
  *
@@ -24,10 +27,14 @@ namespace blaze::fwd
 struct PointShadow
 {
 	TextureCube shadowMap;
+	Texture2D paraboloidMap;
+	/// The framebuffer of the map of the current mode.
 	spirv::Framebuffer framebuffer;
 	VkRect2D scissor;
 	VkViewport viewport;
-	uint16_t next;
+	bool dualParaboloid{false};
+	/// The light casting the shadow.
+	uint16_t light;
 	
 	struct PCB
 	{
@@ -38,6 +45,17 @@ struct PointShadow
 	};
 
 	PointShadow(const Context* context, const spirv::RenderPass& renderPass, uint32_t mapResolution) noexcept;
+
+	/**
+	 * @brief Replaces the map with the map of the other mode.
+	 *
+	 * @param renderPass The render pass drawing the new map.
+	 */
+	void setDualParaboloid(const Context* context, const spirv::RenderPass& renderPass, bool enable);
+
+	static TextureCube createCubeMap(const Context* context, uint32_t mapResolution);
+	/// The hemispheres around +z and -z, as layers drawn by the two views.
+	static Texture2D createParaboloidMap(const Context* context, uint32_t mapResolution);
 };
 /**
  * @endcond
@@ -54,33 +72,53 @@ private:
 		alignas(4) float radius;
 		alignas(16) glm::vec3 color;
 		alignas(4) int shadowIdx;
+		/// Non zero if the shadow is drawn to the paraboloidMap instead of the cube.
+		alignas(4) int dualParaboloid;
 	};
 
 	uint32_t maxLights;
 	uint32_t maxShadows;
 
 	uint32_t count;
-	int16_t freeLight;
+	/// The first free light, maxLights if the table is full.
+	int freeLight;
 	std::vector<LightData> lights;
 
 	constexpr static std::string_view dataUniformName = "lights";
 	constexpr static std::string_view textureUniformName = "shadows";
+	constexpr static std::string_view paraboloidUniformName = "pointParaboloidShadows";
 
 	constexpr static std::string_view vertShaderFileName = "shaders/forward/vPointShadow.vert.spv";
 	constexpr static std::string_view fragShaderFileName = "shaders/forward/fPointShadow.frag.spv";
+	constexpr static std::string_view paraboloidVertShaderFileName =
+		"shaders/forward/vPointParaboloidShadow.vert.spv";
+	constexpr static std::string_view paraboloidFragShaderFileName =
+		"shaders/forward/fPointParaboloidShadow.frag.spv";
 
 	spirv::RenderPass renderPass;
 	spirv::Shader shadowShader;
 	spirv::Pipeline shadowPipeline;
 
+	/// Draws the two hemispheres of a dual paraboloid shadow as two views.
+	spirv::RenderPass paraboloidRenderPass;
+	spirv::Shader paraboloidShader;
+	spirv::Pipeline paraboloidPipeline;
+
 	spirv::SetSingleton viewSet;
 	UBO<CubemapUBlock> viewUBO;
 
 	UBODataVector ubos;
 	
 	uint32_t shadowCount;
-	int freeShadow;
+	std::vector<int> freeShadows;
 	std::vector<PointShadow> shadows;
+	/// Bound to the slots of the mode a shadow isn't in, as every element of the arrays must be valid.
+	TextureCube emptyCubeMap;
+	Texture2D emptyParaboloidMap;
+
+	const Context* context;
+	/// The texture set of the FwdLightCaster, rebound when a shadow changes its map.
+	const spirv::SetSingleton* textureSet;
 
 public:
 	PointLightCaster(const Context* context, const spirv::SetVector& sets, const spirv::SetSingleton& texSet) noexcept;
@@ -91,6 +129,13 @@ public:
 	void removeLight(uint16_t idx);
 	bool setShadow(uint16_t idx, bool enableShadow);
 
+	/**
+	 * @brief Switches the shadow of a light between the cube and the two paraboloid hemispheres.
+	 *
+	 * The map of the shadow is replaced, which waits for the GPU to be idle.
+	 */
+	void setDualParaboloid(uint16_t idx, bool enable);
+
 	int createShadow();
 	void removeShadow(int idx);
 
@@ -117,10 +162,8 @@ public:
 	void cast(VkCommandBuffer cmd, const std::vector<Drawable*>& drawables);
 
 private:
-	void bindDataSet(const Context* context, const spirv::SetVector& sets);
 	void bindTextureSet(const Context* context, const spirv::SetSingleton& set);
-	spirv::RenderPass createRenderPass(const Context* context);
-	spirv::Shader createShader(const Context* context);
-	spirv::Pipeline createPipeline(const Context* context);
+	void bindShadow(uint32_t shadowIdx);
+	void setShadowMode(int shadowIdx, bool dualParaboloid);
 };
 } // namespace blaze
\ No newline at end of file
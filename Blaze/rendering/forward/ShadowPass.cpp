@@ -0,0 +1,163 @@
+#include "ShadowPass.hpp"
+
+#include <util/files.hpp>
+
+namespace blaze::fwd
+{
+spirv::RenderPass createShadowRenderPass(const Context* context, uint32_t viewMask)
+{
+	using namespace spirv;
+
+	std::vector<AttachmentFormat> format(1);
+	format[0].usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	format[0].format = VK_FORMAT_D32_SFLOAT;
+	format[0].sampleCount = VK_SAMPLE_COUNT_1_BIT;
+	format[0].loadStoreConfig = LoadStoreConfig(LoadStoreConfig::LoadAction::CLEAR, LoadStoreConfig::StoreAction::READ);
+
+	VkAttachmentReference depthRef = {};
+	depthRef.attachment = 0;
+	depthRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	std::vector<VkSubpassDescription> subpass(1);
+	subpass[0].pDepthStencilAttachment = &depthRef;
+	subpass[0].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpass[0].inputAttachmentCount = 0;
+	subpass[0].pInputAttachments = nullptr;
+	subpass[0].colorAttachmentCount = 0;
+	subpass[0].pColorAttachments = nullptr;
+	subpass[0].preserveAttachmentCount = 0;
+	subpass[0].pPreserveAttachments = nullptr;
+	subpass[0].pResolveAttachments = nullptr;
+	subpass[0].flags = 0;
+
+	VkRenderPassMultiviewCreateInfo multiview = {};
+	multiview.sType = VK_STRUCTURE_TYPE_RENDER_PASS_MULTIVIEW_CREATE_INFO;
+	multiview.pNext = nullptr;
+	multiview.subpassCount = 1;
+	multiview.pViewMasks = &viewMask;
+	multiview.correlationMaskCount = 0;
+	multiview.pCorrelationMasks = nullptr;
+	multiview.dependencyCount = 0;
+	multiview.pViewOffsets = nullptr;
+
+	VkClearValue clear = {};
+	clear.depthStencil = {1.0f, 0};
+
+	auto rp = context->get_pipelineFactory()->createRenderPass(format, subpass, viewMask ? &multiview : nullptr);
+	rp.clearValues = {clear};
+	return std::move(rp);
+}
+
+spirv::Shader createShadowShader(const Context* context, std::string_view vertFileName, std::string_view fragFileName)
+{
+	std::vector<spirv::ShaderStageData> stages;
+
+	spirv::ShaderStageData* stage;
+	stage = &stages.emplace_back();
+	stage->spirv = util::loadBinaryFile(vertFileName);
+	stage->stage = VK_SHADER_STAGE_VERTEX_BIT;
+
+	stage = &stages.emplace_back();
+	stage->spirv = util::loadBinaryFile(fragFileName);
+	stage->stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	return context->get_pipelineFactory()->createShader(stages);
+}
+
+spirv::Pipeline createShadowPipeline(const Context* context, const spirv::Shader& shader,
+									 const spirv::RenderPass& pass)
+{
+	assert(shader.valid());
+	assert(pass.valid());
+
+	spirv::GraphicsPipelineCreateInfo info = {};
+
+	info.inputAssemblyCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	info.inputAssemblyCreateInfo.flags = 0;
+	info.inputAssemblyCreateInfo.pNext = nullptr;
+	info.inputAssemblyCreateInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	info.inputAssemblyCreateInfo.primitiveRestartEnable = VK_FALSE;
+
+	info.rasterizerCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	info.rasterizerCreateInfo.rasterizerDiscardEnable = VK_FALSE;
+	info.rasterizerCreateInfo.polygonMode = VK_POLYGON_MODE_FILL;
+	info.rasterizerCreateInfo.lineWidth = 1.0f;
+	info.rasterizerCreateInfo.cullMode = VK_CULL_MODE_BACK_BIT;
+	info.rasterizerCreateInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+	info.rasterizerCreateInfo.depthBiasEnable = VK_TRUE;
+	info.rasterizerCreateInfo.depthClampEnable = VK_FALSE;
+	info.rasterizerCreateInfo.pNext = nullptr;
+	info.rasterizerCreateInfo.flags = 0;
+
+	info.multisampleCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	info.multisampleCreateInfo.sampleShadingEnable = VK_FALSE;
+	info.multisampleCreateInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+	info.colorblendCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	info.colorblendCreateInfo.logicOpEnable = VK_FALSE;
+	info.colorblendCreateInfo.attachmentCount = 0;
+	info.colorblendCreateInfo.pAttachments = nullptr;
+
+	info.depthStencilCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	info.depthStencilCreateInfo.depthTestEnable = VK_TRUE;
+	info.depthStencilCreateInfo.depthWriteEnable = VK_TRUE;
+	info.depthStencilCreateInfo.depthCompareOp = VK_COMPARE_OP_LESS;
+	info.depthStencilCreateInfo.depthBoundsTestEnable = VK_FALSE;
+	info.depthStencilCreateInfo.maxDepthBounds = 0.0f; // Don't care
+	info.depthStencilCreateInfo.minDepthBounds = 1.0f; // Don't care
+	info.depthStencilCreateInfo.stencilTestEnable = VK_FALSE;
+	info.depthStencilCreateInfo.front = {}; // Don't Care
+	info.depthStencilCreateInfo.back = {};	// Don't Care
+
+	std::vector<VkDynamicState> dynamicStates = {
+		VK_DYNAMIC_STATE_VIEWPORT,
+		VK_DYNAMIC_STATE_SCISSOR,
+	};
+
+	info.dynamicStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	info.dynamicStateCreateInfo.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+	info.dynamicStateCreateInfo.pDynamicStates = dynamicStates.data();
+
+	return context->get_pipelineFactory()->createGraphicsPipeline(shader, pass, info);
+}
+
+void bindLightData(const Context* context, const spirv::SetVector& sets, std::string_view uniformName,
+				   const UBODataVector& ubos)
+{
+	const spirv::UniformInfo* unif = sets.getUniform(uniformName);
+
+	for (uint32_t i = 0; i < sets.size(); i++)
+	{
+		VkDescriptorBufferInfo info = ubos[i].get_descriptorInfo();
+
+		VkWriteDescriptorSet write = {};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.descriptorType = unif->type;
+		write.descriptorCount = unif->arrayLength;
+		write.dstSet = sets[i];
+		write.dstBinding = unif->binding;
+		write.dstArrayElement = 0;
+		write.pBufferInfo = &info;
+
+		vkUpdateDescriptorSets(context->get_device(), 1, &write, 0, nullptr);
+	}
+}
+
+void bindShadowMaps(const Context* context, const spirv::SetSingleton& set, std::string_view uniformName,
+					const std::vector<VkDescriptorImageInfo>& infos, uint32_t first)
+{
+	const spirv::UniformInfo* unif = set.getUniform(uniformName);
+	assert(first + infos.size() <= unif->arrayLength);
+
+	VkWriteDescriptorSet write = {};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.descriptorType = unif->type;
+	write.descriptorCount = static_cast<uint32_t>(infos.size());
+	write.dstSet = set.get();
+	write.dstBinding = unif->binding;
+	write.dstArrayElement = first;
+	write.pImageInfo = infos.data();
+
+	vkUpdateDescriptorSets(context->get_device(), 1, &write, 0, nullptr);
+}
+} // namespace blaze::fwd
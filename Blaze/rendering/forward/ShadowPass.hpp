@@ -0,0 +1,44 @@
+#pragma once
+
+#include <core/Context.hpp>
+#include <core/UniformBuffer.hpp>
+#include <spirv/PipelineFactory.hpp>
+
+#include <string_view>
+#include <vector>
+
+namespace blaze::fwd
+{
+/**
+ * @brief Creates the depth only render pass of the shadow maps of the forward lights.
+ *
+ * The depth is cleared on load and stored to be sampled by the lighting.
+ *
+ * @param context The Vulkan Context in use.
+ * @param viewMask The views drawn with multiview, eg. 0b111111 for the faces of a cube. 0 draws a single view.
+ */
+spirv::RenderPass createShadowRenderPass(const Context* context, uint32_t viewMask = 0);
+
+/**
+ * @brief Loads a shadow shader of a vertex and a fragment stage.
+ */
+spirv::Shader createShadowShader(const Context* context, std::string_view vertFileName, std::string_view fragFileName);
+
+/**
+ * @brief Creates the depth biased pipeline drawing the casters, with a dynamic viewport and scissor.
+ */
+spirv::Pipeline createShadowPipeline(const Context* context, const spirv::Shader& shader,
+									 const spirv::RenderPass& pass);
+
+/**
+ * @brief Binds the buffer of each frame in \a ubos to the uniform \a uniformName of the set of the frame.
+ */
+void bindLightData(const Context* context, const spirv::SetVector& sets, std::string_view uniformName,
+				   const UBODataVector& ubos);
+
+/**
+ * @brief Writes the maps to the elements of the array uniform \a uniformName, starting at \a first.
+ */
+void bindShadowMaps(const Context* context, const spirv::SetSingleton& set, std::string_view uniformName,
+					const std::vector<VkDescriptorImageInfo>& infos, uint32_t first = 0);
+} // namespace blaze::fwd
@@ -0,0 +1,260 @@
+#include "SpotLightCaster.hpp"
+#include "ShadowPass.hpp"
+
+#include <rendering/ClusterCuller.hpp>
+
+#include <algorithm>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <thirdparty/optick/optick.h>
+
+#undef min
+#undef max
+
+namespace blaze::fwd
+{
+SpotLightCaster::SpotLightCaster(const Context* context, const spirv::SetVector& sets,
+								 const spirv::SetSingleton& texSet) noexcept
+{
+	renderPass = createShadowRenderPass(context);
+	shadowShader = createShadowShader(context, vertShaderFileName, fragShaderFileName);
+	shadowPipeline = createShadowPipeline(context, shadowShader, renderPass);
+
+	auto uniform = sets.getUniform(dataUniformName);
+	maxLights = uniform->size / static_cast<uint32_t>(sizeof(LightData));
+	lights.reserve(maxLights);
+	uploadedLights = std::vector<LightData>(maxLights);
+	ubos = UBODataVector(context, uniform->size, sets.size());
+
+	uniform = texSet.getUniform(textureUniformName);
+	maxShadows = uniform->arrayLength;
+
+	shadows.reserve(maxShadows);
+	freeShadows.reserve(maxShadows);
+	for (uint32_t i = 0; i < maxShadows; ++i)
+	{
+		shadows.emplace_back(context, renderPass, SPOT_MAP_RESOLUTION);
+		// Popped from the back, so the first shadows are used first.
+		freeShadows.push_back(maxShadows - 1 - i);
+	}
+
+	for (uint32_t i = 0; i < sets.size(); ++i)
+	{
+		update(i);
+	}
+
+	bindLightData(context, sets, dataUniformName, ubos);
+	bindTextureSet(context, texSet);
+}
+
+void SpotLightCaster::recreate(const Context* context, const spirv::SetVector& sets)
+{
+	ubos = UBODataVector(context, sets.getUniform(dataUniformName)->size, sets.size());
+
+	for (uint32_t i = 0; i < sets.size(); ++i)
+	{
+		update(i);
+	}
+
+	bindLightData(context, sets, dataUniformName, ubos);
+}
+
+void SpotLightCaster::update(uint32_t frame)
+{
+	uploadedLights.clear();
+	for (auto& light : lights)
+	{
+		if (light.shadowIdx >= 0)
+		{
+			light.shadowViewProj = getShadowViewProj(light);
+		}
+		uploadedLights.push_back(light);
+	}
+
+	LightData empty = {};
+	empty.shadowViewProj = glm::mat4(1.0f);
+	empty.radius = -1.0f;
+	empty.direction = glm::vec3(0.0f, 0.0f, -1.0f);
+	empty.cosOuter = 1.0f;
+	empty.cosInner = 1.0f;
+	empty.shadowIdx = -1;
+	uploadedLights.resize(maxLights, empty);
+
+	ubos[frame].writeData(uploadedLights.data(), maxLights * sizeof(LightData));
+}
+
+SpotLightCaster::Handle SpotLightCaster::createLight(const glm::vec3& position, const glm::vec3& direction,
+													 const glm::vec3& color, float radius, float innerAngle,
+													 float outerAngle, bool enableShadow)
+{
+	if (lights.get_size() >= maxLights)
+	{
+		return INVALID_HANDLE;
+	}
+
+	assert(radius > 0.0f);
+	assert(innerAngle <= outerAngle);
+	const float outer = std::clamp(outerAngle, 0.01f, MAX_SPOT_ANGLE);
+
+	LightData light = {};
+	light.shadowViewProj = glm::mat4(1.0f);
+	light.position = position;
+	light.radius = radius;
+	light.direction = glm::normalize(direction);
+	light.cosOuter = glm::cos(outer);
+	light.color = color;
+	light.cosInner = glm::cos(std::clamp(innerAngle, 0.0f, outer));
+	light.shadowIdx = enableShadow ? createShadow() : -1;
+
+	return lights.add(light);
+}
+
+void SpotLightCaster::removeLight(Handle handle)
+{
+	LightData* pLight = lights.get(handle);
+	if (pLight == nullptr)
+	{
+		return;
+	}
+
+	if (pLight->shadowIdx >= 0)
+	{
+		removeShadow(pLight->shadowIdx);
+	}
+	lights.remove(handle);
+}
+
+bool SpotLightCaster::setShadow(Handle handle, bool enableShadow)
+{
+	LightData* pLight = lights.get(handle);
+	assert(pLight != nullptr);
+
+	if ((pLight->shadowIdx >= 0) == enableShadow)
+	{
+		return pLight->shadowIdx >= 0;
+	}
+	else if (enableShadow)
+	{
+		pLight->shadowIdx = createShadow();
+		return pLight->shadowIdx >= 0;
+	}
+	else
+	{
+		removeShadow(pLight->shadowIdx);
+		pLight->shadowIdx = -1;
+	}
+	return false;
+}
+
+int SpotLightCaster::createShadow()
+{
+	if (freeShadows.empty())
+	{
+		return -1;
+	}
+	int i = freeShadows.back();
+	freeShadows.pop_back();
+	return i;
+}
+
+void SpotLightCaster::removeShadow(int idx)
+{
+	assert(idx >= 0 && idx < static_cast<int>(maxShadows));
+	freeShadows.push_back(idx);
+}
+
+glm::mat4 SpotLightCaster::getShadowViewProj(const LightData& light) const
+{
+	const glm::vec3 up =
+		glm::abs(light.direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+	const float fov = 2.0f * glm::acos(light.cosOuter);
+	return glm::perspective(fov, 1.0f, NEAR_PLANE, light.radius) *
+		   glm::lookAt(light.position, light.position + light.direction, up);
+}
+
+void SpotLightCaster::cast(VkCommandBuffer cmd, const std::vector<Drawable*>& drawables)
+{
+	OPTICK_EVENT();
+	uint32_t objectSet = shadowShader.getSetWithUniform("nodeTransforms")->set;
+	for (const auto& light : lights)
+	{
+		if (light.shadowIdx < 0)
+			continue;
+		SpotShadow* shadow = &shadows[light.shadowIdx];
+
+		renderPass.begin(cmd, shadow->framebuffer);
+
+		SpotShadow::PCB pcb = {
+			getShadowViewProj(light),
+			light.position,
+			light.radius,
+		};
+
+		shadowPipeline.bind(cmd);
+		vkCmdSetViewport(cmd, 0, 1, &shadow->viewport);
+		vkCmdSetScissor(cmd, 0, 1, &shadow->scissor);
+		vkCmdPushConstants(cmd, shadowShader.pipelineLayout.get(), shadowShader.pushConstant.stage, 0,
+						   sizeof(SpotShadow::PCB), &pcb);
+
+		// Only the casters in the light's sphere.
+		const auto sphere = ClusterCuller::createSphere(light.position, light.radius);
+		for (Drawable* d : drawables)
+		{
+			if (ClusterCuller::intersects(sphere, d->get_bounds()))
+			{
+				d->drawGeometry(cmd, shadowShader.pipelineLayout.get(), objectSet);
+			}
+		}
+
+		renderPass.end(cmd);
+	}
+}
+
+void SpotLightCaster::bindTextureSet(const Context* context, const spirv::SetSingleton& set)
+{
+	std::vector<VkDescriptorImageInfo> infos;
+	infos.reserve(maxShadows);
+	for (auto& shadow : shadows)
+	{
+		infos.push_back(shadow.shadowMap.get_imageInfo());
+	}
+
+	bindShadowMaps(context, set, textureUniformName, infos);
+}
+
+// Spot Shadow
+SpotShadow::SpotShadow(const Context* context, const spirv::RenderPass& renderPass, uint32_t mapResolution) noexcept
+{
+	ImageData2D id2d{};
+	id2d.height = mapResolution;
+	id2d.width = mapResolution;
+	id2d.numChannels = 1;
+	id2d.size = mapResolution * mapResolution;
+	id2d.anisotropy = VK_FALSE;
+	id2d.samplerAddressMode = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	id2d.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	id2d.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+	id2d.format = VK_FORMAT_D32_SFLOAT;
+	id2d.aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+	id2d.access = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	shadowMap = Texture2D(context, id2d, false);
+
+	viewport = VkViewport{0.0f,
+						  static_cast<float>(mapResolution),
+						  static_cast<float>(mapResolution),
+						  -static_cast<float>(mapResolution),
+						  0.0f,
+						  1.0f};
+
+	scissor.offset = {0, 0};
+	scissor.extent = {mapResolution, mapResolution};
+
+	std::vector<VkImageView> attachments = {shadowMap.get_imageView()};
+
+	framebuffer = context->get_pipelineFactory()->createFramebuffer(renderPass, scissor.extent, attachments);
+}
+} // namespace blaze::fwd
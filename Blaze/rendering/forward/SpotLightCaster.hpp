@@ -0,0 +1,155 @@
+#pragma once
+
+#include <core/Context.hpp>
+#include <core/Drawable.hpp>
+#include <core/Texture2D.hpp>
+#include <core/UniformBuffer.hpp>
+#include <spirv/PipelineFactory.hpp>
+#include <util/SlotMap.hpp>
+
+namespace blaze::fwd
+{
+/**
+ * @class SpotShadow
+ *
+ * @brief Encapsulates the attachment and framebuffer for a spot light shadow.
+ *
+ * Contains the shadowMap (D32), a single perspective view down the cone, along with the
+ * framebuffer and viewport configured.
+ *
+ * @note Not supposed to be used externally.
+ *
+ * @cond PRIVATE
+ */
+struct SpotShadow
+{
+	Texture2D shadowMap;
+	spirv::Framebuffer framebuffer;
+	VkRect2D scissor;
+	VkViewport viewport;
+
+	struct PCB
+	{
+		alignas(16) glm::mat4 viewProj;
+		alignas(16) glm::vec3 position;
+		alignas(4) float radius;
+	};
+
+	SpotShadow(const Context* context, const spirv::RenderPass& renderPass, uint32_t mapResolution) noexcept;
+};
+/**
+ * @endcond
+ */
+
+/**
+ * @brief Owns the spot lights and their shadows.
+ *
+ * A spot light lights the cone around its direction up to its radius. Its shadow is a single
+ * perspective map of the cone, instead of the six faces of a point light's cube map.
+ *
+ * The lights are kept densely packed in a SlotMap and uploaded in front of the table, the rest
+ * of the table is filled with lights of negative radius, which the shaders skip.
+ */
+class SpotLightCaster
+{
+private:
+	/// The size of a face of the point light shadows, so a spot shadow costs a sixth of one.
+	constexpr static uint32_t SPOT_MAP_RESOLUTION = 512;
+	constexpr static float NEAR_PLANE = 0.3f;
+	/// Widest half angle of a light, 80 degrees, as the shadow is a perspective view.
+	constexpr static float MAX_SPOT_ANGLE = 1.3962634f;
+
+	struct LightData
+	{
+		/// The projection of the shadow, updated every frame.
+		alignas(16) glm::mat4 shadowViewProj;
+		alignas(16) glm::vec3 position;
+		alignas(4) float radius;
+		alignas(16) glm::vec3 direction;
+		/// Cosine of the half angle where the light ends.
+		alignas(4) float cosOuter;
+		alignas(16) glm::vec3 color;
+		/// Cosine of the half angle where the light starts to fade.
+		alignas(4) float cosInner;
+		/// Index of the shadow, -1 if the light has none.
+		alignas(4) int shadowIdx;
+	};
+
+public:
+	using Handle = util::SlotMap<LightData>::Handle;
+	constexpr static Handle INVALID_HANDLE = util::SlotMap<LightData>::INVALID_HANDLE;
+
+private:
+	uint32_t maxLights;
+	uint32_t maxShadows;
+
+	util::SlotMap<LightData> lights;
+	/// The table as uploaded, the lights followed by empty ones.
+	std::vector<LightData> uploadedLights;
+
+	constexpr static std::string_view dataUniformName = "spotLights";
+	constexpr static std::string_view textureUniformName = "spotShadows";
+
+	constexpr static std::string_view vertShaderFileName = "shaders/forward/vSpotShadow.vert.spv";
+	constexpr static std::string_view fragShaderFileName = "shaders/forward/fSpotShadow.frag.spv";
+
+	spirv::RenderPass renderPass;
+	spirv::Shader shadowShader;
+	spirv::Pipeline shadowPipeline;
+
+	UBODataVector ubos;
+
+	std::vector<SpotShadow> shadows;
+	/// The indices of the unused shadows.
+	std::vector<int> freeShadows;
+
+public:
+	SpotLightCaster(const Context* context, const spirv::SetVector& sets, const spirv::SetSingleton& texSet) noexcept;
+	void recreate(const Context* context, const spirv::SetVector& sets);
+	void update(uint32_t frame);
+
+	/**
+	 * @brief Creates a spot light.
+	 *
+	 * @param innerAngle The half angle in radians where the light starts to fade.
+	 * @param outerAngle The half angle in radians where the light ends, up to MAX_SPOT_ANGLE.
+	 *
+	 * @returns The handle of the light, or INVALID_HANDLE if the table is full.
+	 */
+	Handle createLight(const glm::vec3& position, const glm::vec3& direction, const glm::vec3& color, float radius,
+					   float innerAngle, float outerAngle, bool enableShadow);
+	void removeLight(Handle handle);
+	bool setShadow(Handle handle, bool enableShadow);
+
+	/**
+	 * @brief Returns the light of \a handle, or nullptr if it was removed.
+	 */
+	LightData* getLight(Handle handle)
+	{
+		return lights.get(handle);
+	}
+
+	inline uint32_t get_count() const
+	{
+		return lights.get_size();
+	}
+
+	inline uint32_t getMaxLights() const
+	{
+		return maxLights;
+	}
+
+	inline uint32_t getMaxShadows() const
+	{
+		return maxShadows;
+	}
+
+	void cast(VkCommandBuffer cmd, const std::vector<Drawable*>& drawables);
+
+private:
+	int createShadow();
+	void removeShadow(int idx);
+	glm::mat4 getShadowViewProj(const LightData& light) const;
+	void bindTextureSet(const Context* context, const spirv::SetSingleton& set);
+};
+} // namespace blaze::fwd
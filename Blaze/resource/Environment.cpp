@@ -4,481 +4,293 @@
 #include <util/processing.hpp>
 #include <rendering/ARenderer.hpp>
 #include <util/files.hpp>
+#include <algorithm>
+#include <array>
+#include <cassert>
 #include <vector>
 #include <thirdparty/optick/optick.h>
 
 namespace blaze
 {
-TextureCube Environment::createIrradianceCube(const Context* context, spirv::SetSingleton* environment)
+void Environment::startBake(const Context* context)
 {
 	OPTICK_EVENT();
-	spirv::RenderPass renderpass;
-	spirv::Shader shader;
-	spirv::Pipeline pipeline;
-	spirv::Framebuffer framebuffer;
-	TextureCube irradianceMap;
-	spirv::SetSingleton descriptorSet;
-
-	struct PCB
-	{
-		float deltaPhi{(2.0f * glm::pi<float>()) / 180.0f};
-		float deltaTheta{(0.5f * glm::pi<float>()) / 64.0f};
-	} pcb = {};
 
-	uint32_t dim = 64u;
-	
-	ImageDataCube idc{};
-	idc.height = dim;
-	idc.width = dim;
-	idc.numChannels = 4;
-	idc.size = 4 * 6 * dim * dim;
-	idc.layerSize = 4 * dim * dim;
-	idc.usage  = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
-	idc.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-	idc.format = VK_FORMAT_R16G16B16A16_SFLOAT;
-	idc.access = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-	irradianceMap = TextureCube(context, idc, false);
+	bake = std::make_unique<Bake>();
+	bake->context = context;
 
-	std::vector<spirv::ShaderStageData> shaderStages;
-	{
-		spirv::ShaderStageData* stage = &shaderStages.emplace_back();
-		stage->spirv = util::loadBinaryFile("shaders/env/vIrradiance.vert.spv");
-		stage->stage = VK_SHADER_STAGE_VERTEX_BIT;
-
-		stage = &shaderStages.emplace_back();
-		stage->spirv = util::loadBinaryFile("shaders/env/fIrradiance.frag.spv");
-		stage->stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-	}
-
-	spirv::AttachmentFormat format = {
-		VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
-		irradianceMap.get_format(),
-		VK_SAMPLE_COUNT_1_BIT,
-		spirv::LoadStoreConfig(spirv::LoadStoreConfig::LoadAction::DONT_CARE,
-							   spirv::LoadStoreConfig::StoreAction::READ),
+	auto createComputeShader = [context](const std::string_view& filename) {
+		std::vector<spirv::ShaderStageData> stages;
+		spirv::ShaderStageData* stage = &stages.emplace_back();
+		stage->spirv = util::loadBinaryFile(filename);
+		stage->stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		return context->get_pipelineFactory()->createShader(stages);
 	};
 
-	VkAttachmentReference colorRef = {0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
-
-	VkSubpassDescription subpass = {};
-	subpass.flags = 0;
-	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-	subpass.colorAttachmentCount = 1;
-	subpass.pColorAttachments = &colorRef;
-	subpass.inputAttachmentCount = 0;
-	subpass.preserveAttachmentCount = 0;
-	subpass.pDepthStencilAttachment = nullptr;
-
-	uint32_t viewmask = 0b111111;
-
-	VkRenderPassMultiviewCreateInfo multiview = {};
-	multiview.sType = VK_STRUCTURE_TYPE_RENDER_PASS_MULTIVIEW_CREATE_INFO;
-	multiview.pNext = nullptr;
-	multiview.subpassCount = 1;
-	multiview.pViewMasks = &viewmask;
-	multiview.correlationMaskCount = 0;
-	multiview.pCorrelationMasks = nullptr;
-	multiview.dependencyCount = 0;
-	multiview.pViewOffsets = nullptr;
-
-	renderpass = context->get_pipelineFactory()->createRenderPass({format}, {subpass}, &multiview);
-
-	VkClearValue clearColor = {};
-	clearColor.color = {0.0f, 0.0f, 0.0f, 1.0f};
-	renderpass.clearValues = {clearColor};
-
-	shader = context->get_pipelineFactory()->createShader(shaderStages);
-
-	spirv::GraphicsPipelineCreateInfo info = {};
-
-	info.inputAssemblyCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-	info.inputAssemblyCreateInfo.flags = 0;
-	info.inputAssemblyCreateInfo.pNext = nullptr;
-	info.inputAssemblyCreateInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-	info.inputAssemblyCreateInfo.primitiveRestartEnable = VK_FALSE;
-
-	info.rasterizerCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-	info.rasterizerCreateInfo.rasterizerDiscardEnable = VK_FALSE;
-	info.rasterizerCreateInfo.polygonMode = VK_POLYGON_MODE_FILL;
-	info.rasterizerCreateInfo.lineWidth = 1.0f;
-	info.rasterizerCreateInfo.cullMode = VK_CULL_MODE_FRONT_BIT;
-	info.rasterizerCreateInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-	info.rasterizerCreateInfo.depthBiasEnable = VK_TRUE;
-	info.rasterizerCreateInfo.depthClampEnable = VK_FALSE;
-	info.rasterizerCreateInfo.pNext = nullptr;
-	info.rasterizerCreateInfo.flags = 0;
-
-	info.multisampleCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-	info.multisampleCreateInfo.sampleShadingEnable = VK_FALSE;
-	info.multisampleCreateInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-
-	VkPipelineColorBlendAttachmentState colorblendAttachment = {};
-	colorblendAttachment.blendEnable = VK_FALSE;
-	colorblendAttachment.colorWriteMask =
-		VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-
-	info.colorblendCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-	info.colorblendCreateInfo.logicOpEnable = VK_FALSE;
-	info.colorblendCreateInfo.attachmentCount = 1;
-	info.colorblendCreateInfo.pAttachments = &colorblendAttachment;
-
-	info.depthStencilCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-	info.depthStencilCreateInfo.depthTestEnable = VK_FALSE;
-	info.depthStencilCreateInfo.depthWriteEnable = VK_FALSE;
-	info.depthStencilCreateInfo.depthCompareOp = VK_COMPARE_OP_LESS;
-	info.depthStencilCreateInfo.depthBoundsTestEnable = VK_FALSE;
-	info.depthStencilCreateInfo.maxDepthBounds = 0.0f; // Don't care
-	info.depthStencilCreateInfo.minDepthBounds = 1.0f; // Don't care
-	info.depthStencilCreateInfo.stencilTestEnable = VK_FALSE;
-	info.depthStencilCreateInfo.front = {}; // Don't Care
-	info.depthStencilCreateInfo.back = {};	// Don't Care
-
-	std::vector<VkDynamicState> dynamicStates = {
-		VK_DYNAMIC_STATE_VIEWPORT,
-		VK_DYNAMIC_STATE_SCISSOR,
-	};
-
-	info.dynamicStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-	info.dynamicStateCreateInfo.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
-	info.dynamicStateCreateInfo.pDynamicStates = dynamicStates.data();
-
-	pipeline = context->get_pipelineFactory()->createGraphicsPipeline(shader, renderpass, info);
-
-	framebuffer =
-		context->get_pipelineFactory()->createFramebuffer(renderpass, {dim, dim}, {irradianceMap.get_imageView()});
-
-	auto cube = getUVCube(context);
-
-	CubemapUBlock uboData = {
-		glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 512.0f),
-		{
-			// POSITIVE_X (Outside in - so NEG_X face)
-			glm::lookAt(glm::vec3(0.0f), glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f)),
-			// NEGATIVE_X (Outside in - so POS_X face)
-			glm::lookAt(glm::vec3(0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f)),
-			// POSITIVE_Y
-			glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f)),
-			// NEGATIVE_Y
-			glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f)),
-			// POSITIVE_Z
-			glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 1.0f, 0.0f)),
-			// NEGATIVE_Z
-			glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f)),
-		}};
-
-	UBO<CubemapUBlock> ubo(context, uboData);
-
-	descriptorSet = context->get_pipelineFactory()->createSet(*shader.getSetWithUniform("pv"));
+	bake->projectShader = createComputeShader(irradianceShaderFileName);
+	bake->reduceShader = createComputeShader(irradianceReduceShaderFileName);
+	bake->prefilterShader = createComputeShader(prefilterShaderFileName);
+	bake->projectPipeline = context->get_pipelineFactory()->createComputePipeline(bake->projectShader);
+	bake->reducePipeline = context->get_pipelineFactory()->createComputePipeline(bake->reduceShader);
+	bake->prefilterPipeline = context->get_pipelineFactory()->createComputePipeline(bake->prefilterShader);
 
+	// Irradiance
 	{
-		VkDescriptorBufferInfo info = ubo.get_descriptorInfo();
-
-		VkWriteDescriptorSet write = {};
-		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		write.descriptorCount = 1;
-		write.dstSet = descriptorSet.get();
-		write.dstBinding = 0;
-		write.dstArrayElement = 0;
-		write.pBufferInfo = &info;
-
-		vkUpdateDescriptorSets(context->get_device(), 1, &write, 0, nullptr);
+		const uint32_t size = skybox.get_width();
+		bake->projectGroups = (size + IRRADIANCE_TILE_SIZE - 1) / IRRADIANCE_TILE_SIZE;
+		const uint32_t groupCount = bake->projectGroups * bake->projectGroups * 6;
+
+		bake->partials = context->createBuffer(groupCount * 9 * sizeof(glm::vec4), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+											   VMA_MEMORY_USAGE_GPU_ONLY);
+		bake->coefficients = context->createBuffer(sizeof(IrradianceSH), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+												   VMA_MEMORY_USAGE_GPU_TO_CPU);
+
+		const auto& projectShader = bake->projectShader;
+		const auto& reduceShader = bake->reduceShader;
+		bake->projectSet = context->get_pipelineFactory()->createSet(*projectShader.getSetWithUniform("skybox"));
+		bake->reduceSet = context->get_pipelineFactory()->createSet(*reduceShader.getSetWithUniform("coefficients"));
+
+		VkDescriptorBufferInfo partialsInfo = {bake->partials.handle, 0, VK_WHOLE_SIZE};
+		VkDescriptorBufferInfo coefficientsInfo = {bake->coefficients.handle, 0, VK_WHOLE_SIZE};
+
+		std::array<VkWriteDescriptorSet, 4> writes;
+		auto setWrite = [&writes](uint32_t index, const spirv::SetSingleton& set, const spirv::UniformInfo* unif) {
+			writes[index] = {};
+			writes[index].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[index].descriptorType = unif->type;
+			writes[index].descriptorCount = 1;
+			writes[index].dstSet = set.get();
+			writes[index].dstBinding = unif->binding;
+			writes[index].dstArrayElement = 0;
+		};
+		setWrite(0, bake->projectSet, projectShader.getUniform("skybox"));
+		writes[0].pImageInfo = &skybox.get_imageInfo();
+		setWrite(1, bake->projectSet, projectShader.getUniform("partials"));
+		writes[1].pBufferInfo = &partialsInfo;
+		setWrite(2, bake->reduceSet, reduceShader.getUniform("partials"));
+		writes[2].pBufferInfo = &partialsInfo;
+		setWrite(3, bake->reduceSet, reduceShader.getUniform("coefficients"));
+		writes[3].pBufferInfo = &coefficientsInfo;
+
+		vkUpdateDescriptorSets(context->get_device(), static_cast<uint32_t>(writes.size()), writes.data(), 0,
+							   nullptr);
+
+		// Written once the coefficients are read back.
+		irradianceSH = UBO<IrradianceSH>(context, IrradianceSH{});
 	}
 
-	glm::mat4 mvppcb{};
-
-	auto cmdBuffer = context->startCommandBufferRecord();
-
-	// RENDERPASSES
-
-	renderpass.begin(cmdBuffer, framebuffer);
-
-	VkViewport viewport = {};
-	viewport.x = 0.0f;
-	viewport.y = static_cast<float>(dim);
-	viewport.width = (float)dim;
-	viewport.height = -(float)dim;
-	viewport.minDepth = 0.0f;
-	viewport.maxDepth = 1.0f;
-
-	VkRect2D scissor = {};
-	scissor.offset = {0, 0};
-	scissor.extent = {dim, dim};
-
-	vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
-	vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
-
-	pipeline.bind(cmdBuffer);
-	vkCmdBindDescriptorSets(cmdBuffer, pipeline.bindPoint, shader.pipelineLayout.get(), 0, 1,
-							&descriptorSet.get(), 0, nullptr);
-	vkCmdBindDescriptorSets(cmdBuffer, pipeline.bindPoint, shader.pipelineLayout.get(), 1, 1,
-							&environment->get(), 0, nullptr);
-
-	mvppcb = glm::mat4(1.0f);
-	vkCmdPushConstants(cmdBuffer, shader.pipelineLayout.get(), shader.pushConstant.stage, 0,
-						sizeof(glm::mat4), &mvppcb);
-	vkCmdPushConstants(cmdBuffer, shader.pipelineLayout.get(), shader.pushConstant.stage,
-						sizeof(glm::mat4), sizeof(PCB), &pcb);
-
-	VkDeviceSize offsets = {0};
-
-	cube.bind(cmdBuffer);
-	vkCmdDrawIndexed(cmdBuffer, cube.get_indexCount(), 1, 0, 0, 0);
-
-	renderpass.end(cmdBuffer);
-	context->flushCommandBuffer(cmdBuffer);
+	// Prefiltered cube
+	{
+		const uint32_t dim = PREFILTERED_DIM;
+
+		// Written as storage by every mip, then sampled.
+		ImageDataCube idc{};
+		idc.height = dim;
+		idc.width = dim;
+		idc.numChannels = 4;
+		idc.size = 4 * 6 * dim * dim;
+		idc.layerSize = 4 * dim * dim;
+		idc.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+					VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		idc.layout = VK_IMAGE_LAYOUT_GENERAL;
+		idc.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+		idc.access = VK_ACCESS_SHADER_WRITE_BIT;
+		prefilteredMap = TextureCube(context, idc, true);
+
+		const uint32_t totalMips = prefilteredMap.get_miplevels();
+
+		std::vector<VkImageView> views(totalMips);
+		for (uint32_t miplevel = 0; miplevel < totalMips; miplevel++)
+		{
+			views[miplevel] =
+				util::createImageView(context->get_device(), prefilteredMap.get_image(), VK_IMAGE_VIEW_TYPE_2D_ARRAY,
+									  idc.format, VK_IMAGE_ASPECT_COLOR_BIT, 1, 6, 0, miplevel);
+		}
+		bake->mipViews = vkw::ImageViewVector(std::move(views), context->get_device());
 
-	irradianceMap.implicitTransferLayout(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_SHADER_READ_BIT);
+		const auto& shader = bake->prefilterShader;
+		bake->prefilterSets.reserve(totalMips);
+		for (uint32_t miplevel = 0; miplevel < totalMips; miplevel++)
+		{
+			auto& set = bake->prefilterSets.emplace_back(
+				context->get_pipelineFactory()->createSet(*shader.getSetWithUniform("skybox")));
+
+			VkDescriptorImageInfo mipInfo = {VK_NULL_HANDLE, bake->mipViews[miplevel], VK_IMAGE_LAYOUT_GENERAL};
+
+			const char* names[] = {"skybox", "prefilteredMip"};
+			std::array<VkWriteDescriptorSet, 2> writes;
+			for (size_t j = 0; j < writes.size(); j++)
+			{
+				auto unif = shader.getUniform(names[j]);
+
+				writes[j] = {};
+				writes[j].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				writes[j].descriptorType = unif->type;
+				writes[j].descriptorCount = 1;
+				writes[j].dstSet = set.get();
+				writes[j].dstBinding = unif->binding;
+				writes[j].dstArrayElement = 0;
+			}
+			writes[0].pImageInfo = &skybox.get_imageInfo();
+			writes[1].pImageInfo = &mipInfo;
+
+			vkUpdateDescriptorSets(context->get_device(), static_cast<uint32_t>(writes.size()), writes.data(), 0,
+								   nullptr);
+		}
+	}
 
-	return irradianceMap;
+	// Every face of the projection, then every face of every mip.
+	bake->sliceCount = 6 + 6 * prefilteredMap.get_miplevels();
 }
 
-TextureCube Environment::createPrefilteredCube(const Context* context, spirv::SetSingleton* environment)
+bool Environment::recordBake(VkCommandBuffer cmdBuffer, uint32_t sliceCount)
 {
 	OPTICK_EVENT();
 
-	struct PCB
+	struct ProjectPCB
 	{
-		float roughness = 0;
-		float miplevel = 0;
-	} pcb;
-
-	const uint32_t dim = 128u;
-
-	spirv::Shader shader;
-	spirv::Pipeline pipeline;
-	spirv::RenderPass renderpass;
-	spirv::Framebuffer framebuffer;
-
-	VkFormat imageFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
-
-	// Setup the TextureCube
-	ImageDataCube idc{};
-	idc.height = dim;
-	idc.width = dim;
-	idc.numChannels = 4;
-	idc.size = 4 * 6 * dim * dim;
-	idc.layerSize = 4 * dim * dim;
-	idc.layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-	idc.format = imageFormat;
-	idc.access = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-	TextureCube prefilterMap(context, idc, true);
-
-	ImageData2D id2d{};
-	id2d.height = dim;
-	id2d.width = dim;
-	id2d.numChannels = 4;
-	id2d.size = 4 * dim * dim;
-	id2d.format = imageFormat;
-	id2d.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
-	id2d.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-	id2d.access = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-	Texture2D fbColorAttachment(context, id2d, false);
-	
-	std::vector<spirv::ShaderStageData> shaderStages;
+		uint32_t size;
+		uint32_t baseFace;
+	};
+	struct ReducePCB
 	{
-		spirv::ShaderStageData* stage = &shaderStages.emplace_back();
-		stage->spirv = util::loadBinaryFile("shaders/env/vPrefilter.vert.spv");
-		stage->stage = VK_SHADER_STAGE_VERTEX_BIT;
-
-		stage = &shaderStages.emplace_back();
-		stage->spirv = util::loadBinaryFile("shaders/env/fPrefilter.frag.spv");
-		stage->stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-	}
-
-	spirv::AttachmentFormat format = {
-		VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
-		fbColorAttachment.get_format(),
-		VK_SAMPLE_COUNT_1_BIT,
-		spirv::LoadStoreConfig(spirv::LoadStoreConfig::LoadAction::DONT_CARE,
-							   spirv::LoadStoreConfig::StoreAction::CONTINUE),
+		uint32_t count;
 	};
-
-	VkAttachmentReference colorRef = {0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
-
-	VkSubpassDescription subpass = {};
-	subpass.flags = 0;
-	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-	subpass.colorAttachmentCount = 1;
-	subpass.pColorAttachments = &colorRef;
-	subpass.inputAttachmentCount = 0;
-	subpass.preserveAttachmentCount = 0;
-	subpass.pDepthStencilAttachment = nullptr;
-
-	renderpass = context->get_pipelineFactory()->createRenderPass({format}, {subpass});
-
-	std::vector<VkClearValue> clearColor(1);
-	clearColor[0].color = {0.0f, 0.0f, 0.0f, 1.0f};
-	renderpass.clearValues = std::move(clearColor);
-
-	shader = context->get_pipelineFactory()->createShader(shaderStages);
-
-	spirv::GraphicsPipelineCreateInfo info = {};
-
-	info.inputAssemblyCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-	info.inputAssemblyCreateInfo.flags = 0;
-	info.inputAssemblyCreateInfo.pNext = nullptr;
-	info.inputAssemblyCreateInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-	info.inputAssemblyCreateInfo.primitiveRestartEnable = VK_FALSE;
-
-	info.rasterizerCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-	info.rasterizerCreateInfo.rasterizerDiscardEnable = VK_FALSE;
-	info.rasterizerCreateInfo.polygonMode = VK_POLYGON_MODE_FILL;
-	info.rasterizerCreateInfo.lineWidth = 1.0f;
-	info.rasterizerCreateInfo.cullMode = VK_CULL_MODE_FRONT_BIT;
-	info.rasterizerCreateInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-	info.rasterizerCreateInfo.depthBiasEnable = VK_TRUE;
-	info.rasterizerCreateInfo.depthClampEnable = VK_FALSE;
-	info.rasterizerCreateInfo.pNext = nullptr;
-	info.rasterizerCreateInfo.flags = 0;
-
-	info.multisampleCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-	info.multisampleCreateInfo.sampleShadingEnable = VK_FALSE;
-	info.multisampleCreateInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-
-	VkPipelineColorBlendAttachmentState colorblendAttachment = {};
-	colorblendAttachment.blendEnable = VK_FALSE;
-	colorblendAttachment.colorWriteMask =
-		VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-
-	info.colorblendCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-	info.colorblendCreateInfo.logicOpEnable = VK_FALSE;
-	info.colorblendCreateInfo.attachmentCount = 1;
-	info.colorblendCreateInfo.pAttachments = &colorblendAttachment;
-
-	info.depthStencilCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-	info.depthStencilCreateInfo.depthTestEnable = VK_FALSE;
-	info.depthStencilCreateInfo.depthWriteEnable = VK_FALSE;
-	info.depthStencilCreateInfo.depthCompareOp = VK_COMPARE_OP_LESS;
-	info.depthStencilCreateInfo.depthBoundsTestEnable = VK_FALSE;
-	info.depthStencilCreateInfo.maxDepthBounds = 0.0f; // Don't care
-	info.depthStencilCreateInfo.minDepthBounds = 1.0f; // Don't care
-	info.depthStencilCreateInfo.stencilTestEnable = VK_FALSE;
-	info.depthStencilCreateInfo.front = {}; // Don't Care
-	info.depthStencilCreateInfo.back = {};	// Don't Care
-
-	std::vector<VkDynamicState> dynamicStates = {
-		VK_DYNAMIC_STATE_VIEWPORT,
-		VK_DYNAMIC_STATE_SCISSOR,
+	struct PrefilterPCB
+	{
+		float roughness;
+		uint32_t size;
+		uint32_t baseFace;
 	};
 
-	info.dynamicStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-	info.dynamicStateCreateInfo.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
-	info.dynamicStateCreateInfo.pDynamicStates = dynamicStates.data();
-
-	pipeline = context->get_pipelineFactory()->createGraphicsPipeline(shader, renderpass, info);
-
-	framebuffer =
-		context->get_pipelineFactory()->createFramebuffer(renderpass, {dim, dim}, {fbColorAttachment.get_imageView()});
-
-	auto cube = getUVCube(context);
-
-	glm::mat4 proj = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 512.0f);
-
-	std::vector<glm::mat4> matrices = {
-		// POSITIVE_X (Outside in - so NEG_X face)
-		glm::lookAt(glm::vec3(0.0f), glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f)),
-		// NEGATIVE_X (Outside in - so POS_X face)
-		glm::lookAt(glm::vec3(0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f)),
-		// POSITIVE_Y
-		glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f)),
-		// NEGATIVE_Y
-		glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f)),
-		// POSITIVE_Z
-		glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 1.0f, 0.0f)),
-		// NEGATIVE_Z
-		glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f)),
-	};
+	assert(bake && !bake->recorded);
 
-	glm::mat4 mvppcb{};
+	const uint32_t totalMips = prefilteredMap.get_miplevels();
+	const uint32_t endSlice = bake->nextSlice + std::min(sliceCount, bake->sliceCount - bake->nextSlice);
 
-	uint32_t totalMips = prefilterMap.get_miplevels();
-	uint32_t mipsize = dim;
-	auto cmdBuffer = context->startCommandBufferRecord();
-	for (uint32_t miplevel = 0; miplevel < totalMips; miplevel++)
+	// The slices write disjoint parts of the partials and the mips, so they need no barriers between them.
+	for (; bake->nextSlice < endSlice; bake->nextSlice++)
 	{
-		// RENDERPASSES
-		VkViewport viewport = {};
-		viewport.x = 0.0f;
-		viewport.y = static_cast<float>(mipsize);
-		viewport.width = static_cast<float>(mipsize);
-		viewport.height = -static_cast<float>(mipsize);
-		viewport.minDepth = 0.0f;
-		viewport.maxDepth = 1.0f;
-
-		VkRect2D scissor = {};
-		scissor.offset = {0, 0};
-		scissor.extent = {mipsize, mipsize};
-		framebuffer.renderArea = scissor;
-
-		for (int face = 0; face < 6; face++)
+		const uint32_t slice = bake->nextSlice;
+		if (slice < 6)
 		{
-			renderpass.begin(cmdBuffer, framebuffer);
-			vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
-			vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
-
-			pipeline.bind(cmdBuffer);
-
-			vkCmdBindDescriptorSets(cmdBuffer, pipeline.bindPoint, shader.pipelineLayout.get(), 0, 1,
-									&environment->get(), 0, nullptr);
+			const auto& shader = bake->projectShader;
+			const auto& pipeline = bake->projectPipeline;
+			const ProjectPCB pcb = {skybox.get_width(), slice};
 
-			mvppcb = proj * matrices[face];
-			pcb.roughness = (float)miplevel / (float)(totalMips - 1);
-			pcb.miplevel = static_cast<float>(miplevel);
+			vkCmdBindPipeline(cmdBuffer, pipeline.bindPoint, pipeline.pipeline.get());
+			vkCmdBindDescriptorSets(cmdBuffer, pipeline.bindPoint, shader.pipelineLayout.get(),
+									bake->projectSet.setIdx, 1, &bake->projectSet.get(), 0, nullptr);
 			vkCmdPushConstants(cmdBuffer, shader.pipelineLayout.get(), shader.pushConstant.stage, 0,
-							   sizeof(glm::mat4), &mvppcb);
-			vkCmdPushConstants(cmdBuffer, shader.pipelineLayout.get(), shader.pushConstant.stage,
-							   sizeof(glm::mat4), sizeof(PCB), &pcb);
+							   sizeof(ProjectPCB), &pcb);
+			vkCmdDispatch(cmdBuffer, bake->projectGroups, bake->projectGroups, 1);
+		}
+		else
+		{
+			const uint32_t miplevel = (slice - 6) / 6;
+			const uint32_t face = (slice - 6) % 6;
+			const uint32_t mipsize = std::max(PREFILTERED_DIM >> miplevel, 1u);
+			const uint32_t groups = (mipsize + PREFILTER_GROUP_SIZE - 1) / PREFILTER_GROUP_SIZE;
+
+			const auto& shader = bake->prefilterShader;
+			const auto& pipeline = bake->prefilterPipeline;
+			const auto& set = bake->prefilterSets[miplevel];
+			const PrefilterPCB pcb = {static_cast<float>(miplevel) / static_cast<float>(totalMips - 1), mipsize,
+									  face};
+
+			vkCmdBindPipeline(cmdBuffer, pipeline.bindPoint, pipeline.pipeline.get());
+			vkCmdBindDescriptorSets(cmdBuffer, pipeline.bindPoint, shader.pipelineLayout.get(), set.setIdx, 1,
+									&set.get(), 0, nullptr);
+			vkCmdPushConstants(cmdBuffer, shader.pipelineLayout.get(), shader.pushConstant.stage, 0,
+							   sizeof(PrefilterPCB), &pcb);
+			vkCmdDispatch(cmdBuffer, groups, groups, 1);
+		}
+	}
 
-			cube.bind(cmdBuffer);
-			vkCmdDrawIndexed(cmdBuffer, cube.get_indexCount(), 1, 0, 0, 0);
+	if (bake->nextSlice < bake->sliceCount)
+	{
+		return false;
+	}
 
-			renderpass.end(cmdBuffer);
-			fbColorAttachment.implicitTransferLayout(VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-													 VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+	// The barriers also cover the slices recorded into earlier command buffers of the queue.
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+						 &barrier, 0, nullptr, 0, nullptr);
 
-			fbColorAttachment.transferLayout(cmdBuffer, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-											 VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-											 VK_PIPELINE_STAGE_TRANSFER_BIT);
+	{
+		const auto& shader = bake->reduceShader;
+		const auto& pipeline = bake->reducePipeline;
+		const ReducePCB pcb = {bake->projectGroups * bake->projectGroups * 6};
+
+		vkCmdBindPipeline(cmdBuffer, pipeline.bindPoint, pipeline.pipeline.get());
+		vkCmdBindDescriptorSets(cmdBuffer, pipeline.bindPoint, shader.pipelineLayout.get(), bake->reduceSet.setIdx,
+								1, &bake->reduceSet.get(), 0, nullptr);
+		vkCmdPushConstants(cmdBuffer, shader.pipelineLayout.get(), shader.pushConstant.stage, 0, sizeof(ReducePCB),
+						   &pcb);
+		vkCmdDispatch(cmdBuffer, 1, 1, 1);
+	}
 
-			VkImageCopy copyRegion = {};
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier,
+						 0, nullptr, 0, nullptr);
 
-			copyRegion.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			copyRegion.srcSubresource.baseArrayLayer = 0;
-			copyRegion.srcSubresource.mipLevel = 0;
-			copyRegion.srcSubresource.layerCount = 1;
-			copyRegion.srcOffset = {0, 0, 0};
+	// The mips are independent, so a single barrier covers them all.
+	prefilteredMap.transferLayout(cmdBuffer, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_SHADER_READ_BIT,
+								  VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
 
-			copyRegion.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			copyRegion.dstSubresource.baseArrayLayer = face;
-			copyRegion.dstSubresource.mipLevel = miplevel;
-			copyRegion.dstSubresource.layerCount = 1;
-			copyRegion.dstOffset = {0, 0, 0};
+	if (!bake->cacheFile.empty())
+	{
+		bake->prefilteredReadback = recordIblDownload(bake->context, cmdBuffer, prefilteredMap);
+	}
 
-			copyRegion.extent.width = static_cast<uint32_t>(mipsize);
-			copyRegion.extent.height = static_cast<uint32_t>(mipsize);
-			copyRegion.extent.depth = 1;
+	bake->recorded = true;
+	return true;
+}
 
-			vkCmdCopyImage(cmdBuffer, fbColorAttachment.get_image(), fbColorAttachment.get_imageInfo().imageLayout,
-						   prefilterMap.get_image(), prefilterMap.get_imageInfo().imageLayout, 1, &copyRegion);
-		}
+void Environment::finishBake()
+{
+	OPTICK_EVENT();
 
-		mipsize /= 2;
-	}
+	assert(bake && bake->recorded);
 
-	prefilterMap.transferLayout(cmdBuffer, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_SHADER_READ_BIT,
-								 VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+	IrradianceSH sh;
+	void* data;
+	vmaMapMemory(bake->coefficients.allocator, bake->coefficients.allocation, &data);
+	vmaInvalidateAllocation(bake->coefficients.allocator, bake->coefficients.allocation, 0, VK_WHOLE_SIZE);
+	memcpy(&sh, data, sizeof(IrradianceSH));
+	vmaUnmapMemory(bake->coefficients.allocator, bake->coefficients.allocation);
+	irradianceSH.write(sh);
 
-	context->flushCommandBuffer(cmdBuffer);
+	if (!bake->cacheFile.empty())
+	{
+		// The coefficients are cached as a 9x1 image.
+		IblImage shImage;
+		shImage.width = 9;
+		shImage.height = 1;
+		shImage.layerCount = 1;
+		shImage.miplevels = 1;
+		shImage.format = VK_FORMAT_R32G32B32A32_SFLOAT;
+		shImage.data.resize(sizeof(IrradianceSH));
+		memcpy(shImage.data.data(), &sh, sizeof(IrradianceSH));
+
+		std::vector<IblImage> images;
+		images.push_back(std::move(shImage));
+		images.push_back(finishIblDownload(std::move(bake->prefilteredReadback)));
+		writeIblCache(bake->cacheFile, bake->cacheKey, images);
+	}
 
-	return prefilterMap;
+	bake.reset();
 }
 
 Texture2D Environment::createBrdfLut(const Context* context)
 {
 	OPTICK_EVENT();
 
-	const uint32_t dim = 512;
+	const uint32_t dim = BRDF_LUT_DIM;
 
 	spirv::Shader shader;
 	spirv::Pipeline pipeline;
@@ -497,7 +309,7 @@ Texture2D Environment::createBrdfLut(const Context* context)
 	id2d.format = VK_FORMAT_R16G16B16A16_SFLOAT;
 	id2d.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 	id2d.access = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-	id2d.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	id2d.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
 	id2d.samplerAddressMode = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
 	Texture2D lut(context, id2d, false);
 
@@ -629,7 +441,104 @@ Texture2D Environment::createBrdfLut(const Context* context)
 	return lut;
 }
 
-Environment::Environment(const Context* context, TextureCube&& skybox, spirv::SetSingleton* environment)
+TextureCube Environment::createCachedCube(const Context* context, const IblImage& image)
+{
+	ImageDataCube idc{};
+	idc.width = image.width;
+	idc.height = image.height;
+	idc.numChannels = 4;
+	idc.format = image.format;
+	idc.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	idc.layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	idc.access = VK_ACCESS_TRANSFER_WRITE_BIT;
+	TextureCube cube(context, idc, image.miplevels > 1);
+
+	uploadIblImage(context, cube, image);
+	return cube;
+}
+
+Texture2D Environment::createCachedLut(const Context* context, const IblImage& image)
+{
+	ImageData2D id2d{};
+	id2d.width = image.width;
+	id2d.height = image.height;
+	id2d.numChannels = 4;
+	id2d.format = image.format;
+	id2d.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	id2d.layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	id2d.access = VK_ACCESS_TRANSFER_WRITE_BIT;
+	id2d.samplerAddressMode = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	Texture2D lut(context, id2d, false);
+
+	uploadIblImage(context, lut, image);
+	return lut;
+}
+
+void Environment::loadOrBakeMaps(const Context* context, const std::string& source, bool deferBake)
+{
+	OPTICK_EVENT();
+
+	std::string cacheFile;
+	IblCacheKey key;
+	if (!source.empty())
+	{
+		cacheFile = source.substr(0, source.find_last_of('.')) + std::string(cacheExtension);
+		key.sourceHash = util::hashFile(source);
+		key.version = CACHE_VERSION;
+		key.dims[1] = PREFILTERED_DIM;
+
+		// The coefficients are cached as a 9x1 image.
+		std::vector<IblImage> images;
+		if (readIblCache(cacheFile, key, images) && images.size() == 2 && images[0].width == 9 &&
+			images[0].format == VK_FORMAT_R32G32B32A32_SFLOAT && images[0].data.size() == sizeof(IrradianceSH))
+		{
+			IrradianceSH sh;
+			memcpy(&sh, images[0].data.data(), sizeof(IrradianceSH));
+			irradianceSH = UBO<IrradianceSH>(context, sh);
+			prefilteredMap = createCachedCube(context, images[1]);
+			return;
+		}
+	}
+
+	startBake(context);
+	bake->cacheFile = std::move(cacheFile);
+	bake->cacheKey = key;
+	if (deferBake)
+	{
+		return;
+	}
+
+	auto cmdBuffer = context->startCommandBufferRecord();
+	recordBake(cmdBuffer, bake->sliceCount);
+	context->flushCommandBuffer(cmdBuffer);
+	finishBake();
+}
+
+void Environment::loadOrBakeBrdfLut(const Context* context)
+{
+	OPTICK_EVENT();
+
+	const std::string cacheFile(brdfLutCacheFileName);
+	IblCacheKey key;
+	key.version = BRDF_LUT_CACHE_VERSION;
+	key.dims[2] = BRDF_LUT_DIM;
+
+	std::vector<IblImage> images;
+	if (readIblCache(cacheFile, key, images) && images.size() == 1)
+	{
+		brdfLut = createCachedLut(context, images[0]);
+		return;
+	}
+
+	brdfLut = createBrdfLut(context);
+
+	images.clear();
+	images.push_back(downloadIblImage(context, brdfLut));
+	writeIblCache(cacheFile, key, images);
+}
+
+Environment::Environment(const Context* context, TextureCube&& skybox, spirv::SetSingleton* environment,
+						 const std::string& source, bool deferBake)
 {
 	const spirv::UniformInfo* skyboxInfo = nullptr;
 	const spirv::UniformInfo* irradianceInfo = nullptr;
@@ -641,7 +550,7 @@ Environment::Environment(const Context* context, TextureCube&& skybox, spirv::Se
 		{
 			skyboxInfo = &uniform;
 		}
-		else if (uniform.name == "irradianceMap")
+		else if (uniform.name == "irradianceSH")
 		{
 			irradianceInfo = &uniform;
 		}
@@ -676,21 +585,25 @@ Environment::Environment(const Context* context, TextureCube&& skybox, spirv::Se
 	write.pImageInfo = &this->skybox.get_imageInfo();
 	vkUpdateDescriptorSets(context->get_device(), 1, &write, 0, nullptr);
 
-	this->irradianceMap = createIrradianceCube(context, environment);
+	loadOrBakeMaps(context, source, deferBake);
 
+	VkDescriptorBufferInfo irradianceBufferInfo = irradianceSH.get_descriptorInfo();
 	write.dstBinding = irradianceInfo->binding;
 	write.descriptorType = irradianceInfo->type;
-	write.pImageInfo = &this->irradianceMap.get_imageInfo();
+	write.pImageInfo = nullptr;
+	write.pBufferInfo = &irradianceBufferInfo;
 	vkUpdateDescriptorSets(context->get_device(), 1, &write, 0, nullptr);
+	write.pBufferInfo = nullptr;
 
-	this->prefilteredMap = createPrefilteredCube(context, environment);
-
+	// Still in the layout it is baked in if the bake is deferred.
+	VkDescriptorImageInfo prefilteredImageInfo = this->prefilteredMap.get_imageInfo();
+	prefilteredImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 	write.dstBinding = prefilteredInfo->binding;
 	write.descriptorType = prefilteredInfo->type;
-	write.pImageInfo = &this->prefilteredMap.get_imageInfo();
+	write.pImageInfo = &prefilteredImageInfo;
 	vkUpdateDescriptorSets(context->get_device(), 1, &write, 0, nullptr);
 
-	this->brdfLut = createBrdfLut(context);
+	loadOrBakeBrdfLut(context);
 
 	write.dstBinding = brdfLutInfo->binding;
 	write.descriptorType = brdfLutInfo->type;
@@ -6,6 +6,13 @@
 #include <core/Bindable.hpp>
 #include <core/Texture2D.hpp>
 #include <core/TextureCube.hpp>
+#include <core/UniformBuffer.hpp>
+#include <resource/IblCache.hpp>
+
+#include <glm/glm.hpp>
+#include <memory>
+#include <string>
+#include <vector>
 
 namespace blaze
 {
@@ -14,24 +21,157 @@ namespace blaze
  * @brief Holder for all the environment texture maps and descriptor set.
  *
  * The Environment textures for current renderers are the PBR/IBL maps.
+ *
+ * The maps of the skybox are baked by compute shaders. The prefiltered cube is written directly as
+ * storage, with one dispatch per mip covering all faces, and the diffuse irradiance is kept as 9
+ * spherical harmonics projected from the skybox by a parallel reduction.
+ *
+ * The baked maps are cached on disk. The irradiance and prefiltered cube of a source are kept in an
+ * \a .iblcache file next to it, keyed by the hash of the source and the bake parameters, and the BRDF LUT
+ * which never changes is kept in a single file shared by all environments.
+ *
+ * The bake can also be spread over several frames, to replace an environment in use without stalling.
+ * It is then recorded into the command buffers of the frames a few slices at a time, a slice being one
+ * face of the irradiance projection or of a mip of the prefiltered cube.
  */
 class Environment
 {
+private:
+	/// The version of the irradiance and prefiltered cube caches.
+	constexpr static uint32_t CACHE_VERSION = 2;
+	/// The version of the BRDF LUT cache, bumped separately as it doesn't depend on the environment bake.
+	constexpr static uint32_t BRDF_LUT_CACHE_VERSION = 1;
+	constexpr static uint32_t PREFILTERED_DIM = 128;
+	constexpr static uint32_t BRDF_LUT_DIM = 512;
+	/// Distinct from the \a .ibl descriptors of sIBL sets, which live in the same directories.
+	constexpr static std::string_view cacheExtension = ".iblcache";
+	constexpr static std::string_view brdfLutCacheFileName = "assets/brdfLut.iblcache";
+
+	constexpr static std::string_view prefilterShaderFileName = "shaders/env/cPrefilter.comp.spv";
+	constexpr static std::string_view irradianceShaderFileName = "shaders/env/cIrradianceSH.comp.spv";
+	constexpr static std::string_view irradianceReduceShaderFileName = "shaders/env/cIrradianceSHReduce.comp.spv";
+	constexpr static uint32_t PREFILTER_GROUP_SIZE = 8;
+	/// Each group of the projection sums 8x8 invocations of 2x2 texels.
+	constexpr static uint32_t IRRADIANCE_TILE_SIZE = 16;
+
 public:
+	/**
+	 * @brief The irradiance coefficients as bound to the environment set.
+	 *
+	 * Scaled by the convolution of each band, so that the sum of the coefficients times the basis is the
+	 * irradiance over PI.
+	 */
+	struct IrradianceSH
+	{
+		alignas(16) glm::vec4 coefficients[9];
+	};
+
 	TextureCube skybox;
-	TextureCube irradianceMap;
+	UBO<IrradianceSH> irradianceSH;
 	TextureCube prefilteredMap;
 	Texture2D brdfLut;
 
+private:
+	/**
+	 * @brief The state of a bake of the irradiance and the prefiltered cube.
+	 */
+	struct Bake
+	{
+		const Context* context{nullptr};
+
+		spirv::Shader projectShader;
+		spirv::Shader reduceShader;
+		spirv::Shader prefilterShader;
+		spirv::Pipeline projectPipeline;
+		spirv::Pipeline reducePipeline;
+		spirv::Pipeline prefilterPipeline;
+
+		spirv::SetSingleton projectSet;
+		spirv::SetSingleton reduceSet;
+		/// A set per mip of the prefiltered cube, with the six faces as layers.
+		std::vector<spirv::SetSingleton> prefilterSets;
+		vkw::ImageViewVector mipViews;
+
+		/// The sums of every group of the projection, summed by a single group after.
+		vkw::Buffer partials;
+		vkw::Buffer coefficients;
+		uint32_t projectGroups{0};
+
+		uint32_t nextSlice{0};
+		uint32_t sliceCount{0};
+		bool recorded{false};
+
+		/// The cache to write once baked, none if empty.
+		std::string cacheFile;
+		IblCacheKey cacheKey;
+		IblReadback prefilteredReadback;
+	};
+
+	std::unique_ptr<Bake> bake;
+
+public:
 	Environment()
 	{
 	}
 
-	Environment(const Context* context, TextureCube&& skybox, spirv::SetSingleton* environment);
+	/**
+	 * @brief Main constructor.
+	 *
+	 * @param context The Vulkan Context in use.
+	 * @param skybox The environment cube.
+	 * @param environment The environment set to write the maps to.
+	 * @param source The file the skybox was loaded from, to cache the maps for. Not cached if empty.
+	 * @param deferBake Leaves the irradiance and prefiltered cube to be baked by recordBake, instead of before
+	 * returning. Ignored if they are loaded from the cache.
+	 */
+	Environment(const Context* context, TextureCube&& skybox, spirv::SetSingleton* environment,
+				const std::string& source = {}, bool deferBake = false);
+
+	/**
+	 * @brief Checks if the maps are still being baked, until which the environment must not be drawn with.
+	 */
+	bool isBaking() const
+	{
+		return bake != nullptr;
+	}
+
+	/**
+	 * @brief Records the next slices of the bake.
+	 *
+	 * @param cmdBuffer The command buffer to record into.
+	 * @param sliceCount The number of slices to record.
+	 *
+	 * @returns \a true If the last slices were recorded, after which the bake is ended by finishBake once
+	 * \a cmdBuffer has completed.
+	 * @returns \a false If slices remain to be recorded.
+	 */
+	bool recordBake(VkCommandBuffer cmdBuffer, uint32_t sliceCount);
+
+	/**
+	 * @brief Reads back the irradiance and caches the maps, once the last slices have completed.
+	 */
+	void finishBake();
 
 private:
-	TextureCube createIrradianceCube(const Context* context, spirv::SetSingleton* environment);
-	TextureCube createPrefilteredCube(const Context* context, spirv::SetSingleton* environment);
+	/**
+	 * @brief Creates the prefiltered cube and the irradiance buffer, and everything needed to bake them.
+	 */
+	void startBake(const Context* context);
 	Texture2D createBrdfLut(const Context* context);
+
+	/**
+	 * @brief Loads the irradiance and prefiltered cube from the cache of \a source, or starts baking them.
+	 *
+	 * The bake is finished before returning unless \a deferBake is set.
+	 */
+	void loadOrBakeMaps(const Context* context, const std::string& source, bool deferBake);
+
+	/**
+	 * @brief Loads the BRDF LUT from its cache, or bakes and caches it.
+	 */
+	void loadOrBakeBrdfLut(const Context* context);
+
+	static TextureCube createCachedCube(const Context* context, const IblImage& image);
+	static Texture2D createCachedLut(const Context* context, const IblImage& image);
 };
 } // namespace blaze::util
@@ -0,0 +1,334 @@
+#include "IblCache.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#include <thirdparty/optick/optick.h>
+
+namespace blaze
+{
+namespace
+{
+constexpr char MAGIC[4] = {'B', 'I', 'B', 'L'};
+
+uint32_t getTexelSize(VkFormat format)
+{
+	switch (format)
+	{
+	case VK_FORMAT_R8G8B8A8_UNORM:
+		return 4;
+	case VK_FORMAT_R16G16B16A16_SFLOAT:
+		return 8;
+	case VK_FORMAT_R32G32B32A32_SFLOAT:
+		return 16;
+	default:
+		throw std::invalid_argument("Format " + std::to_string(format) + " can't be cached.");
+	}
+}
+
+size_t getMipSize(const IblImage& image, uint32_t miplevel)
+{
+	size_t width = std::max(image.width >> miplevel, 1u);
+	size_t height = std::max(image.height >> miplevel, 1u);
+	return width * height * image.layerCount * getTexelSize(image.format);
+}
+
+size_t getSize(const IblImage& image)
+{
+	size_t size = 0;
+	for (uint32_t mip = 0; mip < image.miplevels; mip++)
+	{
+		size += getMipSize(image, mip);
+	}
+	return size;
+}
+
+template <typename T>
+void write(std::ofstream& file, const T& value)
+{
+	file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+void read(std::ifstream& file, T& value)
+{
+	file.read(reinterpret_cast<char*>(&value), sizeof(T));
+}
+
+/**
+ * @brief A copy region per mip, each covering all the layers, in the order of IblImage::data.
+ */
+std::vector<VkBufferImageCopy> getRegions(const IblImage& image)
+{
+	std::vector<VkBufferImageCopy> regions(image.miplevels);
+	VkDeviceSize offset = 0;
+	for (uint32_t mip = 0; mip < image.miplevels; mip++)
+	{
+		auto& region = regions[mip];
+		region.bufferOffset = offset;
+		region.bufferRowLength = 0;
+		region.bufferImageHeight = 0;
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = mip;
+		region.imageSubresource.baseArrayLayer = 0;
+		region.imageSubresource.layerCount = image.layerCount;
+		region.imageOffset = {0, 0, 0};
+		region.imageExtent = {std::max(image.width >> mip, 1u), std::max(image.height >> mip, 1u), 1};
+		offset += getMipSize(image, mip);
+	}
+	return regions;
+}
+
+template <typename Texture>
+IblReadback recordDownload(const Context* context, VkCommandBuffer cmdBuffer, Texture& texture, uint32_t layerCount)
+{
+	OPTICK_EVENT();
+
+	IblReadback readback;
+	IblImage& image = readback.image;
+	image.width = texture.get_width();
+	image.height = texture.get_height();
+	image.layerCount = layerCount;
+	image.miplevels = texture.get_miplevels();
+	image.format = texture.get_format();
+
+	readback.buffer =
+		context->createBuffer(getSize(image), VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_TO_CPU);
+	auto regions = getRegions(image);
+
+	VkImageLayout layout = texture.get_layout();
+	VkAccessFlags access = texture.get_access();
+
+	texture.transferLayout(cmdBuffer, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_TRANSFER_READ_BIT,
+						   VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+	vkCmdCopyImageToBuffer(cmdBuffer, texture.get_image(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+						   readback.buffer.handle, static_cast<uint32_t>(regions.size()), regions.data());
+	texture.transferLayout(cmdBuffer, layout, access, VK_PIPELINE_STAGE_TRANSFER_BIT,
+						   VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0,
+						 nullptr, 0, nullptr);
+
+	return readback;
+}
+
+template <typename Texture>
+void upload(const Context* context, Texture& texture, const IblImage& image, uint32_t layerCount)
+{
+	OPTICK_EVENT();
+
+	if (image.width != texture.get_width() || image.height != texture.get_height() ||
+		image.layerCount != layerCount || image.miplevels != texture.get_miplevels() ||
+		image.format != texture.get_format())
+	{
+		throw std::invalid_argument("Cached image does not match the texture.");
+	}
+	assert(image.data.size() == getSize(image));
+
+	auto buffer =
+		context->createBuffer(image.data.size(), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
+	void* data;
+	vmaMapMemory(buffer.allocator, buffer.allocation, &data);
+	memcpy(data, image.data.data(), image.data.size());
+	vmaUnmapMemory(buffer.allocator, buffer.allocation);
+
+	auto regions = getRegions(image);
+
+	auto cmdBuffer = context->startCommandBufferRecord();
+	texture.transferLayout(cmdBuffer, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT,
+						   VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+	vkCmdCopyBufferToImage(cmdBuffer, buffer.handle, texture.get_image(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+						   static_cast<uint32_t>(regions.size()), regions.data());
+	texture.transferLayout(cmdBuffer, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_SHADER_READ_BIT,
+						   VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+	context->flushCommandBuffer(cmdBuffer);
+}
+} // namespace
+
+bool IblCacheKey::operator==(const IblCacheKey& other) const
+{
+	return sourceHash == other.sourceHash && version == other.version && dims[0] == other.dims[0] &&
+		   dims[1] == other.dims[1] && dims[2] == other.dims[2];
+}
+
+bool IblCacheKey::operator!=(const IblCacheKey& other) const
+{
+	return !(*this == other);
+}
+
+bool readIblCache(const std::string& filename, const IblCacheKey& key, std::vector<IblImage>& images)
+{
+	OPTICK_EVENT();
+
+	images.clear();
+	std::ifstream file(filename, std::ios::binary);
+	if (!file.is_open())
+	{
+		return false;
+	}
+
+	char magic[4];
+	file.read(magic, sizeof(magic));
+	if (!file || memcmp(magic, MAGIC, sizeof(MAGIC)) != 0)
+	{
+		return false;
+	}
+
+	IblCacheKey fileKey;
+	read(file, fileKey.sourceHash);
+	read(file, fileKey.version);
+	read(file, fileKey.dims);
+	uint32_t imageCount = 0;
+	read(file, imageCount);
+	if (!file || fileKey != key)
+	{
+		return false;
+	}
+
+	try
+	{
+		images.resize(imageCount);
+		for (auto& image : images)
+		{
+			uint64_t size = 0;
+			read(file, image.width);
+			read(file, image.height);
+			read(file, image.layerCount);
+			read(file, image.miplevels);
+			read(file, image.format);
+			read(file, size);
+			if (!file || image.miplevels == 0 || image.miplevels > 32 || size != getSize(image))
+			{
+				images.clear();
+				return false;
+			}
+			image.data.resize(size);
+			file.read(reinterpret_cast<char*>(image.data.data()), size);
+		}
+	}
+	catch (std::exception&)
+	{
+		// An unknown format or a size too large to allocate is a corrupt file.
+		images.clear();
+		return false;
+	}
+
+	if (!file)
+	{
+		images.clear();
+		return false;
+	}
+	return true;
+}
+
+void writeIblCache(const std::string& filename, const IblCacheKey& key, const std::vector<IblImage>& images)
+{
+	OPTICK_EVENT();
+
+	// Write a temporary file first, so a partially written cache never replaces a complete one.
+	const std::string tempname = filename + ".tmp";
+	{
+		std::ofstream file(tempname, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			std::cerr << "IBL cache " << tempname << " could not be opened for writing." << std::endl;
+			return;
+		}
+
+		file.write(MAGIC, sizeof(MAGIC));
+		write(file, key.sourceHash);
+		write(file, key.version);
+		write(file, key.dims);
+		write(file, static_cast<uint32_t>(images.size()));
+		for (const auto& image : images)
+		{
+			assert(image.data.size() == getSize(image));
+			write(file, image.width);
+			write(file, image.height);
+			write(file, image.layerCount);
+			write(file, image.miplevels);
+			write(file, image.format);
+			write(file, static_cast<uint64_t>(image.data.size()));
+			file.write(reinterpret_cast<const char*>(image.data.data()), image.data.size());
+		}
+
+		if (!file)
+		{
+			std::cerr << "IBL cache " << tempname << " could not be written." << std::endl;
+			file.close();
+			std::error_code ec;
+			std::filesystem::remove(tempname, ec);
+			return;
+		}
+	}
+
+	std::error_code ec;
+	std::filesystem::rename(tempname, filename, ec);
+	if (ec)
+	{
+		std::cerr << "IBL cache " << filename << " could not be replaced: " << ec.message() << std::endl;
+		std::filesystem::remove(tempname, ec);
+	}
+}
+
+IblReadback recordIblDownload(const Context* context, VkCommandBuffer cmdBuffer, TextureCube& texture)
+{
+	return recordDownload(context, cmdBuffer, texture, 6);
+}
+
+IblReadback recordIblDownload(const Context* context, VkCommandBuffer cmdBuffer, Texture2D& texture)
+{
+	return recordDownload(context, cmdBuffer, texture, texture.get_layerCount());
+}
+
+IblImage finishIblDownload(IblReadback&& readback)
+{
+	OPTICK_EVENT();
+
+	IblImage image = std::move(readback.image);
+	image.data.resize(getSize(image));
+
+	void* data;
+	vmaMapMemory(readback.buffer.allocator, readback.buffer.allocation, &data);
+	vmaInvalidateAllocation(readback.buffer.allocator, readback.buffer.allocation, 0, VK_WHOLE_SIZE);
+	memcpy(image.data.data(), data, image.data.size());
+	vmaUnmapMemory(readback.buffer.allocator, readback.buffer.allocation);
+
+	readback.buffer = vkw::Buffer();
+	return image;
+}
+
+IblImage downloadIblImage(const Context* context, TextureCube& texture)
+{
+	auto cmdBuffer = context->startCommandBufferRecord();
+	auto readback = recordIblDownload(context, cmdBuffer, texture);
+	context->flushCommandBuffer(cmdBuffer);
+	return finishIblDownload(std::move(readback));
+}
+
+IblImage downloadIblImage(const Context* context, Texture2D& texture)
+{
+	auto cmdBuffer = context->startCommandBufferRecord();
+	auto readback = recordIblDownload(context, cmdBuffer, texture);
+	context->flushCommandBuffer(cmdBuffer);
+	return finishIblDownload(std::move(readback));
+}
+
+void uploadIblImage(const Context* context, TextureCube& texture, const IblImage& image)
+{
+	upload(context, texture, image, 6);
+}
+
+void uploadIblImage(const Context* context, Texture2D& texture, const IblImage& image)
+{
+	upload(context, texture, image, texture.get_layerCount());
+}
+} // namespace blaze
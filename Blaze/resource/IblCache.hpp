@@ -0,0 +1,113 @@
+#pragma once
+
+#include <core/Context.hpp>
+#include <core/Texture2D.hpp>
+#include <core/TextureCube.hpp>
+
+#include <string>
+#include <vector>
+
+namespace blaze
+{
+/**
+ * @brief The key a cache file was baked for, any difference invalidates the file.
+ */
+struct IblCacheKey
+{
+	/// The hash of the source file, 0 for maps that don't depend on a source.
+	uint64_t sourceHash{0};
+	/// The version of the baking, to be bumped when the shaders or the layout change.
+	uint32_t version{0};
+	/// The sizes the maps were baked at.
+	uint32_t dims[3]{0, 0, 0};
+
+	bool operator==(const IblCacheKey& other) const;
+	bool operator!=(const IblCacheKey& other) const;
+};
+
+/**
+ * @brief The texels of one baked image on the host.
+ *
+ * The texels are tightly packed, mip by mip and layer by layer inside each mip.
+ */
+struct IblImage
+{
+	uint32_t width{0};
+	uint32_t height{0};
+	uint32_t layerCount{0};
+	uint32_t miplevels{0};
+	VkFormat format{VK_FORMAT_UNDEFINED};
+	std::vector<uint8_t> data;
+};
+
+/**
+ * @brief A download recorded into a command buffer, finished once the command buffer has completed.
+ */
+struct IblReadback
+{
+	/// The image without its texels.
+	IblImage image;
+	vkw::Buffer buffer;
+};
+
+/**
+ * @brief Reads the images of a cache file.
+ *
+ * @param filename The path of the cache file.
+ * @param key The key the images must have been baked for.
+ * @param images The images read, in the order they were written.
+ *
+ * @returns \a true If the file exists, matches the key and is complete.
+ * @returns \a false Otherwise, in which case the maps must be baked.
+ */
+bool readIblCache(const std::string& filename, const IblCacheKey& key, std::vector<IblImage>& images);
+
+/**
+ * @brief Writes images to a cache file, replacing the file only once it is complete.
+ *
+ * Failures are reported and ignored, as the maps can always be baked again.
+ *
+ * @param filename The path of the cache file.
+ * @param key The key the images were baked for.
+ * @param images The images to write.
+ */
+void writeIblCache(const std::string& filename, const IblCacheKey& key, const std::vector<IblImage>& images);
+
+/**
+ * @name Transfers.
+ *
+ * @brief Copies all the mips and layers of a texture to and from the host.
+ *
+ * Both wait for the copy to finish. The texture must have the transfer usage of the copy and is
+ * left in its layout before a download, and in the shader read layout after an upload.
+ *
+ * @{
+ */
+[[nodiscard]] IblImage downloadIblImage(const Context* context, TextureCube& texture);
+[[nodiscard]] IblImage downloadIblImage(const Context* context, Texture2D& texture);
+void uploadIblImage(const Context* context, TextureCube& texture, const IblImage& image);
+void uploadIblImage(const Context* context, Texture2D& texture, const IblImage& image);
+/**
+ * @}
+ */
+
+/**
+ * @name Recorded downloads.
+ *
+ * @brief Records the copy of all the mips and layers of a texture to the host without waiting for it.
+ *
+ * The texture is left in its layout. The texels are read by finishIblDownload once \a cmdBuffer has completed.
+ *
+ * @{
+ */
+[[nodiscard]] IblReadback recordIblDownload(const Context* context, VkCommandBuffer cmdBuffer, TextureCube& texture);
+[[nodiscard]] IblReadback recordIblDownload(const Context* context, VkCommandBuffer cmdBuffer, Texture2D& texture);
+/**
+ * @}
+ */
+
+/**
+ * @brief Reads the texels of a recorded download, whose command buffer must have completed.
+ */
+[[nodiscard]] IblImage finishIblDownload(IblReadback&& readback);
+} // namespace blaze
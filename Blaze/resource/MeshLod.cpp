@@ -0,0 +1,331 @@
+#include "MeshLod.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+namespace blaze
+{
+namespace
+{
+/**
+ * @brief Symmetric 4x4 error quadric, scaled by the accumulated triangle area.
+ */
+struct Quadric
+{
+	double a00{0}, a01{0}, a02{0}, a03{0};
+	double a11{0}, a12{0}, a13{0};
+	double a22{0}, a23{0};
+	double a33{0};
+	double weight{0};
+
+	static Quadric fromPlane(const glm::dvec3& n, double d, double w)
+	{
+		Quadric q;
+		q.a00 = w * n.x * n.x;
+		q.a01 = w * n.x * n.y;
+		q.a02 = w * n.x * n.z;
+		q.a03 = w * n.x * d;
+		q.a11 = w * n.y * n.y;
+		q.a12 = w * n.y * n.z;
+		q.a13 = w * n.y * d;
+		q.a22 = w * n.z * n.z;
+		q.a23 = w * n.z * d;
+		q.a33 = w * d * d;
+		q.weight = w;
+		return q;
+	}
+
+	Quadric& operator+=(const Quadric& o)
+	{
+		a00 += o.a00;
+		a01 += o.a01;
+		a02 += o.a02;
+		a03 += o.a03;
+		a11 += o.a11;
+		a12 += o.a12;
+		a13 += o.a13;
+		a22 += o.a22;
+		a23 += o.a23;
+		a33 += o.a33;
+		weight += o.weight;
+		return *this;
+	}
+
+	/// Area weighted mean squared distance of \a p to the planes.
+	double evaluate(const glm::vec3& p) const
+	{
+		double x = p.x, y = p.y, z = p.z;
+		double r = a00 * x * x + 2 * a01 * x * y + 2 * a02 * x * z + 2 * a03 * x + a11 * y * y + 2 * a12 * y * z +
+				   2 * a13 * y + a22 * z * z + 2 * a23 * z + a33;
+		return weight > 0 ? std::abs(r) / weight : 0.0;
+	}
+};
+
+struct Collapse
+{
+	uint32_t from;
+	uint32_t to;
+	double cost;
+};
+
+/// Maps every vertex to the smallest vertex index with the same position.
+std::vector<uint32_t> weldPositions(const Vertex* vertices, uint32_t vertexCount)
+{
+	std::vector<uint32_t> order(vertexCount);
+	std::iota(order.begin(), order.end(), 0u);
+	auto less = [vertices](uint32_t a, uint32_t b) {
+		const glm::vec3& pa = vertices[a].position;
+		const glm::vec3& pb = vertices[b].position;
+		if (pa.x != pb.x)
+			return pa.x < pb.x;
+		if (pa.y != pb.y)
+			return pa.y < pb.y;
+		if (pa.z != pb.z)
+			return pa.z < pb.z;
+		return a < b;
+	};
+	std::sort(order.begin(), order.end(), less);
+
+	std::vector<uint32_t> canonical(vertexCount);
+	for (uint32_t i = 0; i < vertexCount; i++)
+	{
+		bool same = i > 0 && vertices[order[i]].position == vertices[order[i - 1]].position;
+		canonical[order[i]] = same ? canonical[order[i - 1]] : order[i];
+	}
+	return canonical;
+}
+
+bool flipsTriangle(const glm::vec3& moved, const glm::vec3& target, const glm::vec3& b, const glm::vec3& c)
+{
+	glm::vec3 before = glm::cross(b - moved, c - moved);
+	glm::vec3 after = glm::cross(b - target, c - target);
+	return glm::dot(before, after) <= 0.0f;
+}
+} // namespace
+
+std::vector<uint32_t> simplifyMesh(const std::vector<uint32_t>& indices, const Vertex* vertices,
+								   uint32_t targetIndexCount, float& error)
+{
+	using namespace std;
+
+	error = 0.0f;
+	vector<uint32_t> result(indices.begin(), indices.begin() + (indices.size() / 3) * 3);
+	if (result.size() <= targetIndexCount)
+	{
+		return result;
+	}
+
+	uint32_t vertexCount = 0;
+	for (uint32_t index : result)
+	{
+		vertexCount = max(vertexCount, index + 1);
+	}
+
+	// Seams and borders are locked.
+	vector<uint32_t> canonical = weldPositions(vertices, vertexCount);
+	vector<uint8_t> locked(vertexCount, 0);
+	vector<uint32_t> copies(vertexCount, 0);
+	for (uint32_t v = 0; v < vertexCount; v++)
+	{
+		copies[canonical[v]]++;
+	}
+	for (uint32_t v = 0; v < vertexCount; v++)
+	{
+		locked[v] = copies[canonical[v]] > 1;
+	}
+	{
+		vector<pair<uint32_t, uint32_t>> edges;
+		edges.reserve(result.size());
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			for (uint32_t k = 0; k < 3; k++)
+			{
+				uint32_t a = canonical[result[i + k]];
+				uint32_t b = canonical[result[i + (k + 1) % 3]];
+				edges.emplace_back(min(a, b), max(a, b));
+			}
+		}
+		sort(edges.begin(), edges.end());
+		for (size_t i = 0; i < edges.size();)
+		{
+			size_t j = i;
+			while (j < edges.size() && edges[j] == edges[i])
+			{
+				j++;
+			}
+			if (j - i != 2)
+			{
+				locked[edges[i].first] = 1;
+				locked[edges[i].second] = 1;
+			}
+			i = j;
+		}
+		for (uint32_t v = 0; v < vertexCount; v++)
+		{
+			locked[v] |= locked[canonical[v]];
+		}
+	}
+
+	vector<Quadric> quadrics(vertexCount);
+	// The planes of the original triangles around each vertex, and the vertices collapsed into it, to measure
+	// how far the surface has moved.
+	vector<glm::dvec4> planes;
+	vector<vector<uint32_t>> vertexPlanes(vertexCount);
+	for (size_t i = 0; i < result.size(); i += 3)
+	{
+		glm::dvec3 p0 = vertices[result[i]].position;
+		glm::dvec3 p1 = vertices[result[i + 1]].position;
+		glm::dvec3 p2 = vertices[result[i + 2]].position;
+		glm::dvec3 n = glm::cross(p1 - p0, p2 - p0);
+		double area = glm::length(n);
+		if (area <= 0.0)
+		{
+			continue;
+		}
+		n /= area;
+		Quadric q = Quadric::fromPlane(n, -glm::dot(n, p0), area * 0.5);
+		const uint32_t plane = static_cast<uint32_t>(planes.size());
+		planes.emplace_back(n, -glm::dot(n, p0));
+		for (uint32_t k = 0; k < 3; k++)
+		{
+			quadrics[result[i + k]] += q;
+			vertexPlanes[result[i + k]].push_back(plane);
+		}
+	}
+
+	vector<uint32_t> adjacencyOffsets(vertexCount + 1);
+	vector<uint32_t> adjacency;
+	vector<Collapse> collapses;
+	vector<uint32_t> remap(vertexCount);
+	vector<uint8_t> touched(vertexCount);
+	double maxDistance = 0.0;
+
+	while (result.size() > targetIndexCount)
+	{
+		const uint32_t triangleCount = static_cast<uint32_t>(result.size() / 3);
+
+		// Vertex to triangle adjacency (CSR) of the current mesh.
+		fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0u);
+		for (uint32_t index : result)
+		{
+			adjacencyOffsets[index + 1]++;
+		}
+		partial_sum(adjacencyOffsets.begin(), adjacencyOffsets.end(), adjacencyOffsets.begin());
+		adjacency.resize(result.size());
+		{
+			vector<uint32_t> cursor(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+			for (uint32_t i = 0; i < triangleCount * 3; i++)
+			{
+				adjacency[cursor[result[i]]++] = i / 3;
+			}
+		}
+
+		collapses.clear();
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			for (uint32_t k = 0; k < 3; k++)
+			{
+				uint32_t a = result[i + k];
+				uint32_t b = result[i + (k + 1) % 3];
+				if (a > b || (locked[a] && locked[b]))
+				{
+					continue;
+				}
+				Quadric q = quadrics[a];
+				q += quadrics[b];
+				double costAB = locked[a] ? numeric_limits<double>::max() : q.evaluate(vertices[b].position);
+				double costBA = locked[b] ? numeric_limits<double>::max() : q.evaluate(vertices[a].position);
+				collapses.push_back(costAB <= costBA ? Collapse{a, b, costAB} : Collapse{b, a, costBA});
+			}
+		}
+		sort(collapses.begin(), collapses.end(),
+			 [](const Collapse& x, const Collapse& y) { return x.cost < y.cost; });
+
+		iota(remap.begin(), remap.end(), 0u);
+		fill(touched.begin(), touched.end(), 0);
+
+		// Each collapse removes about two triangles.
+		const size_t collapseBudget = (result.size() - targetIndexCount) / 6 + 1;
+		size_t collapseCount = 0;
+		for (const Collapse& collapse : collapses)
+		{
+			if (collapseCount >= collapseBudget)
+			{
+				break;
+			}
+			if (touched[collapse.from] || touched[collapse.to])
+			{
+				continue;
+			}
+
+			const glm::vec3& from = vertices[collapse.from].position;
+			const glm::vec3& to = vertices[collapse.to].position;
+			bool flips = false;
+			for (uint32_t a = adjacencyOffsets[collapse.from]; a < adjacencyOffsets[collapse.from + 1] && !flips; a++)
+			{
+				const uint32_t* tri = &result[adjacency[a] * 3];
+				if (tri[0] == collapse.to || tri[1] == collapse.to || tri[2] == collapse.to)
+				{
+					continue;
+				}
+				uint32_t k = tri[0] == collapse.from ? 0 : (tri[1] == collapse.from ? 1 : 2);
+				flips = flipsTriangle(from, to, vertices[tri[(k + 1) % 3]].position,
+									  vertices[tri[(k + 2) % 3]].position);
+			}
+			if (flips)
+			{
+				continue;
+			}
+
+			// The one ring of the collapsed vertex changes shape, so it stays fixed for the rest of the pass.
+			for (uint32_t a = adjacencyOffsets[collapse.from]; a < adjacencyOffsets[collapse.from + 1]; a++)
+			{
+				const uint32_t* tri = &result[adjacency[a] * 3];
+				touched[tri[0]] = touched[tri[1]] = touched[tri[2]] = 1;
+			}
+
+			remap[collapse.from] = collapse.to;
+			quadrics[collapse.to] += quadrics[collapse.from];
+
+			// The surface around the collapsed vertex now passes through the target. The quadric cost is a mean
+			// of squared distances, so the largest distance is taken from the planes themselves.
+			const glm::dvec3 target = to;
+			vector<uint32_t>& toPlanes = vertexPlanes[collapse.to];
+			for (uint32_t plane : vertexPlanes[collapse.from])
+			{
+				maxDistance = max(maxDistance, abs(glm::dot(glm::dvec3(planes[plane]), target) + planes[plane].w));
+				toPlanes.push_back(plane);
+			}
+			vertexPlanes[collapse.from].clear();
+			sort(toPlanes.begin(), toPlanes.end());
+			toPlanes.erase(unique(toPlanes.begin(), toPlanes.end()), toPlanes.end());
+			collapseCount++;
+		}
+
+		if (collapseCount == 0)
+		{
+			break;
+		}
+
+		size_t write = 0;
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			uint32_t a = remap[result[i]];
+			uint32_t b = remap[result[i + 1]];
+			uint32_t c = remap[result[i + 2]];
+			if (a != b && b != c && c != a)
+			{
+				result[write++] = a;
+				result[write++] = b;
+				result[write++] = c;
+			}
+		}
+		result.resize(write);
+	}
+
+	error = static_cast<float>(maxDistance);
+	return result;
+}
+} // namespace blaze
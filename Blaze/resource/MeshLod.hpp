@@ -0,0 +1,29 @@
+#pragma once
+
+#include <Datatypes.hpp>
+#include <vector>
+
+namespace blaze
+{
+/**
+ * @fn simplifyMesh
+ *
+ * @brief Simplifies a triangle list with quadric error metrics, keeping the original vertices.
+ *
+ * Edges are collapsed onto one of their endpoints in the order of the error they
+ * introduce (Garland, Heckbert - Surface Simplification Using Quadric Error Metrics).
+ * Vertices on mesh borders and on attribute seams (vertices sharing a position) are
+ * never moved so that the simplified mesh stays watertight and the UVs stay intact.
+ *
+ * @param indices The triangle list indices, local to \a vertices.
+ * @param vertices The vertices referenced by \a indices.
+ * @param targetIndexCount The number of indices to stop at.
+ * @param error Receives the largest distance the surface has moved, in model units. It is measured as the
+ *              largest distance of a collapsed vertex's target from the planes of the original triangles
+ *              around the vertex.
+ *
+ * @returns The indices of the simplified triangle list, referencing the same vertices.
+ */
+std::vector<uint32_t> simplifyMesh(const std::vector<uint32_t>& indices, const Vertex* vertices,
+								   uint32_t targetIndexCount, float& error);
+} // namespace blaze
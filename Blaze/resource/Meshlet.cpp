@@ -0,0 +1,195 @@
+#include "Meshlet.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace blaze
+{
+namespace
+{
+enum TriangleState : uint8_t
+{
+	FREE = 0,
+	QUEUED = 1,
+	USED = 2,
+};
+
+Meshlet createMeshletBounds(const uint32_t* indices, uint32_t indexCount, const Vertex* vertices,
+							bool allowConeCulling)
+{
+	glm::vec3 lo(std::numeric_limits<float>::max());
+	glm::vec3 hi(std::numeric_limits<float>::lowest());
+	for (uint32_t i = 0; i < indexCount; i++)
+	{
+		lo = glm::min(lo, vertices[indices[i]].position);
+		hi = glm::max(hi, vertices[indices[i]].position);
+	}
+
+	glm::vec3 center = 0.5f * (lo + hi);
+	float radius = 0.0f;
+	for (uint32_t i = 0; i < indexCount; i++)
+	{
+		radius = std::max(radius, glm::distance(center, vertices[indices[i]].position));
+	}
+
+	// Normal cone from the face normals.
+	// Ref: https://github.com/zeux/meshoptimizer (meshopt_computeClusterBounds)
+	glm::vec3 axis(0.0f);
+	std::vector<glm::vec3> normals;
+	normals.reserve(indexCount / 3);
+	for (uint32_t i = 0; i + 2 < indexCount; i += 3)
+	{
+		const glm::vec3& a = vertices[indices[i]].position;
+		const glm::vec3& b = vertices[indices[i + 1]].position;
+		const glm::vec3& c = vertices[indices[i + 2]].position;
+		glm::vec3 n = glm::cross(b - a, c - a);
+		float len = glm::length(n);
+		if (len > 0.0f)
+		{
+			normals.push_back(n / len);
+			axis += n / len;
+		}
+	}
+
+	float cutoff = 1.0f;
+	float axisLength = glm::length(axis);
+	if (allowConeCulling && axisLength > 0.0f)
+	{
+		axis /= axisLength;
+		float minDot = 1.0f;
+		for (auto& n : normals)
+		{
+			minDot = std::min(minDot, glm::dot(n, axis));
+		}
+		// Cones wider than ~84 degrees are practically never culled.
+		cutoff = (minDot <= 0.1f) ? 1.0f : std::sqrt(1.0f - minDot * minDot);
+	}
+	if (cutoff >= 1.0f)
+	{
+		axis = glm::vec3(0.0f);
+	}
+
+	Meshlet meshlet = {};
+	meshlet.sphere = glm::vec4(center, radius);
+	meshlet.cone = glm::vec4(axis, cutoff);
+	return meshlet;
+}
+} // namespace
+
+std::vector<Meshlet> buildMeshlets(std::vector<uint32_t>& indices, const Vertex* vertices, uint32_t firstIndex,
+								   int32_t vertexOffset, uint32_t primitive, bool allowConeCulling,
+								   uint32_t maxTriangles)
+{
+	using namespace std;
+
+	const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+	if (triangleCount == 0 || maxTriangles == 0)
+	{
+		return {};
+	}
+
+	uint32_t vertexCount = 0;
+	for (uint32_t index : indices)
+	{
+		vertexCount = max(vertexCount, index + 1);
+	}
+
+	// Vertex to triangle adjacency (CSR)
+	vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+	for (uint32_t i = 0; i < triangleCount * 3; i++)
+	{
+		adjacencyOffsets[indices[i] + 1]++;
+	}
+	for (uint32_t v = 0; v < vertexCount; v++)
+	{
+		adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+	}
+	vector<uint32_t> adjacency(adjacencyOffsets.back());
+	{
+		vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (uint32_t i = 0; i < triangleCount * 3; i++)
+		{
+			adjacency[fill[indices[i]]++] = i / 3;
+		}
+	}
+
+	vector<uint8_t> state(triangleCount, TriangleState::FREE);
+	vector<uint32_t> reordered;
+	reordered.reserve(indices.size());
+	vector<Meshlet> meshlets;
+	meshlets.reserve(triangleCount / maxTriangles + 1);
+
+	vector<uint32_t> frontier;
+	uint32_t seedCursor = 0;
+	uint32_t emitted = 0;
+
+	while (emitted < triangleCount)
+	{
+		uint32_t meshletStart = static_cast<uint32_t>(reordered.size());
+		uint32_t meshletTriangles = 0;
+
+		frontier.clear();
+		size_t head = 0;
+
+		while (meshletTriangles < maxTriangles && emitted < triangleCount)
+		{
+			if (head == frontier.size())
+			{
+				// Disconnected patches are merged while the meshlet is still small.
+				if (meshletTriangles >= maxTriangles / 2)
+				{
+					break;
+				}
+				while (state[seedCursor] != TriangleState::FREE)
+				{
+					seedCursor++;
+				}
+				state[seedCursor] = TriangleState::QUEUED;
+				frontier.push_back(seedCursor);
+			}
+
+			uint32_t tri = frontier[head++];
+			state[tri] = TriangleState::USED;
+			for (uint32_t k = 0; k < 3; k++)
+			{
+				uint32_t vert = indices[tri * 3 + k];
+				reordered.push_back(vert);
+				for (uint32_t a = adjacencyOffsets[vert]; a < adjacencyOffsets[vert + 1]; a++)
+				{
+					uint32_t neighbour = adjacency[a];
+					if (state[neighbour] == TriangleState::FREE)
+					{
+						state[neighbour] = TriangleState::QUEUED;
+						frontier.push_back(neighbour);
+					}
+				}
+			}
+			meshletTriangles++;
+			emitted++;
+		}
+
+		// Release the triangles that were queued but didn't fit.
+		for (size_t i = head; i < frontier.size(); i++)
+		{
+			state[frontier[i]] = TriangleState::FREE;
+			seedCursor = min(seedCursor, frontier[i]);
+		}
+
+		uint32_t meshletIndexCount = meshletTriangles * 3;
+		Meshlet meshlet =
+			createMeshletBounds(&reordered[meshletStart], meshletIndexCount, vertices, allowConeCulling);
+		meshlet.firstIndex = firstIndex + meshletStart;
+		meshlet.indexCount = meshletIndexCount;
+		meshlet.vertexOffset = vertexOffset;
+		meshlet.primitive = primitive;
+		meshlets.push_back(meshlet);
+	}
+
+	// Trailing indices of an incomplete triangle are kept at the end.
+	reordered.insert(reordered.end(), indices.begin() + triangleCount * 3, indices.end());
+	indices = move(reordered);
+
+	return meshlets;
+}
+} // namespace blaze
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <Datatypes.hpp>
+#include <core/VertexBuffer.hpp>
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace blaze
+{
+/// Upper bound on the triangles held by a single Meshlet.
+constexpr uint32_t MAX_MESHLET_TRIANGLES = 128;
+
+/**
+ * @struct Meshlet
+ *
+ * @brief A small cluster of triangles of a Primitive with its culling bounds.
+ *
+ * The triangles of a meshlet are a contiguous range of the index buffer, so a
+ * meshlet can be drawn with a single (indirect) indexed draw.
+ * The layout matches the std430 struct in the cluster culling shader.
+ */
+struct Meshlet
+{
+	/// Bounding sphere in model space. xyz is the center, w the radius.
+	glm::vec4 sphere;
+	/// Normal cone. xyz is the axis, w is the cutoff (1 disables cone culling).
+	glm::vec4 cone;
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	int32_t vertexOffset;
+	/// Index of the Primitive owning the meshlet, used as the firstInstance of its draw.
+	uint32_t primitive;
+};
+
+static_assert(sizeof(Meshlet) == 48, "Meshlet must match the std430 layout in the culling shader");
+
+/**
+ * @brief Storage buffer holding the meshlets of a Model on the GPU.
+ */
+class MeshletBuffer : public BaseVBO
+{
+public:
+	/**
+	 * @fn MeshletBuffer()
+	 *
+	 * @brief Default Constructor.
+	 */
+	MeshletBuffer() noexcept : BaseVBO()
+	{
+	}
+
+	/**
+	 * @brief Main constructor.
+	 *
+	 * @param context The Vulkan Context in use.
+	 * @param data The meshlets to upload.
+	 */
+	MeshletBuffer(const Context* context, const std::vector<Meshlet>& data) noexcept
+		: BaseVBO(context, Usage::StorageBuffer, data.data(), static_cast<uint32_t>(data.size()),
+				  data.size() * sizeof(Meshlet))
+	{
+	}
+
+	/**
+	 * @brief Creates a new VkDescriptorBufferInfo for the buffer.
+	 */
+	inline VkDescriptorBufferInfo get_descriptorInfo() const
+	{
+		return VkDescriptorBufferInfo{
+			buffer.handle,
+			0,
+			size,
+		};
+	}
+};
+
+/**
+ * @fn buildMeshlets
+ *
+ * @brief Splits the triangles of a primitive into spatially coherent meshlets.
+ *
+ * Triangles are grown into clusters by walking shared vertices, and \a indices is
+ * reordered in place so that each meshlet is a contiguous range.
+ *
+ * @param indices The triangle list indices of the primitive, local to \a vertices.
+ * @param vertices The vertices of the primitive.
+ * @param firstIndex The offset of \a indices in the index buffer of the Model.
+ * @param vertexOffset The offset of \a vertices in the vertex buffer of the Model.
+ * @param primitive The index of the primitive in the Model.
+ * @param allowConeCulling False for double sided or blended materials which can't be backface culled.
+ * @param maxTriangles The maximum number of triangles in a meshlet.
+ *
+ * @returns The meshlets covering all the triangles of the primitive.
+ */
+std::vector<Meshlet> buildMeshlets(std::vector<uint32_t>& indices, const Vertex* vertices, uint32_t firstIndex,
+								   int32_t vertexOffset, uint32_t primitive, bool allowConeCulling,
+								   uint32_t maxTriangles = MAX_MESHLET_TRIANGLES);
+} // namespace blaze
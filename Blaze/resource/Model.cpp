@@ -1,65 +1,156 @@
 
 #include "Model.hpp"
 
+#include <rendering/RenderQueue.hpp>
+
+#include <algorithm>
+#include <limits>
+
 namespace blaze
 {
 // Model
 
 Model::Model(const std::vector<int>& top_level_nodes, std::vector<Node>&& nodes, std::vector<Primitive>&& prims,
-			   IndexedVertexBuffer<Vertex>&& ivb, Material&& mat) noexcept
-	: prime_nodes(top_level_nodes), nodes(std::move(nodes)), primitives(std::move(prims)), vbo(std::move(ivb)),
-	  root(glm::mat4(1.0f), top_level_nodes, std::make_pair<int, int>(0, 0), 0), material(std::move(mat))
+			   Geometry&& geometry, Material&& mat, Objects&& objects, Clusters&& clusters) noexcept
+	: prime_nodes(top_level_nodes), nodes(std::move(nodes)), primitives(std::move(prims)),
+	  geometry(std::move(geometry)),
+	  root(glm::mat4(1.0f), top_level_nodes, std::make_pair<int, int>(0, 0), 0), material(std::move(mat)),
+	  objects(std::move(objects)), clusters(std::move(clusters)),
+	  nodeLods(this->nodes.size() * ClusterCuller::VIEW_COUNT, 0)
 {
 	using namespace util;
 }
 
+Model::~Model()
+{
+	if (material.heap)
+	{
+		material.heap->release(material.heapRange);
+	}
+	if (geometry.arena)
+	{
+		geometry.arena->release(geometry.handle);
+	}
+}
+
+namespace
+{
+/// Source of the versions of all Models, so that no two Models share one.
+uint64_t versionCounter = 0;
+} // namespace
+
 void Model::update()
 {
+	const glm::mat4 rootTransform = root.pcb;
 	root.update();
+	bool changed = root.pcb != rootTransform;
 	for (int i : prime_nodes)
 	{
-		update_nodes(i);
+		changed |= update_nodes(i);
+	}
+
+	if (changed || version == 0)
+	{
+		objects.transformsDirty = true;
+		version = ++versionCounter;
+		updateBounds();
+	}
+}
+
+void Model::updateBounds()
+{
+	glm::vec3 lo(std::numeric_limits<float>::max());
+	glm::vec3 hi(std::numeric_limits<float>::lowest());
+	for (const auto& node : nodes)
+	{
+		if (node.primitive_range.first == node.primitive_range.second)
+		{
+			continue;
+		}
+		glm::vec3 center = node.pcb * glm::vec4(glm::vec3(node.bounds), 1.0f);
+		float scale = std::max({glm::length(glm::vec3(node.pcb[0])), glm::length(glm::vec3(node.pcb[1])),
+								glm::length(glm::vec3(node.pcb[2]))});
+		lo = glm::min(lo, center - node.bounds.w * scale);
+		hi = glm::max(hi, center + node.bounds.w * scale);
+	}
+
+	if (lo.x > hi.x)
+	{
+		bounds = glm::vec4(0.0f);
+		return;
 	}
+	bounds = glm::vec4(0.5f * (lo + hi), 0.5f * glm::length(hi - lo));
 }
 
-void Model::draw(VkCommandBuffer buf, VkPipelineLayout layout)
+uint64_t Model::get_version() const
 {
-	vbo.bind(buf);
+	return version;
+}
 
-	vkCmdBindDescriptorSets(buf, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, material.dset.setIdx,
-							static_cast<uint32_t>(material.dset.size()), &material.dset.get(), 0, nullptr);
-	for (auto& node : nodes)
+glm::vec4 Model::get_bounds() const
+{
+	return bounds;
+}
+
+void Model::draw(VkCommandBuffer buf, VkPipelineLayout layout, uint32_t objectSet)
+{
+	bindObjects(buf, layout, objectSet);
+	bindMaterialSet(buf, layout);
+	for (size_t n = 0; n < nodes.size(); n++)
 	{
-		vkCmdPushConstants(buf, layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0,
-						   sizeof(ModelPushConstantBlock), &node.pcb);
+		auto& node = nodes[n];
+		uint32_t lod = nodeLods[n * ClusterCuller::VIEW_COUNT + ClusterCuller::CAMERA_VIEW];
 		for (int i = node.primitive_range.first; i < node.primitive_range.second; i++)
 		{
-			auto& primitive = primitives[i];
-			vkCmdPushConstants(buf, layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-							   sizeof(ModelPushConstantBlock), sizeof(Material::PCB),
-							   &material.pushConstantBlocks[primitive.material]);
-			vkCmdDrawIndexed(buf, primitive.indexCount, 1, primitive.firstIndex, 0, 0);
+			drawPrimitive(buf, i, ClusterCuller::CAMERA_VIEW, lod);
 		}
 	}
 }
 
-void Model::drawGeometry(VkCommandBuffer buf, VkPipelineLayout layout)
+void Model::drawGeometry(VkCommandBuffer buf, VkPipelineLayout layout, uint32_t objectSet)
 {
-	vbo.bind(buf);
-	for (auto& node : nodes)
+	bindObjects(buf, layout, objectSet);
+	for (size_t n = 0; n < nodes.size(); n++)
 	{
-		vkCmdPushConstants(buf, layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0,
-						   sizeof(ModelPushConstantBlock), &node.pcb);
+		auto& node = nodes[n];
+		uint32_t lod = nodeLods[n * ClusterCuller::VIEW_COUNT + ClusterCuller::SHADOW_VIEW];
 		for (int i = node.primitive_range.first; i < node.primitive_range.second; i++)
 		{
-			auto& primitive = primitives[i];
-			vkCmdDrawIndexed(buf, primitive.indexCount, 1, primitive.firstIndex, 0, 0);
+			drawPrimitive(buf, i, ClusterCuller::SHADOW_VIEW, lod);
 		}
 	}
 }
 
-void Model::update_nodes(int node, int parent)
+void Model::bindObjects(VkCommandBuffer buf, VkPipelineLayout layout, uint32_t objectSet, bool bindGeometry)
 {
+	if (bindGeometry)
+	{
+		if (geometry.arena)
+		{
+			geometry.arena->bind(buf);
+		}
+		else
+		{
+			geometry.vbo.bind(buf);
+		}
+	}
+	vkCmdBindDescriptorSets(buf, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, objectSet, 1, &objects.set.get(), 0,
+							nullptr);
+}
+
+void Model::bindMaterialSet(VkCommandBuffer buf, VkPipelineLayout layout) const
+{
+	// The renderer binds the texture heap once for every model.
+	if (material.heap == nullptr)
+	{
+		vkCmdBindDescriptorSets(buf, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, material.dset.setIdx,
+								static_cast<uint32_t>(material.dset.size()), &material.dset.get(), 0, nullptr);
+	}
+}
+
+bool Model::update_nodes(int node, int parent)
+{
+	const glm::mat4 previous = nodes[node].pcb;
 	if (parent == -1)
 	{
 		nodes[node].update(root.pcb);
@@ -68,49 +159,235 @@ void Model::update_nodes(int node, int parent)
 	{
 		nodes[node].update(nodes[parent].pcb);
 	}
+	bool changed = nodes[node].pcb != previous;
 	for (int child : nodes[node].children)
 	{
-		update_nodes(child, node);
+		changed |= update_nodes(child, node);
 	}
+	return changed;
 }
-void Model::drawOpaque(VkCommandBuffer buf, VkPipelineLayout layout)
-{
-	vbo.bind(buf);
 
-	vkCmdBindDescriptorSets(buf, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, material.dset.setIdx,
-							static_cast<uint32_t>(material.dset.size()), &material.dset.get(), 0, nullptr);
-	for (auto& node : nodes)
+void Model::drawOpaque(VkCommandBuffer buf, VkPipelineLayout layout, uint32_t objectSet)
+{
+	bindObjects(buf, layout, objectSet);
+	bindMaterialSet(buf, layout);
+	for (size_t n = 0; n < nodes.size(); n++)
 	{
-		vkCmdPushConstants(buf, layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0,
-						   sizeof(ModelPushConstantBlock), &node.pcb);
+		auto& node = nodes[n];
+		uint32_t lod = nodeLods[n * ClusterCuller::VIEW_COUNT + ClusterCuller::CAMERA_VIEW];
 		for (int i = node.primitive_range.first; i < node.primitive_range.first + node.numOpaque; i++)
 		{
-			auto& primitive = primitives[i];
-			vkCmdPushConstants(buf, layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-							   sizeof(ModelPushConstantBlock), sizeof(Material::PCB),
-							   &material.pushConstantBlocks[primitive.material]);
-			vkCmdDrawIndexed(buf, primitive.indexCount, 1, primitive.firstIndex, 0, 0);
+			drawPrimitive(buf, i, ClusterCuller::CAMERA_VIEW, lod);
+		}
+	}
+}
+
+void Model::drawAlphaBlended(VkCommandBuffer buf, VkPipelineLayout layout, uint32_t objectSet)
+{
+	bindObjects(buf, layout, objectSet);
+	bindMaterialSet(buf, layout);
+	for (size_t n = 0; n < nodes.size(); n++)
+	{
+		auto& node = nodes[n];
+		uint32_t lod = nodeLods[n * ClusterCuller::VIEW_COUNT + ClusterCuller::CAMERA_VIEW];
+		for (int i = node.primitive_range.first + node.numOpaque; i < node.primitive_range.second; i++)
+		{
+			drawPrimitive(buf, i, ClusterCuller::CAMERA_VIEW, lod);
+		}
+	}
+}
+
+void Model::enqueue(RenderQueue& queue, const glm::vec3& eye)
+{
+	for (size_t n = 0; n < nodes.size(); n++)
+	{
+		const auto& node = nodes[n];
+		if (node.primitive_range.first == node.primitive_range.second)
+		{
+			continue;
 		}
+
+		glm::vec3 center = node.pcb * glm::vec4(glm::vec3(node.bounds), 1.0f);
+		float depth = glm::distance(center, eye);
+		uint32_t lod = nodeLods[n * ClusterCuller::VIEW_COUNT + ClusterCuller::CAMERA_VIEW];
+		for (int i = node.primitive_range.first; i < node.primitive_range.second; i++)
+		{
+			const auto& primitive = primitives[i];
+			queue.push(this, i, lod, primitive.material, primitive.isAlphaBlending, depth);
+		}
+	}
+}
+
+void Model::bind(VkCommandBuffer buf, VkPipelineLayout layout, uint32_t objectSet)
+{
+	// The RenderQueue binds the arena.
+	bindObjects(buf, layout, objectSet, geometry.arena == nullptr);
+	bindMaterialSet(buf, layout);
+}
+
+void Model::drawItem(VkCommandBuffer buf, uint32_t element, uint32_t lod)
+{
+	drawPrimitive(buf, element, ClusterCuller::CAMERA_VIEW, lod);
+}
+
+const GeometryArena* Model::get_geometryArena() const
+{
+	return geometry.arena;
+}
+
+void Model::cull(VkCommandBuffer buf, const ClusterCuller& culler, ClusterCuller::View view,
+				 const ClusterCuller::Frustum& frustum)
+{
+	const uint32_t meshletCount = clusters.meshlets.get_count();
+	const uint32_t viewBit = 1u << view;
+	if (meshletCount == 0 || !culler.enabled)
+	{
+		clusters.culledViews &= ~viewBit;
+		return;
+	}
+
+	if (!clusters.cullSet.pool.valid())
+	{
+		clusters.cullSet = culler.createSet(clusters.meshlets.get_descriptorInfo(),
+											{objects.transforms.handle, 0, VK_WHOLE_SIZE},
+											{clusters.draws.handle, 0, VK_WHOLE_SIZE},
+											objects.drawInfos.get_descriptorInfo());
+	}
+
+	uint32_t vertexBase = 0;
+	uint32_t indexBase = 0;
+	if (geometry.arena)
+	{
+		const auto& allocation = geometry.arena->get_allocation(geometry.handle);
+		vertexBase = allocation.vertices.first;
+		indexBase = allocation.indices.first;
 	}
+	culler.dispatch(buf, clusters.cullSet, frustum, meshletCount, view * meshletCount, vertexBase, indexBase);
+	clusters.culledViews |= viewBit;
 }
 
-void Model::drawAlphaBlended(VkCommandBuffer buf, VkPipelineLayout layout)
+void Model::selectLod(ClusterCuller::View view, const glm::vec3& eye, float lodScale)
 {
-	vbo.bind(buf);
+	bool shadowLodChanged = false;
+	for (size_t n = 0; n < nodes.size(); n++)
+	{
+		const auto& node = nodes[n];
+		uint32_t lod = 0;
+
+		if (lodScale > 0.0f && node.primitive_range.first < node.primitive_range.second)
+		{
+			glm::vec3 center = node.pcb * glm::vec4(glm::vec3(node.bounds), 1.0f);
+			float scale = std::max({glm::length(glm::vec3(node.pcb[0])), glm::length(glm::vec3(node.pcb[1])),
+									glm::length(glm::vec3(node.pcb[2]))});
+			float distance = glm::distance(center, eye) - node.bounds.w * scale;
+
+			uint32_t maxLod = 0;
+			for (int i = node.primitive_range.first; i < node.primitive_range.second; i++)
+			{
+				maxLod = std::max(maxLod, primitives[i].lodCount - 1);
+			}
+
+			// The coarsest level whose error stays below a pixel for every primitive.
+			for (lod = distance > 0.0f ? maxLod : 0; lod > 0; lod--)
+			{
+				float error = 0.0f;
+				for (int i = node.primitive_range.first; i < node.primitive_range.second; i++)
+				{
+					error = std::max(error, primitives[i].get_lod(lod).error);
+				}
+				if (error * scale * lodScale <= distance)
+				{
+					break;
+				}
+			}
+		}
+
+		uint8_t& selected = nodeLods[n * ClusterCuller::VIEW_COUNT + view];
+		shadowLodChanged |= view == ClusterCuller::SHADOW_VIEW && selected != lod;
+		selected = static_cast<uint8_t>(lod);
+	}
 
-	vkCmdBindDescriptorSets(buf, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, material.dset.setIdx,
-							static_cast<uint32_t>(material.dset.size()), &material.dset.get(), 0, nullptr);
+	// The shadow casts draw the shadow levels, so the shadows cached from the previous levels are stale.
+	if (shadowLodChanged)
+	{
+		version = ++versionCounter;
+	}
+}
+
+void Model::upload(VkCommandBuffer buf)
+{
+	if (!objects.transformsDirty)
+	{
+		return;
+	}
+
+	// vkCmdUpdateBuffer is limited to 64KiB per call.
+	constexpr size_t maxNodesPerUpdate = 65536 / sizeof(glm::mat4);
+
+	std::vector<glm::mat4> transforms;
+	transforms.reserve(nodes.size());
 	for (auto& node : nodes)
 	{
-		vkCmdPushConstants(buf, layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0,
-						   sizeof(ModelPushConstantBlock), &node.pcb);
-		for (int i = node.primitive_range.first + node.numOpaque; i < node.primitive_range.second; i++)
+		transforms.push_back(node.pcb);
+	}
+
+	// The previous frame may still be reading the transforms.
+	vkCmdPipelineBarrier(buf, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+						 VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+	for (size_t first = 0; first < transforms.size(); first += maxNodesPerUpdate)
+	{
+		size_t count = std::min(maxNodesPerUpdate, transforms.size() - first);
+		vkCmdUpdateBuffer(buf, objects.transforms.handle, first * sizeof(glm::mat4), count * sizeof(glm::mat4),
+						  &transforms[first]);
+	}
+
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+	vkCmdPipelineBarrier(buf, VK_PIPELINE_STAGE_TRANSFER_BIT,
+						 VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0,
+						 nullptr, 0, nullptr);
+
+	objects.transformsDirty = false;
+}
+
+void Model::drawPrimitive(VkCommandBuffer buf, uint32_t primitiveIdx, ClusterCuller::View view, uint32_t lod) const
+{
+	const auto& primitive = primitives[primitiveIdx];
+
+	// Meshlets only cover the full detail level.
+	if (lod > 0 || primitive.meshletCount == 0 || (clusters.culledViews & (1u << view)) == 0)
+	{
+		const auto& level = primitive.get_lod(lod);
+		uint32_t firstIndex = level.firstIndex;
+		int32_t vertexOffset = primitive.vertexOffset;
+		if (geometry.arena)
+		{
+			// Arena ranges move on compaction, so the offsets are resolved at record time.
+			const auto& allocation = geometry.arena->get_allocation(geometry.handle);
+			firstIndex += allocation.indices.first;
+			vertexOffset += static_cast<int32_t>(allocation.vertices.first);
+		}
+		// The index of the primitive is the firstInstance, the shaders look up the node and material with it.
+		vkCmdDrawIndexed(buf, level.indexCount, 1, firstIndex, vertexOffset, primitiveIdx);
+		return;
+	}
+
+	constexpr uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+	VkDeviceSize offset =
+		(static_cast<VkDeviceSize>(view) * clusters.meshlets.get_count() + primitive.firstMeshlet) * stride;
+	if (clusters.multiDrawIndirect)
+	{
+		vkCmdDrawIndexedIndirect(buf, clusters.draws.handle, offset, primitive.meshletCount, stride);
+	}
+	else
+	{
+		for (uint32_t i = 0; i < primitive.meshletCount; i++)
 		{
-			auto& primitive = primitives[i];
-			vkCmdPushConstants(buf, layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-							   sizeof(ModelPushConstantBlock), sizeof(Material::PCB),
-							   &material.pushConstantBlocks[primitive.material]);
-			vkCmdDrawIndexed(buf, primitive.indexCount, 1, primitive.firstIndex, 0, 0);
+			vkCmdDrawIndexedIndirect(buf, clusters.draws.handle, offset + i * stride, 1, stride);
 		}
 	}
 }
@@ -1,9 +1,12 @@
 
 #pragma once
 
+#include "Meshlet.hpp"
 #include "Node.hpp"
 #include <core/Drawable.hpp>
+#include <core/GeometryArena.hpp>
 #include <core/Texture2D.hpp>
+#include <core/TextureHeap.hpp>
 #include <core/VertexBuffer.hpp>
 #include <vector>
 #include <vkwrap/VkWrap.hpp>
@@ -24,7 +27,10 @@ public:
 			ALPHA_BLEND = 2,
 		};
 
-		struct PCB
+		/**
+		 * @brief The parameters of a material, laid out as the std430 Material struct in the shaders.
+		 */
+		struct Data
 		{
 			glm::vec4 baseColorFactor{1.0f, 0, 1.0f, 1.0f};		// 16	| 16
 			glm::vec4 emissiveColorFactor{1.0f, 0, 1.0f, 1.0f}; // 16	| 32
@@ -35,10 +41,12 @@ public:
 			int normalTextureSet{-1};							// 4	| 52
 			int occlusionTextureSet{-1};						// 4	| 56
 			int emissiveTextureSet{-1};							// 4	| 60
-			int textureArrIdx{0};								// 4	| 64
+			int textureArrIdx{0};								// 4	| 64 Material index, or first heap slot
 			int alphaMode{ALPHA_OPAQUE};						// 4	| 68
 			float alphaCutoff{0.5f};							// 4	| 72
+			float pad_[2];										// 8	| 80 Array stride of a vec4 aligned struct
 		};
+		static_assert(sizeof(Data) == 80, "Material::Data must match the std430 layout in the shaders");
 
 		std::vector<Texture2D> diffuse;
 		std::vector<Texture2D> metalRough;
@@ -46,9 +54,73 @@ public:
 		std::vector<Texture2D> occlusion;
 		std::vector<Texture2D> emission;
 
-		std::vector<PCB> pushConstantBlocks;
+		std::vector<Data> data;
 
+		/// Per model texture arrays, used when there is no TextureHeap.
 		spirv::SetSingleton dset;
+
+		/// The heap holding the textures, TEXTURES_PER_MATERIAL consecutive slots per material.
+		TextureHeap* heap{nullptr};
+		TextureHeap::Range heapRange;
+
+		constexpr static uint32_t TEXTURES_PER_MATERIAL = 5;
+	};
+
+	/**
+	 * @brief The node and material of a primitive, laid out as the std430 struct in the shaders.
+	 */
+	struct DrawInfo
+	{
+		uint32_t node;
+		uint32_t material;
+	};
+
+	/**
+	 * @brief The storage buffers the shaders read the per draw data from.
+	 *
+	 * Every draw of a primitive uses the index of the primitive as its firstInstance,
+	 * so the vertex shader finds its DrawInfo at gl_InstanceIndex without any push constants.
+	 */
+	struct Objects
+	{
+		/// Node transforms, one per node.
+		vkw::Buffer transforms;
+		/// One DrawInfo per primitive.
+		StorageBuffer<DrawInfo> drawInfos;
+		/// One Material::Data per material.
+		StorageBuffer<Material::Data> materials;
+		/// The set of the three buffers, compatible with every pipeline drawing the Model.
+		spirv::SetSingleton set;
+		bool transformsDirty{true};
+	};
+
+	/**
+	 * @brief The vertices and indices of the Model.
+	 *
+	 * Either a range of the renderer's GeometryArena, or buffers of its own if the arena is
+	 * unavailable, out of room, or the indices do not fit in 16 bits.
+	 */
+	struct Geometry
+	{
+		IndexedVertexBuffer<Vertex> vbo;
+		GeometryArena* arena{nullptr};
+		GeometryArena::Handle handle{0};
+		uint32_t vertexCount{0};
+		uint32_t indexCount{0};
+	};
+
+	/**
+	 * @brief The meshlets of the Model and the buffers used to cull them.
+	 */
+	struct Clusters
+	{
+		MeshletBuffer meshlets;
+		/// ClusterCuller::VIEW_COUNT draw commands per meshlet.
+		vkw::Buffer draws;
+		spirv::SetSingleton cullSet;
+		/// Bitmask of the views with valid culled draws.
+		uint32_t culledViews{0};
+		bool multiDrawIndirect{false};
 	};
 
 private:
@@ -57,7 +129,15 @@ private:
 	std::vector<Node> nodes;
 	std::vector<Primitive> primitives;
 	Material material;
-	IndexedVertexBuffer<Vertex> vbo;
+	Geometry geometry;
+	Objects objects;
+	Clusters clusters;
+	/// The selected detail level of each node, ClusterCuller::VIEW_COUNT per node.
+	std::vector<uint8_t> nodeLods;
+	/// Bumped from a counter shared by all Models whenever a node transform changes.
+	uint64_t version{0};
+	/// World space bounding sphere of the nodes, updated with the version.
+	glm::vec4 bounds{0.0f};
 
 public:
 	/**
@@ -73,11 +153,13 @@ public:
 	 * @param top_level_nodes The indices of nodes that are at the top level and have no parents.
 	 * @param nodes The list of nodes in the model.
 	 * @param prims The list of primitives in the model.
-	 * @param ivb The IndexedVertexBuffer that contains \b all the vertices and indices.
+	 * @param geometry The buffers or arena range that contain \b all the vertices and indices.
 	 * @param mat The material used in the model.
+	 * @param objects The storage buffers of the nodes, primitives and materials.
+	 * @param clusters The meshlets of all the primitives.
 	 */
 	Model(const std::vector<int>& top_level_nodes, std::vector<Node>&& nodes, std::vector<Primitive>&& prims,
-		   IndexedVertexBuffer<Vertex>&& ivb, Material&& mat) noexcept;
+		   Geometry&& geometry, Material&& mat, Objects&& objects, Clusters&& clusters) noexcept;
 
 	/**
 	 * @name Move Constructors.
@@ -96,10 +178,17 @@ public:
 	 * @}
 	 */
 
+	/**
+	 * @brief Releases the texture heap slots of the materials and the geometry arena range.
+	 */
+	~Model();
+
 	/**
 	 * @fn update()
 	 *
 	 * @brief Update the transformation of the model starting from the root node.
+	 *
+	 * The transforms are only uploaded again, and the version bumped, if one of them changed.
 	 */
 	void update();
 
@@ -110,10 +199,20 @@ public:
 	 *
 	 * @{
 	 */
-	virtual void draw(VkCommandBuffer buf, VkPipelineLayout layout) override;
-	virtual void drawGeometry(VkCommandBuffer buf, VkPipelineLayout layout) override;
-	virtual void drawOpaque(VkCommandBuffer cb, VkPipelineLayout lay) override;
-	virtual void drawAlphaBlended(VkCommandBuffer cb, VkPipelineLayout lay) override;
+	virtual void draw(VkCommandBuffer buf, VkPipelineLayout layout, uint32_t objectSet) override;
+	virtual void drawGeometry(VkCommandBuffer buf, VkPipelineLayout layout, uint32_t objectSet) override;
+	virtual void drawOpaque(VkCommandBuffer cb, VkPipelineLayout lay, uint32_t objectSet) override;
+	virtual void drawAlphaBlended(VkCommandBuffer cb, VkPipelineLayout lay, uint32_t objectSet) override;
+	virtual void upload(VkCommandBuffer cb) override;
+	virtual void enqueue(RenderQueue& queue, const glm::vec3& eye) override;
+	virtual void bind(VkCommandBuffer cb, VkPipelineLayout lay, uint32_t objectSet) override;
+	virtual void drawItem(VkCommandBuffer cb, uint32_t element, uint32_t lod) override;
+	virtual const GeometryArena* get_geometryArena() const override;
+	virtual uint64_t get_version() const override;
+	virtual glm::vec4 get_bounds() const override;
+	virtual void cull(VkCommandBuffer cb, const ClusterCuller& culler, ClusterCuller::View view,
+					  const ClusterCuller::Frustum& frustum) override;
+	virtual void selectLod(ClusterCuller::View view, const glm::vec3& eye, float lodScale) override;
 	/**
 	 * @}
 	 */
@@ -131,17 +230,25 @@ public:
 	}
 	uint32_t get_vertexCount() const
 	{
-		return vbo.get_vertexCount();
+		return geometry.vertexCount;
 	}
 	uint32_t get_indexCount() const
 	{
-		return vbo.get_indexCount();
+		return geometry.indexCount;
+	}
+	uint32_t get_meshletCount() const
+	{
+		return clusters.meshlets.get_count();
 	}
 	/**
 	 * @}
 	 */
 
 private:
-	void update_nodes(int node, int parent = -1);
+	bool update_nodes(int node, int parent = -1);
+	void updateBounds();
+	void bindObjects(VkCommandBuffer buf, VkPipelineLayout layout, uint32_t objectSet, bool bindGeometry = true);
+	void bindMaterialSet(VkCommandBuffer buf, VkPipelineLayout layout) const;
+	void drawPrimitive(VkCommandBuffer buf, uint32_t primitiveIdx, ClusterCuller::View view, uint32_t lod) const;
 };
 } // namespace blaze
@@ -4,9 +4,13 @@
 #include <core/Texture2D.hpp>
 #include <core/VertexBuffer.hpp>
 #include <glm/glm.hpp>
+#include <limits>
+#include <map>
 #include <memory>
 #include <thirdparty/gltf/tiny_gltf.h>
 
+#include "MeshLod.hpp"
+#include "Meshlet.hpp"
 #include "Node.hpp"
 
 #include <spirv/PipelineFactory.hpp>
@@ -52,6 +56,244 @@ Model::Material::AlphaMode getAlphaModeFromString(const std::string_view& str)
 	return Model::Material::AlphaMode::ALPHA_OPAQUE;
 }
 
+void buildLods(Primitive& primitive, const std::vector<uint32_t>& indices, const Vertex* vertices,
+			   std::vector<uint32_t>& lodIndices)
+{
+	// Small primitives don't gain anything from simplification.
+	constexpr size_t minIndexCount = 3 * 256;
+	if (indices.size() < minIndexCount)
+	{
+		return;
+	}
+
+	uint32_t firstIndex = primitive.firstIndex + static_cast<uint32_t>(indices.size());
+	for (uint32_t lod = 1; lod < MAX_PRIMITIVE_LODS; lod++)
+	{
+		const auto& previous = primitive.lods[lod - 1];
+		uint32_t targetIndexCount = static_cast<uint32_t>((indices.size() / 3) >> lod) * 3;
+
+		float error = 0.0f;
+		auto simplified = simplifyMesh(indices, vertices, targetIndexCount, error);
+
+		// Levels that barely reduce the triangle count aren't worth the memory.
+		if (simplified.empty() || simplified.size() * 4 > previous.indexCount * 3)
+		{
+			break;
+		}
+
+		uint32_t indexCount = static_cast<uint32_t>(simplified.size());
+		primitive.lods[lod] = {firstIndex, indexCount, std::max(error, previous.error)};
+		primitive.lodCount++;
+		firstIndex += indexCount;
+		lodIndices.insert(lodIndices.end(), simplified.begin(), simplified.end());
+	}
+}
+
+/**
+ * @brief Reorders the indices of every primitive into meshlets and appends its detail levels.
+ *
+ * Runs once the primitives are in their final order, so that the meshlets refer to the right primitive.
+ */
+void buildClusters(std::vector<Primitive>& primitives, const std::vector<Vertex>& vertexBuffer,
+				   std::vector<uint32_t>& indexBuffer, std::vector<Meshlet>& meshlets,
+				   const std::vector<bool>& doubleSided)
+{
+	std::vector<uint32_t> clusteredIndices;
+	clusteredIndices.reserve(indexBuffer.size());
+
+	for (uint32_t p = 0; p < static_cast<uint32_t>(primitives.size()); p++)
+	{
+		auto& primitive = primitives[p];
+		std::vector<uint32_t> indices(indexBuffer.begin() + primitive.firstIndex,
+									  indexBuffer.begin() + primitive.firstIndex + primitive.indexCount);
+		primitive.firstIndex = static_cast<uint32_t>(clusteredIndices.size());
+		primitive.lods[0].firstIndex = primitive.firstIndex;
+
+		// The simplified levels follow the full detail indices and share the vertices.
+		std::vector<uint32_t> lodIndices;
+		if (primitive.hasIndex)
+		{
+			// Cone culling is invalid for faces that are visible from behind.
+			bool allowConeCulling = !primitive.isAlphaBlending && !doubleSided[primitive.material];
+
+			auto primitiveMeshlets =
+				buildMeshlets(indices, &vertexBuffer[primitive.vertexOffset], primitive.firstIndex,
+							  primitive.vertexOffset, p, allowConeCulling);
+
+			primitive.firstMeshlet = static_cast<uint32_t>(meshlets.size());
+			primitive.meshletCount = static_cast<uint32_t>(primitiveMeshlets.size());
+			meshlets.insert(meshlets.end(), primitiveMeshlets.begin(), primitiveMeshlets.end());
+
+			buildLods(primitive, indices, &vertexBuffer[primitive.vertexOffset], lodIndices);
+		}
+
+		clusteredIndices.insert(clusteredIndices.end(), indices.begin(), indices.end());
+		clusteredIndices.insert(clusteredIndices.end(), lodIndices.begin(), lodIndices.end());
+	}
+
+	indexBuffer = std::move(clusteredIndices);
+}
+
+glm::vec4 computeBounds(const Vertex* vertices, size_t count)
+{
+	if (count == 0)
+	{
+		return glm::vec4(0.0f);
+	}
+
+	glm::vec3 lo(std::numeric_limits<float>::max());
+	glm::vec3 hi(std::numeric_limits<float>::lowest());
+	for (size_t i = 0; i < count; i++)
+	{
+		lo = glm::min(lo, vertices[i].position);
+		hi = glm::max(hi, vertices[i].position);
+	}
+	glm::vec3 center = 0.5f * (lo + hi);
+	float radius = 0.0f;
+	for (size_t i = 0; i < count; i++)
+	{
+		radius = std::max(radius, glm::distance(center, vertices[i].position));
+	}
+	return glm::vec4(center, radius);
+}
+
+void computeWorldTransforms(const std::vector<Node>& nodes, int node, const glm::mat4& parent,
+							std::vector<glm::mat4>& world, std::vector<bool>& reachable)
+{
+	world[node] = parent * nodes[node].localTRS;
+	reachable[node] = true;
+	for (int child : nodes[node].children)
+	{
+		computeWorldTransforms(nodes, child, world[node], world, reachable);
+	}
+}
+
+/**
+ * @brief Merges the opaque primitives of the nodes into world space batches, one per material and region.
+ *
+ * The vertices are transformed into the space of the Model root, so the batches are drawn by new
+ * top level nodes with an identity transform. Blended primitives are kept in their nodes for sorting,
+ * and the batches are split at 65536 vertices to keep their indices 16 bit.
+ */
+void batchStaticNodes(std::vector<Node>& nodes, std::vector<Primitive>& primitives, std::vector<Vertex>& vertexBuffer,
+					  std::vector<uint32_t>& indexBuffer, std::vector<int>& topLevelNodes)
+{
+	// Batches are limited to a region of the model so that they can still be culled.
+	constexpr int gridSize = 4;
+	constexpr size_t maxBatchVertices = 65536;
+
+	struct Batch
+	{
+		uint32_t material;
+		std::vector<Vertex> vertices;
+		std::vector<uint32_t> indices;
+	};
+
+	std::vector<glm::mat4> world(nodes.size(), glm::mat4(1.0f));
+	std::vector<bool> reachable(nodes.size(), false);
+	for (int node : topLevelNodes)
+	{
+		computeWorldTransforms(nodes, node, glm::mat4(1.0f), world, reachable);
+	}
+
+	glm::vec3 lo(std::numeric_limits<float>::max());
+	glm::vec3 hi(std::numeric_limits<float>::lowest());
+	for (size_t n = 0; n < nodes.size(); n++)
+	{
+		if (reachable[n])
+		{
+			glm::vec3 center = world[n] * glm::vec4(glm::vec3(nodes[n].bounds), 1.0f);
+			lo = glm::min(lo, center);
+			hi = glm::max(hi, center);
+		}
+	}
+	const glm::vec3 cellSize = glm::max((hi - lo) / static_cast<float>(gridSize), glm::vec3(1e-6f));
+
+	// Batches with the same key, the last one is open for appending.
+	std::map<std::pair<uint32_t, int>, std::vector<Batch>> batches;
+
+	std::vector<Vertex> keptVertices;
+	std::vector<uint32_t> keptIndices;
+	std::vector<Primitive> keptPrimitives;
+
+	for (size_t n = 0; n < nodes.size(); n++)
+	{
+		auto& node = nodes[n];
+		const int first = static_cast<int>(keptPrimitives.size());
+		int numOpaque = 0;
+
+		glm::vec3 center = world[n] * glm::vec4(glm::vec3(node.bounds), 1.0f);
+		glm::ivec3 cell = glm::clamp(glm::ivec3((center - lo) / cellSize), glm::ivec3(0), glm::ivec3(gridSize - 1));
+		int cellIdx = (cell.z * gridSize + cell.y) * gridSize + cell.x;
+
+		const glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(world[n])));
+
+		for (int i = node.primitive_range.first; i < node.primitive_range.second; i++)
+		{
+			const auto& primitive = primitives[i];
+			const Vertex* vertices = &vertexBuffer[primitive.vertexOffset];
+			const uint32_t* indices = &indexBuffer[primitive.firstIndex];
+
+			if (reachable[n] && primitive.hasIndex && !primitive.isAlphaBlending)
+			{
+				auto& chain = batches[{primitive.material, cellIdx}];
+				if (chain.empty() || chain.back().vertices.size() + primitive.vertexCount > maxBatchVertices)
+				{
+					chain.push_back({primitive.material, {}, {}});
+				}
+				auto& batch = chain.back();
+
+				const uint32_t base = static_cast<uint32_t>(batch.vertices.size());
+				for (uint32_t v = 0; v < primitive.vertexCount; v++)
+				{
+					Vertex vertex = vertices[v];
+					vertex.position = world[n] * glm::vec4(vertex.position, 1.0f);
+					vertex.normal = glm::normalize(normalMatrix * vertex.normal);
+					batch.vertices.push_back(vertex);
+				}
+				for (uint32_t x = 0; x < primitive.indexCount; x++)
+				{
+					batch.indices.push_back(base + indices[x]);
+				}
+				continue;
+			}
+
+			Primitive kept(static_cast<uint32_t>(keptIndices.size()), static_cast<int32_t>(keptVertices.size()),
+						   primitive.vertexCount, primitive.indexCount, primitive.material, primitive.isAlphaBlending);
+			keptVertices.insert(keptVertices.end(), vertices, vertices + primitive.vertexCount);
+			keptIndices.insert(keptIndices.end(), indices, indices + primitive.indexCount);
+			keptPrimitives.push_back(kept);
+			numOpaque += primitive.isAlphaBlending ? 0 : 1;
+		}
+
+		// The remaining primitives keep their order, opaque before blended.
+		node.primitive_range = std::make_pair(first, static_cast<int>(keptPrimitives.size()));
+		node.numOpaque = numOpaque;
+	}
+
+	for (auto& [key, chain] : batches)
+	{
+		for (auto& batch : chain)
+		{
+			const int first = static_cast<int>(keptPrimitives.size());
+			Primitive merged(static_cast<uint32_t>(keptIndices.size()), static_cast<int32_t>(keptVertices.size()),
+							 static_cast<uint32_t>(batch.vertices.size()), static_cast<uint32_t>(batch.indices.size()),
+							 batch.material, false);
+			keptVertices.insert(keptVertices.end(), batch.vertices.begin(), batch.vertices.end());
+			keptIndices.insert(keptIndices.end(), batch.indices.begin(), batch.indices.end());
+			keptPrimitives.push_back(merged);
+
+			topLevelNodes.push_back(static_cast<int>(nodes.size()));
+			nodes.emplace_back(glm::mat4(1.0f), std::vector<int>(), std::make_pair(first, first + 1), 1);
+			nodes.back().bounds = computeBounds(batch.vertices.data(), batch.vertices.size());
+		}
+	}
+
+	vertexBuffer = std::move(keptVertices);
+	indexBuffer = std::move(keptIndices);
+	primitives = std::move(keptPrimitives);
+}
+
 void ModelLoader::scan()
 {
 	auto rdi = fs::recursive_directory_iterator(fs::current_path().append("assets"));
@@ -69,7 +311,8 @@ void ModelLoader::scan()
 	}
 }
 
-std::shared_ptr<Model> ModelLoader::loadModel(const Context* context, const spirv::Shader* shader, uint32_t index)
+std::shared_ptr<Model> ModelLoader::loadModel(const Context* context, const spirv::Shader* shader, uint32_t index,
+											  TextureHeap* heap, GeometryArena* arena)
 {
 	OPTICK_EVENT();
 	fs::path filePath = modelFilePaths[index];
@@ -126,6 +369,7 @@ std::shared_ptr<Model> ModelLoader::loadModel(const Context* context, const spir
 	vector<uint32_t> indexBuffer;
 	vector<Node> nodes;
 	vector<Primitive> primitives;
+	vector<Meshlet> meshlets;
 	Model::Material materialPack;
 
 	materialPack.diffuse.reserve(model.materials.size());
@@ -133,7 +377,7 @@ std::shared_ptr<Model> ModelLoader::loadModel(const Context* context, const spir
 	materialPack.metalRough.reserve(model.materials.size());
 	materialPack.occlusion.reserve(model.materials.size());
 	materialPack.emission.reserve(model.materials.size());
-	materialPack.pushConstantBlocks.reserve(model.materials.size());
+	materialPack.data.reserve(model.materials.size());
 
 	{
 		OPTICK_EVENT("Load Materials");
@@ -149,7 +393,7 @@ std::shared_ptr<Model> ModelLoader::loadModel(const Context* context, const spir
 			imgData.size = 256 * 256 * 4;
 			imgData.numChannels = 4;
 
-			Model::Material::PCB pushConstantBlock = {};
+			Model::Material::Data materialData = {};
 			ImageData2D diffuseImageData = imgData;
 			ImageData2D normalImageData = imgData;
 			ImageData2D metallicRoughnessImageData = imgData;
@@ -157,16 +401,16 @@ std::shared_ptr<Model> ModelLoader::loadModel(const Context* context, const spir
 			ImageData2D emissiveImageData = imgData;
 
 			{
-				pushConstantBlock.baseColorFactor =
+				materialData.baseColorFactor =
 					glm::make_vec4(material.pbrMetallicRoughness.baseColorFactor.data());
 
 				if (material.pbrMetallicRoughness.baseColorTexture.index < 0)
 				{
-					pushConstantBlock.baseColorTextureSet = -1;
+					materialData.baseColorTextureSet = -1;
 				}
 				else
 				{
-					pushConstantBlock.baseColorTextureSet = material.pbrMetallicRoughness.baseColorTexture.texCoord;
+					materialData.baseColorTextureSet = material.pbrMetallicRoughness.baseColorTexture.texCoord;
 
 					auto& image =
 						model.images[model.textures[material.pbrMetallicRoughness.baseColorTexture.index].source];
@@ -186,11 +430,11 @@ std::shared_ptr<Model> ModelLoader::loadModel(const Context* context, const spir
 			{
 				if (material.normalTexture.index < 0)
 				{
-					pushConstantBlock.normalTextureSet = -1;
+					materialData.normalTextureSet = -1;
 				}
 				else
 				{
-					pushConstantBlock.normalTextureSet = material.normalTexture.texCoord;
+					materialData.normalTextureSet = material.normalTexture.texCoord;
 
 					auto& image = model.images[model.textures[material.normalTexture.index].source];
 					uint64_t texelCount = static_cast<uint64_t>(image.width) * static_cast<uint64_t>(image.height);
@@ -207,16 +451,16 @@ std::shared_ptr<Model> ModelLoader::loadModel(const Context* context, const spir
 			}
 
 			{
-				pushConstantBlock.metallicFactor = static_cast<float>(material.pbrMetallicRoughness.metallicFactor);
-				pushConstantBlock.roughnessFactor = static_cast<float>(material.pbrMetallicRoughness.roughnessFactor);
+				materialData.metallicFactor = static_cast<float>(material.pbrMetallicRoughness.metallicFactor);
+				materialData.roughnessFactor = static_cast<float>(material.pbrMetallicRoughness.roughnessFactor);
 
 				if (material.pbrMetallicRoughness.metallicRoughnessTexture.index < 0)
 				{
-					pushConstantBlock.physicalDescriptorTextureSet = -1;
+					materialData.physicalDescriptorTextureSet = -1;
 				}
 				else
 				{
-					pushConstantBlock.physicalDescriptorTextureSet =
+					materialData.physicalDescriptorTextureSet =
 						material.pbrMetallicRoughness.metallicRoughnessTexture.texCoord;
 
 					auto& image =
@@ -238,11 +482,11 @@ std::shared_ptr<Model> ModelLoader::loadModel(const Context* context, const spir
 			{
 				if (material.occlusionTexture.index < 0)
 				{
-					pushConstantBlock.occlusionTextureSet = -1;
+					materialData.occlusionTextureSet = -1;
 				}
 				else
 				{
-					pushConstantBlock.occlusionTextureSet = material.occlusionTexture.texCoord;
+					materialData.occlusionTextureSet = material.occlusionTexture.texCoord;
 
 					auto& image = model.images[model.textures[material.occlusionTexture.index].source];
 					uint64_t texelCount = static_cast<uint64_t>(image.width) * static_cast<uint64_t>(image.height);
@@ -261,13 +505,13 @@ std::shared_ptr<Model> ModelLoader::loadModel(const Context* context, const spir
 			{
 				if (material.emissiveTexture.index < 0)
 				{
-					pushConstantBlock.emissiveTextureSet = -1;
+					materialData.emissiveTextureSet = -1;
 				}
 				else
 				{
-					pushConstantBlock.emissiveTextureSet = material.emissiveTexture.texCoord;
+					materialData.emissiveTextureSet = material.emissiveTexture.texCoord;
 
-					pushConstantBlock.emissiveColorFactor = glm::make_vec4(material.emissiveFactor.data());
+					materialData.emissiveColorFactor = glm::make_vec4(material.emissiveFactor.data());
 
 					auto& image = model.images[model.textures[material.emissiveTexture.index].source];
 					uint64_t texelCount = static_cast<uint64_t>(image.width) * static_cast<uint64_t>(image.height);
@@ -283,12 +527,12 @@ std::shared_ptr<Model> ModelLoader::loadModel(const Context* context, const spir
 				}
 			}
 
-			pushConstantBlock.alphaMode = getAlphaModeFromString(material.alphaMode);
-			pushConstantBlock.alphaCutoff = static_cast<float>(material.alphaCutoff);
+			materialData.alphaMode = getAlphaModeFromString(material.alphaMode);
+			materialData.alphaCutoff = static_cast<float>(material.alphaCutoff);
 
-			pushConstantBlock.textureArrIdx = static_cast<uint32_t>(materialPack.diffuse.size());
+			materialData.textureArrIdx = static_cast<uint32_t>(materialPack.diffuse.size());
 
-			materialPack.pushConstantBlocks.push_back(pushConstantBlock);
+			materialPack.data.push_back(materialData);
 			materialPack.diffuse.emplace_back(context, diffuseImageData, true);
 			materialPack.normal.emplace_back(context, normalImageData, true);
 			materialPack.metalRough.emplace_back(context, metallicRoughnessImageData, true);
@@ -328,10 +572,10 @@ std::shared_ptr<Model> ModelLoader::loadModel(const Context* context, const spir
 			imgData.size = 256 * 256 * 4;
 			imgData.numChannels = 4;
 
-			Model::Material::PCB pushConstantBlock = {};
-			pushConstantBlock.textureArrIdx = static_cast<uint32_t>(materialPack.diffuse.size());
+			Model::Material::Data materialData = {};
+			materialData.textureArrIdx = static_cast<uint32_t>(materialPack.diffuse.size());
 
-			materialPack.pushConstantBlocks.push_back(pushConstantBlock);
+			materialPack.data.push_back(materialData);
 			materialPack.diffuse.emplace_back(context, imgData, true);
 			materialPack.normal.emplace_back(context, imgData, true);
 			materialPack.metalRough.emplace_back(context, imgData, true);
@@ -346,6 +590,7 @@ std::shared_ptr<Model> ModelLoader::loadModel(const Context* context, const spir
 		for (const auto& node : model.nodes)
 		{
 			std::pair<int, int> primitive_range;
+			glm::vec4 bounds(0.0f);
 			if (node.mesh < 0)
 			{
 				primitive_range = std::make_pair(0, 0);
@@ -355,6 +600,7 @@ std::shared_ptr<Model> ModelLoader::loadModel(const Context* context, const spir
 				const auto& mesh = model.meshes[node.mesh];
 				primitive_range = std::make_pair(static_cast<int>(primitives.size()),
 												 static_cast<int>(primitives.size() + mesh.primitives.size()));
+				const size_t firstVertex = vertexBuffer.size();
 
 				for (auto& primitive : mesh.primitives)
 				{
@@ -455,20 +701,17 @@ std::shared_ptr<Model> ModelLoader::loadModel(const Context* context, const spir
 						break;
 						}
 					}
+					uint32_t materialIdx = static_cast<uint32_t>(
+						(primitive.material >= 0 ? primitive.material : materialPack.diffuse.size() - 1));
+					bool isAlphaBlending = materialPack.data[materialIdx].alphaMode ==
+										   blaze::Model::Material::AlphaMode::ALPHA_BLEND;
+
 					Primitive newPrimitive{
-						static_cast<uint32_t>(indexBuffer.size()), static_cast<uint32_t>(vertexCount),
+						static_cast<uint32_t>(indexBuffer.size()), static_cast<int32_t>(vertexBuffer.size()),
+						static_cast<uint32_t>(vertexCount),
 						static_cast<uint32_t>(indexCount),
-						static_cast<uint32_t>(
-							(primitive.material >= 0 ? primitive.material : materialPack.diffuse.size() - 1)),
-						materialPack.pushConstantBlocks[primitive.material].alphaMode ==
-							blaze::Model::Material::AlphaMode::ALPHA_BLEND};
-					primitives.push_back(newPrimitive);
-
-					uint32_t startIndex = static_cast<uint32_t>(vertexBuffer.size());
-					for (auto& index : indices)
-					{
-						indexBuffer.emplace_back(index + startIndex);
-					}
+						materialIdx,
+						isAlphaBlending};
 
 					for (size_t i = 0; i < vertexCount; i++)
 					{
@@ -478,6 +721,17 @@ std::shared_ptr<Model> ModelLoader::loadModel(const Context* context, const spir
 												tex0Buffer ? glm::make_vec2(&tex0Buffer[2 * i]) : glm::vec2(0.0f),
 												tex1Buffer ? glm::make_vec3(&tex1Buffer[2 * i]) : glm::vec2(0.0f)});
 					}
+
+					primitives.push_back(newPrimitive);
+
+					// Indices stay local to the primitive, the vertex offset is applied in the draw call.
+					// This keeps them narrow enough for a 16 bit index buffer in most models.
+					indexBuffer.insert(indexBuffer.end(), indices.begin(), indices.end());
+				}
+
+				if (vertexBuffer.size() > firstVertex)
+				{
+					bounds = computeBounds(&vertexBuffer[firstVertex], vertexBuffer.size() - firstVertex);
 				}
 			}
 
@@ -512,18 +766,124 @@ std::shared_ptr<Model> ModelLoader::loadModel(const Context* context, const spir
 			nodes.emplace_back(glm::translate(glm::mat4(1.0f), T) * glm::mat4_cast(R) * glm::scale(glm::mat4(1.0f), S) *
 								   M,
 							   node.children, primitive_range, numOpaque);
+			nodes.back().bounds = bounds;
 		}
 	}
 
-	materialPack.dset = context->get_pipelineFactory()->createSet(*shader->getSetWithUniform("diffuseMap"));
-	setupMaterialSet(context, materialPack);
-
 	const tinygltf::Scene& scene = model.scenes[model.defaultScene > -1 ? model.defaultScene : 0];
+	vector<int> topLevelNodes = scene.nodes;
+
+	if (staticBatching)
+	{
+		OPTICK_EVENT("Batch Static Nodes");
+		batchStaticNodes(nodes, primitives, vertexBuffer, indexBuffer, topLevelNodes);
+	}
+
+	{
+		OPTICK_EVENT("Build Clusters");
+		vector<bool> doubleSided(materialPack.data.size(), false);
+		for (size_t i = 0; i < model.materials.size(); i++)
+		{
+			doubleSided[i] = model.materials[i].doubleSided;
+		}
+		buildClusters(primitives, vertexBuffer, indexBuffer, meshlets, doubleSided);
+	}
+
+	if (heap)
+	{
+		setupMaterialHeap(heap, materialPack);
+	}
+	else
+	{
+		materialPack.dset = context->get_pipelineFactory()->createSet(*shader->getSetWithUniform("diffuseMap"));
+		setupMaterialSet(context, materialPack);
+	}
 
-	auto ivb = IndexedVertexBuffer(context, indexBuffer, vertexBuffer);
+	Model::Geometry geometry;
+	geometry.vertexCount = static_cast<uint32_t>(vertexBuffer.size());
+	geometry.indexCount = static_cast<uint32_t>(indexBuffer.size());
+	// The arena only holds 16 bit indices, wider ones and overflow get buffers of their own.
+	auto narrowed = IndexBuffer::narrow(indexBuffer);
+	std::optional<GeometryArena::Handle> handle;
+	if (arena && (!narrowed.empty() || indexBuffer.empty()))
+	{
+		handle = arena->allocate(vertexBuffer, narrowed);
+	}
+	if (handle)
+	{
+		geometry.arena = arena;
+		geometry.handle = *handle;
+	}
+	else
+	{
+		geometry.vbo = IndexedVertexBuffer(context, indexBuffer, vertexBuffer);
+	}
+
+	auto objects = setupObjects(context, shader, nodes, primitives, materialPack);
+
+	// The culled draws carry the primitive index in firstInstance.
+	Model::Clusters clusters;
+	clusters.multiDrawIndirect = context->get_enabledFeatures().multiDrawIndirect == VK_TRUE;
+	if (!meshlets.empty() && context->get_enabledFeatures().drawIndirectFirstInstance == VK_TRUE)
+	{
+		clusters.meshlets = MeshletBuffer(context, meshlets);
+		clusters.draws = context->createBuffer(ClusterCuller::VIEW_COUNT * meshlets.size() *
+												   sizeof(VkDrawIndexedIndirectCommand),
+											   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+												   VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+											   VMA_MEMORY_USAGE_GPU_ONLY);
+	}
 
-	return std::make_shared<Model>(scene.nodes, std::move(nodes), std::move(primitives), std::move(ivb),
-								   std::move(materialPack));
+	return std::make_shared<Model>(topLevelNodes, std::move(nodes), std::move(primitives), std::move(geometry),
+								   std::move(materialPack), std::move(objects), std::move(clusters));
+}
+
+Model::Objects ModelLoader::setupObjects(const Context* context, const spirv::Shader* shader,
+										 const std::vector<Node>& nodes, const std::vector<Primitive>& primitives,
+										 const Model::Material& mat)
+{
+	std::vector<Model::DrawInfo> drawInfos(primitives.size());
+	for (uint32_t n = 0; n < static_cast<uint32_t>(nodes.size()); n++)
+	{
+		for (int i = nodes[n].primitive_range.first; i < nodes[n].primitive_range.second; i++)
+		{
+			drawInfos[i] = {n, primitives[i].material};
+		}
+	}
+
+	Model::Objects objects;
+	objects.transforms = context->createBuffer(std::max<size_t>(nodes.size(), 1) * sizeof(glm::mat4),
+											   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+											   VMA_MEMORY_USAGE_GPU_ONLY);
+	objects.drawInfos = StorageBuffer<Model::DrawInfo>(context, drawInfos);
+	objects.materials = StorageBuffer<Model::Material::Data>(context, mat.data);
+	objects.set = context->get_pipelineFactory()->createSet(*shader->getSetWithUniform("nodeTransforms"));
+
+	const VkDescriptorBufferInfo infos[] = {
+		{objects.transforms.handle, 0, VK_WHOLE_SIZE},
+		objects.drawInfos.get_descriptorInfo(),
+		objects.materials.get_descriptorInfo(),
+	};
+	const char* names[] = {"nodeTransforms", "drawInfos", "materials"};
+
+	std::array<VkWriteDescriptorSet, 3> writes;
+	for (size_t i = 0; i < writes.size(); i++)
+	{
+		auto unif = shader->getUniform(names[i]);
+
+		writes[i] = {};
+		writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[i].descriptorType = unif->type;
+		writes[i].descriptorCount = 1;
+		writes[i].dstSet = objects.set.get();
+		writes[i].dstBinding = unif->binding;
+		writes[i].dstArrayElement = 0;
+		writes[i].pBufferInfo = &infos[i];
+	}
+
+	vkUpdateDescriptorSets(context->get_device(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+
+	return objects;
 }
 
 void ModelLoader::setupMaterialSet(const Context* context, Model::Material& mat)
@@ -603,4 +963,29 @@ void ModelLoader::setupMaterialSet(const Context* context, Model::Material& mat)
 	vkUpdateDescriptorSets(context->get_device(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
 }
 
+void ModelLoader::setupMaterialHeap(TextureHeap* heap, Model::Material& mat)
+{
+	constexpr uint32_t stride = Model::Material::TEXTURES_PER_MATERIAL;
+	const uint32_t materialCount = static_cast<uint32_t>(mat.data.size());
+
+	mat.heap = heap;
+	mat.heapRange = heap->allocate(materialCount * stride);
+
+	std::vector<VkDescriptorImageInfo> imageInfos;
+	imageInfos.reserve(mat.heapRange.count);
+	for (uint32_t i = 0; i < materialCount; i++)
+	{
+		// The order matches the texture offsets in the bindless shaders.
+		imageInfos.emplace_back(mat.diffuse[i].get_imageInfo());
+		imageInfos.emplace_back(mat.normal[i].get_imageInfo());
+		imageInfos.emplace_back(mat.metalRough[i].get_imageInfo());
+		imageInfos.emplace_back(mat.occlusion[i].get_imageInfo());
+		imageInfos.emplace_back(mat.emission[i].get_imageInfo());
+
+		mat.data[i].textureArrIdx = static_cast<int>(mat.heapRange.first + i * stride);
+	}
+
+	heap->write(mat.heapRange.first, imageInfos);
+}
+
 } // namespace blaze
@@ -20,6 +20,14 @@ private:
 	std::vector<std::string> modelFileNames;
 	std::vector<fs::path> modelFilePaths;
 public:
+	/**
+	 * @brief Merges the opaque primitives of the nodes into world space batches per material.
+	 *
+	 * The nodes of loaded models are static, as there is no animation support, so batching
+	 * only trades the node transforms for fewer draws.
+	 */
+	bool staticBatching{true};
+
 	ModelLoader() noexcept 
 	{
 		scan();
@@ -32,21 +40,35 @@ public:
 		return modelFileNames;
 	}
 
-	std::shared_ptr<Model> loadModel(const Context* context, const spirv::Shader* set, const std::string& fileName)
+	/**
+	 * @brief Loads the model with the given file name.
+	 *
+	 * @param context The Vulkan Context in use.
+	 * @param set The Shader the object set, and the material set when \a heap is null, are created from.
+	 * @param fileName The name of the model file without extension.
+	 * @param heap The bindless texture heap to place the textures in, if supported.
+	 * @param arena The GeometryArena to place the vertices and indices in, if they fit.
+	 */
+	std::shared_ptr<Model> loadModel(const Context* context, const spirv::Shader* set, const std::string& fileName,
+									 TextureHeap* heap = nullptr, GeometryArena* arena = nullptr)
 	{
 		int i = 0;
 		for (auto& name : modelFileNames)
 		{
 			if (name == fileName)
 			{
-				return loadModel(context, set, i);
+				return loadModel(context, set, i, heap, arena);
 			}
 			i++;
 		}
 	}
-	std::shared_ptr<Model> loadModel(const Context* context, const spirv::Shader* set, uint32_t idx);
+	std::shared_ptr<Model> loadModel(const Context* context, const spirv::Shader* set, uint32_t idx,
+									 TextureHeap* heap = nullptr, GeometryArena* arena = nullptr);
 
 private:
 	void setupMaterialSet(const Context* context, Model::Material& mat);
+	Model::Objects setupObjects(const Context* context, const spirv::Shader* shader, const std::vector<Node>& nodes,
+								const std::vector<Primitive>& primitives, const Model::Material& mat);
+	void setupMaterialHeap(TextureHeap* heap, Model::Material& mat);
 };
 } // namespace blaze
\ No newline at end of file
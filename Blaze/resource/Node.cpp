@@ -31,7 +31,7 @@ Node::Node(const glm::mat4& TRS, const std::vector<int>& children, const std::pa
 Node::Node(Node&& other) noexcept
 	: translation(other.translation), rotation(other.rotation), scale(other.scale), localTRS(other.localTRS),
 	  pcb(other.pcb), children(std::move(other.children)), primitive_range(std::move(other.primitive_range)),
-	  numOpaque(other.numOpaque)
+	  numOpaque(other.numOpaque), bounds(other.bounds)
 {
 }
 
@@ -49,6 +49,7 @@ Node& Node::operator=(Node&& other) noexcept
 	children = std::move(other.children);
 	primitive_range = std::move(other.primitive_range);
 	numOpaque = other.numOpaque;
+	bounds = other.bounds;
 	return *this;
 }
 
@@ -5,10 +5,15 @@
 #include <glm/glm.hpp>
 #include <glm/gtx/matrix_decompose.hpp>
 #include <glm/gtx/quaternion.hpp>
+#include <algorithm>
+#include <array>
 #include <vector>
 
 namespace blaze
 {
+/// Number of detail levels a Primitive can have, including the full detail one.
+constexpr uint32_t MAX_PRIMITIVE_LODS = 4;
+
 /**
  * @struct Primitive
  *
@@ -22,20 +27,49 @@ namespace blaze
  */
 struct Primitive
 {
+	/**
+	 * @brief A simplified version of the primitive drawn from the same vertices.
+	 */
+	struct Lod
+	{
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		/// Largest deviation from the full detail surface, in model units.
+		float error;
+	};
+
 	uint32_t firstIndex;
+	int32_t vertexOffset;
 	uint32_t vertexCount;
 	uint32_t indexCount;
 	uint32_t material;
+	uint32_t firstMeshlet{0};
+	uint32_t meshletCount{0};
+	/// Detail levels ordered from full to lowest detail. The first one is the full primitive.
+	std::array<Lod, MAX_PRIMITIVE_LODS> lods;
+	uint32_t lodCount{1};
 	bool hasIndex;
 	bool isAlphaBlending;
 
 	/**
 	 * @brief Constructor
+	 *
+	 * Indices of the primitive are local to it, \a vertexOffset is added to them at draw time.
+	 */
+	Primitive(uint32_t firstIndex, int32_t vertexOffset, uint32_t vertexCount, uint32_t indexCount, uint32_t material,
+			  bool blendAlpha)
+		: firstIndex(firstIndex), vertexOffset(vertexOffset), vertexCount(vertexCount), indexCount(indexCount),
+		  material(material), hasIndex(indexCount > 0), isAlphaBlending(blendAlpha)
+	{
+		lods[0] = {firstIndex, indexCount, 0.0f};
+	}
+
+	/**
+	 * @brief Gets the requested detail level, or the lowest one available.
 	 */
-	Primitive(uint32_t firstIndex, uint32_t vertexCount, uint32_t indexCount, uint32_t material, bool blendAlpha)
-		: firstIndex(firstIndex), vertexCount(vertexCount), indexCount(indexCount), material(material),
-		  hasIndex(indexCount > 0), isAlphaBlending(blendAlpha)
+	inline const Lod& get_lod(uint32_t lod) const
 	{
+		return lods[std::min(lod, lodCount - 1)];
 	}
 };
 
@@ -60,6 +94,8 @@ struct Node
 
 	std::pair<int, int> primitive_range;
 	int numOpaque;
+	/// Bounding sphere of the primitives in node space, xyz is the center and w the radius.
+	glm::vec4 bounds{0.0f};
 
 	/**
 	 * @fn Node()
@@ -35,13 +35,25 @@ layout(set = 0, binding = 0) uniform CameraUBO {
 layout(set = 0, binding = 1) uniform SettingsUBO {
 	int enableIBL;
 	int viewRT;
+	int useVertexNormals;
+	float falseRoughness;
+	int shadowTaps;
+	float shadowFilterRadius;
+	int shadowFilter;
+	float shadowBleedReduction;
 } settings;
 
 struct PointLightData {
 	vec3 position;
 	float radius;
 	vec3 color;
-	int shadowIndex;
+	int castShadow;
+	uint shadowResolution;
+	uint shadowTiles[6];
+	vec3 direction;
+	float cosOuter;
+	float cosInner;
+	int dualParaboloid;
 };
 
 struct DirLightData {
@@ -67,11 +79,15 @@ layout(set = 2, binding = 1) readonly buffer DirLights {
 	DirLightData data[];
 } dirLights;
 
-layout(set = 3, binding = 0) uniform samplerCube shadows[MAX_SHADOWS];
-layout(set = 3, binding = 1) uniform sampler2DArray dirShadows[MAX_SHADOWS];
+layout(set = 3, binding = 0) uniform sampler2DShadow shadowAtlas;
+layout(set = 3, binding = 1) uniform sampler2DArrayShadow dirShadows[MAX_SHADOWS];
+layout(set = 3, binding = 2) uniform sampler2D shadowMomentAtlas;
+layout(set = 3, binding = 3) uniform sampler2DArray dirShadowMoments[MAX_SHADOWS];
 
 layout(set = 4, binding = 0) uniform samplerCube skybox;
-layout(set = 4, binding = 1) uniform samplerCube irradianceMap;
+layout(set = 4, binding = 1) uniform IrradianceSH {
+	vec4 coefficients[9];
+} irradianceSH;
 layout(set = 4, binding = 2) uniform samplerCube prefilteredMap;
 layout(set = 4, binding = 3) uniform sampler2D brdfLUT;
 
@@ -125,10 +141,89 @@ float GeometrySmith(vec3 N, vec3 V, vec3 L, float roughness)
 	return ggx1 * ggx2;
 }
 
+// The irradiance over PI from the spherical harmonics of the environment.
+vec3 getIrradiance(vec3 N) {
+	vec4 c[9] = irradianceSH.coefficients;
+	vec3 irradiance = c[0].rgb * 0.282095f
+					+ c[1].rgb * 0.488603f * N.y
+					+ c[2].rgb * 0.488603f * N.z
+					+ c[3].rgb * 0.488603f * N.x
+					+ c[4].rgb * 1.092548f * N.x * N.y
+					+ c[5].rgb * 1.092548f * N.y * N.z
+					+ c[6].rgb * 0.315392f * (3.0f * N.z * N.z - 1.0f)
+					+ c[7].rgb * 1.092548f * N.x * N.z
+					+ c[8].rgb * 0.546274f * (N.x * N.x - N.y * N.y);
+	return max(irradiance, vec3(0.0f));
+}
+
 vec3 fresnelSchlickRoughness(float cosTheta, vec3 F0, float roughness) {
 	return F0 + (max(vec3(1.0f - roughness), F0) - F0) * pow(1.0f - cosTheta, 5.0f);
 }
 
+// Taps of the shadow filter, each a bilinear compare of 4 texels.
+const int MAX_SHADOW_TAPS = 16;
+const vec2 POISSON_DISK[MAX_SHADOW_TAPS] = vec2[](
+	vec2(-0.94201624f, -0.39906216f), vec2(0.94558609f, -0.76890725f), vec2(-0.09418410f, -0.92938870f),
+	vec2(0.34495938f, 0.29387760f), vec2(-0.91588581f, 0.45771432f), vec2(-0.81544232f, -0.87912464f),
+	vec2(-0.38277543f, 0.27676845f), vec2(0.97484398f, 0.75648379f), vec2(0.44323325f, -0.97511554f),
+	vec2(0.53742981f, -0.47373420f), vec2(-0.26496911f, -0.41893023f), vec2(0.79197514f, 0.19090188f),
+	vec2(-0.24188840f, 0.99706507f), vec2(-0.81409955f, 0.91437590f), vec2(0.19984126f, 0.78641367f),
+	vec2(0.14383161f, -0.14100790f));
+
+// Rotates the taps per pixel, trading the banding of a small kernel for noise.
+mat2 getShadowKernelRotation() {
+	// Ref: Jimenez - Next Generation Post Processing in Call of Duty: Advanced Warfare, interleaved gradient noise
+	float noise = fract(52.9829189f * fract(dot(gl_FragCoord.xy, vec2(0.06711056f, 0.00583715f))));
+	float angle = 2.0f * PI * noise;
+	return mat2(cos(angle), sin(angle), -sin(angle), cos(angle));
+}
+
+// The offset of a tap in texels, the center alone for a single tap.
+vec2 getShadowTapOffset(int tap, int taps, mat2 rotation) {
+	return taps > 1 ? rotation * POISSON_DISK[tap] * settings.shadowFilterRadius : vec2(0.0f);
+}
+
+const int SHADOW_EVSM = 0x1;
+
+// Exponents of the warp of the moment maps, as in cShadowMoments.
+const float EVSM_POSITIVE_EXPONENT = 5.54f;
+const float EVSM_NEGATIVE_EXPONENT = 5.54f;
+
+// Ref: Donnelly, Lauritzen - Variance Shadow Maps, the one tailed Chebyshev bound
+float getChebyshevUpperBound(vec2 moments, float depth, float minVariance) {
+	if (depth <= moments.x) {
+		return 1.0f;
+	}
+	float variance = max(moments.y - moments.x * moments.x, minVariance);
+	float d = depth - moments.x;
+	float pMax = variance / (variance + d * d);
+	// Cuts off the tail of the bound, which lights the receivers behind more than one caster.
+	float reduction = settings.shadowBleedReduction;
+	return clamp((pMax - reduction) / (1.0f - reduction), 0.0f, 1.0f);
+}
+
+// The lit fraction of a receiver at depth in [0, 1] from the filtered moments.
+float getMomentShadowLit(vec4 moments, float depth) {
+	vec2 exponents = vec2(EVSM_POSITIVE_EXPONENT, EVSM_NEGATIVE_EXPONENT);
+	float warped = 2.0f * depth - 1.0f;
+	vec2 warpedDepth = vec2(exp(exponents.x * warped), -exp(-exponents.y * warped));
+	// The least variance, scaled with the slope of each warp.
+	vec2 depthScale = 0.0001f * exponents * abs(warpedDepth);
+	vec2 minVariance = depthScale * depthScale;
+	return min(getChebyshevUpperBound(moments.xy, warpedDepth.x, minVariance.x),
+			   getChebyshevUpperBound(moments.zw, warpedDepth.y, minVariance.y));
+}
+
+// The world size of a screen pixel at viewDepth.
+float getPixelWorldSize(float viewDepth) {
+	return 2.0f * viewDepth / (abs(camera.projection[1][1]) * camera.screenSize.y);
+}
+
+// The mip of a moment map of resolution whose texels, of texelSize at level 0, cover a pixel of pixelSize.
+float getMomentLod(float pixelSize, float texelSize, float resolution) {
+	return clamp(log2(pixelSize / texelSize), 0.0f, log2(resolution));
+}
+
 float getDirectionShadow(int lightIdx, vec3 N, vec3 position) {
 	int shadowIdx = dirLights.data[lightIdx].shadowIndex;
 	if (shadowIdx < 0) {
@@ -138,33 +233,37 @@ float getDirectionShadow(int lightIdx, vec3 N, vec3 position) {
 	vec4 viewpos = camera.view * vec4(position, 1.0f);
 
 	int cascade = 0;
-	for (int i = 0; i < dirLights.data[lightIdx].numCascades; i++) {
+	for (int i = 0; i < dirLights.data[lightIdx].numCascades - 1; i++) {
 		if (-viewpos.z > dirLights.data[lightIdx].cascadeSplits[i]) {
 			cascade = i+1;
 		}
 	}
 
-	vec4 shadowCoord = biasMat * dirLights.data[shadowIdx].cascadeViewProj[cascade] * vec4(position, 1.0f);// V_LIGHTCOORD[shadowIdx][cascade];
+	vec4 shadowCoord = biasMat * dirLights.data[lightIdx].cascadeViewProj[cascade] * vec4(position, 1.0f);
 	shadowCoord.y = 1.0f - shadowCoord.y;
-	float shade = 0.0f;
+	if (shadowCoord.w <= 0.0f || shadowCoord.z <= -1.0f || shadowCoord.z >= 1.0f) {
+		return 0.0f;
+	}
+
+	if (settings.shadowFilter == SHADOW_EVSM) {
+		// The first row of the ortho view projection is the light's x axis over the half width of the box.
+		mat4 viewProj = dirLights.data[lightIdx].cascadeViewProj[cascade];
+		float resolution = float(textureSize(dirShadowMoments[shadowIdx], 0).x);
+		float texelSize = 2.0f / (length(vec3(viewProj[0][0], viewProj[1][0], viewProj[2][0])) * resolution);
+		float lod = getMomentLod(getPixelWorldSize(-viewpos.z), texelSize, resolution);
+		vec4 moments = textureLod(dirShadowMoments[shadowIdx], vec3(shadowCoord.st, cascade), lod);
+		return 1.0f - getMomentShadowLit(moments, shadowCoord.z);
+	}
 
 	vec2 texelSize = vec2(1.0f) / textureSize(dirShadows[shadowIdx], 0).xy;
-	for (int i = -1; i <= 1; i++)
-	{
-		for (int j = -1; j <= 1; j++)
-		{
-			if ( shadowCoord.z > -1.0 && shadowCoord.z < 1.0 ) 
-			{
-				float dist = texture( dirShadows[shadowIdx], vec3(shadowCoord.st + vec2(i,j) * texelSize, cascade)).r;
-				if ( shadowCoord.w > 0.0 && dist < shadowCoord.z )
-				{
-					shade += 1.0f;
-				}
-			}
-		}
+	mat2 rotation = getShadowKernelRotation();
+	int taps = clamp(settings.shadowTaps, 1, MAX_SHADOW_TAPS);
+	float lit = 0.0f;
+	for (int i = 0; i < taps; i++) {
+		vec2 uv = shadowCoord.st + getShadowTapOffset(i, taps, rotation) * texelSize;
+		lit += texture(dirShadows[shadowIdx], vec4(uv, cascade, shadowCoord.z));
 	}
-	shade /= 9.0f;
-	return shade;
+	return 1.0f - lit / float(taps);
 }
 
 vec4 sampleSkybox() {
@@ -202,7 +301,7 @@ void main() {
 
 	// Direction Lighting
 	for (int i = 0; i < dirLights.data.length(); i++) {
-		if (dirLights.data[i].brightness < 0.0f) continue;
+		if (dirLights.data[i].brightness < 0.0f) break;
 		
 		vec3 L		 = normalize(-dirLights.data[i].direction.xyz);
 		vec3 H		 = normalize(V + L);
@@ -244,7 +343,7 @@ void main() {
 		vec3 kd = vec3(1.0f) - ks;
 		kd *= 1.0f - metallic;
 
-		vec3 diffuse = texture(irradianceMap, N).rgb * albedo;
+		vec3 diffuse = getIrradiance(N) * albedo;
 
 		iblContrib = (kd * diffuse + specular);
 
@@ -0,0 +1,21 @@
+#version 450
+
+// Unused, declared to keep the camera set compatible with the set of the other passes.
+layout(set = 0, binding = 0) uniform CameraUBO {
+	mat4 view;
+	mat4 projection;
+	vec3 viewPos;
+	float ambientBrightness;
+	vec2 screenSize;
+	float nearPlane;
+	float farPlane;
+} camera;
+
+layout(set = 0, binding = 1) uniform SettingsUBO {
+	int enableIBL;
+	int viewRT;
+} settings;
+
+// Only the samples that pass the depth test are counted, with no color written.
+void main() {
+}
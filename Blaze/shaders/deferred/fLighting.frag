@@ -10,6 +10,7 @@
 
 layout(location = 0) in vec4 V_POSITION;
 layout(location = 1, component = 0) in vec2 V_UV0;
+layout(location = 2) flat in int V_LIGHT_IDX;
 
 layout(location = 0) out vec4 O_COLOR;
 
@@ -26,13 +27,25 @@ layout(set = 0, binding = 0) uniform CameraUBO {
 layout(set = 0, binding = 1) uniform SettingsUBO {
 	int enableIBL;
 	int viewRT;
+	int useVertexNormals;
+	float falseRoughness;
+	int shadowTaps;
+	float shadowFilterRadius;
+	int shadowFilter;
+	float shadowBleedReduction;
 } settings;
 
 struct PointLightData {
 	vec3 position;
 	float radius;
 	vec3 color;
-	int shadowIndex;
+	int castShadow;
+	uint shadowResolution;
+	uint shadowTiles[6];
+	vec3 direction;
+	float cosOuter;
+	float cosInner;
+	int dualParaboloid;
 };
 
 struct DirLightData {
@@ -58,15 +71,10 @@ layout(set = 2, binding = 1) readonly buffer DirLights {
 	DirLightData data[];
 } dirLights;
 
-layout(set = 3, binding = 0) uniform samplerCube shadows[MAX_SHADOWS];
-layout(set = 3, binding = 1) uniform sampler2DArray dirShadows[MAX_SHADOWS];
-
-layout(push_constant) uniform LightIdx {
-	int idx;
-	int pad0_;
-	int pad1_;
-	int pad2_;
-} pcb;
+layout(set = 3, binding = 0) uniform sampler2DShadow shadowAtlas;
+layout(set = 3, binding = 1) uniform sampler2DArrayShadow dirShadows[MAX_SHADOWS];
+layout(set = 3, binding = 2) uniform sampler2D shadowMomentAtlas;
+layout(set = 3, binding = 3) uniform sampler2DArray dirShadowMoments[MAX_SHADOWS];
 
 const float PI = 3.1415926535897932384626433832795f;
 
@@ -109,18 +117,186 @@ vec3 fresnelSchlickRoughness(float cosTheta, vec3 F0, float roughness) {
 	return F0 + (max(vec3(1.0f - roughness), F0) - F0) * pow(1.0f - cosTheta, 5.0f);
 }
 
+// Taps of the shadow filter, each a bilinear compare of 4 texels.
+const int MAX_SHADOW_TAPS = 16;
+const vec2 POISSON_DISK[MAX_SHADOW_TAPS] = vec2[](
+	vec2(-0.94201624f, -0.39906216f), vec2(0.94558609f, -0.76890725f), vec2(-0.09418410f, -0.92938870f),
+	vec2(0.34495938f, 0.29387760f), vec2(-0.91588581f, 0.45771432f), vec2(-0.81544232f, -0.87912464f),
+	vec2(-0.38277543f, 0.27676845f), vec2(0.97484398f, 0.75648379f), vec2(0.44323325f, -0.97511554f),
+	vec2(0.53742981f, -0.47373420f), vec2(-0.26496911f, -0.41893023f), vec2(0.79197514f, 0.19090188f),
+	vec2(-0.24188840f, 0.99706507f), vec2(-0.81409955f, 0.91437590f), vec2(0.19984126f, 0.78641367f),
+	vec2(0.14383161f, -0.14100790f));
+
+// Rotates the taps per pixel, trading the banding of a small kernel for noise.
+mat2 getShadowKernelRotation() {
+	// Ref: Jimenez - Next Generation Post Processing in Call of Duty: Advanced Warfare, interleaved gradient noise
+	float noise = fract(52.9829189f * fract(dot(gl_FragCoord.xy, vec2(0.06711056f, 0.00583715f))));
+	float angle = 2.0f * PI * noise;
+	return mat2(cos(angle), sin(angle), -sin(angle), cos(angle));
+}
+
+// The offset of a tap in texels, the center alone for a single tap.
+vec2 getShadowTapOffset(int tap, int taps, mat2 rotation) {
+	return taps > 1 ? rotation * POISSON_DISK[tap] * settings.shadowFilterRadius : vec2(0.0f);
+}
+
+const int SHADOW_EVSM = 0x1;
+
+// Exponents of the warp of the moment maps, as in cShadowMoments.
+const float EVSM_POSITIVE_EXPONENT = 5.54f;
+const float EVSM_NEGATIVE_EXPONENT = 5.54f;
+
+// Ref: Donnelly, Lauritzen - Variance Shadow Maps, the one tailed Chebyshev bound
+float getChebyshevUpperBound(vec2 moments, float depth, float minVariance) {
+	if (depth <= moments.x) {
+		return 1.0f;
+	}
+	float variance = max(moments.y - moments.x * moments.x, minVariance);
+	float d = depth - moments.x;
+	float pMax = variance / (variance + d * d);
+	// Cuts off the tail of the bound, which lights the receivers behind more than one caster.
+	float reduction = settings.shadowBleedReduction;
+	return clamp((pMax - reduction) / (1.0f - reduction), 0.0f, 1.0f);
+}
+
+// The lit fraction of a receiver at depth in [0, 1] from the filtered moments.
+float getMomentShadowLit(vec4 moments, float depth) {
+	vec2 exponents = vec2(EVSM_POSITIVE_EXPONENT, EVSM_NEGATIVE_EXPONENT);
+	float warped = 2.0f * depth - 1.0f;
+	vec2 warpedDepth = vec2(exp(exponents.x * warped), -exp(-exponents.y * warped));
+	// The least variance, scaled with the slope of each warp.
+	vec2 depthScale = 0.0001f * exponents * abs(warpedDepth);
+	vec2 minVariance = depthScale * depthScale;
+	return min(getChebyshevUpperBound(moments.xy, warpedDepth.x, minVariance.x),
+			   getChebyshevUpperBound(moments.zw, warpedDepth.y, minVariance.y));
+}
+
+// The world size of a screen pixel at viewDepth.
+float getPixelWorldSize(float viewDepth) {
+	return 2.0f * viewDepth / (abs(camera.projection[1][1]) * camera.screenSize.y);
+}
+
+// The mip of a moment map of resolution whose texels, of texelSize at level 0, cover a pixel of pixelSize.
+float getMomentLod(float pixelSize, float texelSize, float resolution) {
+	return clamp(log2(pixelSize / texelSize), 0.0f, log2(resolution));
+}
+
+// The faces of the point shadows, in the order of the views in PointLightCaster.
+const vec3 FACE_FORWARD[6] = vec3[6](vec3(-1.0f, 0.0f, 0.0f), vec3(1.0f, 0.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f),
+									 vec3(0.0f, -1.0f, 0.0f), vec3(0.0f, 0.0f, 1.0f), vec3(0.0f, 0.0f, -1.0f));
+const vec3 FACE_UP[6] = vec3[6](vec3(0.0f, 1.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f), vec3(0.0f, 0.0f, -1.0f),
+								vec3(0.0f, 0.0f, 1.0f), vec3(0.0f, 1.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f));
+
+// The fraction of the taps around uv in the tile of face whose stored depth is not closer than depth, or the
+// moment filter's estimate of it for a pixel of pixelSize. The view of the tile spans 2 * tanHalfFov at unit distance.
+float sampleShadowTile(int lightIdx, int face, vec2 uv, float depth, float pixelSize, float tanHalfFov) {
+	float resolution = float(lights.data[lightIdx].shadowResolution);
+	uint tile = lights.data[lightIdx].shadowTiles[face];
+	vec2 origin = vec2(tile & 0xFFFFu, tile >> 16);
+
+	if (settings.shadowFilter == SHADOW_EVSM) {
+		// The moment tiles are half the size of the depth tiles.
+		float momentResolution = 0.5f * resolution;
+		float texelSize = 2.0f * tanHalfFov * depth * lights.data[lightIdx].radius / momentResolution;
+		float lod = getMomentLod(pixelSize, texelSize, momentResolution);
+		// Clamped half a texel of the coarser mip inside the tile.
+		float border = 0.5f * exp2(ceil(lod));
+		vec2 texel = 0.5f * origin + clamp(uv * momentResolution, vec2(border), vec2(momentResolution - border));
+		vec4 moments = textureLod(shadowMomentAtlas, texel / vec2(textureSize(shadowMomentAtlas, 0)), lod);
+		return getMomentShadowLit(moments, depth);
+	}
+
+	vec2 atlasSize = vec2(textureSize(shadowAtlas, 0));
+
+	mat2 rotation = getShadowKernelRotation();
+	int taps = clamp(settings.shadowTaps, 1, MAX_SHADOW_TAPS);
+	float lit = 0.0f;
+	for (int i = 0; i < taps; i++) {
+		// Clamped half a texel inside the tile to not filter in the neighbouring tiles.
+		vec2 texel = uv * resolution + getShadowTapOffset(i, taps, rotation);
+		texel = origin + clamp(texel, vec2(0.5f), vec2(resolution - 0.5f));
+		lit += texture(shadowAtlas, vec3(texel / atlasSize, depth));
+	}
+	return lit / float(taps);
+}
+
+// A spot light has a single view down its cone, in the tile of the first face.
+float sampleSpotShadowAtlas(int lightIdx, vec3 dir, float depth, float pixelSize) {
+	vec3 forward = lights.data[lightIdx].direction;
+	// The up of the view in PointLightCaster.
+	vec3 up = abs(forward.y) > 0.99f ? vec3(0.0f, 0.0f, 1.0f) : vec3(0.0f, 1.0f, 0.0f);
+	vec3 right = normalize(cross(forward, up));
+	up = cross(right, forward);
+
+	float cosOuter = lights.data[lightIdx].cosOuter;
+	float tanOuter = sqrt(1.0f - cosOuter * cosOuter) / cosOuter;
+	vec2 ndc = vec2(dot(right, dir), dot(up, dir)) / (dot(forward, dir) * tanOuter);
+	// The shadow pass flips the viewport.
+	vec2 uv = vec2(0.5f + 0.5f * ndc.x, 0.5f - 0.5f * ndc.y);
+	return sampleShadowTile(lightIdx, 0, uv, depth, pixelSize, tanOuter);
+}
+
+// The shadow of the light around dir, from the face of dir or the view of a spot light.
+// The hemisphere of dir, as drawn by the shadow pass: face 0 around +z and face 1 around -z.
+float sampleParaboloidShadowAtlas(int lightIdx, vec3 dir, float depth, float pixelSize) {
+	vec3 n = normalize(dir);
+	int face = n.z >= 0.0f ? 0 : 1;
+	float s = face == 0 ? 1.0f : -1.0f;
+	vec2 ndc = vec2(-s * n.x, n.y) / (1.0f + s * n.z);
+	vec2 uv = vec2(0.5f + 0.5f * ndc.x, 0.5f - 0.5f * ndc.y);
+	// The center of a paraboloid has half the texels per angle of a cube face.
+	return sampleShadowTile(lightIdx, face, uv, depth, pixelSize, 2.0f);
+}
+
+float samplePointShadowAtlas(int lightIdx, vec3 dir, float depth, float pixelSize) {
+	if (lights.data[lightIdx].cosOuter > -1.0f) {
+		return sampleSpotShadowAtlas(lightIdx, dir, depth, pixelSize);
+	}
+	if (lights.data[lightIdx].dualParaboloid != 0) {
+		return sampleParaboloidShadowAtlas(lightIdx, dir, depth, pixelSize);
+	}
+
+	vec3 absDir = abs(dir);
+	int face;
+	if (absDir.x >= absDir.y && absDir.x >= absDir.z) {
+		face = dir.x < 0.0f ? 0 : 1;
+	} else if (absDir.y >= absDir.z) {
+		face = dir.y > 0.0f ? 2 : 3;
+	} else {
+		face = dir.z > 0.0f ? 4 : 5;
+	}
+
+	vec3 forward = FACE_FORWARD[face];
+	vec3 up = FACE_UP[face];
+	vec2 ndc = vec2(dot(cross(forward, up), dir), dot(up, dir)) / dot(forward, dir);
+	// The shadow pass flips the viewport.
+	vec2 uv = vec2(0.5f + 0.5f * ndc.x, 0.5f - 0.5f * ndc.y);
+	// A face spans 90 degrees.
+	return sampleShadowTile(lightIdx, face, uv, depth, pixelSize, 1.0f);
+}
+
+// The falloff of a spot light towards the edge of its cone, 1 for a point light. L points to the light.
+float getSpotAttenuation(int lightIdx, vec3 L) {
+	float cosOuter = lights.data[lightIdx].cosOuter;
+	if (cosOuter <= -1.0f) {
+		return 1.0f;
+	}
+	float cosAngle = dot(-L, lights.data[lightIdx].direction);
+	float fade = max(lights.data[lightIdx].cosInner - cosOuter, 0.0001f);
+	return clamp((cosAngle - cosOuter) / fade, 0.0f, 1.0f);
+}
+
 float getPointShadow(int lightIdx, vec3 N, vec3 position) {
-	int shadowIdx = lights.data[lightIdx].shadowIndex;
-	if (shadowIdx < 0) {
+	if (lights.data[lightIdx].shadowResolution == 0) {
 		return 0.0f;
 	}
 	vec3 dir = position - lights.data[lightIdx].position;
-	dir.x *= -1;
 	float current_depth = length(dir);
 	dir = normalize(dir);
-	float closest_depth = texture(shadows[shadowIdx], dir).r * lights.data[lightIdx].radius;
 	float shadow_bias = max(0.05f * (1.0f - dot(N, dir)), 0.005f);
-	return ((current_depth - shadow_bias) > closest_depth ? 1.0f: 0.0f);
+	float pixelSize = getPixelWorldSize(-(camera.view * vec4(position, 1.0f)).z);
+	return 1.0f - samplePointShadowAtlas(lightIdx, dir, (current_depth - shadow_bias) / lights.data[lightIdx].radius,
+										 pixelSize);
 }
 
 void main() {
@@ -136,7 +312,7 @@ void main() {
 	vec3 albedo = texture(I_ALBEDO, UV).rgb;
 	vec3 V = normalize(camera.viewPos - position.xyz);
 
-	int i = pcb.idx;
+	int i = V_LIGHT_IDX;
 	float d = distance(position, lights.data[i].position);
 
 	
@@ -148,11 +324,15 @@ void main() {
 	if (d >= lights.data[i].radius) discard;
 		
 	vec3 L		 = normalize(lights.data[i].position.xyz - position.xyz);
+	// The cone volume of a spot light is wider than the cone.
+	float spot = getSpotAttenuation(i, L);
+	if (spot <= 0.0f) discard;
+
 	vec3 H		 = normalize(V + L);
 	float cosine = max(dot(L, N), 0.0f);
 
 	float dist		  = length(lights.data[i].position.xyz - position.xyz);
-	float attenuation = 1.0 / (dist * dist);
+	float attenuation = spot / (dist * dist);
 	vec3 radiance	  = lightColor * attenuation * lights.data[i].color;
 		
 	float NDF = DistributionGGX(N, H, roughness);
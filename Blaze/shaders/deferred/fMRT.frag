@@ -1,5 +1,9 @@
 #version 450
 
+#ifdef BINDLESS
+#extension GL_EXT_nonuniform_qualifier : require
+#endif
+
 #define MAX_TEX_IN_MAT 32
 #define MAX_POINT_LIGHTS 16
 #define MAX_DIRECTION_LIGHTS 4
@@ -12,6 +16,7 @@ layout(location = 0) in vec4 V_POSITION;
 layout(location = 1) in vec4 V_NORMAL;
 layout(location = 2, component = 0) in vec2 V_UV0;
 layout(location = 2, component = 2) in vec2 V_UV1;
+layout(location = 3) flat in uint V_MATERIAL;
 
 layout(location = 0) out vec4 O_POSITION;
 layout(location = 1) out vec4 O_NORMAL;
@@ -36,19 +41,35 @@ layout(set = 0, binding = 1) uniform SettingsUBO {
 	float falseRoughness;
 } settings;
 
+#ifdef BINDLESS
+// Global texture heap, each material owns 5 consecutive slots starting at textureArrIdx.
+layout(set = 1, binding = 0) uniform sampler2D textures[];
+
+#define DIFFUSE_MAP textures[material.textureArrIdx + 0]
+#define NORMAL_MAP textures[material.textureArrIdx + 1]
+#define METAL_ROUGH_MAP textures[material.textureArrIdx + 2]
+#define OCCLUSION_MAP textures[material.textureArrIdx + 3]
+#define EMISSION_MAP textures[material.textureArrIdx + 4]
+#else
 layout(set = 1, binding = 0) uniform sampler2D diffuseMap[MAX_TEX_IN_MAT];
 layout(set = 1, binding = 1) uniform sampler2D normalMap[MAX_TEX_IN_MAT];
 layout(set = 1, binding = 2) uniform sampler2D metalRoughMap[MAX_TEX_IN_MAT];
 layout(set = 1, binding = 3) uniform sampler2D occlusionMap[MAX_TEX_IN_MAT];
 layout(set = 1, binding = 4) uniform sampler2D emissionMap[MAX_TEX_IN_MAT];
 
+#define DIFFUSE_MAP diffuseMap[material.textureArrIdx]
+#define NORMAL_MAP normalMap[material.textureArrIdx]
+#define METAL_ROUGH_MAP metalRoughMap[material.textureArrIdx]
+#define OCCLUSION_MAP occlusionMap[material.textureArrIdx]
+#define EMISSION_MAP emissionMap[material.textureArrIdx]
+#endif
+
 // AlphaMode
 const uint ALPHA_OPAQUE = 0x00000000u;
 const uint ALPHA_MASK   = 0x00000001u;
 const uint ALPHA_BLEND  = 0x00000002u;
 
-layout(push_constant) uniform ModelBlock {
-	float opaque_[16];
+struct Material {
 	vec4 baseColorFactor;
 	vec4 emissiveColorFactor;
 	float metallicFactor;
@@ -61,7 +82,13 @@ layout(push_constant) uniform ModelBlock {
 	int textureArrIdx;
 	int alphaMode;
 	float alphaCutoff;
-} pcb;
+};
+
+layout(set = 2, binding = 2) readonly buffer Materials {
+	Material data[];
+} materials;
+
+Material material;
 
 const float PI = 3.1415926535897932384626433832795f;
 
@@ -82,7 +109,7 @@ vec4 SRGBtoLINEAR(vec4 srgbIn)
 
 vec3 getNormal()
 {
-	vec3 tangentNormal = texture(normalMap[pcb.textureArrIdx], pcb.normalTextureSet == 0 ? V_UV0 : V_UV1).xyz * 2.0 - 1.0;
+	vec3 tangentNormal = texture(NORMAL_MAP, material.normalTextureSet == 0 ? V_UV0 : V_UV1).xyz * 2.0 - 1.0;
 
 	vec4 q1  = dFdx(V_POSITION);
 	vec4 q2  = dFdy(V_POSITION);
@@ -105,40 +132,42 @@ float linearDepth(float depth)
 
 void main()
 {
+	material = materials.data[V_MATERIAL];
+
 	// Setup
 	O_POSITION = vec4(V_POSITION.xyz, linearDepth(gl_FragCoord.z));
 
-	bool useNormal = pcb.normalTextureSet > -1 && settings.useVertexNormals == 0;
+	bool useNormal = material.normalTextureSet > -1 && settings.useVertexNormals == 0;
 	O_NORMAL = vec4(useNormal ? getNormal() : normalize(V_NORMAL.xyz), 0.0f);
 
 	float alpha;
-	if (pcb.baseColorTextureSet < 0) {
-		O_ALBEDO = vec4(pcb.baseColorFactor.rgb, 1.0f);
-		alpha = pcb.baseColorFactor.a;
+	if (material.baseColorTextureSet < 0) {
+		O_ALBEDO = vec4(material.baseColorFactor.rgb, 1.0f);
+		alpha = material.baseColorFactor.a;
 	} else {
-		vec4 texRGBA = texture(diffuseMap[pcb.textureArrIdx], V_UV0);
-		O_ALBEDO = vec4(SRGBtoLINEAR(texRGBA).rgb * pcb.baseColorFactor.rgb, 1.0f);
+		vec4 texRGBA = texture(DIFFUSE_MAP, V_UV0);
+		O_ALBEDO = vec4(SRGBtoLINEAR(texRGBA).rgb * material.baseColorFactor.rgb, 1.0f);
 		alpha = texRGBA.a;
 	}
 
-	if (pcb.alphaMode == ALPHA_MASK) {
-		if (alpha < pcb.alphaCutoff) {
+	if (material.alphaMode == ALPHA_MASK) {
+		if (alpha < material.alphaCutoff) {
 			discard;
 		} else {
 			alpha = 1.0f;
 		}
-	} else if (pcb.alphaMode == ALPHA_OPAQUE) {
+	} else if (material.alphaMode == ALPHA_OPAQUE) {
 		alpha = 1.0f;
 	}
 
-	if (pcb.physicalDescriptorTextureSet < 0) {
-		O_OMR.g	= pcb.metallicFactor;
-		O_OMR.b	= pcb.roughnessFactor;
+	if (material.physicalDescriptorTextureSet < 0) {
+		O_OMR.g	= material.metallicFactor;
+		O_OMR.b	= material.roughnessFactor;
 		O_OMR.r	= 1.0f;
 	} else {
-		vec3 metalRough = texture(metalRoughMap[pcb.textureArrIdx], V_UV0).rgb;
-		O_OMR.g			= metalRough.b * pcb.metallicFactor;
-		O_OMR.b			= metalRough.g * pcb.roughnessFactor;
+		vec3 metalRough = texture(METAL_ROUGH_MAP, V_UV0).rgb;
+		O_OMR.g			= metalRough.b * material.metallicFactor;
+		O_OMR.b			= metalRough.g * material.roughnessFactor;
 		O_OMR.r			= 1.0f;
 	}
 
@@ -148,13 +177,13 @@ void main()
 
 	O_OMR.a = 1.0f - O_OMR.g;
 
-	if (pcb.occlusionTextureSet >= 0) {
-		O_OMR.r = texture(occlusionMap[pcb.textureArrIdx], V_UV0).r;
+	if (material.occlusionTextureSet >= 0) {
+		O_OMR.r = texture(OCCLUSION_MAP, V_UV0).r;
 	}
 
-	if (pcb.emissiveTextureSet < 0) {
+	if (material.emissiveTextureSet < 0) {
 		O_EMISSION = vec4(0.0f, 0.0f, 0.0f, 1.0f);
 	} else {
-		O_EMISSION = vec4(SRGBtoLINEAR(texture(emissionMap[pcb.textureArrIdx], V_UV0)).rgb * pcb.emissiveColorFactor.rgb, 1.0f);
+		O_EMISSION = vec4(SRGBtoLINEAR(texture(EMISSION_MAP, V_UV0)).rgb * material.emissiveColorFactor.rgb, 1.0f);
 	}
 }
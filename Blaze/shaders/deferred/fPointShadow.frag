@@ -0,0 +1,33 @@
+#version 450
+
+layout(location = 0) in vec4 V_POSITION;
+
+// Unused, declared to keep the object set compatible with the set of the material passes.
+layout(set = 1, binding = 2) readonly buffer Materials {
+	vec4 data[];
+} materials;
+
+layout(push_constant) uniform PushConsts {
+	vec3 lightPos;
+	float radius;
+	float p22;
+	float p32;
+	int face;
+	float spotScale;
+	mat4 spotView;
+} pcb;
+
+// The hemisphere around +z of a dual paraboloid shadow, followed by the one around -z.
+const int PARABOLOID_FACE = 7;
+
+void main() {
+	if (pcb.face >= PARABOLOID_FACE) {
+		// The triangles that cross into the other hemisphere are stretched across the tile.
+		float s = pcb.face == PARABOLOID_FACE ? 1.0f : -1.0f;
+		if (s * (V_POSITION.z - pcb.lightPos.z) < 0.0f) {
+			discard;
+		}
+	}
+	float z_dist = length(V_POSITION.xyz - pcb.lightPos);
+	gl_FragDepth = z_dist / pcb.radius;
+}
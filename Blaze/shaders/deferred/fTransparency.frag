@@ -1,5 +1,9 @@
 #version 450
 
+#ifdef BINDLESS
+#extension GL_EXT_nonuniform_qualifier : require
+#endif
+
 #define MAX_TEX_IN_MAT 32
 #define MAX_POINT_LIGHTS 16
 #define MAX_DIRECTION_LIGHTS 4
@@ -24,6 +28,7 @@ layout(location = 2, component = 0) in vec2 V_UV0;
 layout(location = 2, component = 2) in vec2 V_UV1;
 layout(location = 3) in vec4 V_VIEWPOS;
 layout(location = 4) in vec4 V_LIGHTCOORD[MAX_DIRECTION_LIGHTS][MAX_CASCADES];
+layout(location = 20) flat in uint V_MATERIAL;
 
 layout(location = 0) out vec4 O_COLOR;
 
@@ -40,19 +45,48 @@ layout(set = 0, binding = 0) uniform CameraUBO {
 layout(set = 0, binding = 1) uniform SettingsUBO {
 	int enableIBL;
 	int viewRT;
+	int useVertexNormals;
+	float falseRoughness;
+	int shadowTaps;
+	float shadowFilterRadius;
+	int shadowFilter;
+	float shadowBleedReduction;
 } settings;
 
+#ifdef BINDLESS
+// Global texture heap, each material owns 5 consecutive slots starting at textureArrIdx.
+layout(set = 1, binding = 0) uniform sampler2D textures[];
+
+#define DIFFUSE_MAP textures[material.textureArrIdx + 0]
+#define NORMAL_MAP textures[material.textureArrIdx + 1]
+#define METAL_ROUGH_MAP textures[material.textureArrIdx + 2]
+#define OCCLUSION_MAP textures[material.textureArrIdx + 3]
+#define EMISSION_MAP textures[material.textureArrIdx + 4]
+#else
 layout(set = 1, binding = 0) uniform sampler2D diffuseMap[MAX_TEX_IN_MAT];
 layout(set = 1, binding = 1) uniform sampler2D normalMap[MAX_TEX_IN_MAT];
 layout(set = 1, binding = 2) uniform sampler2D metalRoughMap[MAX_TEX_IN_MAT];
 layout(set = 1, binding = 3) uniform sampler2D occlusionMap[MAX_TEX_IN_MAT];
 layout(set = 1, binding = 4) uniform sampler2D emissionMap[MAX_TEX_IN_MAT];
 
+#define DIFFUSE_MAP diffuseMap[material.textureArrIdx]
+#define NORMAL_MAP normalMap[material.textureArrIdx]
+#define METAL_ROUGH_MAP metalRoughMap[material.textureArrIdx]
+#define OCCLUSION_MAP occlusionMap[material.textureArrIdx]
+#define EMISSION_MAP emissionMap[material.textureArrIdx]
+#endif
+
 struct PointLightData {
 	vec3 position;
 	float radius;
 	vec3 color;
-	int shadowIndex;
+	int castShadow;
+	uint shadowResolution;
+	uint shadowTiles[6];
+	vec3 direction;
+	float cosOuter;
+	float cosInner;
+	int dualParaboloid;
 };
 
 struct DirLightData {
@@ -72,11 +106,15 @@ layout(set = 2, binding = 1) readonly buffer DirLights {
 	DirLightData data[];
 } dirLights;
 
-layout(set = 3, binding = 0) uniform samplerCube shadows[MAX_SHADOWS];
-layout(set = 3, binding = 1) uniform sampler2DArray dirShadows[MAX_SHADOWS];
+layout(set = 3, binding = 0) uniform sampler2DShadow shadowAtlas;
+layout(set = 3, binding = 1) uniform sampler2DArrayShadow dirShadows[MAX_SHADOWS];
+layout(set = 3, binding = 2) uniform sampler2D shadowMomentAtlas;
+layout(set = 3, binding = 3) uniform sampler2DArray dirShadowMoments[MAX_SHADOWS];
 
 layout(set = 4, binding = 0) uniform samplerCube skybox;
-layout(set = 4, binding = 1) uniform samplerCube irradianceMap;
+layout(set = 4, binding = 1) uniform IrradianceSH {
+	vec4 coefficients[9];
+} irradianceSH;
 layout(set = 4, binding = 2) uniform samplerCube prefilteredMap;
 layout(set = 4, binding = 3) uniform sampler2D brdfLUT;
 
@@ -85,8 +123,7 @@ const uint ALPHA_OPAQUE = 0x00000000u;
 const uint ALPHA_MASK   = 0x00000001u;
 const uint ALPHA_BLEND  = 0x00000002u;
 
-layout(push_constant) uniform ModelBlock {
-	mat4 model;
+struct Material {
 	vec4 baseColorFactor;
 	vec4 emissiveColorFactor;
 	float metallicFactor;
@@ -99,7 +136,13 @@ layout(push_constant) uniform ModelBlock {
 	int textureArrIdx;
 	int alphaMode;
 	float alphaCutoff;
-} pcb;
+};
+
+layout(set = 5, binding = 2) readonly buffer Materials {
+	Material data[];
+} materials;
+
+Material material;
 
 const float PI = 3.1415926535897932384626433832795f;
 
@@ -120,7 +163,7 @@ vec4 SRGBtoLINEAR(vec4 srgbIn)
 
 vec3 getNormal()
 {
-	vec3 tangentNormal = texture(normalMap[pcb.textureArrIdx], pcb.normalTextureSet == 0 ? V_UV0 : V_UV1).xyz * 2.0 - 1.0;
+	vec3 tangentNormal = texture(NORMAL_MAP, material.normalTextureSet == 0 ? V_UV0 : V_UV1).xyz * 2.0 - 1.0;
 
 	vec4 q1  = dFdx(V_POSITION);
 	vec4 q2  = dFdy(V_POSITION);
@@ -170,22 +213,204 @@ float GeometrySmith(vec3 N, vec3 V, vec3 L, float roughness)
 	return ggx1 * ggx2;
 }
 
+// The irradiance over PI from the spherical harmonics of the environment.
+vec3 getIrradiance(vec3 N) {
+	vec4 c[9] = irradianceSH.coefficients;
+	vec3 irradiance = c[0].rgb * 0.282095f
+					+ c[1].rgb * 0.488603f * N.y
+					+ c[2].rgb * 0.488603f * N.z
+					+ c[3].rgb * 0.488603f * N.x
+					+ c[4].rgb * 1.092548f * N.x * N.y
+					+ c[5].rgb * 1.092548f * N.y * N.z
+					+ c[6].rgb * 0.315392f * (3.0f * N.z * N.z - 1.0f)
+					+ c[7].rgb * 1.092548f * N.x * N.z
+					+ c[8].rgb * 0.546274f * (N.x * N.x - N.y * N.y);
+	return max(irradiance, vec3(0.0f));
+}
+
 vec3 fresnelSchlickRoughness(float cosTheta, vec3 F0, float roughness) {
 	return F0 + (max(vec3(1.0f - roughness), F0) - F0) * pow(1.0f - cosTheta, 5.0f);
 }
 
+// Taps of the shadow filter, each a bilinear compare of 4 texels.
+const int MAX_SHADOW_TAPS = 16;
+const vec2 POISSON_DISK[MAX_SHADOW_TAPS] = vec2[](
+	vec2(-0.94201624f, -0.39906216f), vec2(0.94558609f, -0.76890725f), vec2(-0.09418410f, -0.92938870f),
+	vec2(0.34495938f, 0.29387760f), vec2(-0.91588581f, 0.45771432f), vec2(-0.81544232f, -0.87912464f),
+	vec2(-0.38277543f, 0.27676845f), vec2(0.97484398f, 0.75648379f), vec2(0.44323325f, -0.97511554f),
+	vec2(0.53742981f, -0.47373420f), vec2(-0.26496911f, -0.41893023f), vec2(0.79197514f, 0.19090188f),
+	vec2(-0.24188840f, 0.99706507f), vec2(-0.81409955f, 0.91437590f), vec2(0.19984126f, 0.78641367f),
+	vec2(0.14383161f, -0.14100790f));
+
+// Rotates the taps per pixel, trading the banding of a small kernel for noise.
+mat2 getShadowKernelRotation() {
+	// Ref: Jimenez - Next Generation Post Processing in Call of Duty: Advanced Warfare, interleaved gradient noise
+	float noise = fract(52.9829189f * fract(dot(gl_FragCoord.xy, vec2(0.06711056f, 0.00583715f))));
+	float angle = 2.0f * PI * noise;
+	return mat2(cos(angle), sin(angle), -sin(angle), cos(angle));
+}
+
+// The offset of a tap in texels, the center alone for a single tap.
+vec2 getShadowTapOffset(int tap, int taps, mat2 rotation) {
+	return taps > 1 ? rotation * POISSON_DISK[tap] * settings.shadowFilterRadius : vec2(0.0f);
+}
+
+const int SHADOW_EVSM = 0x1;
+
+// Exponents of the warp of the moment maps, as in cShadowMoments.
+const float EVSM_POSITIVE_EXPONENT = 5.54f;
+const float EVSM_NEGATIVE_EXPONENT = 5.54f;
+
+// Ref: Donnelly, Lauritzen - Variance Shadow Maps, the one tailed Chebyshev bound
+float getChebyshevUpperBound(vec2 moments, float depth, float minVariance) {
+	if (depth <= moments.x) {
+		return 1.0f;
+	}
+	float variance = max(moments.y - moments.x * moments.x, minVariance);
+	float d = depth - moments.x;
+	float pMax = variance / (variance + d * d);
+	// Cuts off the tail of the bound, which lights the receivers behind more than one caster.
+	float reduction = settings.shadowBleedReduction;
+	return clamp((pMax - reduction) / (1.0f - reduction), 0.0f, 1.0f);
+}
+
+// The lit fraction of a receiver at depth in [0, 1] from the filtered moments.
+float getMomentShadowLit(vec4 moments, float depth) {
+	vec2 exponents = vec2(EVSM_POSITIVE_EXPONENT, EVSM_NEGATIVE_EXPONENT);
+	float warped = 2.0f * depth - 1.0f;
+	vec2 warpedDepth = vec2(exp(exponents.x * warped), -exp(-exponents.y * warped));
+	// The least variance, scaled with the slope of each warp.
+	vec2 depthScale = 0.0001f * exponents * abs(warpedDepth);
+	vec2 minVariance = depthScale * depthScale;
+	return min(getChebyshevUpperBound(moments.xy, warpedDepth.x, minVariance.x),
+			   getChebyshevUpperBound(moments.zw, warpedDepth.y, minVariance.y));
+}
+
+// The world size of a screen pixel at viewDepth.
+float getPixelWorldSize(float viewDepth) {
+	return 2.0f * viewDepth / (abs(camera.projection[1][1]) * camera.screenSize.y);
+}
+
+// The mip of a moment map of resolution whose texels, of texelSize at level 0, cover a pixel of pixelSize.
+float getMomentLod(float pixelSize, float texelSize, float resolution) {
+	return clamp(log2(pixelSize / texelSize), 0.0f, log2(resolution));
+}
+
+// The faces of the point shadows, in the order of the views in PointLightCaster.
+const vec3 FACE_FORWARD[6] = vec3[6](vec3(-1.0f, 0.0f, 0.0f), vec3(1.0f, 0.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f),
+									 vec3(0.0f, -1.0f, 0.0f), vec3(0.0f, 0.0f, 1.0f), vec3(0.0f, 0.0f, -1.0f));
+const vec3 FACE_UP[6] = vec3[6](vec3(0.0f, 1.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f), vec3(0.0f, 0.0f, -1.0f),
+								vec3(0.0f, 0.0f, 1.0f), vec3(0.0f, 1.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f));
+
+// The fraction of the taps around uv in the tile of face whose stored depth is not closer than depth, or the
+// moment filter's estimate of it for a pixel of pixelSize. The view of the tile spans 2 * tanHalfFov at unit distance.
+float sampleShadowTile(int lightIdx, int face, vec2 uv, float depth, float pixelSize, float tanHalfFov) {
+	float resolution = float(lights.data[lightIdx].shadowResolution);
+	uint tile = lights.data[lightIdx].shadowTiles[face];
+	vec2 origin = vec2(tile & 0xFFFFu, tile >> 16);
+
+	if (settings.shadowFilter == SHADOW_EVSM) {
+		// The moment tiles are half the size of the depth tiles.
+		float momentResolution = 0.5f * resolution;
+		float texelSize = 2.0f * tanHalfFov * depth * lights.data[lightIdx].radius / momentResolution;
+		float lod = getMomentLod(pixelSize, texelSize, momentResolution);
+		// Clamped half a texel of the coarser mip inside the tile.
+		float border = 0.5f * exp2(ceil(lod));
+		vec2 texel = 0.5f * origin + clamp(uv * momentResolution, vec2(border), vec2(momentResolution - border));
+		vec4 moments = textureLod(shadowMomentAtlas, texel / vec2(textureSize(shadowMomentAtlas, 0)), lod);
+		return getMomentShadowLit(moments, depth);
+	}
+
+	vec2 atlasSize = vec2(textureSize(shadowAtlas, 0));
+
+	mat2 rotation = getShadowKernelRotation();
+	int taps = clamp(settings.shadowTaps, 1, MAX_SHADOW_TAPS);
+	float lit = 0.0f;
+	for (int i = 0; i < taps; i++) {
+		// Clamped half a texel inside the tile to not filter in the neighbouring tiles.
+		vec2 texel = uv * resolution + getShadowTapOffset(i, taps, rotation);
+		texel = origin + clamp(texel, vec2(0.5f), vec2(resolution - 0.5f));
+		lit += texture(shadowAtlas, vec3(texel / atlasSize, depth));
+	}
+	return lit / float(taps);
+}
+
+// A spot light has a single view down its cone, in the tile of the first face.
+float sampleSpotShadowAtlas(int lightIdx, vec3 dir, float depth, float pixelSize) {
+	vec3 forward = lights.data[lightIdx].direction;
+	// The up of the view in PointLightCaster.
+	vec3 up = abs(forward.y) > 0.99f ? vec3(0.0f, 0.0f, 1.0f) : vec3(0.0f, 1.0f, 0.0f);
+	vec3 right = normalize(cross(forward, up));
+	up = cross(right, forward);
+
+	float cosOuter = lights.data[lightIdx].cosOuter;
+	float tanOuter = sqrt(1.0f - cosOuter * cosOuter) / cosOuter;
+	vec2 ndc = vec2(dot(right, dir), dot(up, dir)) / (dot(forward, dir) * tanOuter);
+	// The shadow pass flips the viewport.
+	vec2 uv = vec2(0.5f + 0.5f * ndc.x, 0.5f - 0.5f * ndc.y);
+	return sampleShadowTile(lightIdx, 0, uv, depth, pixelSize, tanOuter);
+}
+
+// The shadow of the light around dir, from the face of dir or the view of a spot light.
+// The hemisphere of dir, as drawn by the shadow pass: face 0 around +z and face 1 around -z.
+float sampleParaboloidShadowAtlas(int lightIdx, vec3 dir, float depth, float pixelSize) {
+	vec3 n = normalize(dir);
+	int face = n.z >= 0.0f ? 0 : 1;
+	float s = face == 0 ? 1.0f : -1.0f;
+	vec2 ndc = vec2(-s * n.x, n.y) / (1.0f + s * n.z);
+	vec2 uv = vec2(0.5f + 0.5f * ndc.x, 0.5f - 0.5f * ndc.y);
+	// The center of a paraboloid has half the texels per angle of a cube face.
+	return sampleShadowTile(lightIdx, face, uv, depth, pixelSize, 2.0f);
+}
+
+float samplePointShadowAtlas(int lightIdx, vec3 dir, float depth, float pixelSize) {
+	if (lights.data[lightIdx].cosOuter > -1.0f) {
+		return sampleSpotShadowAtlas(lightIdx, dir, depth, pixelSize);
+	}
+	if (lights.data[lightIdx].dualParaboloid != 0) {
+		return sampleParaboloidShadowAtlas(lightIdx, dir, depth, pixelSize);
+	}
+
+	vec3 absDir = abs(dir);
+	int face;
+	if (absDir.x >= absDir.y && absDir.x >= absDir.z) {
+		face = dir.x < 0.0f ? 0 : 1;
+	} else if (absDir.y >= absDir.z) {
+		face = dir.y > 0.0f ? 2 : 3;
+	} else {
+		face = dir.z > 0.0f ? 4 : 5;
+	}
+
+	vec3 forward = FACE_FORWARD[face];
+	vec3 up = FACE_UP[face];
+	vec2 ndc = vec2(dot(cross(forward, up), dir), dot(up, dir)) / dot(forward, dir);
+	// The shadow pass flips the viewport.
+	vec2 uv = vec2(0.5f + 0.5f * ndc.x, 0.5f - 0.5f * ndc.y);
+	// A face spans 90 degrees.
+	return sampleShadowTile(lightIdx, face, uv, depth, pixelSize, 1.0f);
+}
+
+// The falloff of a spot light towards the edge of its cone, 1 for a point light. L points to the light.
+float getSpotAttenuation(int lightIdx, vec3 L) {
+	float cosOuter = lights.data[lightIdx].cosOuter;
+	if (cosOuter <= -1.0f) {
+		return 1.0f;
+	}
+	float cosAngle = dot(-L, lights.data[lightIdx].direction);
+	float fade = max(lights.data[lightIdx].cosInner - cosOuter, 0.0001f);
+	return clamp((cosAngle - cosOuter) / fade, 0.0f, 1.0f);
+}
+
 float getPointShadow(int lightIdx, vec3 N) {
-	int shadowIdx = lights.data[lightIdx].shadowIndex;
-	if (shadowIdx < 0) {
+	if (lights.data[lightIdx].shadowResolution == 0) {
 		return 0.0f;
 	}
 	vec3 dir = V_POSITION.xyz - lights.data[lightIdx].position;
-	dir.x *= -1;
 	float current_depth = length(dir);
 	dir = normalize(dir);
-	float closest_depth = texture(shadows[shadowIdx], dir).r * lights.data[lightIdx].radius;
 	float shadow_bias = max(0.05f * (1.0f - dot(N, dir)), 0.005f);
-	return ((current_depth - shadow_bias) > closest_depth ? 1.0f: 0.0f);
+	return 1.0f - samplePointShadowAtlas(lightIdx, dir, (current_depth - shadow_bias) / lights.data[lightIdx].radius,
+										 getPixelWorldSize(-V_VIEWPOS.z));
 }
 
 float getDirectionShadow(int lightIdx, vec3 N) {
@@ -195,39 +420,45 @@ float getDirectionShadow(int lightIdx, vec3 N) {
 	}
 
 	int cascade = 0;
-	for (int i = 0; i < dirLights.data[lightIdx].numCascades; i++) {
+	for (int i = 0; i < dirLights.data[lightIdx].numCascades - 1; i++) {
 		if (-V_VIEWPOS.z > dirLights.data[lightIdx].cascadeSplits[i]) {
 			cascade = i+1;
 		}
 	}
 
-	vec4 shadowCoord = V_LIGHTCOORD[shadowIdx][cascade];
-	float shade = 0.0f;
+	vec4 shadowCoord = V_LIGHTCOORD[lightIdx][cascade];
+	if (shadowCoord.w <= 0.0f || shadowCoord.z <= -1.0f || shadowCoord.z >= 1.0f) {
+		return 0.0f;
+	}
+
+	if (settings.shadowFilter == SHADOW_EVSM) {
+		// The first row of the ortho view projection is the light's x axis over the half width of the box.
+		mat4 viewProj = dirLights.data[lightIdx].cascadeViewProj[cascade];
+		float resolution = float(textureSize(dirShadowMoments[shadowIdx], 0).x);
+		float texelSize = 2.0f / (length(vec3(viewProj[0][0], viewProj[1][0], viewProj[2][0])) * resolution);
+		float lod = getMomentLod(getPixelWorldSize(-V_VIEWPOS.z), texelSize, resolution);
+		vec4 moments = textureLod(dirShadowMoments[shadowIdx], vec3(shadowCoord.st, cascade), lod);
+		return 1.0f - getMomentShadowLit(moments, shadowCoord.z);
+	}
 
 	vec2 texelSize = vec2(1.0f) / textureSize(dirShadows[shadowIdx], 0).xy;
-	for (int i = -1; i <= 1; i++)
-	{
-		for (int j = -1; j <= 1; j++)
-		{
-			if ( shadowCoord.z > -1.0 && shadowCoord.z < 1.0 ) 
-			{
-				float dist = texture( dirShadows[shadowIdx], vec3(shadowCoord.st + vec2(i,j) * texelSize, cascade)).r;
-				if ( shadowCoord.w > 0.0 && dist < shadowCoord.z )
-				{
-					shade += 1.0f;
-				}
-			}
-		}
+	mat2 rotation = getShadowKernelRotation();
+	int taps = clamp(settings.shadowTaps, 1, MAX_SHADOW_TAPS);
+	float lit = 0.0f;
+	for (int i = 0; i < taps; i++) {
+		vec2 uv = shadowCoord.st + getShadowTapOffset(i, taps, rotation) * texelSize;
+		lit += texture(dirShadows[shadowIdx], vec4(uv, cascade, shadowCoord.z));
 	}
-	shade /= 9.0f;
-	return shade;
+	return 1.0f - lit / float(taps);
 }
 
 void main()
 {
+	material = materials.data[V_MATERIAL];
+
 	// Setup
 	vec3 lightColor = vec3(23.47, 21.31, 20.79);
-	vec3 N = (pcb.normalTextureSet > -1 ? getNormal() : normalize(V_NORMAL.xyz));
+	vec3 N = (material.normalTextureSet > -1 ? getNormal() : normalize(V_NORMAL.xyz));
 	vec3 V = normalize(camera.viewPos - V_POSITION.xyz);
 
 	vec3 albedo;
@@ -237,34 +468,34 @@ void main()
 	float ao;
 	vec3 emission;
 
-	if (pcb.baseColorTextureSet < 0) {
-		albedo = pcb.baseColorFactor.rgb;
-		alpha = pcb.baseColorFactor.a;
+	if (material.baseColorTextureSet < 0) {
+		albedo = material.baseColorFactor.rgb;
+		alpha = material.baseColorFactor.a;
 	} else {
-		vec4 texRGBA = texture(diffuseMap[pcb.textureArrIdx], V_UV0);
-		albedo = SRGBtoLINEAR(texRGBA).rgb * pcb.baseColorFactor.rgb;
+		vec4 texRGBA = texture(DIFFUSE_MAP, V_UV0);
+		albedo = SRGBtoLINEAR(texRGBA).rgb * material.baseColorFactor.rgb;
 		alpha = texRGBA.a;
 	}
 
-	if (pcb.physicalDescriptorTextureSet < 0) {
-		metallic  = pcb.metallicFactor;
-		roughness = pcb.roughnessFactor;
+	if (material.physicalDescriptorTextureSet < 0) {
+		metallic  = material.metallicFactor;
+		roughness = material.roughnessFactor;
 		ao		  = 1.0f;
 	} else {
-		vec3 metalRough = texture(metalRoughMap[pcb.textureArrIdx], V_UV0).rgb;
-		metallic		= metalRough.b * pcb.metallicFactor;
-		roughness		= metalRough.g * pcb.roughnessFactor;
+		vec3 metalRough = texture(METAL_ROUGH_MAP, V_UV0).rgb;
+		metallic		= metalRough.b * material.metallicFactor;
+		roughness		= metalRough.g * material.roughnessFactor;
 		ao				= 1.0f;
 	}
 
-	if (pcb.occlusionTextureSet >= 0) {
-		ao = texture(occlusionMap[pcb.textureArrIdx], V_UV0).r;
+	if (material.occlusionTextureSet >= 0) {
+		ao = texture(OCCLUSION_MAP, V_UV0).r;
 	}
 
-	if (pcb.emissiveTextureSet < 0) {
+	if (material.emissiveTextureSet < 0) {
 		emission = vec3(0.0f);
 	} else {
-		emission = SRGBtoLINEAR(texture(emissionMap[pcb.textureArrIdx], V_UV0)).rgb * pcb.emissiveColorFactor.rgb;
+		emission = SRGBtoLINEAR(texture(EMISSION_MAP, V_UV0)).rgb * material.emissiveColorFactor.rgb;
 	}
 
 	// Lighting setup
@@ -278,15 +509,18 @@ void main()
 
 	// Point Lighting
 	for (int i = 0; i < lights.data.length(); i++) {
-		if (lights.data[i].radius < 0.0f) continue;
+		if (lights.data[i].radius < 0.0f) break;
 		if (distance(V_POSITION.xyz, lights.data[i].position) >= lights.data[i].radius) continue;
 		
 		vec3 L		 = normalize(lights.data[i].position.xyz - V_POSITION.xyz);
+		float spot	 = getSpotAttenuation(i, L);
+		if (spot <= 0.0f) continue;
+
 		vec3 H		 = normalize(V + L);
 		float cosine = max(dot(L, N), 0.0f);
 
 		float dist		  = length(lights.data[i].position.xyz - V_POSITION.xyz);
-		float attenuation = 1.0 / (dist * dist);
+		float attenuation = spot / (dist * dist);
 		vec3 radiance	  = lightColor * attenuation * lights.data[i].color;
 		
 		float NDF = DistributionGGX(N, H, roughness);
@@ -309,7 +543,7 @@ void main()
 
 	// Direction Lighting
 	for (int i = 0; i < dirLights.data.length(); i++) {
-		if (dirLights.data[i].brightness < 0.0f) continue;
+		if (dirLights.data[i].brightness < 0.0f) break;
 		
 		vec3 L		 = normalize(-dirLights.data[i].direction.xyz);
 		vec3 H		 = normalize(V + L);
@@ -350,7 +584,7 @@ void main()
 		vec3 kd = vec3(1.0f) - ks;
 		kd *= 1.0f - metallic;
 
-		vec3 diffuse = texture(irradianceMap, N).rgb * albedo;
+		vec3 diffuse = getIrradiance(N) * albedo;
 
 		iblContrib = (kd * diffuse + specular);
 	}
@@ -34,7 +34,13 @@ struct PointLightData {
 	vec3 position;
 	float radius;
 	vec3 color;
-	int shadowIndex;
+	int castShadow;
+	uint shadowResolution;
+	uint shadowTiles[6];
+	vec3 direction;
+	float cosOuter;
+	float cosInner;
+	int dualParaboloid;
 };
 
 struct DirLightData {
@@ -13,6 +13,8 @@ layout(location = 3) in vec2 A_UV1;
 
 layout(location = 0) out vec4 O_POSITION;
 layout(location = 1, component = 0) out vec2 O_UV0;
+// One instance per light, the lights are packed so the instance is the light.
+layout(location = 2) flat out int O_LIGHT_IDX;
 
 layout(set = 0, binding = 0) uniform CameraUBO {
 	mat4 view;
@@ -24,18 +26,17 @@ layout(set = 0, binding = 0) uniform CameraUBO {
 	float farPlane;
 } camera;
 
-layout(push_constant) uniform LightIdx {
-	int idx;
-	int pad0_;
-	int pad1_;
-	int pad2_;
-} pcb;
-
 struct PointLightData {
 	vec3 position;
 	float radius;
 	vec3 color;
-	int shadowIndex;
+	int castShadow;
+	uint shadowResolution;
+	uint shadowTiles[6];
+	vec3 direction;
+	float cosOuter;
+	float cosInner;
+	int dualParaboloid;
 };
 
 struct DirLightData {
@@ -56,7 +57,22 @@ layout(set = 2, binding = 1) readonly buffer DirLights {
 } dirLights;
 
 void main() {
-	O_POSITION = vec4(lights.data[pcb.idx].position + (A_POSITION * lights.data[pcb.idx].radius), 1.0f);
+	O_LIGHT_IDX = gl_InstanceIndex;
+	PointLightData light = lights.data[O_LIGHT_IDX];
+	vec3 offset;
+	if (light.cosOuter > -1.0f) {
+		// The spot lights are drawn with a cone, apex at the light and base at z = 1, stretched down their cone.
+		vec3 forward = light.direction;
+		vec3 up = abs(forward.y) > 0.99f ? vec3(0.0f, 0.0f, 1.0f) : vec3(0.0f, 1.0f, 0.0f);
+		// A right handed basis, to keep the winding of the cone.
+		vec3 side = normalize(cross(up, forward));
+		up = cross(forward, side);
+		float tanOuter = sqrt(1.0f - light.cosOuter * light.cosOuter) / light.cosOuter;
+		offset = light.radius * (tanOuter * (A_POSITION.x * side + A_POSITION.y * up) + A_POSITION.z * forward);
+	} else {
+		offset = A_POSITION * light.radius;
+	}
+	O_POSITION = vec4(light.position + offset, 1.0f);
 	gl_Position = camera.projection * camera.view * O_POSITION;
 	O_UV0 = A_UV0;
 }
@@ -15,6 +15,7 @@ layout(location = 0) out vec4 O_POSITION;
 layout(location = 1) out vec4 O_NORMAL;
 layout(location = 2, component = 0) out vec2 O_UV0;
 layout(location = 2, component = 2) out vec2 O_UV1;
+layout(location = 3) flat out uint O_MATERIAL;
 
 layout(set = 0, binding = 0) uniform CameraUBO {
 	mat4 view;
@@ -26,15 +27,28 @@ layout(set = 0, binding = 0) uniform CameraUBO {
 	float farPlane;
 } camera;
 
-layout(push_constant) uniform ModelBlock {
-	mat4 model;
-	float opaque_[18];
-} pcb;
+struct DrawInfo {
+	uint node;
+	uint material;
+};
+
+// Indexed by gl_InstanceIndex, the firstInstance of each draw is the index of the primitive.
+layout(set = 2, binding = 0) readonly buffer NodeTransforms {
+	mat4 data[];
+} nodeTransforms;
+
+layout(set = 2, binding = 1) readonly buffer DrawInfos {
+	DrawInfo data[];
+} drawInfos;
 
 void main() {
-	O_POSITION = pcb.model * vec4(A_POSITION, 1.0f);
+	DrawInfo draw = drawInfos.data[gl_InstanceIndex];
+	mat4 model = nodeTransforms.data[draw.node];
+
+	O_POSITION = model * vec4(A_POSITION, 1.0f);
 	gl_Position = camera.projection * camera.view * O_POSITION;
-	O_NORMAL = transpose(inverse(pcb.model)) * vec4(A_NORMAL, 0.0f);
+	O_NORMAL = transpose(inverse(model)) * vec4(A_NORMAL, 0.0f);
 	O_UV0 = A_UV0;
 	O_UV1 = A_UV1;
+	O_MATERIAL = draw.material;
 }
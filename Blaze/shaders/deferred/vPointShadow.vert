@@ -0,0 +1,71 @@
+#version 450
+
+layout(location = 0) in vec3 A_POSITION;
+layout(location = 1) in vec3 A_NORMAL;
+layout(location = 2) in vec2 A_UV0;
+layout(location = 3) in vec2 A_UV1;
+
+layout(location = 0) out vec4 O_POSITION;
+
+layout(set = 0, binding = 0) uniform ProjView {
+	mat4 projection;
+	mat4 view[6];
+} views;
+
+struct DrawInfo {
+	uint node;
+	uint material;
+};
+
+// Indexed by gl_InstanceIndex, the firstInstance of each draw is the index of the primitive.
+layout(set = 1, binding = 0) readonly buffer NodeTransforms {
+	mat4 data[];
+} nodeTransforms;
+
+layout(set = 1, binding = 1) readonly buffer DrawInfos {
+	DrawInfo data[];
+} drawInfos;
+
+// The face of a spot light, its single view down the cone.
+const int SPOT_FACE = 6;
+// The hemisphere around +z of a dual paraboloid shadow, followed by the one around -z.
+const int PARABOLOID_FACE = 7;
+
+// One face is drawn at a time, into its tile of the shadow atlas.
+layout(push_constant) uniform PushConsts {
+	vec3 lightPos;
+	float radius;
+	float p22;
+	float p32;
+	int face;
+	float spotScale;
+	mat4 spotView;
+} pcb;
+
+void main() {
+	mat4 model = nodeTransforms.data[drawInfos.data[gl_InstanceIndex].node];
+	if (pcb.face >= PARABOLOID_FACE) {
+		// Projected onto the paraboloid, oriented as the +z or -z face of the cube.
+		O_POSITION = model * vec4(A_POSITION, 1.0f);
+		vec3 toVertex = O_POSITION.xyz - pcb.lightPos;
+		vec3 dir = normalize(toVertex);
+		float s = pcb.face == PARABOLOID_FACE ? 1.0f : -1.0f;
+		vec2 ndc = vec2(-s * dir.x, dir.y) / max(1.0f + s * dir.z, 0.0001f);
+		gl_Position = vec4(ndc, length(toVertex) / pcb.radius, 1.0f);
+		return;
+	}
+
+	mat4 proj = views.projection;
+	proj[2][2] = pcb.p22;
+	proj[3][2] = pcb.p32;
+	mat4 view;
+	if (pcb.face == SPOT_FACE) {
+		proj[0][0] = pcb.spotScale;
+		proj[1][1] = pcb.spotScale;
+		view = pcb.spotView;
+	} else {
+		view = views.view[pcb.face];
+	}
+	O_POSITION = model * vec4(A_POSITION, 1.0f);
+	gl_Position = proj * view * (O_POSITION - vec4(pcb.lightPos, 0.0f));
+}
@@ -1,7 +1,11 @@
 #version 450
 
+// Unused, declared to keep the object set compatible with the set of the material passes.
+layout(set = 0, binding = 2) readonly buffer Materials {
+	vec4 data[];
+} materials;
+
 layout(push_constant) uniform PushConsts {
-	mat4 model;
 	mat4 PV;
 } pcb;
 
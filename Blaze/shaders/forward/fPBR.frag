@@ -3,6 +3,7 @@
 #define MAX_TEX_IN_MAT 32
 #define MAX_POINT_LIGHTS 16
 #define MAX_DIRECTION_LIGHTS 4
+#define MAX_SPOT_LIGHTS 16
 #define MAX_SHADOWS 16
 #define MAX_CASCADES 4
 
@@ -14,6 +15,7 @@ layout(location = 2, component = 0) in vec2 V_UV0;
 layout(location = 2, component = 2) in vec2 V_UV1;
 layout(location = 3) in vec4 V_VIEWPOS;
 layout(location = 4) in vec4 V_LIGHTCOORD[MAX_DIRECTION_LIGHTS][MAX_CASCADES];
+layout(location = 20) flat in uint V_MATERIAL;
 
 layout(location = 0) out vec4 outColor;
 
@@ -34,7 +36,9 @@ layout(set = 0, binding = 1) uniform SettingsUBO {
 } settings;
 
 layout(set = 1, binding = 0) uniform samplerCube skybox;
-layout(set = 1, binding = 1) uniform samplerCube irradianceMap;
+layout(set = 1, binding = 1) uniform IrradianceSH {
+	vec4 coefficients[9];
+} irradianceSH;
 layout(set = 1, binding = 2) uniform samplerCube prefilteredMap;
 layout(set = 1, binding = 3) uniform sampler2D brdfLUT;
 
@@ -49,6 +53,19 @@ struct PointLightData {
 	float radius;
 	vec3 color;
 	int shadowIndex;
+	// Non zero if the shadow is the paraboloid map of two hemispheres instead of the cube.
+	int dualParaboloid;
+};
+
+struct SpotLightData {
+	mat4 shadowViewProj;
+	vec3 position;
+	float radius;
+	vec3 direction;
+	float cosOuter;
+	vec3 color;
+	float cosInner;
+	int shadowIndex;
 };
 
 struct DirLightData {
@@ -71,12 +88,16 @@ layout(set = 3, binding = 0) uniform PointLightUBO {
 layout(set = 3, binding = 1) uniform DirLightUBO {
 	DirLightData data[MAX_DIRECTION_LIGHTS];
 } dirLights;
+layout(set = 3, binding = 2) uniform SpotLightUBO {
+	SpotLightData data[MAX_SPOT_LIGHTS];
+} spotLights;
 
 layout(set = 4, binding = 0) uniform samplerCube shadows[MAX_SHADOWS];
 layout(set = 4, binding = 1) uniform sampler2DArray dirShadows[MAX_SHADOWS];
+layout(set = 4, binding = 2) uniform sampler2D spotShadows[MAX_SHADOWS];
+layout(set = 4, binding = 3) uniform sampler2DArray pointParaboloidShadows[MAX_SHADOWS];
 
-layout(push_constant) uniform ModelBlock {
-	float opaque_[16];
+struct Material {
 	vec4 baseColorFactor;
 	vec4 emissiveColorFactor;
 	float metallicFactor;
@@ -89,7 +110,13 @@ layout(push_constant) uniform ModelBlock {
 	int textureArrIdx;
 	int alphaMode;
 	float alphaCutoff;
-} pcb;
+};
+
+layout(set = 5, binding = 2) readonly buffer Materials {
+	Material data[];
+} materials;
+
+Material material;
 
 const float PI = 3.1415926535897932384626433832795f;
 
@@ -129,7 +156,7 @@ vec4 SRGBtoLINEAR(vec4 srgbIn)
 
 vec3 getNormal()
 {
-	vec3 tangentNormal = texture(normalMap[pcb.textureArrIdx], pcb.normalTextureSet == 0 ? V_UV0 : V_UV1).xyz * 2.0 - 1.0;
+	vec3 tangentNormal = texture(normalMap[material.textureArrIdx], material.normalTextureSet == 0 ? V_UV0 : V_UV1).xyz * 2.0 - 1.0;
 
 	vec4 q1  = dFdx(V_POSITION);
 	vec4 q2  = dFdy(V_POSITION);
@@ -179,6 +206,21 @@ float GeometrySmith(vec3 N, vec3 V, vec3 L, float roughness)
 	return ggx1 * ggx2;
 }
 
+// The irradiance over PI from the spherical harmonics of the environment.
+vec3 getIrradiance(vec3 N) {
+	vec4 c[9] = irradianceSH.coefficients;
+	vec3 irradiance = c[0].rgb * 0.282095f
+					+ c[1].rgb * 0.488603f * N.y
+					+ c[2].rgb * 0.488603f * N.z
+					+ c[3].rgb * 0.488603f * N.x
+					+ c[4].rgb * 1.092548f * N.x * N.y
+					+ c[5].rgb * 1.092548f * N.y * N.z
+					+ c[6].rgb * 0.315392f * (3.0f * N.z * N.z - 1.0f)
+					+ c[7].rgb * 1.092548f * N.x * N.z
+					+ c[8].rgb * 0.546274f * (N.x * N.x - N.y * N.y);
+	return max(irradiance, vec3(0.0f));
+}
+
 vec3 fresnelSchlickRoughness(float cosTheta, vec3 F0, float roughness) {
 	return F0 + (max(vec3(1.0f - roughness), F0) - F0) * pow(1.0f - cosTheta, 5.0f);
 }
@@ -192,7 +234,41 @@ float getPointShadow(int lightIdx, vec3 N) {
 	dir.x *= -1;
 	float current_depth = length(dir);
 	dir = normalize(dir);
-	float closest_depth = texture(shadows[shadowIdx], dir).r * lights.data[lightIdx].radius;
+	float closest_depth;
+	if (lights.data[lightIdx].dualParaboloid != 0) {
+		// Layer 0 holds the hemisphere around +z, layer 1 the one around -z. The shadow pass maps
+		// x to -x around +z, which is already flipped for the cube here.
+		float layer = dir.z >= 0.0f ? 0.0f : 1.0f;
+		float s = 1.0f - 2.0f * layer;
+		vec2 ndc = vec2(s * dir.x, dir.y) / (1.0f + s * dir.z);
+		// The shadow pass flips the viewport.
+		vec2 uv = vec2(0.5f + 0.5f * ndc.x, 0.5f - 0.5f * ndc.y);
+		closest_depth = texture(pointParaboloidShadows[shadowIdx], vec3(uv, layer)).r;
+	} else {
+		closest_depth = texture(shadows[shadowIdx], dir).r;
+	}
+	closest_depth *= lights.data[lightIdx].radius;
+	float shadow_bias = max(0.05f * (1.0f - dot(N, dir)), 0.005f);
+	return ((current_depth - shadow_bias) > closest_depth ? 1.0f: 0.0f);
+}
+
+float getSpotShadow(int lightIdx, vec3 N) {
+	int shadowIdx = spotLights.data[lightIdx].shadowIndex;
+	if (shadowIdx < 0) {
+		return 0.0f;
+	}
+	vec4 shadowCoord = spotLights.data[lightIdx].shadowViewProj * V_POSITION;
+	if (shadowCoord.w <= 0.0f) {
+		return 0.0f;
+	}
+	// The shadow pass flips the viewport.
+	vec2 ndc = shadowCoord.xy / shadowCoord.w;
+	vec2 uv = vec2(0.5f + 0.5f * ndc.x, 0.5f - 0.5f * ndc.y);
+
+	vec3 dir = V_POSITION.xyz - spotLights.data[lightIdx].position;
+	float current_depth = length(dir);
+	dir = normalize(dir);
+	float closest_depth = texture(spotShadows[shadowIdx], uv).r * spotLights.data[lightIdx].radius;
 	float shadow_bias = max(0.05f * (1.0f - dot(N, dir)), 0.005f);
 	return ((current_depth - shadow_bias) > closest_depth ? 1.0f: 0.0f);
 }
@@ -210,7 +286,7 @@ float getDirectionShadow(int lightIdx, vec3 N) {
 		}
 	}
 
-	vec4 shadowCoord = V_LIGHTCOORD[shadowIdx][cascade];
+	vec4 shadowCoord = V_LIGHTCOORD[lightIdx][cascade];
 	float shade = 0.0f;
 
 	vec2 texelSize = vec2(1.0f) / textureSize(dirShadows[shadowIdx], 0).xy;
@@ -234,9 +310,11 @@ float getDirectionShadow(int lightIdx, vec3 N) {
 
 void main()
 {
+	material = materials.data[V_MATERIAL];
+
 	// Setup
 	vec3 lightColor = vec3(23.47, 21.31, 20.79);
-	vec3 N = (pcb.normalTextureSet > -1 ? getNormal() : normalize(V_NORMAL.xyz));
+	vec3 N = (material.normalTextureSet > -1 ? getNormal() : normalize(V_NORMAL.xyz));
 	vec3 V = normalize(camera.viewPos - V_POSITION.xyz);
 
 	vec3 albedo;
@@ -246,44 +324,44 @@ void main()
 	float ao;
 	vec3 emission;
 
-	if (pcb.baseColorTextureSet < 0) {
-		albedo = pcb.baseColorFactor.rgb;
-		alpha = pcb.baseColorFactor.a;
+	if (material.baseColorTextureSet < 0) {
+		albedo = material.baseColorFactor.rgb;
+		alpha = material.baseColorFactor.a;
 	} else {
-		vec4 texRGBA = texture(diffuseMap[pcb.textureArrIdx], V_UV0);
-		albedo = SRGBtoLINEAR(texRGBA).rgb * pcb.baseColorFactor.rgb;
+		vec4 texRGBA = texture(diffuseMap[material.textureArrIdx], V_UV0);
+		albedo = SRGBtoLINEAR(texRGBA).rgb * material.baseColorFactor.rgb;
 		alpha = texRGBA.a;
 	}
 
-	if (pcb.alphaMode == ALPHA_MASK) {
-		if (alpha < pcb.alphaCutoff) {
+	if (material.alphaMode == ALPHA_MASK) {
+		if (alpha < material.alphaCutoff) {
 			discard;
 		} else {
 			alpha = 1.0f;
 		}
-	} else if (pcb.alphaMode == ALPHA_OPAQUE) {
+	} else if (material.alphaMode == ALPHA_OPAQUE) {
 		alpha = 1.0f;
 	}
 
-	if (pcb.physicalDescriptorTextureSet < 0) {
-		metallic  = pcb.metallicFactor;
-		roughness = pcb.roughnessFactor;
+	if (material.physicalDescriptorTextureSet < 0) {
+		metallic  = material.metallicFactor;
+		roughness = material.roughnessFactor;
 		ao		  = 1.0f;
 	} else {
-		vec3 metalRough = texture(metalRoughMap[pcb.textureArrIdx], V_UV0).rgb;
-		metallic		= metalRough.b * pcb.metallicFactor;
-		roughness		= metalRough.g * pcb.roughnessFactor;
+		vec3 metalRough = texture(metalRoughMap[material.textureArrIdx], V_UV0).rgb;
+		metallic		= metalRough.b * material.metallicFactor;
+		roughness		= metalRough.g * material.roughnessFactor;
 		ao				= 1.0f;
 	}
 
-	if (pcb.occlusionTextureSet >= 0) {
-		ao = texture(occlusionMap[pcb.textureArrIdx], V_UV0).r;
+	if (material.occlusionTextureSet >= 0) {
+		ao = texture(occlusionMap[material.textureArrIdx], V_UV0).r;
 	}
 
-	if (pcb.emissiveTextureSet < 0) {
+	if (material.emissiveTextureSet < 0) {
 		emission = vec3(0.0f);
 	} else {
-		emission = SRGBtoLINEAR(texture(emissionMap[pcb.textureArrIdx], V_UV0)).rgb * pcb.emissiveColorFactor.rgb;
+		emission = SRGBtoLINEAR(texture(emissionMap[material.textureArrIdx], V_UV0)).rgb * material.emissiveColorFactor.rgb;
 	}
 
 	// Lighting setup
@@ -326,6 +404,41 @@ void main()
 		L0 += mix((kd * albedo / PI + specular) * radiance * NdotL, vec3(0.0f), shade);
 	}
 
+	// Spot Lighting
+	for (int i = 0; i < MAX_SPOT_LIGHTS; i++) {
+		if (spotLights.data[i].radius < 0.0f) continue;
+		if (distance(V_POSITION.xyz, spotLights.data[i].position) >= spotLights.data[i].radius) continue;
+
+		vec3 L = normalize(spotLights.data[i].position.xyz - V_POSITION.xyz);
+		float cosAngle = dot(-L, spotLights.data[i].direction);
+		float fade = max(spotLights.data[i].cosInner - spotLights.data[i].cosOuter, 0.0001f);
+		float spot = clamp((cosAngle - spotLights.data[i].cosOuter) / fade, 0.0f, 1.0f);
+		if (spot <= 0.0f) continue;
+
+		vec3 H = normalize(V + L);
+
+		float dist		  = length(spotLights.data[i].position.xyz - V_POSITION.xyz);
+		float attenuation = spot / (dist * dist);
+		vec3 radiance	  = lightColor * attenuation * spotLights.data[i].color;
+
+		float NDF = DistributionGGX(N, H, roughness);
+		float G	  = GeometrySmith(N, V, L, roughness);
+		vec3 F	  = fresnelSchlickRoughness(max(dot(H, V), 0.0f), F0, roughness);
+
+		vec3 ks = F;
+		vec3 kd = vec3(1.0f) - ks;
+		kd *= 1.0f - metallic;
+
+		vec3 numerator	  = NDF * G * F;
+		float denominator = 4.0 * max(dot(N, V), 0.0) * max(dot(N, L), 0.0);
+		vec3 specular	  = numerator / max(denominator, 0.001);
+
+		float NdotL = max(dot(N, L), 0.0f);
+		float shade = getSpotShadow(i, N);
+
+		L0 += mix((kd * albedo / PI + specular) * radiance * NdotL, vec3(0.0f), shade);
+	}
+
 	// Direction Lighting
 	for (int i = 0; i < MAX_DIRECTION_LIGHTS; i++) {
 		if (dirLights.data[i].brightness < 0.0f) continue;
@@ -368,7 +481,7 @@ void main()
 		vec3 kd = vec3(1.0f) - ks;
 		kd *= 1.0f - metallic;
 
-		vec3 diffuse = texture(irradianceMap, N).rgb * albedo;
+		vec3 diffuse = getIrradiance(N) * albedo;
 
 		ambient = (kd * diffuse + specular) * ao;
 	} else {
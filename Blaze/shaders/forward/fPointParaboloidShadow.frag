@@ -0,0 +1,26 @@
+#version 450
+#extension GL_EXT_multiview : enable
+
+layout(location = 0) in vec4 V_POSITION;
+
+// Unused, declared to keep the object set compatible with the set of the material passes.
+layout(set = 0, binding = 2) readonly buffer Materials {
+	vec4 data[];
+} materials;
+
+layout(push_constant) uniform PushConsts {
+	vec3 lightPos;
+	float radius;
+	float p22;
+	float p32;
+} pcb;
+
+void main() {
+	// The triangles that cross into the other hemisphere are stretched across the map.
+	float s = gl_ViewIndex == 0 ? 1.0f : -1.0f;
+	if (s * (V_POSITION.z - pcb.lightPos.z) < 0.0f) {
+		discard;
+	}
+	float z_dist = length(V_POSITION.xyz - pcb.lightPos);
+	gl_FragDepth = z_dist / pcb.radius;
+}
@@ -2,8 +2,12 @@
 
 layout(location = 0) in vec4 V_POSITION;
 
+// Unused, declared to keep the object set compatible with the set of the material passes.
+layout(set = 1, binding = 2) readonly buffer Materials {
+	vec4 data[];
+} materials;
+
 layout(push_constant) uniform PushConsts {
-	mat4 model;
 	vec3 lightPos;
 	float radius;
 	float p22;
@@ -26,7 +26,9 @@ layout(set = 0, binding = 1) uniform SettingsUBO {
 } settings;
 
 layout(set = 1, binding = 0) uniform samplerCube skybox;
-layout(set = 1, binding = 1) uniform samplerCube irradianceMap;
+layout(set = 1, binding = 1) uniform IrradianceSH {
+	vec4 coefficients[9];
+} irradianceSH;
 layout(set = 1, binding = 2) uniform samplerCube prefilteredMap;
 layout(set = 1, binding = 3) uniform sampler2D brdfLUT;
 
@@ -0,0 +1,19 @@
+#version 450
+
+layout(location = 0) in vec4 V_POSITION;
+
+// Unused, declared to keep the object set compatible with the set of the material passes.
+layout(set = 0, binding = 2) readonly buffer Materials {
+	vec4 data[];
+} materials;
+
+layout(push_constant) uniform PushConsts {
+	mat4 viewProj;
+	vec3 lightPos;
+	float radius;
+} pcb;
+
+void main() {
+	float z_dist = length(V_POSITION.xyz - pcb.lightPos);
+	gl_FragDepth = z_dist / pcb.radius;
+}
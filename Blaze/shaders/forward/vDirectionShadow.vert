@@ -8,11 +8,25 @@ layout(location = 1) in vec3 A_NORMAL;
 layout(location = 2) in vec2 A_UV0;
 layout(location = 3) in vec2 A_UV1;
 
+struct DrawInfo {
+	uint node;
+	uint material;
+};
+
+// Indexed by gl_InstanceIndex, the firstInstance of each draw is the index of the primitive.
+layout(set = 0, binding = 0) readonly buffer NodeTransforms {
+	mat4 data[];
+} nodeTransforms;
+
+layout(set = 0, binding = 1) readonly buffer DrawInfos {
+	DrawInfo data[];
+} drawInfos;
+
 layout(push_constant) uniform PushConsts {
-	mat4 model;
 	mat4 PV;
 } pcb;
 
 void main() {
-	gl_Position = pcb.PV * pcb.model * vec4(A_POSITION, 1.0f);
+	mat4 model = nodeTransforms.data[drawInfos.data[gl_InstanceIndex].node];
+	gl_Position = pcb.PV * model * vec4(A_POSITION, 1.0f);
 }
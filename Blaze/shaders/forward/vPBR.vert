@@ -17,6 +17,7 @@ layout(location = 2, component = 0) out vec2 O_UV0;
 layout(location = 2, component = 2) out vec2 O_UV1;
 layout(location = 3) out vec4 O_VIEWPOS;
 layout(location = 4) out vec4 O_LIGHTCOORD[MAX_DIRECTION_LIGHTS][MAX_CASCADES];
+layout(location = 20) flat out uint O_MATERIAL;
 
 layout(set = 0, binding = 0) uniform CameraUBO {
 	mat4 view;
@@ -41,10 +42,19 @@ layout(set = 3, binding = 1) uniform DirLightUBO {
 	DirLightData data[MAX_DIRECTION_LIGHTS];
 } dirLights;
 
-layout(push_constant) uniform ModelBlock {
-	mat4 model;
-	float opaque_[18];
-} pcb;
+struct DrawInfo {
+	uint node;
+	uint material;
+};
+
+// Indexed by gl_InstanceIndex, the firstInstance of each draw is the index of the primitive.
+layout(set = 5, binding = 0) readonly buffer NodeTransforms {
+	mat4 data[];
+} nodeTransforms;
+
+layout(set = 5, binding = 1) readonly buffer DrawInfos {
+	DrawInfo data[];
+} drawInfos;
 
 const mat4 biasMat = mat4( 
 	0.5, 0.0, 0.0, 0.0,
@@ -53,12 +63,16 @@ const mat4 biasMat = mat4(
 	0.5, 0.5, 0.0, 1.0 );
 
 void main() {
-	O_POSITION = pcb.model * vec4(A_POSITION, 1.0f);
+	DrawInfo draw = drawInfos.data[gl_InstanceIndex];
+	mat4 model = nodeTransforms.data[draw.node];
+
+	O_POSITION = model * vec4(A_POSITION, 1.0f);
 	O_VIEWPOS = camera.view * O_POSITION;
 	gl_Position = camera.projection * O_VIEWPOS;
-	O_NORMAL = transpose(inverse(pcb.model)) * vec4(A_NORMAL, 0.0f);
+	O_NORMAL = transpose(inverse(model)) * vec4(A_NORMAL, 0.0f);
 	O_UV0 = A_UV0;
 	O_UV1 = A_UV1;
+	O_MATERIAL = draw.material;
 	for (int i = 0; i < MAX_DIRECTION_LIGHTS; ++i) {
 		for (int cascade = 0; cascade < MAX_CASCADES; ++cascade) {
 			O_LIGHTCOORD[i][cascade] = biasMat * dirLights.data[i].cascadeViewProj[cascade] * O_POSITION;
@@ -0,0 +1,42 @@
+#version 450
+#extension GL_EXT_multiview : enable
+
+layout(location = 0) in vec3 A_POSITION;
+layout(location = 1) in vec3 A_NORMAL;
+layout(location = 2) in vec2 A_UV0;
+layout(location = 3) in vec2 A_UV1;
+
+layout(location = 0) out vec4 O_POSITION;
+
+struct DrawInfo {
+	uint node;
+	uint material;
+};
+
+// Indexed by gl_InstanceIndex, the firstInstance of each draw is the index of the primitive.
+layout(set = 0, binding = 0) readonly buffer NodeTransforms {
+	mat4 data[];
+} nodeTransforms;
+
+layout(set = 0, binding = 1) readonly buffer DrawInfos {
+	DrawInfo data[];
+} drawInfos;
+
+// Same as the cube shadow, the projection is unused.
+layout(push_constant) uniform PushConsts {
+	vec3 lightPos;
+	float radius;
+	float p22;
+	float p32;
+} pcb;
+
+void main() {
+	mat4 model = nodeTransforms.data[drawInfos.data[gl_InstanceIndex].node];
+	O_POSITION = model * vec4(A_POSITION, 1.0f);
+	vec3 toVertex = O_POSITION.xyz - pcb.lightPos;
+	vec3 dir = normalize(toVertex);
+	// View 0 is the hemisphere around +z, view 1 the one around -z, oriented as those faces of the cube.
+	float s = gl_ViewIndex == 0 ? 1.0f : -1.0f;
+	vec2 ndc = vec2(-s * dir.x, dir.y) / max(1.0f + s * dir.z, 0.0001f);
+	gl_Position = vec4(ndc, length(toVertex) / pcb.radius, 1.0f);
+}
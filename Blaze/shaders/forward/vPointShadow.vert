@@ -13,8 +13,21 @@ layout(set = 0, binding = 0) uniform ProjView {
 	mat4 view[6];
 } views;
 
+struct DrawInfo {
+	uint node;
+	uint material;
+};
+
+// Indexed by gl_InstanceIndex, the firstInstance of each draw is the index of the primitive.
+layout(set = 1, binding = 0) readonly buffer NodeTransforms {
+	mat4 data[];
+} nodeTransforms;
+
+layout(set = 1, binding = 1) readonly buffer DrawInfos {
+	DrawInfo data[];
+} drawInfos;
+
 layout(push_constant) uniform PushConsts {
-	mat4 model;
 	vec3 lightPos;
 	float radius;
 	float p22;
@@ -22,9 +35,10 @@ layout(push_constant) uniform PushConsts {
 } pcb;
 
 void main() {
+	mat4 model = nodeTransforms.data[drawInfos.data[gl_InstanceIndex].node];
 	mat4 proj = views.projection;
 	proj[2][2] = pcb.p22;
 	proj[3][2] = pcb.p32;
-	O_POSITION = pcb.model * vec4(A_POSITION, 1.0f);
+	O_POSITION = model * vec4(A_POSITION, 1.0f);
 	gl_Position = proj * views.view[gl_ViewIndex] * (O_POSITION - vec4(pcb.lightPos, 0.0f));
 }
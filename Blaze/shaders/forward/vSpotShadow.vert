@@ -0,0 +1,35 @@
+#version 450
+
+layout(location = 0) in vec3 A_POSITION;
+layout(location = 1) in vec3 A_NORMAL;
+layout(location = 2) in vec2 A_UV0;
+layout(location = 3) in vec2 A_UV1;
+
+layout(location = 0) out vec4 O_POSITION;
+
+struct DrawInfo {
+	uint node;
+	uint material;
+};
+
+// Indexed by gl_InstanceIndex, the firstInstance of each draw is the index of the primitive.
+layout(set = 0, binding = 0) readonly buffer NodeTransforms {
+	mat4 data[];
+} nodeTransforms;
+
+layout(set = 0, binding = 1) readonly buffer DrawInfos {
+	DrawInfo data[];
+} drawInfos;
+
+// The single view of the spot light down its cone.
+layout(push_constant) uniform PushConsts {
+	mat4 viewProj;
+	vec3 lightPos;
+	float radius;
+} pcb;
+
+void main() {
+	mat4 model = nodeTransforms.data[drawInfos.data[gl_InstanceIndex].node];
+	O_POSITION = model * vec4(A_POSITION, 1.0f);
+	gl_Position = pcb.viewProj * O_POSITION;
+}
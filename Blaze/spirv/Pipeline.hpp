@@ -10,6 +10,9 @@
 
 namespace blaze::spirv
 {
+/// Number of descriptors backing a runtime sized descriptor array (eg. `sampler2D textures[]`).
+constexpr uint32_t MAX_RUNTIME_ARRAY_LENGTH = 4096;
+
 /**
  * @brief Holds the reflection information of a uniform.
  */
@@ -25,6 +28,8 @@ struct UniformInfo
 	uint32_t size;
     /// The variable name of the UBO.
 	std::string name;
+    /// Runtime sized array, partially bound and updatable after bind via VK_EXT_descriptor_indexing.
+	bool runtimeArray{false};
 
 	bool operator!=(const UniformInfo& other) const
 	{
@@ -82,6 +87,8 @@ struct Shader
 		uint32_t set{0};
 		std::vector<UniformInfo> uniforms;
 		vkw::DescriptorSetLayout layout;
+		/// The set contains a runtime array and needs an update after bind pool.
+		bool updateAfterBind{false};
 
 		using FormatID = uint32_t;
         /**
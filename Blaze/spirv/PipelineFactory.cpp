@@ -107,6 +107,13 @@ Shader PipelineFactory::createShader(const std::vector<ShaderStageData>& stages)
 					info.size = binding->block.size;
 					info.name = binding->name;
 
+					// Runtime arrays are backed by a fixed size, partially bound descriptor array.
+					if (binding->type_description->op == SpvOpTypeRuntimeArray)
+					{
+						info.arrayLength = MAX_RUNTIME_ARRAY_LENGTH;
+						info.runtimeArray = true;
+					}
+
 					if (uniformInfos[set->set].find(binding->binding) != uniformInfos[set->set].end())
 					{
 						if (uniformInfos[set->set][binding->binding].type != info.type)
@@ -254,12 +261,21 @@ Shader PipelineFactory::createShader(const std::vector<ShaderStageData>& stages)
 
 		lay.set = set;
 		vector<VkDescriptorSetLayoutBinding> binds;
+		vector<VkDescriptorBindingFlagsEXT> bindFlags;
 		for (auto& [key, val] : map)
 		{
 			lay.uniforms.push_back(val);
 			binds.push_back(static_cast<VkDescriptorSetLayoutBinding>(val));
+			bindFlags.push_back(val.runtimeArray ? VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT |
+													   VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT
+												 : 0);
+			lay.updateAfterBind |= val.runtimeArray;
+		}
+		if (!lay.updateAfterBind)
+		{
+			bindFlags.clear();
 		}
-		lay.layout = vkw::DescriptorSetLayout(util::createDescriptorSetLayout(device, binds), device);
+		lay.layout = vkw::DescriptorSetLayout(util::createDescriptorSetLayout(device, binds, bindFlags), device);
 
 		setFormatKeys.push_back(getFormatKey(lay.uniforms));
 	}
@@ -377,6 +393,32 @@ Pipeline PipelineFactory::createGraphicsPipeline(const Shader& shader, const Ren
 	return pipe;
 }
 
+Pipeline PipelineFactory::createComputePipeline(const Shader& shader)
+{
+	if (!shader.isCompute)
+	{
+		throw std::invalid_argument("ERR: Trying to create a Compute Pipeline from a Rendering Shader");
+	}
+
+	VkComputePipelineCreateInfo pipelineCreateInfo = {};
+	pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineCreateInfo.stage = shader.pipelineStages.front();
+	pipelineCreateInfo.layout = shader.pipelineLayout.get();
+	pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
+	pipelineCreateInfo.basePipelineIndex = -1;
+
+	VkPipeline computePipeline = VK_NULL_HANDLE;
+	auto result = vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &computePipeline);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Compute Pipeline creation failed with " + std::to_string(result));
+	}
+	Pipeline pipe = {};
+	pipe.pipeline = vkw::Pipeline(computePipeline, device);
+	pipe.bindPoint = VK_PIPELINE_BIND_POINT_COMPUTE;
+	return pipe;
+}
+
 PipelineFactory::SetFormatID PipelineFactory::getFormatKey(const std::vector<UniformInfo>& uniforms)
 {
 	if (uniforms.size())
@@ -610,7 +652,7 @@ vkw::DescriptorPool PipelineFactory::createDescriptorPool(const Shader::Set& set
 		{
 			if (poolSize.type == uniform.type)
 			{
-				poolSize.descriptorCount++;
+				poolSize.descriptorCount += uniform.arrayLength;
 				found = true;
 				break;
 			}
@@ -619,7 +661,7 @@ vkw::DescriptorPool PipelineFactory::createDescriptorPool(const Shader::Set& set
 		{
 			auto& ps = poolSizes.emplace_back();
 			ps.type = uniform.type;
-			ps.descriptorCount = 1;
+			ps.descriptorCount = uniform.arrayLength;
 		}
 	}
 	for (auto& ps : poolSizes)
@@ -627,7 +669,9 @@ vkw::DescriptorPool PipelineFactory::createDescriptorPool(const Shader::Set& set
 		ps.descriptorCount *= maxSets;
 	}
 
-	return vkw::DescriptorPool(util::createDescriptorPool(device, poolSizes, static_cast<uint32_t>(maxSets)), device);
+	VkDescriptorPoolCreateFlags flags = set.updateAfterBind ? VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT : 0;
+	return vkw::DescriptorPool(
+		util::createDescriptorPool(device, poolSizes, static_cast<uint32_t>(maxSets), flags), device);
 }
 
 RenderPass PipelineFactory::createRenderPass(const std::vector<AttachmentFormat>& formats,
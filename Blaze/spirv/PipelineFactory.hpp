@@ -305,6 +305,13 @@ public:
 	Pipeline createGraphicsPipeline(const Shader& shader, const RenderPass& renderPass,
 									const GraphicsPipelineCreateInfo& createInfo);
 
+	/**
+	 * @brief Creates the compute pipeline from the shader.
+	 *
+	 * @param shader The compute Shader to use to create the pipeline.
+	 */
+	Pipeline createComputePipeline(const Shader& shader);
+
 	/**
 	 * @brief Creates a renderpass given the attachments and subpasses.
 	 *
@@ -1,6 +1,8 @@
 
 #pragma once
 
+#include <cassert>
+#include <cstdint>
 #include <memory>
 #include <vector>
 
@@ -11,6 +13,8 @@ namespace blaze::util
  *
  * PackedHandler returns a handle that can be used to refer to the object from it as required.
  * The Handle will automatically erase the object on deletion, and it denotes an ownership of the object.
+ *
+ * Superseded by SlotMap, and only kept as the baseline of bench/SlotMapBenchmark.
  */
 template <typename T>
 class PackedHandler
@@ -148,7 +152,9 @@ private:
 	{
 		if (index < data.size() - 1)
 		{
-			std::swap(handles.at(index).lock()->index, handles.back().lock()->index);
+			// Called from the destructor of the erased handle, whose weak pointer has already expired,
+			// so only the handle of the moved value is updated.
+			handles.back().lock()->index = index;
 
 			std::swap(data.at(index), data.back());
 			std::swap(handles.at(index), handles.back());
@@ -0,0 +1,278 @@
+#include "RadianceReader.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BLAZE_RGBE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace blaze::util
+{
+namespace
+{
+// E5B9G9R9 stores m * 2^(e - 24) with 9 bit mantissas, RGBE m * 2^(e - 136) with 8 bit ones, so
+// doubling the mantissa leaves an exponent of e - 113.
+constexpr int32_t EXPONENT_BIAS = 113;
+constexpr uint32_t MAX_EXPONENT = 31;
+constexpr uint32_t MAX_TEXEL = 0x1FFu | (0x1FFu << 9) | (0x1FFu << 18) | (MAX_EXPONENT << 27);
+
+uint32_t convertTexel(uint8_t r, uint8_t g, uint8_t b, uint8_t e)
+{
+	if (e == 0)
+	{
+		return 0;
+	}
+
+	int32_t exponent = static_cast<int32_t>(e) - EXPONENT_BIAS;
+	if (exponent > static_cast<int32_t>(MAX_EXPONENT))
+	{
+		return MAX_TEXEL;
+	}
+
+	uint32_t red = static_cast<uint32_t>(r) << 1;
+	uint32_t green = static_cast<uint32_t>(g) << 1;
+	uint32_t blue = static_cast<uint32_t>(b) << 1;
+	if (exponent < 0)
+	{
+		// Denormalized, below the smallest exponent.
+		const int32_t shift = -exponent;
+		if (shift > 9)
+		{
+			return 0;
+		}
+		red >>= shift;
+		green >>= shift;
+		blue >>= shift;
+		exponent = 0;
+	}
+	return red | (green << 9) | (blue << 18) | (static_cast<uint32_t>(exponent) << 27);
+}
+
+#ifdef BLAZE_RGBE_SSE2
+inline __m128i loadWidened(const uint8_t* src)
+{
+	int32_t bytes;
+	memcpy(&bytes, src, sizeof(bytes));
+	const __m128i zero = _mm_setzero_si128();
+	__m128i x = _mm_cvtsi32_si128(bytes);
+	x = _mm_unpacklo_epi8(x, zero);
+	return _mm_unpacklo_epi16(x, zero);
+}
+#endif
+
+/**
+ * @brief Converts the R, G, B and E planes of a scanline.
+ */
+void convertPlanes(const uint8_t* planes, uint32_t width, uint32_t* dst)
+{
+	const uint8_t* red = planes;
+	const uint8_t* green = planes + width;
+	const uint8_t* blue = planes + 2 * width;
+	const uint8_t* exponent = planes + 3 * width;
+
+	uint32_t x = 0;
+#ifdef BLAZE_RGBE_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i bias = _mm_set1_epi32(EXPONENT_BIAS);
+	const __m128i minExponent = _mm_set1_epi32(-1);
+	const __m128i maxExponent = _mm_set1_epi32(MAX_EXPONENT + 1);
+	for (; x + 4 <= width; x += 4)
+	{
+		const __m128i e = loadWidened(exponent + x);
+		const __m128i shifted = _mm_sub_epi32(e, bias);
+		const __m128i isZero = _mm_cmpeq_epi32(e, zero);
+		const __m128i inRange =
+			_mm_and_si128(_mm_cmpgt_epi32(shifted, minExponent), _mm_cmplt_epi32(shifted, maxExponent));
+
+		// Texels that need clamping or denormalizing are rare, and take the scalar path.
+		if (_mm_movemask_epi8(_mm_or_si128(inRange, isZero)) != 0xFFFF)
+		{
+			for (uint32_t i = x; i < x + 4; i++)
+			{
+				dst[i] = convertTexel(red[i], green[i], blue[i], exponent[i]);
+			}
+			continue;
+		}
+
+		__m128i packed = _mm_slli_epi32(loadWidened(red + x), 1);
+		packed = _mm_or_si128(packed, _mm_slli_epi32(loadWidened(green + x), 10));
+		packed = _mm_or_si128(packed, _mm_slli_epi32(loadWidened(blue + x), 19));
+		packed = _mm_or_si128(packed, _mm_slli_epi32(shifted, 27));
+		packed = _mm_andnot_si128(isZero, packed);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), packed);
+	}
+#endif
+	for (; x < width; x++)
+	{
+		dst[x] = convertTexel(red[x], green[x], blue[x], exponent[x]);
+	}
+}
+} // namespace
+
+RadianceReader::RadianceReader(const std::string& filename)
+	: file(filename, std::ios::binary), filename(filename), buffer(BUFFER_SIZE)
+{
+	if (!file.is_open())
+	{
+		throw std::runtime_error("Image " + filename + " could not be loaded.");
+	}
+	readHeader();
+	planes.resize(4 * size_t(width));
+}
+
+void RadianceReader::readRows(uint32_t rowCount, uint32_t* dst)
+{
+	if (rowCount > get_rowsLeft())
+	{
+		throw std::invalid_argument("Reading past the end of " + filename);
+	}
+
+	for (uint32_t row = 0; row < rowCount; row++)
+	{
+		readScanline(dst + size_t(row) * width);
+	}
+	currentRow += rowCount;
+}
+
+uint8_t RadianceReader::readByte()
+{
+	if (bufferPos == bufferEnd)
+	{
+		file.read(reinterpret_cast<char*>(buffer.data()), buffer.size());
+		bufferPos = 0;
+		bufferEnd = static_cast<size_t>(file.gcount());
+		if (bufferEnd == 0)
+		{
+			throw std::runtime_error("Image " + filename + " ended early.");
+		}
+	}
+	return buffer[bufferPos++];
+}
+
+void RadianceReader::readBytes(uint8_t* dst, size_t count)
+{
+	while (count > 0)
+	{
+		if (bufferPos == bufferEnd)
+		{
+			// Refills the buffer.
+			*dst++ = readByte();
+			count--;
+			continue;
+		}
+		const size_t available = std::min(count, bufferEnd - bufferPos);
+		memcpy(dst, buffer.data() + bufferPos, available);
+		bufferPos += available;
+		dst += available;
+		count -= available;
+	}
+}
+
+std::string RadianceReader::readLine()
+{
+	std::string line;
+	for (uint8_t c = readByte(); c != '\n'; c = readByte())
+	{
+		line.push_back(static_cast<char>(c));
+	}
+	return line;
+}
+
+void RadianceReader::readHeader()
+{
+	const std::string magic = readLine();
+	if (magic != "#?RADIANCE" && magic != "#?RGBE")
+	{
+		throw std::runtime_error("Image " + filename + " is not a Radiance image.");
+	}
+
+	for (std::string line = readLine(); !line.empty(); line = readLine())
+	{
+		if (line.rfind("FORMAT=", 0) == 0 && line != "FORMAT=32-bit_rle_rgbe")
+		{
+			throw std::runtime_error("Image " + filename + " has unsupported " + line);
+		}
+	}
+
+	std::istringstream resolution(readLine());
+	std::string yAxis, xAxis;
+	int64_t rows = 0, columns = 0;
+	resolution >> yAxis >> rows >> xAxis >> columns;
+	if (!resolution || yAxis != "-Y" || xAxis != "+X" || rows <= 0 || columns <= 0 || rows > INT32_MAX ||
+		columns > INT32_MAX)
+	{
+		throw std::runtime_error("Image " + filename + " has an unsupported resolution or orientation.");
+	}
+	height = static_cast<uint32_t>(rows);
+	width = static_cast<uint32_t>(columns);
+}
+
+void RadianceReader::readScanline(uint32_t* dst)
+{
+	uint8_t* pixels = planes.data();
+
+	// Scanlines outside of these widths can't be run length encoded.
+	if (width < 8 || width > 0x7FFF)
+	{
+		readBytes(pixels, 4 * size_t(width));
+		for (uint32_t x = 0; x < width; x++)
+		{
+			dst[x] = convertTexel(pixels[4 * x], pixels[4 * x + 1], pixels[4 * x + 2], pixels[4 * x + 3]);
+		}
+		return;
+	}
+
+	uint8_t head[4];
+	readBytes(head, sizeof(head));
+	if (head[0] != 2 || head[1] != 2 || (head[2] & 0x80))
+	{
+		// A flat scanline, of which the head is the first pixel.
+		memcpy(pixels, head, sizeof(head));
+		readBytes(pixels + 4, 4 * (size_t(width) - 1));
+		for (uint32_t x = 0; x < width; x++)
+		{
+			dst[x] = convertTexel(pixels[4 * x], pixels[4 * x + 1], pixels[4 * x + 2], pixels[4 * x + 3]);
+		}
+		return;
+	}
+
+	if (((uint32_t(head[2]) << 8) | head[3]) != width)
+	{
+		throw std::runtime_error("Image " + filename + " has a corrupt scanline.");
+	}
+
+	for (uint32_t channel = 0; channel < 4; channel++)
+	{
+		uint8_t* plane = pixels + size_t(channel) * width;
+		uint32_t x = 0;
+		while (x < width)
+		{
+			uint32_t count = readByte();
+			if (count > 128)
+			{
+				count -= 128;
+				if (x + count > width)
+				{
+					throw std::runtime_error("Image " + filename + " has a corrupt scanline.");
+				}
+				memset(plane + x, readByte(), count);
+			}
+			else
+			{
+				if (count == 0 || x + count > width)
+				{
+					throw std::runtime_error("Image " + filename + " has a corrupt scanline.");
+				}
+				readBytes(plane + x, count);
+			}
+			x += count;
+		}
+	}
+
+	convertPlanes(pixels, width, dst);
+}
+} // namespace blaze::util
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace blaze::util
+{
+/**
+ * @brief Streaming reader for Radiance RGBE (.hdr) images.
+ *
+ * Decodes scanlines top to bottom straight into packed \a VK_FORMAT_E5B9G9R9_UFLOAT_PACK32 texels.
+ * RGBE and E5B9G9R9 are both shared exponent formats, so the conversion is exact integer work that
+ * never goes through floats, and is vectorized for run length encoded scanlines. Only the scanline
+ * being decoded is held in memory, so images can be uploaded in bands of rows.
+ *
+ * Only the standard \a -Y \a +X orientation is supported.
+ */
+class RadianceReader
+{
+private:
+	constexpr static size_t BUFFER_SIZE = 1 << 20;
+
+	std::ifstream file;
+	std::string filename;
+	uint32_t width{0};
+	uint32_t height{0};
+	uint32_t currentRow{0};
+
+	std::vector<uint8_t> buffer;
+	size_t bufferPos{0};
+	size_t bufferEnd{0};
+
+	// The channels of a run length encoded scanline, as R, G, B and E planes of width bytes.
+	std::vector<uint8_t> planes;
+
+public:
+	/**
+	 * @brief Opens the file and reads the header.
+	 *
+	 * @param filename The path of the .hdr file.
+	 *
+	 * @throws std::runtime_error If the file can't be opened or is not a supported Radiance image.
+	 */
+	explicit RadianceReader(const std::string& filename);
+
+	/**
+	 * @brief Decodes the next rows of the image.
+	 *
+	 * @param rowCount The number of rows to decode, at most the rows left.
+	 * @param dst The texels of the rows, \a rowCount times the width.
+	 *
+	 * @throws std::runtime_error If the file ends early or a scanline is corrupt.
+	 */
+	void readRows(uint32_t rowCount, uint32_t* dst);
+
+	/**
+	 * @name Getters.
+	 *
+	 * @brief Getters for private variables.
+	 *
+	 * @{
+	 */
+	uint32_t get_width() const
+	{
+		return width;
+	}
+
+	uint32_t get_height() const
+	{
+		return height;
+	}
+
+	uint32_t get_rowsLeft() const
+	{
+		return height - currentRow;
+	}
+	/**
+	 * @}
+	 */
+
+private:
+	uint8_t readByte();
+	void readBytes(uint8_t* dst, size_t count);
+	std::string readLine();
+	void readHeader();
+	void readScanline(uint32_t* dst);
+};
+} // namespace blaze::util
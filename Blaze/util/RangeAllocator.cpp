@@ -0,0 +1,71 @@
+#include "RangeAllocator.hpp"
+
+#include <algorithm>
+
+namespace blaze::util
+{
+RangeAllocator::RangeAllocator(uint32_t capacity) noexcept : capacity(capacity)
+{
+	if (capacity > 0)
+	{
+		freeRanges.push_back({0, capacity});
+	}
+}
+
+std::optional<RangeAllocator::Range> RangeAllocator::allocate(uint32_t count)
+{
+	for (auto it = freeRanges.begin(); it != freeRanges.end(); ++it)
+	{
+		if (it->count >= count)
+		{
+			Range range = {it->first, count};
+			it->first += count;
+			it->count -= count;
+			if (it->count == 0)
+			{
+				freeRanges.erase(it);
+			}
+			return range;
+		}
+	}
+	return std::nullopt;
+}
+
+void RangeAllocator::release(const Range& range)
+{
+	if (range.count == 0)
+	{
+		return;
+	}
+
+	auto it = std::lower_bound(freeRanges.begin(), freeRanges.end(), range.first,
+							   [](const Range& r, uint32_t first) { return r.first < first; });
+	it = freeRanges.insert(it, range);
+
+	// Coalesce with the neighbours.
+	auto next = it + 1;
+	if (next != freeRanges.end() && it->first + it->count == next->first)
+	{
+		it->count += next->count;
+		freeRanges.erase(next);
+	}
+	if (it != freeRanges.begin())
+	{
+		auto prev = it - 1;
+		if (prev->first + prev->count == it->first)
+		{
+			prev->count += it->count;
+			freeRanges.erase(it);
+		}
+	}
+}
+
+bool RangeAllocator::fragmented() const
+{
+	if (freeRanges.empty())
+	{
+		return false;
+	}
+	return freeRanges.size() > 1 || freeRanges.back().first + freeRanges.back().count != capacity;
+}
+} // namespace blaze::util
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace blaze::util
+{
+/**
+ * @brief First fit allocator of contiguous ranges of slots in [0, capacity).
+ *
+ * Only the bookkeeping is done, the slots can be elements of any buffer or descriptor array.
+ * Released ranges are merged with their free neighbours.
+ */
+class RangeAllocator
+{
+public:
+	/**
+	 * @brief A contiguous range of slots.
+	 */
+	struct Range
+	{
+		uint32_t first{0};
+		uint32_t count{0};
+	};
+
+private:
+	uint32_t capacity{0};
+	/// Free ranges sorted by their first slot.
+	std::vector<Range> freeRanges;
+
+public:
+	/**
+	 * @brief Default constructor.
+	 */
+	RangeAllocator() noexcept
+	{
+	}
+
+	/**
+	 * @brief Main constructor.
+	 *
+	 * @param capacity The number of slots, all free.
+	 */
+	explicit RangeAllocator(uint32_t capacity) noexcept;
+
+	/**
+	 * @brief Allocates \a count contiguous slots.
+	 *
+	 * @returns The range, or nullopt if no free range is large enough.
+	 */
+	std::optional<Range> allocate(uint32_t count);
+
+	/**
+	 * @brief Returns the slots of \a range to the allocator.
+	 */
+	void release(const Range& range);
+
+	/**
+	 * @brief Checks if the free slots are split by allocated ones.
+	 *
+	 * An unfragmented allocator has at most one free range, at its end.
+	 */
+	bool fragmented() const;
+
+	inline uint32_t get_capacity() const
+	{
+		return capacity;
+	}
+};
+} // namespace blaze::util
@@ -0,0 +1,211 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+namespace blaze::util
+{
+/**
+ * @brief A densely packed collection addressed by generational handles.
+ *
+ * The values are kept contiguous for iteration, removal moves the last value into the hole.
+ * A Handle packs the index of a slot with the generation of the slot, the generation is bumped
+ * on removal so that stale handles are rejected instead of aliasing a newer value.
+ *
+ * The generation has 12 bits, so a slot can hold 4095 values. A slot whose generation would wrap
+ * is retired and never reused, instead of letting old handles match again. Retired slots count
+ * towards MAX_SIZE, which is only reached after about 4 billion removals.
+ *
+ * Adding and removing are O(1) with no allocation beyond the growth of the vectors, and no
+ * pointers into the container are kept, so it can be moved freely.
+ *
+ * @tparam T The type of the values.
+ */
+template <typename T>
+class SlotMap
+{
+public:
+	/// Index in the low INDEX_BITS, generation in the rest. Zero is never a valid handle.
+	using Handle = uint32_t;
+
+	constexpr static uint32_t INDEX_BITS = 20;
+	constexpr static uint32_t MAX_SIZE = 1u << INDEX_BITS;
+	constexpr static Handle INVALID_HANDLE = 0;
+
+private:
+	constexpr static uint32_t INDEX_MASK = MAX_SIZE - 1;
+	constexpr static uint32_t GENERATION_MASK = (1u << (32 - INDEX_BITS)) - 1;
+
+	struct Slot
+	{
+		/// Index of the value in data, or the next free slot when free.
+		uint32_t dense;
+		uint32_t generation;
+	};
+
+	std::vector<T> data;
+	/// The slot of each value in data.
+	std::vector<uint32_t> dataSlots;
+	std::vector<Slot> slots;
+	uint32_t freeHead{MAX_SIZE};
+
+public:
+	/**
+	 * @brief Adds the new value and returns its handle.
+	 */
+	[[nodiscard]] Handle add(T&& val)
+	{
+		uint32_t slot = acquireSlot();
+		data.push_back(std::move(val));
+		return makeHandle(slot);
+	}
+
+	/**
+	 * @brief Adds the new value and returns its handle.
+	 */
+	[[nodiscard]] Handle add(const T& val)
+	{
+		uint32_t slot = acquireSlot();
+		data.push_back(val);
+		return makeHandle(slot);
+	}
+
+	/**
+	 * @brief Removes the value of \a handle.
+	 *
+	 * @returns False if the handle was invalid or already removed.
+	 */
+	bool remove(Handle handle)
+	{
+		if (!contains(handle))
+		{
+			return false;
+		}
+
+		const uint32_t slot = handle & INDEX_MASK;
+		const uint32_t dense = slots[slot].dense;
+		const uint32_t last = static_cast<uint32_t>(data.size()) - 1;
+		if (dense != last)
+		{
+			data[dense] = std::move(data[last]);
+			dataSlots[dense] = dataSlots[last];
+			slots[dataSlots[dense]].dense = dense;
+		}
+		data.pop_back();
+		dataSlots.pop_back();
+
+		// Generations start at 1 so that no handle is ever 0. A slot at the last generation is retired, its
+		// dense index stays out of range so that its handles never resolve again.
+		if (slots[slot].generation == GENERATION_MASK)
+		{
+			slots[slot].dense = MAX_SIZE;
+			return true;
+		}
+		slots[slot].generation++;
+		slots[slot].dense = freeHead;
+		freeHead = slot;
+		return true;
+	}
+
+	/**
+	 * @brief Checks if \a handle refers to a value in the map.
+	 */
+	bool contains(Handle handle) const
+	{
+		const uint32_t slot = handle & INDEX_MASK;
+		return handle != INVALID_HANDLE && slot < slots.size() &&
+			   slots[slot].generation == (handle >> INDEX_BITS) && slots[slot].dense < data.size() &&
+			   dataSlots[slots[slot].dense] == slot;
+	}
+
+	/**
+	 * @brief Returns the value of \a handle, or nullptr if the handle is stale.
+	 */
+	T* get(Handle handle)
+	{
+		return contains(handle) ? &data[slots[handle & INDEX_MASK].dense] : nullptr;
+	}
+
+	const T* get(Handle handle) const
+	{
+		return contains(handle) ? &data[slots[handle & INDEX_MASK].dense] : nullptr;
+	}
+
+	/**
+	 * @brief Removes every value, invalidating all handles.
+	 */
+	void clear()
+	{
+		while (!dataSlots.empty())
+		{
+			remove(makeHandle(dataSlots.back()));
+		}
+	}
+
+	/**
+	 * @brief Reserves room for \a count values, to add many at once without reallocating.
+	 */
+	void reserve(uint32_t count)
+	{
+		data.reserve(count);
+		dataSlots.reserve(count);
+		slots.reserve(count);
+	}
+
+	auto begin()
+	{
+		return data.begin();
+	}
+
+	auto end()
+	{
+		return data.end();
+	}
+
+	auto begin() const
+	{
+		return data.begin();
+	}
+
+	auto end() const
+	{
+		return data.end();
+	}
+
+	const std::vector<T>& get_data() const
+	{
+		return data;
+	}
+
+	uint32_t get_size() const
+	{
+		return static_cast<uint32_t>(data.size());
+	}
+
+private:
+	uint32_t acquireSlot()
+	{
+		uint32_t slot;
+		if (freeHead != MAX_SIZE)
+		{
+			slot = freeHead;
+			freeHead = slots[slot].dense;
+		}
+		else
+		{
+			assert(slots.size() < MAX_SIZE);
+			slot = static_cast<uint32_t>(slots.size());
+			slots.push_back({0, 1});
+		}
+		slots[slot].dense = static_cast<uint32_t>(data.size());
+		dataSlots.push_back(slot);
+		return slot;
+	}
+
+	Handle makeHandle(uint32_t slot) const
+	{
+		return (slots[slot].generation << INDEX_BITS) | slot;
+	}
+};
+} // namespace blaze::util
@@ -0,0 +1,112 @@
+#include "TileAllocator.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+namespace blaze::util
+{
+namespace
+{
+uint32_t pack(uint32_t x, uint32_t y)
+{
+	return x | (y << 16);
+}
+} // namespace
+
+TileAllocator::TileAllocator(uint32_t atlasSize, uint32_t minTileSize) noexcept
+	: atlasSize(atlasSize), minTileSize(minTileSize)
+{
+	assert(atlasSize <= 65536 && minTileSize > 0 && minTileSize <= atlasSize);
+	freeTiles.resize(levelOf(minTileSize) + 1);
+	freeTiles[0].push_back(pack(0, 0));
+}
+
+std::optional<TileAllocator::Tile> TileAllocator::allocate(uint32_t size)
+{
+	assert(size >= minTileSize && size <= atlasSize);
+	const uint32_t level = levelOf(size);
+
+	// The smallest free tile that is large enough.
+	int32_t found = static_cast<int32_t>(level);
+	while (found >= 0 && freeTiles[found].empty())
+	{
+		found--;
+	}
+	if (found < 0)
+	{
+		return std::nullopt;
+	}
+
+	uint32_t packed = freeTiles[found].back();
+	freeTiles[found].pop_back();
+	uint32_t x = packed & 0xFFFFu;
+	uint32_t y = packed >> 16;
+
+	// Keep the first quarter, free the other three.
+	for (uint32_t l = found + 1; l <= level; l++)
+	{
+		uint32_t half = atlasSize >> l;
+		freeTiles[l].push_back(pack(x + half, y));
+		freeTiles[l].push_back(pack(x, y + half));
+		freeTiles[l].push_back(pack(x + half, y + half));
+	}
+
+	return Tile{x, y, size};
+}
+
+void TileAllocator::release(const Tile& tile)
+{
+	uint32_t level = levelOf(tile.size);
+	uint32_t x = tile.x;
+	uint32_t y = tile.y;
+
+	while (level > 0)
+	{
+		const uint32_t size = atlasSize >> level;
+		const uint32_t parentX = x & ~(2 * size - 1);
+		const uint32_t parentY = y & ~(2 * size - 1);
+
+		auto& tiles = freeTiles[level];
+		uint32_t buddies[3];
+		uint32_t count = 0;
+		for (uint32_t i = 0; i < 4; i++)
+		{
+			uint32_t buddy = pack(parentX + (i & 1) * size, parentY + (i >> 1) * size);
+			if (buddy != pack(x, y))
+			{
+				buddies[count++] = buddy;
+			}
+		}
+
+		const bool allFree = std::all_of(std::begin(buddies), std::end(buddies), [&tiles](uint32_t buddy) {
+			return std::find(tiles.begin(), tiles.end(), buddy) != tiles.end();
+		});
+		if (!allFree)
+		{
+			break;
+		}
+
+		tiles.erase(std::remove_if(tiles.begin(), tiles.end(),
+								   [&buddies](uint32_t t) {
+									   return std::find(std::begin(buddies), std::end(buddies), t) !=
+											  std::end(buddies);
+								   }),
+					tiles.end());
+		x = parentX;
+		y = parentY;
+		level--;
+	}
+
+	freeTiles[level].push_back(pack(x, y));
+}
+
+uint32_t TileAllocator::levelOf(uint32_t size) const
+{
+	uint32_t level = 0;
+	while ((atlasSize >> level) > size)
+	{
+		level++;
+	}
+	return level;
+}
+} // namespace blaze::util
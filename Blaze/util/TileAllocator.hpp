@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace blaze::util
+{
+/**
+ * @brief Buddy allocator of square tiles with power of two sizes in a square atlas.
+ *
+ * A free tile is split in four to serve a smaller request, and released tiles are merged back
+ * with their three buddies once all are free. Any free tile can be split down to the smallest
+ * size, so the smallest tiles can be allocated as long as there is free area.
+ * Only the bookkeeping is done, the atlas can be any image.
+ */
+class TileAllocator
+{
+public:
+	/**
+	 * @brief A square tile, in texels of the atlas.
+	 */
+	struct Tile
+	{
+		uint32_t x{0};
+		uint32_t y{0};
+		uint32_t size{0};
+	};
+
+private:
+	uint32_t atlasSize{0};
+	uint32_t minTileSize{0};
+	/// Free tiles of each size, the first level holds the tiles of atlasSize. Packed as x | y << 16.
+	std::vector<std::vector<uint32_t>> freeTiles;
+
+public:
+	/**
+	 * @brief Default constructor.
+	 */
+	TileAllocator() noexcept
+	{
+	}
+
+	/**
+	 * @brief Main constructor.
+	 *
+	 * @param atlasSize The size of the atlas, a power of two up to 65536.
+	 * @param minTileSize The size of the smallest tiles, a power of two.
+	 */
+	TileAllocator(uint32_t atlasSize, uint32_t minTileSize) noexcept;
+
+	/**
+	 * @brief Allocates a tile of \a size, a power of two between the smallest tile and the atlas size.
+	 *
+	 * @returns The tile, or nullopt if no free tile is large enough.
+	 */
+	std::optional<Tile> allocate(uint32_t size);
+
+	/**
+	 * @brief Returns \a tile to the allocator.
+	 */
+	void release(const Tile& tile);
+
+private:
+	uint32_t levelOf(uint32_t size) const;
+};
+} // namespace blaze::util
@@ -1,5 +1,6 @@
 #include "createFunctions.hpp"
 
+#include <cassert>
 #include <optional>
 #include <stdexcept>
 #include <string>
@@ -53,8 +54,24 @@ VkFence createFence(VkDevice device)
 	throw std::runtime_error("Fence creation failed with " + std::to_string(result));
 }
 
+VkQueryPool createQueryPool(VkDevice device, VkQueryType type, uint32_t count)
+{
+	VkQueryPool pool = VK_NULL_HANDLE;
+	VkQueryPoolCreateInfo createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	createInfo.queryType = type;
+	createInfo.queryCount = count;
+	auto result = vkCreateQueryPool(device, &createInfo, nullptr, &pool);
+	if (result == VK_SUCCESS)
+	{
+		return pool;
+	}
+	throw std::runtime_error("Query pool creation failed with " + std::to_string(result));
+}
+
 VkImageView createImageView(VkDevice device, VkImage image, VkImageViewType viewType, VkFormat format,
-							VkImageAspectFlags aspect, uint32_t miplevels, uint32_t numLayers, uint32_t baseLayer)
+							VkImageAspectFlags aspect, uint32_t miplevels, uint32_t numLayers, uint32_t baseLayer,
+							uint32_t baseMip)
 {
 	VkImageView view;
 	VkImageViewCreateInfo createInfo = {};
@@ -67,7 +84,7 @@ VkImageView createImageView(VkDevice device, VkImage image, VkImageViewType view
 	createInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
 	createInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
 	createInfo.subresourceRange.aspectMask = aspect;
-	createInfo.subresourceRange.baseMipLevel = 0;
+	createInfo.subresourceRange.baseMipLevel = baseMip;
 	createInfo.subresourceRange.levelCount = miplevels;
 	createInfo.subresourceRange.baseArrayLayer = baseLayer;
 	createInfo.subresourceRange.layerCount = numLayers;
@@ -80,14 +97,15 @@ VkImageView createImageView(VkDevice device, VkImage image, VkImageViewType view
 	return view;
 }
 
-VkDescriptorPool createDescriptorPool(VkDevice device, std::vector<VkDescriptorPoolSize>& poolSizes, uint32_t maxSets)
+VkDescriptorPool createDescriptorPool(VkDevice device, std::vector<VkDescriptorPoolSize>& poolSizes, uint32_t maxSets,
+										VkDescriptorPoolCreateFlags flags)
 {
 	VkDescriptorPoolCreateInfo createInfo = {};
 	createInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
 	createInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
 	createInfo.pPoolSizes = poolSizes.data();
 	createInfo.maxSets = maxSets;
-	createInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+	createInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT | flags;
 
 	VkDescriptorPool pool;
 	auto result = vkCreateDescriptorPool(device, &createInfo, nullptr, &pool);
@@ -99,7 +117,8 @@ VkDescriptorPool createDescriptorPool(VkDevice device, std::vector<VkDescriptorP
 }
 
 VkDescriptorSetLayout createDescriptorSetLayout(VkDevice device,
-												std::vector<VkDescriptorSetLayoutBinding>& layoutBindings)
+												std::vector<VkDescriptorSetLayoutBinding>& layoutBindings,
+												const std::vector<VkDescriptorBindingFlagsEXT>& bindingFlags)
 {
 	VkDescriptorSetLayout descriptorSetLayout;
 
@@ -108,6 +127,24 @@ VkDescriptorSetLayout createDescriptorSetLayout(VkDevice device,
 	layoutInfo.bindingCount = static_cast<uint32_t>(layoutBindings.size());
 	layoutInfo.pBindings = layoutBindings.data();
 
+	VkDescriptorSetLayoutBindingFlagsCreateInfoEXT flagsInfo = {};
+	if (!bindingFlags.empty())
+	{
+		assert(bindingFlags.size() == layoutBindings.size());
+		flagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+		flagsInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+		flagsInfo.pBindingFlags = bindingFlags.data();
+		layoutInfo.pNext = &flagsInfo;
+
+		for (auto flag : bindingFlags)
+		{
+			if (flag & VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT)
+			{
+				layoutInfo.flags |= VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+			}
+		}
+	}
+
 	auto result = vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptorSetLayout);
 	if (result != VK_SUCCESS)
 	{
@@ -483,7 +520,8 @@ VkPipeline createGraphicsPipeline(VkDevice device, VkPipelineLayout pipelineLayo
 	return graphicsPipeline;
 }
 
-VkSampler createSampler(VkDevice device, uint32_t miplevels, VkSamplerAddressMode addressMode, VkBool32 anisotropy)
+VkSampler createSampler(VkDevice device, uint32_t miplevels, VkSamplerAddressMode addressMode, VkBool32 anisotropy,
+						VkBool32 depthCompare)
 {
 	VkSamplerCreateInfo createInfo = {};
 	createInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
@@ -496,8 +534,9 @@ VkSampler createSampler(VkDevice device, uint32_t miplevels, VkSamplerAddressMod
 	createInfo.maxAnisotropy = 16;
 	createInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
 	createInfo.unnormalizedCoordinates = VK_FALSE;
-	createInfo.compareEnable = VK_FALSE;
-	createInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+	// Passes when the reference is not behind the stored depth, filtered bilinearly over 4 texels.
+	createInfo.compareEnable = depthCompare;
+	createInfo.compareOp = depthCompare ? VK_COMPARE_OP_LESS_OR_EQUAL : VK_COMPARE_OP_ALWAYS;
 	createInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
 	createInfo.mipLodBias = 0.0f;
 	createInfo.minLod = 0.0f;
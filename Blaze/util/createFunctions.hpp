@@ -34,6 +34,15 @@ namespace blaze::util
  */
 [[nodiscard]] VkFence createFence(VkDevice device);
 
+/**
+ * @brief Creates a query pool on the device.
+ *
+ * @param device The logical device used.
+ * @param type The type of the queries.
+ * @param count The number of queries in the pool.
+ */
+[[nodiscard]] VkQueryPool createQueryPool(VkDevice device, VkQueryType type, uint32_t count);
+
 /**
  * @brief Creates an image view.
  *
@@ -45,10 +54,11 @@ namespace blaze::util
  * @param miplevels The number of levels of mipmapping in the image.
  * @param numLayers The number of layers in the image to construct a view for.
  * @param baseLayer The first layer from which to construct views.
+ * @param baseMip The first mip level of the view.
  */
 [[nodiscard]] VkImageView createImageView(VkDevice device, VkImage image, VkImageViewType viewType, VkFormat format,
 										  VkImageAspectFlags aspect, uint32_t miplevels, uint32_t numLayers,
-										  uint32_t baseLayer = 0);
+										  uint32_t baseLayer = 0, uint32_t baseMip = 0);
 
 /**
  * @brief Creates a new descriptor pool as per the poolsizes.
@@ -56,18 +66,21 @@ namespace blaze::util
  * @param device The logical device used.
  * @param poolSizes The vector of pool sizes to support.
  * @param maxSets The maximum number of descriptor sets to support.
+ * @param flags Additional creation flags, eg. for update after bind sets.
  */
 [[nodiscard]] VkDescriptorPool createDescriptorPool(VkDevice device, std::vector<VkDescriptorPoolSize>& poolSizes,
-													uint32_t maxSets);
+													uint32_t maxSets, VkDescriptorPoolCreateFlags flags = 0);
 
 /**
  * @brief Creates a descriptor set layout as per the bindings.
  *
  * @param device The logical device used.
  * @param layoutBindings The vector of layout bindings in the descriptor set.
+ * @param bindingFlags Optional VK_EXT_descriptor_indexing flags for each of the bindings.
  */
 [[nodiscard]] VkDescriptorSetLayout createDescriptorSetLayout(
-	VkDevice device, std::vector<VkDescriptorSetLayoutBinding>& layoutBindings);
+	VkDevice device, std::vector<VkDescriptorSetLayoutBinding>& layoutBindings,
+	const std::vector<VkDescriptorBindingFlagsEXT>& bindingFlags = {});
 
 /**
  * @brief Creates a renderpass as per the configuration.
@@ -154,5 +167,5 @@ namespace blaze::util
 		Vertex::getAttributeDescriptions());
 
 [[nodiscard]] VkSampler createSampler(VkDevice device, uint32_t miplevels, VkSamplerAddressMode addressMode,
-									  VkBool32 anisotropy);
+									  VkBool32 anisotropy, VkBool32 depthCompare = VK_FALSE);
 } // namespace blaze::util
@@ -23,6 +23,30 @@ std::vector<uint32_t> loadBinaryFile(const std::string_view& filename)
 	throw std::runtime_error("File ("s + filename.data() + ") could not be opened.");
 }
 
+uint64_t hashFile(const std::string_view& filename)
+{
+	using namespace std;
+	ifstream file(filename.data(), ios::binary);
+	if (!file.is_open())
+	{
+		throw std::runtime_error("File ("s + filename.data() + ") could not be opened.");
+	}
+
+	uint64_t hash = 0xcbf29ce484222325ull;
+	vector<char> chunk(1 << 20);
+	while (file)
+	{
+		file.read(chunk.data(), chunk.size());
+		const auto count = static_cast<size_t>(file.gcount());
+		for (size_t i = 0; i < count; i++)
+		{
+			hash ^= static_cast<uint8_t>(chunk[i]);
+			hash *= 0x100000001b3ull;
+		}
+	}
+	return hash;
+}
+
 bool fileExists(const std::string_view& filename)
 {
 	struct stat s;
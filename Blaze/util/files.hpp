@@ -1,6 +1,7 @@
 
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -33,4 +34,15 @@ bool fileExists(const std::string_view& filename);
  * @returns The binary data loaded from the file as \a vector<char>
  */
 std::vector<uint32_t> loadBinaryFile(const std::string_view& filename);
+
+/**
+ * @fn hashFile(const std::string_view& filename)
+ *
+ * @brief Hashes the contents of a file with 64 bit FNV-1a, to detect changes of source assets.
+ *
+ * @param filename The path of the file to hash.
+ *
+ * @returns The hash of the contents.
+ */
+uint64_t hashFile(const std::string_view& filename);
 } // namespace blaze::util
@@ -56,6 +56,7 @@ GEN_DEVICE_DEPENDENT_HOLDER(ShaderModule);
 GEN_DEVICE_DEPENDENT_HOLDER(Framebuffer);
 GEN_DEVICE_DEPENDENT_HOLDER(ImageView);
 GEN_DEVICE_DEPENDENT_HOLDER(Sampler);
+GEN_DEVICE_DEPENDENT_HOLDER(QueryPool);
 
 #define GEN_DEVICE_DEPENDENT_COLLECTION(Type) using Type##Vector = base::DeviceDependentVector<Vk##Type, vkDestroy##Type>
 